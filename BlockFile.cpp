@@ -0,0 +1,96 @@
+#include "BlockFile.h"
+#include "LockManager.h"
+#include <cstring>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+void BlockFile::create() {
+    this->db_open(DB_CREATE | DB_EXCL);
+}
+
+bool BlockFile::open(bool create_if_missing) {
+    if (this->is_open())
+        return true;
+    try {
+        this->db_open(0);
+        return true;
+    } catch (DbException &e) {
+        if (!create_if_missing)
+            throw;
+    }
+    this->close(); // a failed open still leaves a handle behind
+    this->create();
+    return false;
+}
+
+void BlockFile::close() {
+    if (this->db == nullptr)
+        return;
+    this->db->close(0);
+    delete this->db;
+    this->db = nullptr;
+}
+
+void BlockFile::drop() {
+    this->close();
+    _DB_ENV->dbremove(_DB_TXN, this->dbfilename.c_str(), nullptr, 0);
+}
+
+bool BlockFile::read(BlockID block_id, char *buffer) {
+    if (block_id == 0 || block_id > this->last) {
+        memset(buffer, 0, this->block_size);
+        return false;
+    }
+    Dbt key(&block_id, sizeof(block_id)), data;
+    if (this->db->get(nullptr, &key, &data, 0) != 0) {
+        memset(buffer, 0, this->block_size);
+        return false;
+    }
+    memcpy(buffer, data.get_data(), min(data.get_size(), this->block_size));
+    return true;
+}
+
+void BlockFile::lock(BlockID block_id) {
+    if (this->transactional)
+        LockManager::get().lock_block(this->dbfilename, block_id);
+}
+
+bool BlockFile::try_lock(BlockID block_id) {
+    return !this->transactional || LockManager::get().try_lock_block(this->dbfilename, block_id);
+}
+
+void BlockFile::write(BlockID block_id, const char *buffer) {
+    DbTxn *txn = this->transactional ? _DB_TXN : nullptr;  // with no transaction, the write commits itself
+    lock(block_id);
+    // RecNo files can't have holes, so fill in any blocks between the old end and this one
+    if (block_id > this->last + 1) {
+        char *zeros = new char[this->block_size];
+        memset(zeros, 0, this->block_size);
+        for (BlockID id = this->last + 1; id < block_id; id++) {
+            lock(id);
+            Dbt key(&id, sizeof(id)), data(zeros, this->block_size);
+            this->db->put(txn, &key, &data, 0);
+        }
+        delete[] zeros;
+    }
+    Dbt key(&block_id, sizeof(block_id)), data((void *) buffer, this->block_size);
+    this->db->put(txn, &key, &data, 0);
+    if (block_id > this->last)
+        this->last = block_id;
+}
+
+void BlockFile::db_open(uint flags) {
+    this->db = new Db(_DB_ENV, 0);
+    this->db->set_re_len(this->block_size); // record length - will be ignored if file already exists
+    this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    if (flags == 0) {
+        DB_BTREE_STAT *stat;
+        this->db->stat(nullptr, &stat, DB_FAST_STAT);
+        this->last = stat->bt_ndata;
+        free(stat);
+    } else {
+        this->last = 0;
+    }
+}
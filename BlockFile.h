@@ -0,0 +1,101 @@
+#pragma once
+
+#include "storage_engine.h"
+#include "db_cxx.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class BlockFile - a Berkeley DB RecNo file of raw, fixed-size blocks.
+ *
+ * Used for the side structures that live beside a heap file (e.g. its free-space map). Unlike HeapFile, the
+ * blocks have no SlottedPage structure; the owner decides what the bytes mean. Block ids start at 1.
+ *
+ * Writes are part of the current transaction, which locks each block it writes (see LockManager::lock_block),
+ * unless the file is only a hint or a summary that is never narrower than what it sums up, which a crash can
+ * leave as it was without doing harm: those writes are committed at once, and need no locks.
+ */
+class BlockFile {
+public:
+    /**
+     * @param dbfilename     the file
+     * @param block_size     size of its blocks
+     * @param transactional  false to commit each write at once, rather than as part of the current transaction
+     */
+    BlockFile(std::string dbfilename, u32 block_size, bool transactional = true) : dbfilename(dbfilename),
+                                                                                 block_size(block_size), last(0),
+                                                                                 db(nullptr),
+                                                                                 transactional(transactional) {}
+
+    virtual ~BlockFile() { close(); }
+
+    BlockFile(const BlockFile &other) = delete;
+
+    BlockFile(BlockFile &&temp) = delete;
+
+    BlockFile &operator=(const BlockFile &other) = delete;
+
+    BlockFile &operator=(BlockFile &&temp) = delete;
+
+    /**
+     * Create the (empty) file. Fails if it already exists.
+     */
+    virtual void create();
+
+    /**
+     * Open the file.
+     * @param create_if_missing  create an empty file if there isn't one yet
+     * @returns                  true if the file already existed
+     */
+    virtual bool open(bool create_if_missing = false);
+
+    virtual void close();
+
+    /**
+     * Remove the file (closing it first if necessary).
+     */
+    virtual void drop();
+
+    /**
+     * Read a block.
+     * @param block_id  which block to read
+     * @param buffer    receives block_size bytes (zeros if the block has never been written)
+     * @returns         false if the block has never been written
+     */
+    virtual bool read(BlockID block_id, char *buffer);
+
+    /**
+     * Lock a block for the current transaction to write, before changing anything that depends on it (see
+     * LockManager::lock_block); write locks what it writes itself.
+     */
+    virtual void lock(BlockID block_id);
+
+    /**
+     * Lock a block for the current transaction to write if no other transaction has it.
+     * @returns  false if another transaction has it
+     */
+    virtual bool try_lock(BlockID block_id);
+
+    /**
+     * Write a block (extending the file if block_id is past the end).
+     * @param block_id  which block to write
+     * @param buffer    block_size bytes to write
+     */
+    virtual void write(BlockID block_id, const char *buffer);
+
+    virtual BlockID get_last_block_id() const { return last; }
+
+    virtual u32 get_block_size() const { return block_size; }
+
+    bool is_open() const { return db != nullptr; }
+
+protected:
+    std::string dbfilename;
+    u32 block_size;
+    BlockID last;
+    Db *db;
+    bool transactional;
+
+    virtual void db_open(uint flags);
+};
@@ -0,0 +1,106 @@
+#include "BloomFilter.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+BloomFilter::BloomFilter(std::string name, u32 page_size, const ColumnNames &column_names,
+                         const ColumnNames &bloom_columns)
+        : file(file_name(name), (u32) bloom_columns.size() * (page_size / 32)),
+          filter_size(page_size / 32) {
+    for (auto const &column_name: column_names)
+        if (find(bloom_columns.begin(), bloom_columns.end(), column_name) != bloom_columns.end())
+            this->column_names.push_back(column_name);
+    this->entry_size = (u32) this->column_names.size() * this->filter_size;
+}
+
+void BloomFilter::create() {
+    this->drop();
+    if (this->entry_size != 0)
+        this->file.create();
+}
+
+bool BloomFilter::open() {
+    if (this->entry_size == 0 || this->file.is_open())
+        return true;
+    bool existed = this->file.open(true);
+    this->file.load(this->entries);
+    return existed;
+}
+
+void BloomFilter::close() {
+    this->file.close();
+}
+
+void BloomFilter::drop() {
+    if (this->entry_size != 0) {
+        try {
+            this->file.drop();
+        } catch (DbException &e) {
+            // wasn't there
+        }
+    }
+    this->entries.clear();
+}
+
+void BloomFilter::add(BlockID block_id, const ValueDict *row, bool fresh) {
+    if (block_id == 0 || this->entry_size == 0)
+        return;
+    if (block_id * this->entry_size > this->entries.size())
+        this->entries.resize(block_id * this->entry_size, 0);
+    char *entry = this->entries.data() + (block_id - 1) * this->entry_size;
+    if (fresh)
+        memset(entry, 0, this->entry_size);
+    u32 positions[HASH_COUNT];
+    for (uint i = 0; i < this->column_names.size(); i++) {
+        char *filter = entry + i * this->filter_size;
+        probes(row->at(this->column_names[i]), this->filter_size * 8, positions);
+        for (auto position: positions)
+            filter[position / 8] |= (char) (1 << (position % 8));
+    }
+    this->file.write_entry(this->entries, block_id);
+}
+
+bool BloomFilter::might_match(BlockID block_id, const ValueRanges &ranges) const {
+    if (block_id == 0 || block_id * this->entry_size > this->entries.size())
+        return true;  // nothing known about the block (or no filters at all)
+    const char *entry = this->entries.data() + (block_id - 1) * this->entry_size;
+    u32 positions[HASH_COUNT];
+    for (uint i = 0; i < this->column_names.size(); i++) {
+        auto range = ranges.find(this->column_names[i]);
+        if (range == ranges.end())
+            continue;
+        if (!range->second.is_equality())
+            continue;
+        const char *filter = entry + i * this->filter_size;
+        probes(range->second.min, this->filter_size * 8, positions);
+        for (auto position: positions)
+            if ((filter[position / 8] & (1 << (position % 8))) == 0)
+                return false;
+    }
+    return true;
+}
+
+// FNV-1a over the value's bytes gives two 32-bit hashes, combined (Kirsch-Mitzenmacher) into HASH_COUNT bit
+// positions. INT and BOOLEAN hash their number, so a BOOLEAN column can be looked up with an INT literal.
+void BloomFilter::probes(const Value &value, u32 bits, u32 *positions) {
+    const char *bytes;
+    size_t size;
+    if (value.data_type == ColumnAttribute::TEXT) {
+        bytes = value.s.data();
+        size = value.s.size();
+    } else {
+        bytes = (const char *) &value.n;
+        size = sizeof(value.n);
+    }
+    u_int64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (u_int8_t) bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    u32 h1 = (u32) hash, h2 = (u32) (hash >> 32) | 1;
+    for (u32 i = 0; i < HASH_COUNT; i++)
+        positions[i] = (h1 + i * h2) % bits;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include "SummaryFile.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class BloomFilter - persistent per-block Bloom filters on chosen columns of a heap table.
+ *
+ * Chosen with CREATE TABLE ... WITH (bloom = 'col1, col2'). For each heap block there is a small Bloom filter
+ * per chosen column holding every value ever added to that column in the block, so an equality on the column
+ * can skip the blocks whose filter says the value isn't there without reading them. The filters get
+ * page_size / 32 bytes each (about 1% false positives at a hundred rows a block). Deletes leave the filters
+ * alone, until VACUUM rebuilds them. The filters are kept in a
+ * SummaryFile beside the heap file. With no chosen columns there is no file and every block might match.
+ */
+class BloomFilter {
+public:
+    static const u32 HASH_COUNT = 6;  // bits set per value
+
+    /**
+     * @param name          name of the heap file these filters belong to
+     * @param page_size     block size of the heap file
+     * @param column_names  the table's columns
+     * @param bloom_columns the columns to keep filters for
+     */
+    BloomFilter(std::string name, u32 page_size, const ColumnNames &column_names, const ColumnNames &bloom_columns);
+
+    /**
+     * Name of the file holding the Bloom filters for the given heap file.
+     */
+    static std::string file_name(std::string name) { return name + ".bloom.db"; }
+
+    virtual ~BloomFilter() {}
+
+    BloomFilter(const BloomFilter &other) = delete;
+
+    BloomFilter &operator=(const BloomFilter &other) = delete;
+
+    virtual void create();
+
+    /**
+     * Open the filters.
+     * @returns  false if there were none yet (an empty file was created and needs to be rebuilt by the caller)
+     */
+    virtual bool open();
+
+    virtual void close();
+
+    /**
+     * Remove the filters' file if there is one.
+     */
+    virtual void drop();
+
+    /**
+     * Add a row's values to a block's filters.
+     * @param block_id  the block the row went into
+     * @param row       the row
+     * @param fresh     true if the block never had a row before this one, so its filters can start over
+     */
+    virtual void add(BlockID block_id, const ValueDict *row, bool fresh);
+
+    /**
+     * Could any row in the block satisfy all of the ranges? Only ranges that are equalities on a filtered
+     * column are looked at.
+     * @returns  false only if the block can be skipped
+     */
+    virtual bool might_match(BlockID block_id, const ValueRanges &ranges) const;
+
+    /**
+     * The columns with filters.
+     */
+    const ColumnNames &get_columns() const { return column_names; }
+
+protected:
+    SummaryFile file;
+    ColumnNames column_names;  // the columns with filters, in the order of their filters within an entry
+    u32 filter_size;
+    u32 entry_size;
+    std::vector<char> entries;  // in-memory copy; the entry for heap block i is at (i - 1) * entry_size
+
+    static void probes(const Value &value, u32 bits, u32 *positions);
+};
@@ -0,0 +1,61 @@
+#include "BloomFilterTests.h"
+#include "BloomFilter.h"
+
+using namespace std;
+
+namespace BloomFilterTests{
+    static ValueRanges equals(const Identifier &columnName, const Value &value){
+        ValueRanges ranges;
+        ranges[columnName].restrict_min(value, true);
+        ranges[columnName].restrict_max(value, true);
+        return ranges;
+    }
+
+    // a block's filter never rules out a value added to it, rarely lets through one that wasn't, and is still
+    // there once read back; a block starting over forgets its old values, and other columns always match
+    void testMembership(){
+        cout << "Testing Bloom filters" << endl;
+        ColumnNames columnNames = {"id", "name"};
+        ColumnNames bloomColumns = {"name"};
+        string problem;
+        {
+            BloomFilter filters("_test_bloom", DbBlock::BLOCK_SZ, columnNames, bloomColumns);
+            filters.create();
+            ValueDict row;
+            for(int i = 0; i < 100; i++){
+                row["id"] = Value(i);
+                row["name"] = Value("in " + to_string(i));
+                filters.add(1, &row, i == 0);
+                row["name"] = Value("gone " + to_string(i));
+                filters.add(2, &row, i == 0);
+            }
+            row["name"] = Value(string("only"));
+            filters.add(2, &row, true); // block 2 starts over
+        }
+        BloomFilter filters("_test_bloom", DbBlock::BLOCK_SZ, columnNames, bloomColumns);
+        if(!filters.open())
+            problem = "Bloom filters weren't there once read back";
+        int falsePositives = 0;
+        for(int i = 0; i < 100 && problem.empty(); i++){
+            if(!filters.might_match(1, equals("name", Value("in " + to_string(i)))))
+                problem = "Bloom filter ruled out a value that was added to its block";
+            if(filters.might_match(1, equals("name", Value("out " + to_string(i)))))
+                falsePositives++;
+            if(filters.might_match(2, equals("name", Value("gone " + to_string(i)))))
+                falsePositives++;
+        }
+        if(problem.empty() && falsePositives > 10)
+            problem = "Bloom filters let through " + to_string(falsePositives) + " of 200 values not in their blocks";
+        if(problem.empty() && !filters.might_match(2, equals("name", Value(string("only")))))
+            problem = "Bloom filter ruled out a value added once its block started over";
+        if(problem.empty() && !filters.might_match(1, equals("id", Value(1000))))
+            problem = "Bloom filters ruled out a value of a column they aren't kept on";
+        filters.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testMembership();
+    }
+}
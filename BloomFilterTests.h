@@ -0,0 +1,6 @@
+#pragma once
+
+namespace BloomFilterTests{
+    void testMembership();
+    void testAll();
+}
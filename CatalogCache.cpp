@@ -0,0 +1,67 @@
+#include "CatalogCache.h"
+
+using namespace std;
+
+std::atomic<Epoch::Number> Epoch::global(1);
+std::atomic<Epoch::Reader *> Epoch::readers(nullptr);
+
+namespace {
+    // gives the thread's slot back when the thread ends
+    struct ReaderSlot {
+        atomic<bool> *in_use = nullptr;
+
+        ~ReaderSlot() {
+            if (in_use != nullptr)
+                in_use->store(false);
+        }
+    };
+}
+
+// A thread takes a slot left by one that has ended, or adds one, the first time it reads.
+Epoch::Reader &Epoch::reader() {
+    static thread_local Reader *own = nullptr;
+    static thread_local ReaderSlot slot;
+    if (own != nullptr)
+        return *own;
+    for (Reader *r = readers.load(); r != nullptr && own == nullptr; r = r->next) {
+        bool free = false;
+        if (r->in_use.compare_exchange_strong(free, true))
+            own = r;
+    }
+    if (own == nullptr) {
+        own = new Reader();
+        Reader *head = readers.load();
+        do {
+            own->next = head;
+        } while (!readers.compare_exchange_weak(head, own));
+    }
+    slot.in_use = &own->in_use;
+    return *own;
+}
+
+// The announcement is made before the structure is read (both are sequentially consistent), so a writer that swaps
+// it out afterwards is sure to see the announcement when it checks is_quiet.
+Epoch::Guard::Guard() {
+    Reader &r = reader();
+    if (r.depth++ == 0)
+        r.epoch.store(global.load());
+}
+
+Epoch::Guard::~Guard() {
+    Reader &r = reader();
+    if (--r.depth == 0)
+        r.epoch.store(0);
+}
+
+Epoch::Number Epoch::advance() {
+    return ++global;
+}
+
+bool Epoch::is_quiet(Number retired_at) {
+    for (Reader *r = readers.load(); r != nullptr; r = r->next) {
+        Number announced = r->epoch.load();
+        if (announced != 0 && announced < retired_at)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sys/types.h>
+#include <utility>
+#include <vector>
+using namespace std;
+
+/**
+ * @class Epoch - lets threads read shared structures with no locks while others replace them, by putting off
+ * freeing what was replaced until no reader can still be looking at it (epoch-based reclamation).
+ *
+ * A reader announces the epoch it read in for as long as it's reading (see Guard). A writer swaps in the new
+ * structure, then advances the epoch and retires the old one at the new epoch: it may be freed once every reader
+ * is either reading nothing or announced that epoch or a later one, since readers that announced it started after
+ * the swap and so never saw the old one.
+ */
+class Epoch {
+public:
+    typedef u_int64_t Number;
+
+    /**
+     * @class Guard - the current thread is reading from now until the guard goes out of scope (may be nested).
+     */
+    class Guard {
+    public:
+        Guard();
+
+        ~Guard();
+
+        Guard(const Guard &other) = delete;
+
+        Guard &operator=(const Guard &other) = delete;
+    };
+
+    /**
+     * Advance the epoch, after swapping out something readers may be looking at.
+     * @returns  the epoch to retire it at
+     */
+    static Number advance();
+
+    /**
+     * Whether no reader can be looking at anything retired at an epoch.
+     */
+    static bool is_quiet(Number retired_at);
+
+protected:
+    struct Reader {
+        std::atomic<Number> epoch;  // what it announced, or 0 if it isn't reading
+        std::atomic<bool> in_use;   // by a thread (a slot is reused once its thread has ended)
+        u_int32_t depth;            // of nested guards (only touched by its own thread)
+        Reader *next;
+
+        Reader() : epoch(0), in_use(true), depth(0), next(nullptr) {}
+    };
+
+    static std::atomic<Number> global;
+    static std::atomic<Reader *> readers;  // every slot there has ever been, newest first (never freed)
+
+    static Reader &reader();
+};
+
+
+/**
+ * @class CatalogCache - a map from names to the objects (tables, indices) built for them, which any number of
+ * threads can look up in without locks while DDL changes it.
+ *
+ * The map is never changed in place: a change copies it, changes the copy and publishes that in one atomic store,
+ * so a lookup sees either the old map or the new one, whole. Changes are made one at a time. The maps replaced are
+ * freed once no lookup can still be reading them (see Epoch). The objects themselves are owned by the caller, who
+ * frees those it takes out; the table locks keep anyone else from using a table's objects while DDL replaces them.
+ * Objects that lookups may still be using when they're taken out, with no table lock to keep them off, are handed
+ * back through retire instead, to be freed along with the maps; such lookups copy them out with get.
+ */
+template<class Key, class Value>
+class CatalogCache {
+public:
+    typedef std::map<Key, Value *> Map;
+
+    CatalogCache() : published(new Map()) {}
+
+    virtual ~CatalogCache() {
+        delete published.load();
+        for (auto const &retiree: retired)
+            delete retiree.second;
+        for (auto const &retiree: retired_values)
+            delete retiree.second;
+    }
+
+    CatalogCache(const CatalogCache &other) = delete;
+
+    CatalogCache &operator=(const CatalogCache &other) = delete;
+
+    /**
+     * @returns  what is cached for a key, or nullptr if nothing is
+     */
+    Value *find(const Key &key) const {
+        Epoch::Guard guard;
+        const Map *map = published.load();
+        auto found = map->find(key);
+        return found == map->end() ? nullptr : found->second;
+    }
+
+    /**
+     * Copy what is cached for a key while no one can free it.
+     * @returns  whether anything is
+     */
+    bool get(const Key &key, Value &copy) const {
+        Epoch::Guard guard;
+        const Map *map = published.load();
+        auto found = map->find(key);
+        if (found == map->end())
+            return false;
+        copy = *found->second;
+        return true;
+    }
+
+    /**
+     * Cache an object for a key, unless another thread has just cached one for it.
+     * @returns  the one cached (the caller frees the one it offered if that isn't it)
+     */
+    Value *insert(const Key &key, Value *value) {
+        std::lock_guard<std::mutex> guard(writer_lock);
+        const Map *map = published.load();
+        auto found = map->find(key);
+        if (found != map->end())
+            return found->second;
+        Map *changed = new Map(*map);
+        (*changed)[key] = value;
+        publish(changed);
+        return value;
+    }
+
+    /**
+     * Cache an object for a key in place of whatever was cached for it.
+     * @returns  what was (for the caller to free, if need be), or nullptr
+     */
+    Value *assign(const Key &key, Value *value) {
+        std::lock_guard<std::mutex> guard(writer_lock);
+        const Map *map = published.load();
+        auto found = map->find(key);
+        Value *replaced = found == map->end() ? nullptr : found->second;
+        Map *changed = new Map(*map);
+        (*changed)[key] = value;
+        publish(changed);
+        return replaced;
+    }
+
+    /**
+     * Stop caching whatever is cached for a key.
+     * @returns  what was (for the caller to free), or nullptr
+     */
+    Value *erase(const Key &key) {
+        std::vector<Value *> erased = erase_if([&key](const Key &cached) { return cached == key; });
+        return erased.empty() ? nullptr : erased.front();
+    }
+
+    /**
+     * Stop caching whatever is cached for the keys that match.
+     * @returns  what was (for the caller to free)
+     */
+    std::vector<Value *> erase_if(const std::function<bool(const Key &key)> &matches) {
+        std::lock_guard<std::mutex> guard(writer_lock);
+        const Map *map = published.load();
+        std::vector<Value *> erased;
+        Map *changed = new Map();
+        for (auto const &entry: *map) {
+            if (matches(entry.first))
+                erased.push_back(entry.second);
+            else
+                changed->insert(changed->end(), entry);
+        }
+        if (erased.empty())
+            delete changed;
+        else
+            publish(changed);
+        return erased;
+    }
+
+    /**
+     * Free objects taken out (by erase etc.) once no lookup can still be reading them.
+     */
+    void retire(const std::vector<Value *> &values) {
+        if (values.empty())
+            return;
+        std::lock_guard<std::mutex> guard(writer_lock);
+        Epoch::Number retired_at = Epoch::advance();
+        for (auto value: values)
+            retired_values.push_back(std::make_pair(retired_at, value));
+        collect();
+    }
+
+protected:
+    std::atomic<const Map *> published;
+    std::mutex writer_lock;  // one change at a time
+    std::vector<std::pair<Epoch::Number, const Map *>> retired;  // replaced maps not yet freed (guarded by writer_lock)
+    std::vector<std::pair<Epoch::Number, Value *>> retired_values;  // likewise for retired objects
+
+    // Call with writer_lock held.
+    void publish(const Map *changed) {
+        const Map *old = published.exchange(changed);
+        retired.push_back(std::make_pair(Epoch::advance(), old));
+        collect();
+    }
+
+    // Free what was retired that no lookup can still be reading. Call with writer_lock held.
+    void collect() {
+        collect(retired);
+        collect(retired_values);
+    }
+
+    template<class T>
+    static void collect(std::vector<std::pair<Epoch::Number, T *>> &retirees) {
+        auto keep = retirees.begin();
+        for (auto const &retiree: retirees) {
+            if (Epoch::is_quiet(retiree.first))
+                delete retiree.second;
+            else
+                *keep++ = retiree;
+        }
+        retirees.erase(keep, retirees.end());
+    }
+};
@@ -0,0 +1,44 @@
+#include "CatalogCacheTests.h"
+#include "CatalogCache.h"
+#include "storage_engine.h"
+#include <atomic>
+#include <iostream>
+
+using namespace std;
+
+namespace CatalogCacheTests{
+    struct Counted {
+        static atomic<int> alive;
+        Counted(){ alive++; }
+        ~Counted(){ alive--; }
+    };
+    atomic<int> Counted::alive(0);
+
+    // what a catalog cache replaces (maps and retired objects) isn't freed while a lookup that began before it
+    // was replaced is still going, and is freed after
+    void testRetiring(){
+        cout << "Testing catalog caches" << endl;
+        {
+            CatalogCache<Identifier, Counted> cache;
+            cache.insert("a", new Counted());
+            Counted *found;
+            {
+                Epoch::Guard reading; // a lookup still going on
+                found = cache.find("a");
+                cache.retire(cache.erase_if([](const Identifier &) { return true; }));
+                cache.insert("b", new Counted());  // publishing again frees nothing the lookup could see
+                if(Counted::alive != 2 || found == nullptr)
+                    throw DbRelationError("catalog cache freed an object a lookup was still using");
+            }
+            cache.retire(vector<Counted *>(1, cache.erase("b"))); // nobody reading now, so both go
+            if(Counted::alive != 0)
+                throw DbRelationError("catalog cache didn't free retired objects once nobody was reading");
+            if(cache.find("a") != nullptr || cache.find("b") != nullptr)
+                throw DbRelationError("catalog cache still finds what was erased");
+        }
+    }
+
+    void testAll(){
+        testRetiring();
+    }
+}
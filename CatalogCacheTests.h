@@ -0,0 +1,6 @@
+#pragma once
+
+namespace CatalogCacheTests{
+    void testRetiring();
+    void testAll();
+}
@@ -0,0 +1,307 @@
+#include "ColumnarTable.h"
+#include "HeapTable.h"
+#include "LockManager.h"
+#include "UndoLog.h"
+#include "VersionStore.h"
+#include <algorithm>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+// Same file name as a HeapTable's, so the transaction manager's file locks work the same for both.
+ColumnarTable::ColumnarTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                             const TableOptions &options) : DbRelation(table_name, column_names, column_attributes),
+                                                            file(table_name + ".db", HeapTable::page_size(options)),
+                                                            cached_block_id(0), cached_page(nullptr) {
+}
+
+ColumnarTable::~ColumnarTable() {
+    forget_page();
+}
+
+bool ColumnarTable::is_columnar(const TableOptions &options) {
+    auto option = options.find("format");
+    if (option == options.end())
+        return false;
+    string value = option->second;
+    transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value == "columnar";
+}
+
+void ColumnarTable::validate_options(const TableOptions &options) {
+    for (auto const &option: options)
+        if (option.first != "format" && option.first != "page_size")
+            throw DbRelationError("table option '" + option.first + "' is not supported for columnar tables");
+    HeapTable::page_size(options);
+}
+
+void ColumnarTable::create() {
+    this->file.create();
+    if (UndoLog::current != nullptr)
+        UndoLog::current->created(this->table_name);
+}
+
+void ColumnarTable::create_if_not_exists() {
+    try {
+        this->file.create();
+    } catch (...) {
+        this->file.open();
+    }
+}
+
+void ColumnarTable::drop() {
+    forget_page();
+    this->file.drop();
+}
+
+void ColumnarTable::open() {
+    this->file.open();
+}
+
+void ColumnarTable::close() {
+    forget_page();
+    this->file.close();
+}
+
+// Goes at the end of the last block, or else in a new block after it. A block another transaction is writing
+// can't be written by this one till that one ends (see LockManager::lock_block), so then it's the one before
+// the last (where a transaction taking turns with another is likely to have been putting its rows) or a new one.
+Handle ColumnarTable::insert(const ValueDict *row) {
+    this->open();
+    LockManager::get().lock_table(this->table_name, LockManager::IX);
+    vector<Value> values;
+    for (uint col = 0; col < this->column_names.size(); col++) {
+        auto column = row->find(this->column_names[col]);
+        if (column == row->end())
+            throw DbRelationError("don't know how to handle NULLs, defaults, etc. yet");
+        Value value = column->second;
+        ColumnAttribute::DataType data_type = this->column_attributes[col].get_data_type();
+        if ((data_type == ColumnAttribute::TEXT) != (value.data_type == ColumnAttribute::TEXT))
+            throw DbRelationError("wrong type of value for column '" + this->column_names[col] + "'");
+        value.data_type = data_type;
+        values.push_back(value);
+    }
+
+    RecordID record_id;
+    BlockID last = this->file.get_last_block_id();
+    for (BlockID block_id = last; block_id != 0 && block_id + 1 >= last; block_id--) {
+        if (!this->file.try_lock(block_id))
+            continue;
+        PaxPage *page = get_page(block_id);
+        if (page->add(values, record_id)) {
+            put_page(block_id, page);
+            if (UndoLog::current != nullptr)
+                UndoLog::current->inserted(this->table_name, Handle(block_id, record_id));
+            VersionStore::get().changed(this->table_name, Handle(block_id, record_id), nullptr);
+            return Handle(block_id, record_id);
+        }
+        break;
+    }
+    BlockID block_id = last + 1;
+    PaxPage *page = new PaxPage(this->column_attributes, vector<char>(this->file.get_block_size()), true);
+    if (!page->add(values, record_id)) {
+        delete page;
+        throw DbRelationError("row too big to fit in a block");
+    }
+    put_page(block_id, page);
+    if (UndoLog::current != nullptr)
+        UndoLog::current->inserted(this->table_name, Handle(block_id, record_id));
+    VersionStore::get().changed(this->table_name, Handle(block_id, record_id), nullptr);
+    return Handle(block_id, record_id);
+}
+
+// A page's rows can't change size in place, so the old version is marked deleted and the new one goes wherever
+// insert puts it. Each half records itself (for rollback and for snapshots) just as a delete and an insert would:
+// rolling back takes the new row out and brings the old one back under its own handle.
+void ColumnarTable::update(const Handle handle, const ValueDict *new_values) {
+    this->open();
+    LockManager::get().lock_row(this->table_name, handle, LockManager::X);
+    this->file.lock(handle.first);
+    VersionStore::get().check_writable(this->table_name, handle);
+    PaxPage *page = get_page(handle.first);
+    if (page->is_deleted(handle.second))
+        throw DbRelationError("no such row in " + this->table_name);
+    ValueDict row;
+    for (uint col = 0; col < this->column_names.size(); col++)
+        row[this->column_names[col]] = page->get(handle.second, col);
+    for (auto const &column: *new_values) {
+        if (row.find(column.first) == row.end())
+            throw DbRelationError("Column does not exist: '" + column.first + "'");
+        row[column.first] = column.second;
+    }
+    del(handle);
+    insert(&row);
+}
+
+void ColumnarTable::del(const Handle handle) {
+    this->open();
+    LockManager::get().lock_row(this->table_name, handle, LockManager::X);
+    this->file.lock(handle.first);  // before the cached page changes
+    VersionStore::get().check_writable(this->table_name, handle);
+    PaxPage *page = get_page(handle.first);
+    if (VersionStore::current != nullptr) {
+        ValueDict before;
+        for (uint col = 0; col < this->column_names.size(); col++)
+            before[this->column_names[col]] = page->get(handle.second, col);
+        VersionStore::get().changed(this->table_name, handle, &before);
+    }
+    page->del(handle.second);
+    put_page(handle.first, page);
+    if (UndoLog::current != nullptr)
+        UndoLog::current->deleted(this->table_name, handle, ValueDict());
+}
+
+// A deleted row's values stay in its page, so neither inserts nor deletes need a copy of the row to undo them.
+Handle ColumnarTable::undo(const UndoRecord &record) {
+    if (record.kind != UndoRecord::INSERTED && record.kind != UndoRecord::DELETED)
+        return DbRelation::undo(record);
+    this->open();
+    PaxPage *page = get_page(record.handle.first);
+    if (record.kind == UndoRecord::INSERTED)
+        page->del(record.handle.second);
+    else
+        page->undel(record.handle.second);
+    put_page(record.handle.first, page);
+    return record.handle;
+}
+
+Handles *ColumnarTable::select() {
+    return select(nullptr);
+}
+
+Handles *ColumnarTable::select(const ValueDict *where) {
+    this->open();
+    vector<pair<uint, Value>> predicates;
+    if (where != nullptr)
+        for (auto const &column: *where)
+            predicates.push_back(make_pair(column_number(column.first), column.second));
+
+    Handles *handles = new Handles();
+    for (BlockID block_id = 1; block_id <= this->file.get_last_block_id(); block_id++) {
+        PaxPage *page = get_page(block_id);
+        RecordID n_rows = page->get_row_count();
+        if (n_rows == 0)
+            continue;
+        bool pruned = false;
+        for (auto const &predicate: predicates)
+            if (predicate.second < page->get_min(predicate.first) || page->get_max(predicate.first) < predicate.second)
+                pruned = true;
+        if (pruned)
+            continue;
+
+        vector<char> selected(n_rows);
+        for (RecordID record_id = 1; record_id <= n_rows; record_id++)
+            selected[record_id - 1] = (char) !page->is_deleted(record_id);
+        for (auto const &predicate: predicates)
+            page->match(predicate.first, predicate.second, selected);
+        for (RecordID record_id = 1; record_id <= n_rows; record_id++)
+            if (selected[record_id - 1])
+                handles->push_back(Handle(block_id, record_id));
+    }
+    VersionStore::get().select(this->table_name, handles, [where](const ValueDict &row) {
+        if (where != nullptr)
+            for (auto const &column: *where)
+                if (row.at(column.first) != column.second)
+                    return false;
+        return true;
+    });
+    return handles;
+}
+
+// Like the equality select, skipping blocks whose min/max fall outside any of the ranges.
+Handles *ColumnarTable::select(const ValueRanges &ranges) {
+    this->open();
+    vector<pair<uint, const ValueRange *>> predicates;
+    for (auto const &range: ranges)
+        predicates.push_back(make_pair(column_number(range.first), &range.second));
+
+    Handles *handles = new Handles();
+    for (BlockID block_id = 1; block_id <= this->file.get_last_block_id(); block_id++) {
+        PaxPage *page = get_page(block_id);
+        RecordID n_rows = page->get_row_count();
+        bool pruned = n_rows == 0;
+        for (auto const &predicate: predicates)
+            if (!pruned && !predicate.second->overlaps(page->get_min(predicate.first), page->get_max(predicate.first)))
+                pruned = true;
+        if (pruned)
+            continue;
+        for (RecordID record_id = 1; record_id <= n_rows; record_id++) {
+            if (page->is_deleted(record_id))
+                continue;
+            bool selected = true;
+            for (auto const &predicate: predicates)
+                selected = selected && predicate.second->contains(page->get(record_id, predicate.first));
+            if (selected)
+                handles->push_back(Handle(block_id, record_id));
+        }
+    }
+    VersionStore::get().select(this->table_name, handles, [&ranges](const ValueDict &row) {
+        for (auto const &range: ranges)
+            if (!range.second.contains(row.at(range.first)))
+                return false;
+        return true;
+    });
+    return handles;
+}
+
+ValueDict *ColumnarTable::project(Handle handle) {
+    return project(handle, &this->column_names);
+}
+
+// Only the minipages of the columns asked for are looked at.
+ValueDict *ColumnarTable::project(Handle handle, const ColumnNames *column_names) {
+    this->open();
+    ValueDict *row = VersionStore::get().project(this->table_name, handle, column_names);
+    if (row != nullptr)
+        return row;
+    if (column_names->empty())
+        column_names = &this->column_names;
+    PaxPage *page = get_page(handle.first);
+    if (page->is_deleted(handle.second))
+        throw DbRelationError("no such row in " + this->table_name);
+    ValueDict *result = new ValueDict();
+    for (auto const &column_name: *column_names)
+        (*result)[column_name] = page->get(handle.second, column_number(column_name));
+    return result;
+}
+
+BlockID ColumnarTable::get_block_count() {
+    this->open();
+    return this->file.get_last_block_id();
+}
+
+PaxPage *ColumnarTable::get_page(BlockID block_id) {
+    if (block_id == this->cached_block_id)
+        return this->cached_page;
+    vector<char> bytes(this->file.get_block_size());
+    if (!this->file.read(block_id, bytes.data()))
+        throw DbRelationError("no block " + to_string(block_id) + " in " + this->table_name);
+    PaxPage *page = new PaxPage(this->column_attributes, std::move(bytes), false);
+    forget_page();
+    this->cached_block_id = block_id;
+    this->cached_page = page;
+    return page;
+}
+
+void ColumnarTable::put_page(BlockID block_id, PaxPage *page) {
+    this->file.write(block_id, page->get_data());
+    if (page != this->cached_page) {
+        forget_page();
+        this->cached_block_id = block_id;
+        this->cached_page = page;
+    }
+}
+
+uint ColumnarTable::column_number(const Identifier &column_name) const {
+    auto column = find(this->column_names.begin(), this->column_names.end(), column_name);
+    if (column == this->column_names.end())
+        throw DbRelationError("Column does not exist: '" + column_name + "'");
+    return (uint) (column - this->column_names.begin());
+}
+
+void ColumnarTable::forget_page() {
+    delete this->cached_page;
+    this->cached_page = nullptr;
+    this->cached_block_id = 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "storage_engine.h"
+#include "BlockFile.h"
+#include "PaxPage.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class ColumnarTable - column-oriented storage engine (implementation of DbRelation)
+ *
+ * Chosen with CREATE TABLE ... WITH (format = columnar). The rows are kept in PaxPage blocks in a BlockFile,
+ * each block storing its rows column by column, so a select or project only decodes the columns it's asked
+ * about. Equality selects skip any block whose per-column min/max rule the value out, and check the rest a
+ * column at a time. Handles are (block id, row id within the block) just as for a HeapTable, except that an
+ * update moves the row to a new handle (a delete and an insert).
+ */
+class ColumnarTable : public DbRelation {
+public:
+    ColumnarTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                  const TableOptions &options = TableOptions());
+
+    virtual ~ColumnarTable();
+
+    ColumnarTable(const ColumnarTable &other) = delete;
+
+    ColumnarTable(ColumnarTable &&temp) = delete;
+
+    ColumnarTable &operator=(const ColumnarTable &other) = delete;
+
+    ColumnarTable &operator=(ColumnarTable &&temp) = delete;
+
+    virtual void create();
+
+    virtual void create_if_not_exists();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual Handle insert(const ValueDict *row);
+
+    virtual void update(const Handle handle, const ValueDict *new_values);
+
+    virtual void del(const Handle handle);
+
+    virtual Handle undo(const UndoRecord &record);
+
+    virtual Handles *select();
+
+    virtual Handles *select(const ValueDict *where);
+
+    virtual Handles *select(const ValueRanges &ranges);
+
+    virtual ValueDict *project(Handle handle);
+
+    virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
+
+    virtual BlockID get_block_count();
+
+    /**
+     * See whether a table's storage options ask for the columnar format.
+     * @param options  the table's options
+     * @returns        true if the format option is columnar
+     */
+    static bool is_columnar(const TableOptions &options);
+
+    /**
+     * Check the storage options given to CREATE TABLE for a columnar table.
+     * Recognized: format (columnar), page_size (as for HeapTable)
+     * @param options  the options to check
+     * @throws         DbRelationError if an option is unknown or has a bad value
+     */
+    static void validate_options(const TableOptions &options);
+
+protected:
+    BlockFile file;
+    BlockID cached_block_id;  // the last block read or written, kept since projects come a row at a time
+    PaxPage *cached_page;
+
+    virtual PaxPage *get_page(BlockID block_id);
+
+    virtual void put_page(BlockID block_id, PaxPage *page);
+
+    virtual uint column_number(const Identifier &column_name) const;
+
+    virtual void forget_page();
+};
@@ -0,0 +1,97 @@
+#include "ColumnarTableTests.h"
+#include "ColumnarTable.h"
+#include "PaxPage.h"
+
+using namespace std;
+
+namespace ColumnarTableTests{
+    // a PAX page takes rows until it's full, and gives each column of each row back, as it is and once read
+    // back from its bytes, with the min and max of each column
+    void testPaxPage(){
+        cout << "Testing PAX pages" << endl;
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        PaxPage page(columnAttributes, vector<char>(DbBlock::BLOCK_SZ), true);
+        vector<vector<Value>> rows;
+        RecordID id;
+        for(int i = 0; ; i++){
+            vector<Value> row = {Value(i * 7 % 100 - 50), Value(string(i % 20, (char) ('a' + i % 26)))};
+            if(!page.add(row, id))
+                break;
+            rows.push_back(row);
+        }
+        page.del(2);
+        vector<char> bytes(page.get_data(), page.get_data() + DbBlock::BLOCK_SZ);
+        PaxPage readBack(columnAttributes, move(bytes), false);
+        string problem;
+        if(rows.size() < 50 || page.get_row_count() != rows.size())
+            problem = "PAX page only took " + to_string(rows.size()) + " small rows";
+        else if(!readBack.is_deleted(2) || readBack.is_deleted(1))
+            problem = "PAX page didn't keep track of which rows are deleted";
+        int32_t least = 0, most = 0;
+        for(RecordID r = 1; r <= rows.size() && problem.empty(); r++){
+            least = min(least, rows[r - 1][0].n);
+            most = max(most, rows[r - 1][0].n);
+            for(uint col = 0; col < 2; col++)
+                if(page.get(r, col) != rows[r - 1][col] || readBack.get(r, col) != rows[r - 1][col])
+                    problem = "PAX page gave back the wrong value for row " + to_string(r) + " column " + to_string(col);
+        }
+        if(problem.empty() && (readBack.get_min(0).n > least || readBack.get_max(0).n < most))
+            problem = "PAX page's min and max don't cover its values";
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // rows put in a columnar table come back the same, from selects on any column, and updated or deleted
+    void testRoundTrip(){
+        cout << "Testing columnar tables" << endl;
+        ColumnNames columnNames = {"id", "name"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        ColumnarTable table("_test_columnar", columnNames, columnAttributes);
+        table.create();
+        vector<Handle> handles;
+        ValueDict row;
+        for(int i = 0; i < 2000; i++){
+            row["id"] = Value(i);
+            row["name"] = Value("name " + to_string(i % 50));
+            handles.push_back(table.insert(&row));
+        }
+        ValueDict newValues;
+        newValues["name"] = Value(string("renamed"));
+        table.update(handles[10], &newValues); // moves it
+        table.del(handles[20]);
+
+        string problem;
+        Handles *all = table.select();
+        if(all->size() != 1999)
+            problem = "columnar table has " + to_string(all->size()) + " rows instead of 1999";
+        for(auto const &handle : *all){
+            ValueDict *got = table.project(handle);
+            int id = (*got)["id"].n;
+            string name = id == 10 ? "renamed" : "name " + to_string(id % 50);
+            if(problem.empty() && (id == 20 || (*got)["name"].s != name))
+                problem = "columnar table gave back the wrong row for id " + to_string(id);
+            delete got;
+        }
+        delete all;
+        ValueDict where;
+        where["name"] = Value(string("name 7"));
+        Handles *named = table.select(&where);
+        if(problem.empty() && named->size() != 40)
+            problem = "selecting by name found " + to_string(named->size()) + " rows instead of 40";
+        delete named;
+        where.clear();
+        where["id"] = Value(1999);
+        Handles *last = table.select(&where);
+        if(problem.empty() && (last->size() != 1 || last->front() != handles[1999]))
+            problem = "selecting by id didn't find the last row where it was put";
+        delete last;
+        table.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testPaxPage();
+        testRoundTrip();
+    }
+}
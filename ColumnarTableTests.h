@@ -0,0 +1,7 @@
+#pragma once
+
+namespace ColumnarTableTests{
+    void testPaxPage();
+    void testRoundTrip();
+    void testAll();
+}
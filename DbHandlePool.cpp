@@ -0,0 +1,90 @@
+#include "DbHandlePool.h"
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+DbHandlePool::DbHandlePool(std::string dbfilename, u32 record_length) : dbfilename(dbfilename),
+                                                                         record_length(record_length),
+                                                                         opened(false), handle_count(0) {
+}
+
+// Closing a Berkeley DB handle that is still open is all its destructor would do, without telling us of failure.
+DbHandlePool::~DbHandlePool() {
+    try {
+        this->close();
+    } catch (exception &e) {
+        // nothing to be done about it now
+    }
+}
+
+void DbHandlePool::open(u32 flags) {
+    lock_guard<mutex> guard(this->lock);
+    if (this->opened)
+        return;
+    this->idle.push_back(this->open_handle(flags));
+    this->handle_count = 1;
+    this->opened = true;
+}
+
+// A Berkeley DB handle can't be opened again once closed, so every handle is deleted too.
+void DbHandlePool::close() {
+    lock_guard<mutex> guard(this->lock);
+    if (!this->opened)
+        return;
+    if (this->idle.size() != this->handle_count)
+        throw DbRelationError("can't close " + this->dbfilename + " while it is in use");
+    this->opened = false;
+    this->handle_count = 0;
+    vector<Db *> handles;
+    handles.swap(this->idle);
+    bool failed = false;
+    for (auto db: handles) {
+        try {
+            db->close(0);
+        } catch (DbException &e) {
+            failed = true;
+        }
+        delete db;
+    }
+    if (failed)
+        throw DbRelationError("could not close " + this->dbfilename);
+}
+
+size_t DbHandlePool::get_handle_count() {
+    lock_guard<mutex> guard(this->lock);
+    return this->handle_count;
+}
+
+Db *DbHandlePool::open_handle(u32 flags) {
+    Db *db = new Db(_DB_ENV, 0);
+    try {
+        if (this->record_length != 0)
+            db->set_re_len(this->record_length);
+        db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags | DB_THREAD, 0644);
+    } catch (DbException &e) {
+        delete db;
+        throw;
+    }
+    return db;
+}
+
+// Another handle is only opened once the file is, so it never needs creating.
+Db *DbHandlePool::acquire() {
+    lock_guard<mutex> guard(this->lock);
+    if (!this->opened)
+        throw DbRelationError(this->dbfilename + " is not open");
+    if (!this->idle.empty()) {
+        Db *db = this->idle.back();
+        this->idle.pop_back();
+        return db;
+    }
+    Db *db = this->open_handle(0);
+    this->handle_count++;
+    return db;
+}
+
+void DbHandlePool::release(Db *db) {
+    lock_guard<mutex> guard(this->lock);
+    this->idle.push_back(db);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "db_cxx.h"
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class DbHandlePool - the Berkeley DB handles open on a file, lent out to the threads that read and write it.
+ *
+ * The handles are free-threaded (DB_THREAD), but calls through one handle still contend for its mutex, so each
+ * thread borrows a handle of its own for as long as it needs one (see Lease) and gives it back for another thread
+ * to use. The pool opens another handle when every one it has is out, so it holds as many as the most threads that
+ * have used the file at once. Records read through a free-threaded handle have to be read into memory of the
+ * caller's (DB_DBT_USERMEM), not the handle's, so what is read stays put when the handle is lent out again.
+ */
+class DbHandlePool {
+public:
+    /**
+     * @class Lease - a handle borrowed from the pool until the lease goes out of scope.
+     */
+    class Lease {
+    public:
+        explicit Lease(DbHandlePool &pool) : pool(pool), db(pool.acquire()) {}
+
+        ~Lease() { pool.release(db); }
+
+        Lease(const Lease &other) = delete;
+
+        Lease &operator=(const Lease &other) = delete;
+
+        Db *operator->() const { return db; }
+
+    private:
+        DbHandlePool &pool;
+        Db *db;
+    };
+
+    /**
+     * @param dbfilename     the Berkeley DB file
+     * @param record_length  length of its RecNo records (0 if they vary)
+     */
+    DbHandlePool(std::string dbfilename, u32 record_length);
+
+    virtual ~DbHandlePool();
+
+    DbHandlePool(const DbHandlePool &other) = delete;
+
+    DbHandlePool &operator=(const DbHandlePool &other) = delete;
+
+    /**
+     * Open the file through the pool's first handle.
+     * @param flags  DB_CREATE etc., as for Db::open
+     */
+    virtual void open(u32 flags = 0);
+
+    /**
+     * Close every handle. None may be lent out.
+     */
+    virtual void close();
+
+    bool is_open() const { return opened; }
+
+    /**
+     * How many handles the pool has open.
+     */
+    virtual size_t get_handle_count();
+
+protected:
+    std::string dbfilename;
+    u32 record_length;
+    bool opened;
+    std::vector<Db *> idle;  // handles not lent out
+    size_t handle_count;     // idle or lent out
+    std::mutex lock;
+
+    Db *open_handle(u32 flags);
+
+    Db *acquire();
+
+    void release(Db *db);
+};
@@ -0,0 +1,105 @@
+#include "DbHandlePoolTests.h"
+#include "DbHandlePool.h"
+#include "HeapFile.h"
+#include <atomic>
+#include <thread>
+
+using namespace std;
+
+namespace DbHandlePoolTests{
+    static const u32 BLOCK_SIZE = 4096;
+    static const BlockID BLOCKS = 50;
+
+    // blocks holding a record naming themselves
+    static void fill(HeapFile &file){
+        file.create();
+        for(BlockID block_id = 1; block_id <= BLOCKS; block_id++){
+            SlottedPage *block = block_id == 1 ? file.get(1) : file.get_new();
+            string record = "block " + to_string(block_id);
+            Dbt data((void *) record.c_str(), (u_int32_t) record.size() + 1);
+            block->add(&data);
+            file.put(block);
+            delete block;
+        }
+        file.close();
+    }
+
+    // leases out at once get handles of their own, a handle given back is lent out again, and nothing is lent
+    // out once the pool is closed
+    void testLeases(){
+        cout << "Testing handle leases" << endl;
+        HeapFile file("_test_handles", BLOCK_SIZE);
+        fill(file);
+        DbHandlePool pool("_test_handles.db", BLOCK_SIZE);
+        pool.open();
+        string problem;
+        {
+            DbHandlePool::Lease first(pool);
+            DbHandlePool::Lease second(pool);
+            if(first.operator->() == second.operator->())
+                problem = "two leases got the same handle";
+        }
+        {
+            DbHandlePool::Lease again(pool);
+            if(problem.empty() && pool.get_handle_count() != 2)
+                problem = "pool has " + to_string(pool.get_handle_count()) + " handles after two at once";
+        }
+        pool.close();
+        try{
+            DbHandlePool::Lease closed(pool);
+            if(problem.empty())
+                problem = "lent out a handle after closing";
+        } catch(DbRelationError &e){
+        }
+        file.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // threads reading at once each read through a handle of their own into their own memory, so every block
+    // comes back whole
+    void testConcurrentReaders(){
+        cout << "Testing concurrent readers" << endl;
+        HeapFile file("_test_handles", BLOCK_SIZE);
+        fill(file);
+        DbHandlePool pool("_test_handles.db", BLOCK_SIZE);
+        pool.open();
+        atomic<int> wrong(0);
+        vector<thread> readers;
+        for(int reader = 0; reader < 8; reader++)
+            readers.push_back(thread([&, reader](){
+                for(int n = 0; n < 500; n++){
+                    BlockID block_id = (BlockID) ((n + reader) % BLOCKS + 1);
+                    vector<char> bytes(BLOCK_SIZE);
+                    Dbt key(&block_id, sizeof(block_id)), data(bytes.data(), BLOCK_SIZE);
+                    data.set_ulen(BLOCK_SIZE);
+                    data.set_flags(DB_DBT_USERMEM);
+                    {
+                        DbHandlePool::Lease db(pool);
+                        if(db->get(nullptr, &key, &data, 0) != 0){
+                            wrong++;
+                            continue;
+                        }
+                    }
+                    SlottedPage block(move(bytes), block_id, false);
+                    Dbt *record = block.get(1);
+                    if(record == nullptr || string((const char *) record->get_data()) != "block " + to_string(block_id))
+                        wrong++;
+                    delete record;
+                }
+            }));
+        for(auto &reader : readers)
+            reader.join();
+        size_t handles = pool.get_handle_count();
+        pool.close();
+        file.drop();
+        if(wrong != 0 || handles < 1 || handles > 8)
+            throw DbRelationError(to_string(wrong) + " blocks read wrong, with " + to_string(handles) +
+                                  " handles for 8 readers");
+    }
+
+    void testAll(){
+        testLeases();
+        testConcurrentReaders();
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace DbHandlePoolTests{
+    void testLeases();
+    void testConcurrentReaders();
+    void testAll();
+}
@@ -0,0 +1,79 @@
+#include "Dictionary.h"
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+void Dictionary::create() {
+    this->drop();
+    this->open();
+}
+
+// Loads the whole dictionary, creating an empty one if there isn't a file yet.
+void Dictionary::open() {
+    if (this->db != nullptr)
+        return;
+    this->db = new Db(_DB_ENV, 0);
+    this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, DB_CREATE, 0644);
+    DB_BTREE_STAT *stat;
+    this->db->stat(nullptr, &stat, DB_FAST_STAT);
+    u32 count = stat->bt_ndata;
+    free(stat);
+
+    this->values.clear();
+    this->codes.clear();
+    for (u32 code = 1; code <= count; code++) {
+        Dbt key(&code, sizeof(code)), data;
+        if (this->db->get(nullptr, &key, &data, 0) != 0)
+            throw DbRelationError("dictionary " + this->dbfilename + " is missing code " + to_string(code));
+        this->values.push_back(string((const char *) data.get_data(), data.get_size()));
+        this->codes[this->values.back()] = code;
+    }
+}
+
+void Dictionary::close() {
+    if (this->db == nullptr)
+        return;
+    this->db->close(0);
+    delete this->db;
+    this->db = nullptr;
+}
+
+void Dictionary::drop() {
+    this->close();
+    try {
+        _DB_ENV->dbremove(_DB_TXN, this->dbfilename.c_str(), nullptr, 0);
+    } catch (DbException &e) {
+        // wasn't there
+    }
+    this->values.clear();
+    this->codes.clear();
+}
+
+u32 Dictionary::encode(const string &value) {
+    u32 code;
+    if (this->find(value, code))
+        return code;
+    code = (u32) this->values.size() + 1;
+    Dbt key(&code, sizeof(code)), data((void *) value.data(), (u32) value.size());
+    this->db->put(nullptr, &key, &data, 0);  // committed at once (see Dictionary)
+    this->values.push_back(value);
+    this->codes[value] = code;
+    return code;
+}
+
+bool Dictionary::find(const string &value, u32 &code) {
+    this->open();
+    auto entry = this->codes.find(value);
+    if (entry == this->codes.end())
+        return false;
+    code = entry->second;
+    return true;
+}
+
+const string &Dictionary::decode(u32 code) {
+    this->open();
+    if (code == 0 || code > this->values.size())
+        throw DbRelationError("no code " + to_string(code) + " in dictionary " + this->dbfilename);
+    return this->values[code - 1];
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "storage_engine.h"
+#include "db_cxx.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class Dictionary - the distinct values of one dictionary-encoded TEXT column.
+ *
+ * Rows of the table store a small integer code in place of the value. The values are kept in a Berkeley DB
+ * RecNo file of variable-length records beside the heap file, where the record number is the code. The whole
+ * dictionary is also kept in memory both ways round, since it's meant for columns with only a few values.
+ * Codes are never reused or removed, so a row's code stays good for as long as the row does. A new code is
+ * committed at once rather than with the transaction that added it, since other transactions may use it before
+ * that one ends; one added by a transaction that never committed is just never used.
+ */
+class Dictionary {
+public:
+    /**
+     * @param name         name of the heap file this belongs to
+     * @param column_name  the encoded column
+     */
+    Dictionary(std::string name, Identifier column_name) : dbfilename(file_name(name, column_name)),
+                                                           db(nullptr) {}
+
+    /**
+     * Name of the file holding the dictionary for a column of the given heap file.
+     */
+    static std::string file_name(std::string name, Identifier column_name) {
+        return name + "." + column_name + ".dict.db";
+    }
+
+    virtual ~Dictionary() { close(); }
+
+    Dictionary(const Dictionary &other) = delete;
+
+    Dictionary &operator=(const Dictionary &other) = delete;
+
+    /**
+     * Start a new, empty dictionary (replacing any old one).
+     */
+    virtual void create();
+
+    virtual void close();
+
+    /**
+     * Remove the file if there is one.
+     */
+    virtual void drop();
+
+    /**
+     * Get the code for a value, giving it a new one if it doesn't have one yet.
+     */
+    virtual u32 encode(const std::string &value);
+
+    /**
+     * Look up the code for a value without adding it.
+     * @returns  false if the value isn't in the dictionary (so no row has it)
+     */
+    virtual bool find(const std::string &value, u32 &code);
+
+    /**
+     * Get the value for a code.
+     */
+    virtual const std::string &decode(u32 code);
+
+protected:
+    std::string dbfilename;
+    Db *db;
+    std::vector<std::string> values;  // values[code - 1]
+    std::unordered_map<std::string, u32> codes;
+
+    virtual void open();
+};
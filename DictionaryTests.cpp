@@ -0,0 +1,82 @@
+#include "DictionaryTests.h"
+#include "Dictionary.h"
+#include "HeapTable.h"
+
+using namespace std;
+
+namespace DictionaryTests{
+    // a value keeps its code, including once the dictionary is read back from its file, and the code gives back
+    // the value
+    void testCodes(){
+        cout << "Testing dictionary codes" << endl;
+        string values[] = {"red", "green", "blue", "green", "", "red"};
+        vector<u32> codes;
+        {
+            Dictionary dictionary("_test_dict", "colour");
+            dictionary.create();
+            for(auto const &value : values)
+                codes.push_back(dictionary.encode(value));
+        }
+        Dictionary reopened("_test_dict", "colour");
+        string problem;
+        if(codes[1] != codes[3] || codes[0] != codes[5] || codes[0] == codes[1] || codes[1] == codes[2])
+            problem = "dictionary gave a value more than one code, or two values the same one";
+        for(size_t i = 0; i < codes.size() && problem.empty(); i++){
+            u32 code;
+            if(!reopened.find(values[i], code) || code != codes[i] || reopened.decode(code) != values[i])
+                problem = "dictionary didn't give back '" + values[i] + "' for its code once read back";
+        }
+        u32 code;
+        if(problem.empty() && reopened.find("purple", code))
+            problem = "dictionary found a code for a value it was never given";
+        reopened.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // rows of a table with a dictionary-encoded column come back with their values, and can be selected by them
+    void testEncodedColumn(){
+        cout << "Testing dictionary-encoded columns" << endl;
+        ColumnNames columnNames = {"id", "colour"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        TableOptions options;
+        options["dictionary"] = "colour";
+        HeapTable table("_test_dict_table", columnNames, columnAttributes, options);
+        table.create();
+        string colours[] = {"red", "green", "blue"};
+        ValueDict row;
+        for(int i = 0; i < 300; i++){
+            row["id"] = Value(i);
+            row["colour"] = Value(colours[i % 3]);
+            table.insert(&row);
+        }
+        string problem;
+        Handles *all = table.select();
+        for(auto const &handle : *all){
+            ValueDict *got = table.project(handle);
+            if((*got)["colour"].s != colours[(*got)["id"].n % 3])
+                problem = "row " + to_string((*got)["id"].n) + " didn't come back with its colour";
+            delete got;
+        }
+        delete all;
+        ValueDict where;
+        where["colour"] = Value(string("green"));
+        Handles *green = table.select(&where);
+        if(problem.empty() && green->size() != 100)
+            problem = "selecting by an encoded value found " + to_string(green->size()) + " rows instead of 100";
+        delete green;
+        where["colour"] = Value(string("purple"));
+        Handles *purple = table.select(&where);
+        if(problem.empty() && !purple->empty())
+            problem = "selecting by a value not in the dictionary found rows";
+        delete purple;
+        table.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testCodes();
+        testEncodedColumn();
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace DictionaryTests{
+    void testCodes();
+    void testEncodedColumn();
+    void testAll();
+}
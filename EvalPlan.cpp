@@ -4,8 +4,8 @@ TableScanPlan::TableScanPlan(DbRelation* tableToScan){
     table = tableToScan;
 }
 
+// the table belongs to the Tables cache, so it isn't deleted here
 TableScanPlan::~TableScanPlan(){
-    delete table;
 }
 
 DbRelation* TableScanPlan::getTable(){
@@ -13,12 +13,23 @@ DbRelation* TableScanPlan::getTable(){
 }
 
 EvalPipeline TableScanPlan::pipeline(){
-    return EvalPipeline(this->table, *table->select());
+    Handles* handles = table->select();
+    EvalPipeline pipeline(this->table, *handles);
+    delete handles;
+    return pipeline;
 }
 
 
-SelectPlan::SelectPlan(TableScanPlan* tableScanPlan){
+SelectPlan::SelectPlan(TableScanPlan* tableScanPlan, ValueRanges ranges){
     tableScan = tableScanPlan;
+    this->ranges = ranges;
+    index = nullptr;
+    indexFellBack = false;
+}
+
+void SelectPlan::use_index(DbIndex* index, ValueDict key){
+    this->index = index;
+    this->key = key;
 }
 
 // SelectPlan::~SelectPlan(){
@@ -27,9 +38,57 @@ SelectPlan::SelectPlan(TableScanPlan* tableScanPlan){
 //     // delete tableScan;
 // }
 
+// The table does the selecting itself, so it can use whatever it knows about its blocks to skip some.
 EvalPipeline SelectPlan::pipeline(){
+    actual.start();
     DbRelation* table = tableScan->getTable(); // the table in the TableScanPlan
-    return EvalPipeline(table, *table->select());
+    Handles* found = index == nullptr ? nullptr : index->lookup(&key);
+    indexFellBack = index != nullptr && found == nullptr;
+    if(found != nullptr){
+        // the index only answers for its key, so the rows it found are checked against the whole where clause
+        ColumnNames columns;
+        for(auto const &range : ranges)
+            columns.push_back(range.first);
+        // projected all together, so the table can read their blocks at once
+        ValueDicts* rows = table->project(found, &columns);
+        Handles handles;
+        for(size_t i = 0; i < found->size(); i++){
+            ValueDict* row = (*rows)[i];
+            bool selected = true;
+            for(auto const &range : ranges)
+                selected = selected && range.second.contains((*row)[range.first]);
+            if(selected)
+                handles.push_back((*found)[i]);
+            delete row;
+        }
+        delete rows;
+        delete found;
+        actual.stop(handles.size());
+        return EvalPipeline(table, handles);
+    }
+    // no index, or one that can't look things up yet (lookup gives nullptr), so scan
+    if(ranges.empty()){
+        EvalPipeline pipeline = tableScan->pipeline();
+        actual.stop(pipeline.second.size());
+        return pipeline;
+    }
+    Handles* handles = table->select(ranges);
+    EvalPipeline pipeline(table, *handles);
+    delete handles;
+    actual.stop(pipeline.second.size());
+    return pipeline;
+}
+
+ExplainNode SelectPlan::explain(double estimatedRows){
+    bool byIndex = index != nullptr && !indexFellBack;
+    string detail = "on " + tableScan->getTable()->get_table_name();
+    if(byIndex)
+        detail += " using " + index->get_name();
+    if(!ranges.empty())
+        detail += " where " + ExplainNode::describe(ranges);
+    if(index != nullptr && indexFellBack)
+        detail += " (index " + index->get_name() + " can't look up keys, so scanned)";
+    return ExplainNode(byIndex ? "Index Scan" : "Table Scan", detail, estimatedRows, actual);
 }
 
 EvalPlan::EvalPlan(bool projectAllColumns, ColumnNames projectionColumns, SelectPlan* select_plan){
@@ -39,20 +98,34 @@ EvalPlan::EvalPlan(bool projectAllColumns, ColumnNames projectionColumns, Select
 }
 
 ValueDicts EvalPlan::evaluate(){
+    actual.start();
     ValueDicts ret;
     
     EvalPipeline pipeline = selectPlan->pipeline();
     DbRelation* temp_table = pipeline.first;
     Handles handles = pipeline.second;
 
+    ValueDicts* rows;
     if (projectAll)
-        ret = *temp_table->project(&handles);
+        rows = temp_table->project(&handles);
     else
-        ret = *temp_table->project(&handles, &columnsToProject);
+        rows = temp_table->project(&handles, &columnsToProject);
+    ret = *rows;
+    delete rows;
 
+    actual.stop(ret.size());
     return ret;
 }
 
+ExplainNode EvalPlan::explain(double estimatedRows){
+    string columns;
+    for(auto const &column : columnsToProject)
+        columns += (columns.empty() ? "" : ", ") + column;
+    ExplainNode node("Project", projectAll ? "*" : columns, estimatedRows, actual);
+    node.children.push_back(selectPlan->explain(estimatedRows));
+    return node;
+}
+
 // EvalPlan::~EvalPlan(){
 //     cout << "In EvalPlan dtor" << endl;
 //     // delete selectPlan;
@@ -1,4 +1,5 @@
 #include "storage_engine.h"
+#include "Explain.h"
 using namespace std;
 
 typedef std::pair<DbRelation*, Handles> EvalPipeline;
@@ -15,12 +16,22 @@ class TableScanPlan{
 
 class SelectPlan{
     public:
-        SelectPlan(TableScanPlan* tableScanPlan);
+        // ranges: what the where clause allows for each column it restricts (empty to select every row)
+        SelectPlan(TableScanPlan* tableScanPlan, ValueRanges ranges = ValueRanges());
+        // Look the rows up in the index by key instead of scanning (still checking the rest of the where clause).
+        void use_index(DbIndex* index, ValueDict key);
         // ~SelectPlan();
         EvalPipeline pipeline();
+        // Describe this step for EXPLAIN, with what happened if pipeline has been called.
+        ExplainNode explain(double estimatedRows);
         // void operator=(const SelectPlan& selectPlan);
     private:
         TableScanPlan* tableScan;
+        ValueRanges ranges;
+        DbIndex* index; // nullptr to scan
+        ValueDict key;
+        bool indexFellBack; // whether the index couldn't look the key up, so the table was scanned after all
+        Measurement actual;
 };
 
 // Project or ProjectAll plan
@@ -40,5 +51,11 @@ class EvalPlan{
 
         // Evaluate the plan: evaluate gets values, pipeline gets handles
         ValueDicts evaluate();
+
+        // Describe the plan for EXPLAIN, with what happened at each step if evaluate has been called.
+        // estimatedRows is how many rows the where clause is expected to let through.
+        ExplainNode explain(double estimatedRows);
+    private:
+        Measurement actual;
 };  
 
@@ -0,0 +1,80 @@
+#include "Explain.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+// The buffer pool's own counters, so a page BDB had cached counts as a hit even if we asked for it via a
+// different file handle.
+IoCounters IoCounters::now() {
+    IoCounters counters;
+    DB_MPOOL_STAT *stats = nullptr;
+    if (_DB_ENV == nullptr || _DB_ENV->memp_stat(&stats, nullptr, 0) != 0 || stats == nullptr)
+        return counters;
+    counters.blocks_read = stats->st_cache_miss;
+    counters.buffer_hits = stats->st_cache_hit;
+    free(stats);
+    return counters;
+}
+
+void Measurement::start() {
+    this->io_at_start = IoCounters::now();
+    this->started = chrono::steady_clock::now();
+}
+
+void Measurement::stop(u_int64_t rows) {
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - this->started;
+    IoCounters io_now = IoCounters::now();
+    this->measured = true;
+    this->rows = rows;
+    this->elapsed_ms = elapsed.count();
+    this->io.blocks_read = io_now.blocks_read - this->io_at_start.blocks_read;
+    this->io.buffer_hits = io_now.buffer_hits - this->io_at_start.buffer_hits;
+}
+
+void ExplainNode::describe(vector<string> &lines, uint depth) const {
+    string line = depth == 0 ? "" : string(2 * depth, ' ') + "-> ";
+    line += this->name;
+    if (!this->detail.empty())
+        line += " " + this->detail;
+    char numbers[160];
+    snprintf(numbers, sizeof(numbers), "  (rows=%.0f)", this->estimated_rows);
+    line += numbers;
+    if (this->actual.measured) {
+        snprintf(numbers, sizeof(numbers), " (actual rows=%llu time=%.3f ms blocks read=%llu buffer hits=%llu)",
+                 (unsigned long long) this->actual.rows, this->actual.elapsed_ms,
+                 (unsigned long long) this->actual.io.blocks_read,
+                 (unsigned long long) this->actual.io.buffer_hits);
+        line += numbers;
+    }
+    lines.push_back(line);
+    for (auto const &child: this->children)
+        child.describe(lines, depth + 1);
+}
+
+static string literal(const Value &value) {
+    if (value.data_type == ColumnAttribute::TEXT)
+        return "'" + value.s + "'";
+    if (value.data_type == ColumnAttribute::BOOLEAN)
+        return value.n ? "true" : "false";
+    return to_string(value.n);
+}
+
+string ExplainNode::describe(const ValueRanges &ranges) {
+    string text;
+    for (auto const &range: ranges) {
+        const ValueRange &r = range.second;
+        vector<string> comparisons;
+        if (r.is_equality()) {
+            comparisons.push_back(range.first + " = " + literal(r.min));
+        } else {
+            if (r.has_min)
+                comparisons.push_back(range.first + (r.min_inclusive ? " >= " : " > ") + literal(r.min));
+            if (r.has_max)
+                comparisons.push_back(range.first + (r.max_inclusive ? " <= " : " < ") + literal(r.max));
+        }
+        for (auto const &comparison: comparisons)
+            text += (text.empty() ? "" : " AND ") + comparison;
+    }
+    return text;
+}
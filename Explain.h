@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include "storage_engine.h"
+
+/**
+ * What a SELECT is being run for: its rows, a description of its plan (EXPLAIN), or a description of its plan
+ * with what happened at each step when it was run (EXPLAIN ANALYZE).
+ */
+enum class ExplainMode {
+    NONE, PLAN, ANALYZE
+};
+
+/**
+ * @class IoCounters - how many pages the Berkeley DB buffer pool has had to read from the files (blocks read) and
+ * how many it already had (buffer hits), over all files since the environment was opened.
+ */
+class IoCounters {
+public:
+    u_int64_t blocks_read;
+    u_int64_t buffer_hits;
+
+    IoCounters() : blocks_read(0), buffer_hits(0) {}
+
+    static IoCounters now();
+};
+
+/**
+ * @class Measurement - what happened when a plan node ran: rows out, wall time, and pages fetched. Time and pages
+ * include those of the node's inputs, since they are run from inside it.
+ */
+class Measurement {
+public:
+    bool measured;  // false if the node never ran
+    u_int64_t rows;
+    double elapsed_ms;
+    IoCounters io;
+
+    Measurement() : measured(false), rows(0), elapsed_ms(0) {}
+
+    void start();
+
+    void stop(u_int64_t rows);
+
+protected:
+    std::chrono::steady_clock::time_point started;
+    IoCounters io_at_start;
+};
+
+/**
+ * @class ExplainNode - one step of a plan as EXPLAIN shows it, e.g. "Hash Join" on "f.c = c.id"
+ */
+class ExplainNode {
+public:
+    std::string name;
+    std::string detail;  // what it works on, or empty
+    double estimated_rows;
+    Measurement actual;
+    std::vector<ExplainNode> children;
+
+    ExplainNode(std::string name, std::string detail, double estimated_rows, const Measurement &actual)
+            : name(name), detail(detail), estimated_rows(estimated_rows), actual(actual) {}
+
+    /**
+     * Lay the plan out as text: a line per node, each node's inputs indented beneath it.
+     * @param lines  gets the lines
+     * @param depth  how far down the plan this node is
+     */
+    void describe(std::vector<std::string> &lines, uint depth = 0) const;
+
+    /**
+     * Write out where-clause ranges as SQL, e.g. "a >= 1 AND a < 10 AND b = 'x'".
+     */
+    static std::string describe(const ValueRanges &ranges);
+};
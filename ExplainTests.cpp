@@ -0,0 +1,52 @@
+#include "ExplainTests.h"
+#include "Explain.h"
+
+using namespace std;
+
+namespace ExplainTests{
+    // a line per node, inputs indented beneath, actuals only once a node has run
+    void testDescribe(){
+        cout << "Testing EXPLAIN layout" << endl;
+        Measurement ran;
+        ran.rows = 7;
+        ran.measured = true;
+        ExplainNode root("Hash Join", "on a.x = b.y", 12, Measurement());
+        root.children.push_back(ExplainNode("Table Scan", "on a", 3, ran));
+        root.children.push_back(ExplainNode("Table Scan", "", 40, Measurement()));
+        root.children[1].children.push_back(ExplainNode("Sort", "", 40, Measurement()));
+        vector<string> lines;
+        root.describe(lines);
+        vector<string> expected = {
+                "Hash Join on a.x = b.y  (rows=12)",
+                "  -> Table Scan on a  (rows=3) (actual rows=7 time=0.000 ms blocks read=0 buffer hits=0)",
+                "  -> Table Scan  (rows=40)",
+                "    -> Sort  (rows=40)"};
+        if(lines != expected){
+            string got;
+            for(auto const &line : lines)
+                got += "\n" + line;
+            throw DbRelationError("EXPLAIN laid the plan out as:" + got);
+        }
+    }
+
+    // where-clause ranges come back as the comparisons they were made from
+    void testRanges(){
+        cout << "Testing EXPLAIN ranges" << endl;
+        ValueRanges ranges;
+        ranges["a"].restrict_min(Value(1), true);
+        ranges["a"].restrict_max(Value(10), false);
+        ranges["b"].restrict_min(Value("x"), true);
+        ranges["b"].restrict_max(Value("x"), true);
+        ranges["c"].restrict_min(Value(5), false);
+        string text = ExplainNode::describe(ranges);
+        if(text != "a >= 1 AND a < 10 AND b = 'x' AND c > 5")
+            throw DbRelationError("EXPLAIN wrote the ranges as: " + text);
+        if(!ExplainNode::describe(ValueRanges()).empty())
+            throw DbRelationError("EXPLAIN wrote no ranges as something");
+    }
+
+    void testAll(){
+        testDescribe();
+        testRanges();
+    }
+}
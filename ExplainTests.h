@@ -0,0 +1,7 @@
+#pragma once
+
+namespace ExplainTests{
+    void testDescribe();
+    void testRanges();
+    void testAll();
+}
@@ -0,0 +1,120 @@
+#include "FreeSpaceMap.h"
+#include <cstring>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+FreeSpaceMap::FreeSpaceMap(std::string name, u32 heap_block_size) : file(file_name(name), DbBlock::BLOCK_SZ, false),
+                                                                    unit(heap_block_size / CATEGORIES),
+                                                                    search_from(1) {
+    memset(this->counts, 0, sizeof(this->counts));
+}
+
+void FreeSpaceMap::create() {
+    try {
+        this->file.drop();
+    } catch (DbException &e) {}
+    this->file.create();
+    this->load();
+}
+
+bool FreeSpaceMap::open() {
+    bool existed = this->file.open(true);
+    this->load();
+    return existed;
+}
+
+void FreeSpaceMap::close() {
+    this->file.close();
+}
+
+void FreeSpaceMap::drop() {
+    this->file.drop();
+    this->categories.clear();
+    memset(this->counts, 0, sizeof(this->counts));
+}
+
+void FreeSpaceMap::update(BlockID block_id, u32 free_space) {
+    if (block_id == 0)
+        return;
+    u_int8_t cat = category(free_space);
+    if (block_id > this->categories.size()) {
+        this->counts[0] += block_id - this->categories.size();
+        this->categories.resize(block_id, 0);
+    } else if (this->categories[block_id - 1] == cat) {
+        return;  // nothing changed on disk
+    }
+    this->counts[this->categories[block_id - 1]]--;
+    this->counts[cat]++;
+    this->categories[block_id - 1] = cat;
+    if (cat > 0 && block_id < this->search_from)
+        this->search_from = block_id;  // freed up space behind the search point
+    u32 per_block = this->file.get_block_size() * 2;
+    this->write_block((block_id - 1) / per_block + 1);
+}
+
+// Search from where we last found room, wrapping around once. A block is only a candidate if its category
+// guarantees room for size bytes, so a hit almost never fails the actual add().
+BlockID FreeSpaceMap::find(u32 size, const std::function<bool(BlockID)> &usable) {
+    u32 needed = (size + this->unit - 1) / this->unit;
+    if (needed == 0)
+        needed = 1;
+    if (needed >= CATEGORIES)
+        return 0;
+    u32 candidates = 0;
+    for (u32 cat = needed; cat < CATEGORIES; cat++)
+        candidates += this->counts[cat];
+    if (candidates == 0)
+        return 0;  // the usual case when appending to a table that's never had deletes
+    BlockID n = this->size();
+    if (this->search_from > n)
+        this->search_from = 1;
+    for (BlockID i = 0; i < n; i++) {
+        BlockID block_id = (this->search_from - 1 + i) % n + 1;
+        if (this->categories[block_id - 1] >= needed && (usable == nullptr || usable(block_id))) {
+            this->search_from = block_id;
+            return block_id;
+        }
+    }
+    return 0;
+}
+
+u_int8_t FreeSpaceMap::category(u32 free_space) const {
+    u32 cat = free_space / this->unit;
+    return (u_int8_t) (cat >= CATEGORIES ? CATEGORIES - 1 : cat);
+}
+
+// Unpack the nibbles from every map block into the in-memory copy.
+void FreeSpaceMap::load() {
+    u32 block_size = this->file.get_block_size();
+    this->categories.clear();
+    this->search_from = 1;
+    char *buffer = new char[block_size];
+    for (BlockID map_block_id = 1; map_block_id <= this->file.get_last_block_id(); map_block_id++) {
+        this->file.read(map_block_id, buffer);
+        for (u32 i = 0; i < block_size; i++) {
+            u_int8_t b = (u_int8_t) buffer[i];
+            this->categories.push_back(b & 0x0F);
+            this->categories.push_back(b >> 4);
+        }
+    }
+    delete[] buffer;
+    memset(this->counts, 0, sizeof(this->counts));
+    for (auto cat: this->categories)
+        this->counts[cat]++;
+}
+
+// Pack the in-memory categories covered by one map block and write it out.
+void FreeSpaceMap::write_block(BlockID map_block_id) {
+    u32 block_size = this->file.get_block_size();
+    char *buffer = new char[block_size];
+    memset(buffer, 0, block_size);
+    size_t first = (size_t) (map_block_id - 1) * block_size * 2;
+    for (u32 i = 0; i < block_size * 2 && first + i < this->categories.size(); i++) {
+        u_int8_t cat = this->categories[first + i];
+        buffer[i / 2] |= (char) (i % 2 == 0 ? cat : cat << 4);
+    }
+    this->file.write(map_block_id, buffer);
+    delete[] buffer;
+}
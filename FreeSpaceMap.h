@@ -0,0 +1,84 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "BlockFile.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class FreeSpaceMap - persistent record of roughly how much room is left in each block of a heap file.
+ *
+ * Each heap block gets a 4-bit category: category c means the block has at least c/16ths of a block free.
+ * The categories are packed two to a byte into the blocks of a BlockFile stored beside the heap file, so one
+ * map block covers 2 * BLOCK_SZ heap blocks. The whole map is also cached in memory for searching. It's only a
+ * hint (a block it picks is checked for room), so its writes are committed at once, not with the transaction that
+ * changed the heap block.
+ */
+class FreeSpaceMap {
+public:
+    static const uint CATEGORIES = 16;
+
+    /**
+     * @param name               name of the heap file this map belongs to
+     * @param heap_block_size    size of the blocks in the heap file
+     */
+    FreeSpaceMap(std::string name, u32 heap_block_size);
+
+    /**
+     * Name of the file holding the map for the given heap file.
+     */
+    static std::string file_name(std::string name) { return name + ".fsm.db"; }
+
+    virtual ~FreeSpaceMap() {}
+
+    FreeSpaceMap(const FreeSpaceMap &other) = delete;
+
+    FreeSpaceMap &operator=(const FreeSpaceMap &other) = delete;
+
+    virtual void create();
+
+    /**
+     * Open the map.
+     * @returns  false if there was no map yet (one was created empty and needs to be rebuilt by the caller)
+     */
+    virtual bool open();
+
+    virtual void close();
+
+    virtual void drop();
+
+    /**
+     * Record how much free space a heap block now has.
+     * @param block_id    the heap block
+     * @param free_space  bytes available for new records in that block
+     */
+    virtual void update(BlockID block_id, u32 free_space);
+
+    /**
+     * Find a heap block that should have room for a new record.
+     * @param size    bytes needed for the new record
+     * @param usable  which blocks may be picked (nullptr for any)
+     * @returns       a candidate block, or 0 if none is known to have room
+     */
+    virtual BlockID find(u32 size, const std::function<bool(BlockID)> &usable = nullptr);
+
+    /**
+     * Number of heap blocks the map has entries for (rounded up to a whole map block).
+     */
+    virtual BlockID size() const { return (BlockID) categories.size(); }
+
+protected:
+    BlockFile file;
+    u32 unit;                        // bytes of free space per category step
+    std::vector<u_int8_t> categories; // in-memory copy; categories[i] is for heap block i + 1
+    u32 counts[CATEGORIES];          // number of heap blocks in each category
+    BlockID search_from;             // where the last successful find() left off
+
+    virtual u_int8_t category(u32 free_space) const;
+
+    virtual void load();
+
+    virtual void write_block(BlockID map_block_id);
+};
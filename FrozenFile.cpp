@@ -0,0 +1,137 @@
+#include "FrozenFile.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "db_cxx.h"
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+FrozenFile::FrozenFile(std::string name, u32 block_size) : name(name), block_size(block_size), block_count(0),
+                                                           is_mapped(false), mapping(nullptr), reserved(nullptr),
+                                                           reserved_size(0) {
+}
+
+string FrozenFile::path(std::string name) {
+    const char *home = nullptr;
+    if (_DB_ENV != nullptr)
+        _DB_ENV->get_home(&home);
+    return (home == nullptr ? "" : string(home) + "/") + file_name(name);
+}
+
+// The blocks go into a temporary file that is renamed over the old copy only once it's synced, so a crash part
+// way through leaves the old copy (or none) rather than half a new one.
+void FrozenFile::create(std::string name, u32 block_size, BlockID block_count,
+                        const std::function<void(char *blocks)> &fill) {
+    string final_path = path(name);
+    string temp_path = final_path + ".new";
+    size_t size = (size_t) block_count * block_size;
+    int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw DbRelationError("could not create " + temp_path + ": " + strerror(errno));
+    try {
+        if (size > 0) {
+            if (::ftruncate(fd, (off_t) size) != 0)
+                throw DbRelationError("could not size " + temp_path + ": " + strerror(errno));
+            void *blocks = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (blocks == MAP_FAILED)
+                throw DbRelationError("could not map " + temp_path + ": " + strerror(errno));
+            try {
+                fill((char *) blocks);
+            } catch (...) {
+                ::munmap(blocks, size);
+                throw;
+            }
+            int synced = ::msync(blocks, size, MS_SYNC);
+            ::munmap(blocks, size);
+            if (synced != 0)
+                throw DbRelationError("could not write " + temp_path + ": " + strerror(errno));
+        }
+        if (::fsync(fd) != 0)
+            throw DbRelationError("could not write " + temp_path + ": " + strerror(errno));
+    } catch (...) {
+        ::close(fd);
+        ::unlink(temp_path.c_str());
+        throw;
+    }
+    ::close(fd);
+    if (std::rename(temp_path.c_str(), final_path.c_str()) != 0) {
+        ::unlink(temp_path.c_str());
+        throw DbRelationError("could not replace " + final_path + ": " + strerror(errno));
+    }
+}
+
+void FrozenFile::remove_if_exists(std::string name) {
+    ::unlink(path(name).c_str());
+}
+
+// The mapping is read-only, so a stray write through a block view faults rather than changing the copy.
+void FrozenFile::open() {
+    if (this->is_mapped)
+        return;
+    string file_path = path(this->name);
+    int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw DbRelationError("could not open " + file_path + ": " + strerror(errno));
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+        ::close(fd);
+        throw DbRelationError("could not stat " + file_path + ": " + strerror(errno));
+    }
+    size_t size = (size_t) status.st_size;
+    this->block_count = (BlockID) (size / this->block_size);
+    size = (size_t) this->block_count * this->block_size;
+
+    if (size > 0) {
+        // set aside an extra huge page of address space, so the file can be mapped on a huge page boundary
+        void *address = nullptr;
+        if (size >= HUGE_PAGE_SZ) {
+            this->reserved_size = size + HUGE_PAGE_SZ;
+            this->reserved = ::mmap(nullptr, this->reserved_size, PROT_NONE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (this->reserved == MAP_FAILED) {
+                this->reserved = nullptr;
+                this->reserved_size = 0;
+            } else {
+                uintptr_t start = ((uintptr_t) this->reserved + HUGE_PAGE_SZ - 1) & ~(uintptr_t) (HUGE_PAGE_SZ - 1);
+                address = (void *) start;
+            }
+        }
+        void *blocks = ::mmap(address, size, PROT_READ, MAP_SHARED | (address != nullptr ? MAP_FIXED : 0), fd, 0);
+        if (blocks == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            this->close();
+            throw DbRelationError("could not map " + file_path + ": " + strerror(error));
+        }
+        this->mapping = (char *) blocks;
+#ifdef MADV_HUGEPAGE
+        ::madvise(blocks, size, MADV_HUGEPAGE);  // only a request; fine if the kernel can't do it for this file
+#endif
+        ::madvise(blocks, size, MADV_WILLNEED);
+    }
+    ::close(fd);  // the mapping keeps the file open
+    this->is_mapped = true;
+}
+
+void FrozenFile::close() {
+    if (this->reserved != nullptr)
+        ::munmap(this->reserved, this->reserved_size);  // the mapping is inside the reservation
+    else if (this->mapping != nullptr)
+        ::munmap(this->mapping, (size_t) this->block_count * this->block_size);
+    this->reserved = nullptr;
+    this->reserved_size = 0;
+    this->mapping = nullptr;
+    this->is_mapped = false;
+}
+
+const char *FrozenFile::get(BlockID block_id) const {
+    if (block_id == 0 || block_id > this->block_count)
+        throw DbRelationError("no block " + to_string(block_id) + " in " + file_name(this->name));
+    return this->mapping + (size_t) (block_id - 1) * this->block_size;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class FrozenFile - a read-only copy of a heap file's blocks, laid out flat (block n at (n - 1) * block_size, so
+ * every block is page-aligned) and read through a memory mapping.
+ *
+ * FREEZE TABLE writes one of these beside the table's own file; from then on the table's HeapFile hands out
+ * blocks that are views straight into the mapping, with nothing copied and no trip through Berkeley DB. The
+ * mapping is placed on a huge page boundary and the kernel asked to back it with huge pages, where it can.
+ */
+class FrozenFile {
+public:
+    // size of the huge pages we try to get the mapping backed by
+    static const size_t HUGE_PAGE_SZ = 2 * 1024 * 1024;
+
+    /**
+     * @param name        name of the heap file this is a copy of
+     * @param block_size  size of its blocks
+     */
+    FrozenFile(std::string name, u32 block_size);
+
+    /**
+     * Name of the file holding the frozen copy of the given heap file.
+     */
+    static std::string file_name(std::string name) { return name + ".frozen"; }
+
+    virtual ~FrozenFile() { close(); }
+
+    FrozenFile(const FrozenFile &other) = delete;
+
+    FrozenFile &operator=(const FrozenFile &other) = delete;
+
+    /**
+     * Write a frozen copy of a heap file, replacing any there was. The old copy (if any) stays in place until the
+     * new one is complete and on disk.
+     * @param name         name of the heap file
+     * @param block_size   size of its blocks
+     * @param block_count  how many blocks it has
+     * @param fill         called with the new file's (writable) mapping to put the blocks in
+     */
+    static void create(std::string name, u32 block_size, BlockID block_count,
+                       const std::function<void(char *blocks)> &fill);
+
+    /**
+     * Remove the frozen copy of the given heap file, if there is one.
+     */
+    static void remove_if_exists(std::string name);
+
+    virtual void open();
+
+    virtual void close();
+
+    /**
+     * Where a block is in the mapping.
+     * @throws  DbRelationError if there's no such block
+     */
+    virtual const char *get(BlockID block_id) const;
+
+    virtual BlockID get_block_count() const { return block_count; }
+
+    bool is_open() const { return is_mapped; }
+
+protected:
+    std::string name;
+    u32 block_size;
+    BlockID block_count;
+    bool is_mapped;
+    char *mapping;       // the blocks (nullptr if there are none)
+    void *reserved;      // address space set aside to put the mapping on a huge page boundary, if any
+    size_t reserved_size;
+
+    static std::string path(std::string name);
+};
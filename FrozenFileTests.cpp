@@ -0,0 +1,109 @@
+#include "FrozenFileTests.h"
+#include "FrozenFile.h"
+#include "HeapTable.h"
+#include <cstring>
+
+using namespace std;
+
+namespace FrozenFileTests{
+    // blocks read back from the mapping as they were filled in, and only blocks that exist can be got
+    void testMapping(){
+        cout << "Testing frozen files" << endl;
+        const u32 blockSize = DbBlock::BLOCK_SZ;
+        const BlockID blocks = 50;
+        FrozenFile::create("_test_frozen", blockSize, blocks, [&](char *mapped){
+            for(BlockID block_id = 1; block_id <= blocks; block_id++)
+                memset(mapped + (block_id - 1) * blockSize, (int) block_id, blockSize);
+        });
+        FrozenFile file("_test_frozen", blockSize);
+        file.open();
+        string problem;
+        if(file.get_block_count() != blocks)
+            problem = "frozen file has " + to_string(file.get_block_count()) + " blocks of " + to_string(blocks);
+        for(BlockID block_id = 1; problem.empty() && block_id <= blocks; block_id++){
+            const char *block = file.get(block_id);
+            if(block[0] != (char) block_id || block[blockSize - 1] != (char) block_id)
+                problem = "block " + to_string(block_id) + " didn't read back as it was filled in";
+        }
+        try{
+            file.get(blocks + 1);
+            if(problem.empty())
+                problem = "got a block past the end";
+        } catch(DbRelationError &e){
+        }
+        file.close();
+        FrozenFile::remove_if_exists("_test_frozen");
+        try{
+            file.open();
+            if(problem.empty())
+                problem = "opened a frozen file after it was removed";
+            file.close();
+        } catch(DbRelationError &e){
+        }
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // a frozen table reads the same as it did before, refuses changes, and takes them again once unfrozen
+    void testFrozenTable(){
+        cout << "Testing frozen tables" << endl;
+        ColumnNames columnNames = {"a", "b"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        HeapTable table("_test_frozen", columnNames, columnAttributes);
+        table.create();
+        ValueDict row;
+        for(int i = 0; i < 5000; i++){
+            row["a"] = Value(i);
+            row["b"] = Value("row " + to_string(i));
+            table.insert(&row);
+        }
+        Handles *all = table.select();
+        ValueDicts *rows = table.project(all);
+        table.freeze();
+        HeapTable frozen("_test_frozen", columnNames, columnAttributes, TableOptions{{"frozen", "true"}});
+        Handles *frozenAll = frozen.select();
+        ValueDicts *frozenRows = frozen.project(frozenAll);
+        string problem;
+        if(!frozen.is_frozen() || *frozenAll != *all || frozenRows->size() != rows->size())
+            problem = "the frozen table didn't find the same rows";
+        for(size_t i = 0; problem.empty() && i < rows->size(); i++)
+            if(*(*rows)[i] != *(*frozenRows)[i])
+                problem = "the frozen table's rows read back differently";
+        row["a"] = Value(-1);
+        try{
+            frozen.insert(&row);
+            if(problem.empty())
+                problem = "a frozen table took an insert";
+        } catch(DbRelationError &e){
+        }
+        try{
+            frozen.del(frozenAll->front());
+            if(problem.empty())
+                problem = "a frozen table took a delete";
+        } catch(DbRelationError &e){
+        }
+        frozen.unfreeze();
+        HeapTable thawed("_test_frozen", columnNames, columnAttributes);
+        thawed.insert(&row);
+        delete all;
+        all = thawed.select();
+        if(problem.empty() && all->size() != 5001)
+            problem = "the unfrozen table has " + to_string(all->size()) + " rows of 5001";
+        thawed.drop();
+        for(auto r : *rows)
+            delete r;
+        for(auto r : *frozenRows)
+            delete r;
+        delete rows;
+        delete frozenRows;
+        delete all;
+        delete frozenAll;
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testMapping();
+        testFrozenTable();
+    }
+}
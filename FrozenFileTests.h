@@ -0,0 +1,7 @@
+#pragma once
+
+namespace FrozenFileTests{
+    void testMapping();
+    void testFrozenTable();
+    void testAll();
+}
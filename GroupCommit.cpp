@@ -0,0 +1,112 @@
+#include "GroupCommit.h"
+#include "db_cxx.h"
+#include "PageFile.h"
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+GroupCommit::GroupCommit(u32 max_delay_us) : max_delay_us(max_delay_us), env(nullptr), running(false),
+                                             stopping(false), active(0), issued(0), flushed(0), failed(0),
+                                             flush_count(0) {
+}
+
+void GroupCommit::start() {
+    if (this->running)
+        return;
+    this->env = _DB_ENV;
+    this->stopping = false;
+    this->running = true;
+    this->worker = thread(&GroupCommit::work, this);
+}
+
+void GroupCommit::stop() {
+    if (!this->running)
+        return;
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->changed.notify_all();
+    this->worker.join();
+    this->env = nullptr;
+    lock_guard<mutex> guard(this->lock);
+    this->running = false;
+    this->changed.notify_all();
+}
+
+void GroupCommit::begin() {
+    lock_guard<mutex> guard(this->lock);
+    this->active++;
+}
+
+u_int64_t GroupCommit::commit() {
+    lock_guard<mutex> guard(this->lock);
+    if (this->active > 0)
+        this->active--;
+    if (this->issued == this->flushed)
+        this->first_waiting = chrono::steady_clock::now();
+    u_int64_t ticket = ++this->issued;
+    this->changed.notify_all();
+    return ticket;
+}
+
+void GroupCommit::end() {
+    lock_guard<mutex> guard(this->lock);
+    if (this->active > 0)
+        this->active--;
+    this->changed.notify_all();  // one less to wait for
+}
+
+void GroupCommit::wait(u_int64_t ticket) {
+    unique_lock<mutex> guard(this->lock);
+    this->changed.wait(guard, [this, ticket] { return this->flushed >= ticket || !this->running; });
+    if (ticket > 0 && ticket <= this->failed)
+        throw DbRelationError("could not flush the log, so the last commit may not survive a crash");
+}
+
+void GroupCommit::get_counts(u_int64_t &flush_count, u_int64_t &commit_count) {
+    lock_guard<mutex> guard(this->lock);
+    flush_count = this->flush_count;
+    commit_count = this->flushed;
+}
+
+// Commits that come in while a flush is under way go in the next one.
+void GroupCommit::work() {
+    unique_lock<mutex> guard(this->lock);
+    while (true) {
+        this->changed.wait(guard, [this] { return this->stopping || this->issued > this->flushed; });
+        if (this->issued == this->flushed)
+            break;  // stopping, and nothing left to flush
+        chrono::steady_clock::time_point deadline = this->first_waiting + chrono::microseconds(this->max_delay_us);
+        this->changed.wait_until(guard, deadline, [this] { return this->stopping || this->active == 0; });
+
+        u_int64_t batch = this->issued;
+        guard.unlock();
+        bool ok = true;
+        try {
+            this->env->log_flush(nullptr);
+            ok = PageFile::sync_written();  // page files aren't logged, so they're flushed themselves
+        } catch (DbException &e) {
+            ok = false;
+        }
+        guard.lock();
+        this->flushed = batch;
+        if (!ok)
+            this->failed = batch;
+        this->flush_count++;
+        if (this->issued > this->flushed)
+            this->first_waiting = chrono::steady_clock::now();
+        this->changed.notify_all();
+
+        if (ok) {
+            guard.unlock();
+            try {
+                this->env->txn_checkpoint(CHECKPOINT_KB, CHECKPOINT_MIN, 0);  // only if it's been long enough
+            } catch (DbException &e) {
+                // the next one will cover it
+            }
+            guard.lock();
+        }
+    }
+}
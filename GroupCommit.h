@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class GroupCommit - makes committed transactions durable by flushing Berkeley DB's log on a background thread,
+ * one flush for however many transactions committed since the last one, so that committing doesn't cost an
+ * fsync per transaction. The page files written since the last flush are synced with it (see PageFile).
+ *
+ * Transactions are committed without syncing the log (the environment has DB_TXN_NOSYNC set), and then the
+ * committer asks for a ticket and waits for it to be flushed. When a commit comes in while other transactions
+ * are still under way, the thread waits for them to commit too, for up to max_delay from the first commit of the
+ * batch; with nothing else under way it flushes straight away, so a lone session never waits for company.
+ *
+ * Committers must wait without holding anything the transactions still running need (e.g. the server's command
+ * lock), or there is nobody to batch with. The thread flushes through the environment handle everyone uses, which
+ * is free-threaded. It also takes a checkpoint now and then, which bounds how much log recovery has to replay on
+ * startup.
+ */
+class GroupCommit {
+public:
+    static const u32 DEFAULT_MAX_DELAY_US = 1000;
+    static const u32 CHECKPOINT_KB = 4096;   // log written since the last checkpoint that calls for another
+    static const u32 CHECKPOINT_MIN = 1;     // or minutes since it
+
+    /**
+     * @param max_delay_us  longest a commit waits for others to join its flush, in microseconds (0 never waits)
+     */
+    explicit GroupCommit(u32 max_delay_us = DEFAULT_MAX_DELAY_US);
+
+    virtual ~GroupCommit() { stop(); }
+
+    GroupCommit(const GroupCommit &other) = delete;
+
+    GroupCommit &operator=(const GroupCommit &other) = delete;
+
+    /**
+     * Start the flushing thread (on _DB_ENV, which must be open and free-threaded).
+     * @throws  std::system_error if the thread can't be started
+     */
+    virtual void start();
+
+    /**
+     * Flush whatever is still waiting, and stop the thread.
+     */
+    virtual void stop();
+
+    /**
+     * A transaction has begun (one the others might wait for).
+     */
+    virtual void begin();
+
+    /**
+     * A transaction that began has committed (without syncing the log).
+     * @returns  the ticket to wait for
+     */
+    virtual u_int64_t commit();
+
+    /**
+     * A transaction that began has ended without anything to make durable.
+     */
+    virtual void end();
+
+    /**
+     * Wait until the log has been flushed past the commit the ticket was handed out for.
+     * @throws  DbRelationError if the flush failed
+     */
+    virtual void wait(u_int64_t ticket);
+
+    /**
+     * How many flushes there have been, and how many commits they covered.
+     */
+    virtual void get_counts(u_int64_t &flush_count, u_int64_t &commit_count);
+
+protected:
+    u32 max_delay_us;
+    DbEnv *env;                // the environment, while the thread is running
+    bool running, stopping;
+    u32 active;                // transactions begun and not yet committed or ended
+    u_int64_t issued;          // last ticket handed out
+    u_int64_t flushed;         // tickets up to this one are durable
+    u_int64_t failed;          // tickets up to this one were in a flush that failed
+    u_int64_t flush_count;
+    std::chrono::steady_clock::time_point first_waiting;  // when the oldest unflushed commit came in
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable changed;
+
+    void work();
+};
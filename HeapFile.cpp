@@ -1,62 +1,199 @@
 #include "HeapFile.h"
+#include <atomic>
 #include <cstring>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+#include <vector>
 #include "db_cxx.h"
+#include "LockManager.h"
+#include "Lz4.h"
 
 using namespace std;
 using u16 = u_int16_t;
 using u32 = u_int32_t;
 
 
+// first byte of each record in a compressed heap file
+static const char STORED_AS_IS = 0;
+static const char STORED_LZ4 = 1;
+
+// gets of one block after another, this many in a row, are taken to be a scan
+static const u32 SEQUENTIAL_RUN = 4;
+
+// a scan with fewer blocks than this left to read isn't worth starting a prefetch thread for
+static const u32 MIN_PREFETCH = 16;
+
+// the blocks put to each file whose writes are being noted (see note_writes), and how many such files there are,
+// so that put needn't take the mutex while there are none
+static std::mutex noted_mutex;
+static std::map<std::string, std::set<BlockID>> noted;
+static std::atomic<int> noting(0);
+
+static DbRelationError frozen_error(const std::string &name) {
+    return DbRelationError(name + " is frozen (UNFREEZE TABLE it first)");
+}
+
 // HEAPFILE PUBLIC METHODS START HERE
 
 // This method gets a new block of data adds it to the file, then returns the pointer to the new object.
 SlottedPage* HeapFile::get_new(void) {
-    char block[DbBlock::BLOCK_SZ];
-    std::memset(block, 0, sizeof(block));
-    Dbt data(block, sizeof(block));
-
-    int block_id = ++this->last;
-    Dbt key(&block_id, sizeof(block_id));
-
-    // write out an empty block and read it back in so Berkeley DB is managing the memory
-    SlottedPage *page = new SlottedPage(data, this->last, true);
-    this->db.put(nullptr, &key, &data, 0); // write it out with initialization done to it
-    delete page;
-    this->db.get(nullptr, &key, &data, 0);
-    return new SlottedPage(data, this->last, true);
+    if (this->frozen != nullptr)
+        throw frozen_error(this->name);
+    this->prefetcher.hold();
+    SlottedPage *page = new SlottedPage(std::vector<char>(this->block_size, 0), ++this->last, true);
+    this->put(page);
+    return page;
 }
 
 void HeapFile::create(void){
-    this->db_open(DB_CREATE | DB_EXCL);
+    if (this->frozen != nullptr)
+        throw frozen_error(this->name);
+    if (this->pages != nullptr) {
+        this->pages->create();
+        this->last = 0;
+        this->closed = false;
+    } else
+        this->db_open(DB_CREATE | DB_EXCL);
+    this->fsm.create();
     SlottedPage* block = this->get_new();
     delete block;
 }
 
+// A frozen file needs nothing but its frozen copy.
 void HeapFile::open(void){
-    this->db_open(0);
+    if (!this->closed)
+        return;
+    if (this->frozen != nullptr) {
+        this->frozen->open();
+        this->last = this->frozen->get_block_count();
+        this->closed = false;
+        return;
+    }
+    if (this->pages != nullptr) {
+        this->pages->open();
+        this->last = this->pages->get_last_block_id();
+        this->closed = false;
+    } else
+        this->db_open(0);
+    if (!this->fsm.open())
+        this->rebuild_free_space_map();  // table from before we kept free-space maps
 }
 
 void HeapFile::close(void){
-    this->db.close(0);
+    this->prefetcher.stop();
+    this->last_get = 0;
+    this->run = 0;
+    if (this->frozen != nullptr) {
+        this->frozen->close();
+        this->closed = true;
+        return;
+    }
+    if (this->pages != nullptr)
+        this->pages->close();
+    else
+        this->handles.close();
+    this->fsm.close();
     this->closed = true;
 }
 
 void HeapFile::drop(void){
     this->close();
-    Db db(_DB_ENV, 0);
-    db.remove(this->dbfilename.c_str(), nullptr, 0);
+    if (this->pages != nullptr) {
+        this->pages->drop();
+    } else {
+        _DB_ENV->dbremove(_DB_TXN, this->dbfilename.c_str(), nullptr, 0);
+    }
+    this->fsm.drop();
+    FrozenFile::remove_if_exists(this->name);
 }
 
 SlottedPage* HeapFile::get(BlockID block_id){
-    Dbt key(&block_id, sizeof(block_id)), block;
-    this->db.get(NULL, &key, &block, 0);
-    return new SlottedPage(block, block_id, false);
+    if (this->pages == nullptr && this->frozen == nullptr)
+        this->note_get(block_id);
+    return this->read(block_id);
+}
+
+// A frozen file's blocks are views into its mapping, not copies.
+SlottedPage *HeapFile::read(BlockID block_id) {
+    if (this->frozen != nullptr) {
+        Dbt block((void *) this->frozen->get(block_id), this->block_size);
+        return new SlottedPage(block, block_id, false);
+    }
+    if (this->pages != nullptr) {
+        std::vector<char> block(this->block_size);
+        this->pages->read(block_id, block.data());
+        return new SlottedPage(std::move(block), block_id, false);
+    }
+    // a compressed record may be a byte longer than the block (see put)
+    std::vector<char> record(this->compressed ? this->block_size + 1 : this->block_size);
+    Dbt key(&block_id, sizeof(block_id)), block(record.data(), (u32) record.size());
+    block.set_ulen((u32) record.size());
+    block.set_flags(DB_DBT_USERMEM);
+    int status;
+    {
+        DbHandlePool::Lease db(this->handles);
+        status = db->get(nullptr, &key, &block, 0);
+    }
+    if (status == DB_NOTFOUND)
+        throw DbRelationError("missing block " + to_string(block_id) + " in " + this->dbfilename);
+    if (this->compressed)
+        return decompress(block, block_id);
+    return new SlottedPage(std::move(record), block_id, false);
 }
 
 void HeapFile::put(DbBlock* block) {
+    if (this->frozen != nullptr)
+        throw frozen_error(this->name);
     BlockID block_id = block->get_block_id();
+    lock(block_id);
+    this->prefetcher.hold();
     Dbt key(&block_id, sizeof(block_id));
-    this->db.put(nullptr, &key, block->get_block(), 0);
+    if (this->pages != nullptr) {
+        this->pages->write(block_id, (const char *) block->get_data());
+    } else if (this->compressed) {
+        std::vector<char> compressed_block;
+        Lz4::compress((const char *) block->get_data(), this->block_size, compressed_block);
+        std::vector<char> record(1 + std::min((u32) compressed_block.size(), this->block_size));
+        if (compressed_block.size() < this->block_size) {
+            record[0] = STORED_LZ4;
+            memcpy(record.data() + 1, compressed_block.data(), compressed_block.size());
+        } else {
+            record[0] = STORED_AS_IS;
+            memcpy(record.data() + 1, block->get_data(), this->block_size);
+        }
+        Dbt data(record.data(), (u32) record.size());
+        DbHandlePool::Lease db(this->handles);
+        db->put(_DB_TXN, &key, &data, 0);
+    } else {
+        DbHandlePool::Lease db(this->handles);
+        db->put(_DB_TXN, &key, block->get_block(), 0);
+    }
+    this->fsm.update(block_id, block->get_free_space());
+    if (noting > 0) {
+        lock_guard<mutex> guard(noted_mutex);
+        auto found = noted.find(this->name);
+        if (found != noted.end())
+            found->second.insert(block_id);
+    }
+}
+
+void HeapFile::lock(BlockID block_id) {
+    LockManager::get().lock_block(this->dbfilename, block_id);
+}
+
+// Falls back to the last block, since the map's categories are coarse and it may still have a little room.
+BlockID HeapFile::find_room(u_int32_t size) {
+    auto writable = [this](BlockID block_id) {
+        return block_id <= this->last && LockManager::get().try_lock_block(this->dbfilename, block_id);
+    };
+    BlockID block_id = this->fsm.find(size, writable);
+    if (block_id != 0)
+        return block_id;
+    return writable(this->last) ? this->last : 0;
 }
 
 BlockIDs* HeapFile::block_ids() {
@@ -66,6 +203,53 @@ BlockIDs* HeapFile::block_ids() {
     return block_ids;
 }
 
+// Each read's buffer becomes the block, so page-file blocks aren't copied after they arrive.
+void HeapFile::get_blocks(const BlockIDs &block_ids, const std::function<void(SlottedPage *)> &deliver) {
+    if (this->frozen != nullptr) {
+        for (auto const &block_id: block_ids) {
+            std::unique_ptr<SlottedPage> block(this->read(block_id));
+            deliver(block.get());
+        }
+        return;
+    }
+    if (this->pages == nullptr) {
+        bool prefetch = block_ids.size() >= MIN_PREFETCH;
+        if (prefetch)
+            this->prefetcher.start(block_ids);
+        for (auto const &block_id: block_ids) {
+            std::unique_ptr<SlottedPage> block(this->read(block_id));
+            this->prefetcher.consumed(block_id);
+            deliver(block.get());
+        }
+        if (prefetch)
+            this->prefetcher.stop();
+        return;
+    }
+    // deleting the reads waits out any still in flight, so it has to happen even if deliver throws
+    std::unique_ptr<PageReads> reads(this->pages->read_async(block_ids));
+    BlockID block_id;
+    std::vector<char> data;
+    while (reads->next(block_id, data)) {
+        std::unique_ptr<SlottedPage> block(new SlottedPage(std::move(data), block_id, false));
+        deliver(block.get());
+        data.clear();
+    }
+}
+
+// The blocks are read in whatever order they arrive (see get_blocks) and put straight into place in the copy.
+void HeapFile::freeze() {
+    if (this->frozen != nullptr)
+        throw frozen_error(this->name);
+    BlockIDs *block_ids = this->block_ids();
+    FrozenFile::create(this->name, this->block_size, this->last, [&](char *blocks) {
+        this->get_blocks(*block_ids, [&](SlottedPage *block) {
+            memcpy(blocks + (size_t) (block->get_block_id() - 1) * this->block_size, block->get_data(),
+                   this->block_size);
+        });
+    });
+    delete block_ids;
+}
+
 // ATTRIBUTION: We copied this method from Professor Lundeen's solution repo
 // void HeapFile::db_open(uint flags) {
 //     cout << endl << "In HeapFile::db_open" << endl;
@@ -92,18 +276,14 @@ void HeapFile::db_open(uint flags) {
     return;
   }
 
-  //set block size and open db
-  this->db.set_re_len(DbBlock::BLOCK_SZ);
-
-  if(flags == 0)
-    this->db.open(NULL, this->dbfilename.c_str(), NULL, DB_RECNO, 0, 0644);  
-  else
-    this->db.open(NULL, this->dbfilename.c_str(), NULL, DB_RECNO, flags, 0644);
+  //open db through the handle pool (which knows the block size; compressed files have variable-length records)
+  this->handles.open(flags);
 
   //intialize db statisitcs and set last block
   if(flags == 0) {
     DB_BTREE_STAT *stat;
-    this->db.stat(nullptr, &stat, DB_FAST_STAT);
+    DbHandlePool::Lease db(this->handles);
+    db->stat(nullptr, &stat, DB_FAST_STAT);
     this->last = stat->bt_ndata;
     free(stat);
   } else this-> last = 0;
@@ -112,10 +292,118 @@ void HeapFile::db_open(uint flags) {
   this->closed = false;
 }
 
+void HeapFile::swap_in(std::string other_name) {
+    if (this->frozen != nullptr)
+        throw frozen_error(this->name);
+    this->prefetcher.stop();
+    if (this->pages != nullptr &&
+        std::rename(PageFile::path(other_name).c_str(), PageFile::path(this->name).c_str()) != 0)
+        throw DbRelationError("could not replace " + PageFile::file_name(this->name) + " with " +
+                              PageFile::file_name(other_name));
+    // Berkeley DB files are replaced through the environment, so that its log knows them by their new names
+    string renames[][2] = {{FreeSpaceMap::file_name(other_name), FreeSpaceMap::file_name(this->name)},
+                           {other_name + ".db", this->dbfilename}};
+    for (auto const &rename: renames) {
+        if (this->pages != nullptr && rename[1] == this->dbfilename)
+            continue;
+        try {
+            _DB_ENV->dbremove(_DB_TXN, rename[1].c_str(), nullptr, 0);
+        } catch (DbException &e) {
+            // wasn't there
+        }
+        try {
+            _DB_ENV->dbrename(_DB_TXN, rename[0].c_str(), nullptr, rename[1].c_str(), 0);
+        } catch (DbException &e) {
+            throw DbRelationError("could not replace " + rename[1] + " with " + rename[0]);
+        }
+    }
+}
+
+void HeapFile::remove_if_exists(std::string name) {
+    string filenames[] = {name + ".db", FreeSpaceMap::file_name(name)};
+    for (auto const &filename: filenames) {
+        try {
+            _DB_ENV->dbremove(_DB_TXN, filename.c_str(), nullptr, 0);
+        } catch (DbException &e) {
+            // wasn't there
+        }
+    }
+    ::unlink(PageFile::path(name).c_str());
+    FrozenFile::remove_if_exists(name);
+}
+
+void HeapFile::note_writes(std::string name) {
+    lock_guard<mutex> guard(noted_mutex);
+    if (noted.find(name) == noted.end())
+        noting++;
+    noted[name].clear();
+}
+
+BlockIDs HeapFile::take_written(std::string name, bool stop) {
+    lock_guard<mutex> guard(noted_mutex);
+    auto found = noted.find(name);
+    if (found == noted.end())
+        return BlockIDs();
+    BlockIDs written(found->second.begin(), found->second.end());
+    found->second.clear();
+    if (stop) {
+        noted.erase(found);
+        noting--;
+    }
+    return written;
+}
+
+SlottedPage *HeapFile::decompress(Dbt &record, BlockID block_id) {
+    const char *bytes = (const char *) record.get_data();
+    u32 size = record.get_size();
+    std::vector<char> block(this->block_size, 0);
+    if (size == 0)
+        throw DbRelationError("missing block " + to_string(block_id) + " in " + this->dbfilename);
+    if (bytes[0] == STORED_AS_IS && size == this->block_size + 1)
+        memcpy(block.data(), bytes + 1, this->block_size);
+    else if (bytes[0] != STORED_LZ4 ||
+             Lz4::decompress(bytes + 1, size - 1, block.data(), this->block_size) != (int) this->block_size)
+        throw DbRelationError("corrupt compressed block " + to_string(block_id) + " in " + this->dbfilename);
+    return new SlottedPage(std::move(block), block_id, false);
+}
+
+// A get that isn't of the block after the last one ends any prefetch that was following the gets. Asking for the
+// same block again doesn't count either way.
+void HeapFile::note_get(BlockID block_id) {
+    if (block_id == this->last_get)
+        return;
+    this->run = block_id == this->last_get + 1 ? this->run + 1 : 0;
+    this->last_get = block_id;
+    if (this->prefetcher.is_running()) {
+        if (this->run == 0)
+            this->prefetcher.stop();
+        else
+            this->prefetcher.consumed(block_id);
+    } else if (this->run >= SEQUENTIAL_RUN && block_id + MIN_PREFETCH <= this->last) {
+        this->prefetcher.start(block_id + 1, this->last);
+    }
+}
+
+// Fill in the free-space map from the blocks themselves.
+void HeapFile::rebuild_free_space_map() {
+    for (BlockID block_id = 1; block_id <= this->last; block_id++) {
+        SlottedPage *block = this->get(block_id);
+        this->fsm.update(block_id, block->get_free_space());
+        delete block;
+    }
+}
+
 // ATTRIBUTION: We copied this method from Professor Lundeen's solution repo
 uint32_t HeapFile::get_block_count() {
+    if (this->frozen != nullptr)
+        return this->frozen->get_block_count();
+    if (this->pages != nullptr)
+        return this->pages->get_block_count();
     DB_BTREE_STAT *stat;
-    this->db.stat(nullptr, &stat, DB_FAST_STAT);
+    {
+        DbHandlePool::Lease db(this->handles);
+        db->stat(nullptr, &stat, DB_FAST_STAT);
+    }
     uint32_t bt_ndata = stat->bt_ndata; 
     free(stat);
 
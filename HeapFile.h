@@ -1,7 +1,13 @@
 #pragma once
 
 #include "SlottedPage.h"
+#include "FreeSpaceMap.h"
+#include "PageFile.h"
+#include "Prefetcher.h"
+#include "FrozenFile.h"
+#include "DbHandlePool.h"
 #include <cstring>
+#include <functional>
 #include "db_cxx.h"
 using namespace std;
 using u16 = u_int16_t;
@@ -14,12 +20,35 @@ using u32 = u_int32_t;
         database blocks for each Berkeley DB record in the RecNo file. In this way we are using Berkeley DB
         for buffer management and file management.
         Uses SlottedPage for storing records within blocks.
+        Keeps a FreeSpaceMap beside the file so inserts can reuse room freed up in earlier blocks.
+        The block size is fixed when the file is created (it's the RecNo record length).
+        A compressed heap file instead has variable-length RecNo records, each one a block compressed with LZ4
+        (or stored as is, if that's no smaller) behind a byte saying which. Blocks are decompressed into memory
+        owned by the SlottedPage on get and compressed again on put.
+        A heap file can instead keep its blocks in a PageFile (a plain file read with pread or io_uring), so that
+        get_blocks can have many reads outstanding at once. Those files can't be compressed.
+        Scans of a Berkeley DB file are helped along by a Prefetcher, started by get_blocks, or by get once it
+        sees blocks being asked for in order. (A page file gets the kernel's read-ahead instead.)
+        A frozen heap file is read-only and served from a FrozenFile written by freeze: get hands out blocks that
+        are views into its memory mapping.
+        A Berkeley DB file is read and written through a DbHandlePool, a handle per thread using it, and the
+        blocks read from it are copied into memory of their own.
+        While VACUUM is copying a file, the blocks put to it are noted (see note_writes).
  */
 class HeapFile : public DbFile {
 public:
-    HeapFile(std::string name) : DbFile(name), last(0), closed(true), db(_DB_ENV, 0) {this->dbfilename = name + ".db";};
-
-    virtual ~HeapFile() {} //nothing to delete for now, ignore
+    /**
+     * @param name        name of the file (and its table)
+     * @param block_size  size of the blocks
+     * @param compressed  whether to compress the blocks (Berkeley DB files only)
+     * @param io_depth    0 to keep the blocks in a Berkeley DB RecNo file; otherwise they're kept in a PageFile,
+     *                    and get_blocks keeps up to this many reads outstanding
+     * @param frozen      read the blocks from the file's frozen copy (see freeze); the file can't be changed
+     */
+    HeapFile(std::string name, u32 block_size = DbBlock::BLOCK_SZ, bool compressed = false, u32 io_depth = 0,
+             bool frozen = false) : DbFile(name), block_size(block_size), compressed(compressed), last(0), closed(true), handles(name + ".db", compressed ? 0 : block_size), fsm(name, block_size), prefetcher(handles, block_size, compressed), last_get(0), run(0), pages(io_depth == 0 ? nullptr : new PageFile(name, block_size, io_depth)), frozen(frozen ? new FrozenFile(name, block_size) : nullptr) {this->dbfilename = name + ".db";};
+
+    virtual ~HeapFile() { delete pages; delete frozen; }
 
     HeapFile(const HeapFile &other) = delete;
 
@@ -43,18 +72,97 @@ public:
 
     virtual void put(DbBlock *block);
 
+    /**
+     * Lock a block for the current transaction to write, before changing anything that depends on it (see
+     * LockManager::lock_block). put locks the block it writes itself.
+     */
+    virtual void lock(BlockID block_id);
+
     virtual BlockIDs *block_ids();
 
+    /**
+     * Read a number of blocks, handing each one to deliver (which mustn't keep it; it's deleted afterwards).
+     * A page file delivers them in whatever order the reads complete, with up to its io_depth of them under way
+     * at once; a Berkeley DB file reads them one at a time in the order given.
+     * @param block_ids  blocks to read
+     * @param deliver    called with each block as it arrives
+     */
+    virtual void get_blocks(const BlockIDs &block_ids, const std::function<void(SlottedPage *)> &deliver);
+
     virtual u_int32_t get_last_block_id() { return last; }
 
+    virtual u32 get_block_size() const { return block_size; }
+
+    virtual bool is_compressed() const { return compressed; }
+
+    /**
+     * @returns  reads the file keeps outstanding in get_blocks, or 0 if it's a Berkeley DB file
+     */
+    virtual u32 get_io_depth() const { return pages == nullptr ? 0 : pages->get_io_depth(); }
+
+    virtual bool is_frozen() const { return frozen != nullptr; }
+
+    /**
+     * Write a frozen copy of the file (replacing any old one), for a HeapFile constructed with frozen set to
+     * serve. The file must be open, and not itself frozen.
+     */
+    virtual void freeze();
+
+    /**
+     * Ask the free-space map for a block with room for a new record, passing over blocks that another transaction
+     * has written and not yet ended (see LockManager::lock_block). The block is locked for the current one.
+     * @param size  size of the new record
+     * @returns     a block that should have room (the last block if the map doesn't know of one), or 0 if there
+     *              is none to be had
+     */
+    virtual BlockID find_room(u_int32_t size);
+
     bool isOpen() {return this->closed == false;}
 
+    uint32_t get_block_count();
+
+    /**
+     * Replace this file (and its free-space map) with the heap file called other_name, which goes away.
+     * Both files must be closed. The rename is atomic, so the table is never without a file.
+     * @param other_name  name the other HeapFile was constructed with
+     */
+    virtual void swap_in(std::string other_name);
+
+    /**
+     * Remove the heap file called name, and its free-space map and frozen copy, if they exist.
+     */
+    static void remove_if_exists(std::string name);
+
+    /**
+     * Start noting the blocks put to the heap file called name, through whichever HeapFile, so that VACUUM can
+     * copy again just the blocks changed after it copied them (see take_written). Forgets any noted before.
+     */
+    static void note_writes(std::string name);
+
+    /**
+     * @param name  the file
+     * @param stop  whether to stop noting its writes as well
+     * @returns     the blocks put to the file since note_writes (or the last take_written), in order
+     */
+    static BlockIDs take_written(std::string name, bool stop);
+
 protected:
     std::string dbfilename;
+    u32 block_size;
+    bool compressed;
     u_int32_t last;
     bool closed;
-    Db db;
+    DbHandlePool handles;  // on the Berkeley DB file, unless the blocks are in pages
+    FreeSpaceMap fsm;
+    Prefetcher prefetcher;
+    BlockID last_get;    // block most recently asked for with get
+    u32 run;             // how many gets in a row have asked for the block after the one before
+    PageFile *pages;     // where the blocks are kept, unless they're in the Berkeley DB file
+    FrozenFile *frozen;  // where they're read from instead, if the file is frozen
 
     virtual void db_open(uint flags = 0);
-    uint32_t get_block_count();
+    void rebuild_free_space_map();
+    SlottedPage *decompress(Dbt &record, BlockID block_id);
+    SlottedPage *read(BlockID block_id);
+    void note_get(BlockID block_id);
 };
\ No newline at end of file
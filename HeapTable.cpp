@@ -1,11 +1,19 @@
 #include "HeapTable.h"
+#include "LockManager.h"
+#include "UndoLog.h"
+#include "VersionStore.h"
 #include <algorithm>
 #include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
 #include<vector> 
 using namespace std;
 using u16 = u_int16_t;
 using u32 = u_int32_t;
 
+const std::string HeapTable::VACUUM_SUFFIX = ".vacuum";
+
 //HeapTable STARTS HERE
 /**
  * Constructor
@@ -13,22 +21,182 @@ using u32 = u_int32_t;
  * @param column_names
  * @param column_attributes
  */
-HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes) : DbRelation(
-        table_name, column_names, column_attributes), file(table_name) {
+HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                     const TableOptions &options) : DbRelation(
+        table_name, column_names, column_attributes),
+        file(table_name, page_size(options), compressed(options), io_depth(options), frozen(options)),
+        overflow(table_name, page_size(options)), dictionaries(this->column_names.size(), nullptr),
+        zone_map(table_name, this->column_names, this->column_attributes),
+        bloom_filter(table_name, page_size(options), this->column_names, bloom_columns(options)),
+        vacuum_table(nullptr) {
+    for (auto const &column_name: dictionary_columns(options)) {
+        auto column = find(this->column_names.begin(), this->column_names.end(), column_name);
+        if (column != this->column_names.end())
+            this->dictionaries[column - this->column_names.begin()] = new Dictionary(table_name, column_name);
+    }
+}
 
-        }
+HeapTable::HeapTable(const HeapTable &table, const std::string &suffix) : DbRelation(
+        table.table_name + suffix, table.column_names, table.column_attributes),
+        file(table.table_name + suffix, table.file.get_block_size(), table.file.is_compressed(),
+             table.file.get_io_depth()),
+        overflow(table.table_name, table.file.get_block_size()), dictionaries(this->column_names.size(), nullptr),
+        zone_map(table.table_name + suffix, this->column_names, this->column_attributes),
+        bloom_filter(table.table_name + suffix, table.file.get_block_size(), this->column_names,
+                     table.bloom_filter.get_columns()),
+        vacuum_table(nullptr) {
+    for (uint col = 0; col < this->column_names.size(); col++)
+        if (table.dictionaries[col] != nullptr)
+            this->dictionaries[col] = new Dictionary(table.table_name, this->column_names[col]);
+}
+
+// A VACUUM still under way is left to the next one, which finds the writes to the table still being noted.
+HeapTable::~HeapTable() {
+    delete this->vacuum_table;
+    for (auto dictionary: this->dictionaries)
+        delete dictionary;
+}
+
+void HeapTable::validate_options(const TableOptions &options, const ColumnNames &column_names,
+                                 ColumnAttributes column_attributes) {
+    for (auto const &option: options)
+        if (option.first != "page_size" && option.first != "compression" && option.first != "dictionary" &&
+            option.first != "bloom" && option.first != "format" && option.first != "storage" &&
+            option.first != "io_depth")
+            throw DbRelationError("unknown table option '" + option.first + "'");
+    auto format = options.find("format");
+    if (format != options.end()) {
+        string value = format->second;
+        transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (value != "heap")
+            throw DbRelationError("format must be heap or columnar, not '" + format->second + "'");
+    }
+    page_size(options);
+    u32 depth = io_depth(options);
+    if (compressed(options) && depth != 0)
+        throw DbRelationError("compression needs storage = bdb");
+    for (auto const &column_name: dictionary_columns(options)) {
+        auto column = find(column_names.begin(), column_names.end(), column_name);
+        if (column == column_names.end())
+            throw DbRelationError("dictionary column '" + column_name + "' is not in the table");
+        if (column_attributes[column - column_names.begin()].get_data_type() != ColumnAttribute::TEXT)
+            throw DbRelationError("dictionary column '" + column_name + "' is not TEXT");
+    }
+    for (auto const &column_name: bloom_columns(options))
+        if (find(column_names.begin(), column_names.end(), column_name) == column_names.end())
+            throw DbRelationError("bloom column '" + column_name + "' is not in the table");
+}
+
+ColumnNames HeapTable::dictionary_columns(const TableOptions &options) {
+    return option_columns(options, "dictionary");
+}
+
+ColumnNames HeapTable::bloom_columns(const TableOptions &options) {
+    return option_columns(options, "bloom");
+}
+
+// The column names are separated by commas and/or spaces.
+ColumnNames HeapTable::option_columns(const TableOptions &options, const std::string &option_name) {
+    ColumnNames column_names;
+    auto option = options.find(option_name);
+    if (option == options.end())
+        return column_names;
+    string value = option->second;
+    replace(value.begin(), value.end(), ',', ' ');
+    istringstream names(value);
+    string column_name;
+    while (names >> column_name)
+        column_names.push_back(column_name);
+    if (column_names.empty())
+        throw DbRelationError(option_name + " needs at least one column");
+    return column_names;
+}
+
+bool HeapTable::compressed(const TableOptions &options) {
+    auto option = options.find("compression");
+    if (option == options.end())
+        return false;
+    string value = option->second;
+    transform(value.begin(), value.end(), value.begin(), ::tolower);
+    if (value != "lz4" && value != "none")
+        throw DbRelationError("compression must be lz4 or none, not '" + option->second + "'");
+    return value == "lz4";
+}
+
+u32 HeapTable::io_depth(const TableOptions &options) {
+    auto storage = options.find("storage");
+    auto depth = options.find("io_depth");
+    string value = storage == options.end() ? "bdb" : storage->second;
+    transform(value.begin(), value.end(), value.begin(), ::tolower);
+    if (value != "bdb" && value != "pagefile")
+        throw DbRelationError("storage must be bdb or pagefile, not '" + storage->second + "'");
+    if (value == "bdb") {
+        if (depth != options.end())
+            throw DbRelationError("io_depth needs storage = pagefile");
+        return 0;
+    }
+    if (depth == options.end())
+        return PageFile::DEFAULT_IO_DEPTH;
+    value = depth->second;
+    u32 io_depth = 0;
+    if (!value.empty() && value.find_first_not_of("0123456789") == string::npos && value.size() < 5)
+        io_depth = (u32) stoul(value);
+    if (io_depth < 1 || io_depth > PageFile::MAX_IO_DEPTH)
+        throw DbRelationError("io_depth must be from 1 to " + to_string(PageFile::MAX_IO_DEPTH) + ", not '" +
+                              depth->second + "'");
+    return io_depth;
+}
+
+bool HeapTable::frozen(const TableOptions &options) {
+    auto option = options.find("frozen");
+    return option != options.end() && option->second == "true";
+}
+
+u32 HeapTable::page_size(const TableOptions &options) {
+    auto option = options.find("page_size");
+    if (option == options.end())
+        return DbBlock::BLOCK_SZ;
+
+    string value = option->second;
+    transform(value.begin(), value.end(), value.begin(), ::toupper);
+    u32 multiplier = 1;
+    if (value.size() > 2 && value.substr(value.size() - 2) == "KB") {
+        multiplier = 1024;
+        value.resize(value.size() - 2);
+    } else if (value.size() > 1 && value.back() == 'K') {
+        multiplier = 1024;
+        value.pop_back();
+    }
+    u32 size = 0;
+    if (!value.empty() && value.find_first_not_of("0123456789") == string::npos && value.size() < 7)
+        size = (u32) stoul(value) * multiplier;
+    for (u32 allowed = DbBlock::BLOCK_SZ; allowed <= DbBlock::MAX_BLOCK_SZ; allowed *= 2)
+        if (size == allowed)
+            return size;
+    throw DbRelationError("page_size must be one of 4K, 8K, 16K, 32K or 64K, not '" + option->second + "'");
+}
 
 
 
 //file is the HeapFile associated with the HeapTable object
+// Each file beside the heap file starts by dropping any left behind by a table of the same name whose heap file
+// is gone.
 void HeapTable::create() {
     file.create();
+    zone_map.create();
+    bloom_filter.create();
+    overflow.drop();
+    for (auto dictionary: this->dictionaries)
+        if (dictionary != nullptr)
+            dictionary->create();
+    if (UndoLog::current != nullptr)
+        UndoLog::current->created(this->table_name);
 }
 
 //This is just a more complicated version of the above
 void HeapTable::create_if_not_exists() {
     try {
-        file.create();
+        this->create();
     } catch(...) {
         file.open();
     }
@@ -37,43 +205,180 @@ void HeapTable::create_if_not_exists() {
 //this calls drop() from the HeapFile on this one
 void HeapTable::drop() {
     file.drop();
+    zone_map.drop();
+    bloom_filter.drop();
+    overflow.drop();
+    for (auto dictionary: this->dictionaries)
+        if (dictionary != nullptr)
+            dictionary->drop();
 }
 
 //as above, so below
 void HeapTable::open() {
     file.open();
+    bool have_zone_map = zone_map.open();
+    bool have_bloom_filter = bloom_filter.open();
+    if (!have_zone_map || !have_bloom_filter)
+        rebuild_block_summaries();  // table from before we kept them, or just vacuumed
 }
 
 //closes the table
 void HeapTable::close() {
     file.close();
+    zone_map.close();
+    bloom_filter.close();
+    overflow.close();
+    for (auto dictionary: this->dictionaries)
+        if (dictionary != nullptr)
+            dictionary->close();
 }
 
 //Handle is a pair of blockID, recordID defined in the abstract classes
 Handle HeapTable::insert(const ValueDict *row) {
+    if (this->is_frozen())
+        throw DbRelationError(this->table_name + " is frozen");
     this->open();
+    LockManager::get().lock_table(this->table_name, LockManager::IX);  // not the new row: no other snapshot can see it
     ValueDict *full_row = validate(row);
     Handle handle = append(full_row);
     delete full_row;
+    if (UndoLog::current != nullptr)
+        UndoLog::current->inserted(this->table_name, handle);
+    VersionStore::get().changed(this->table_name, handle, nullptr);
     return handle;
 }
 
 
-// this is the SQL UPDATE analogue.
+// this is the SQL UPDATE analogue. The row keeps its handle unless the new version no longer fits in its block.
 void HeapTable::update(const Handle handle, const ValueDict *new_values) {
-    throw DbRelationError("Not implemented");
+    if (this->is_frozen())
+        throw DbRelationError(this->table_name + " is frozen");
+    this->open();
+    LockManager::get().lock_row(this->table_name, handle, LockManager::X);
+    VersionStore::get().check_writable(this->table_name, handle);
+    ValueDict *row = project(handle, &this->column_names, true);
+    ValueDict before = *row;
+    for (auto const &column: *new_values) {
+        if (row->find(column.first) == row->end()) {
+            delete row;
+            throw DbRelationError("Column does not exist: '" + column.first + "'");
+        }
+        (*row)[column.first] = column.second;
+    }
+    try {
+        put_row(handle, row);
+    } catch (DbBlockNoRoomError &e) {
+        // no room for it in its block any more, so it moves (a delete and an insert, as in ColumnarTable)
+        if (UndoLog::current != nullptr)
+            UndoLog::current->deleted(this->table_name, handle, before);
+        VersionStore::get().changed(this->table_name, handle, &before);
+        erase(handle);
+        Handle moved = append(row);
+        delete row;
+        if (UndoLog::current != nullptr)
+            UndoLog::current->inserted(this->table_name, moved);
+        VersionStore::get().changed(this->table_name, moved, nullptr);
+        return;
+    }
+    delete row;
+    if (UndoLog::current != nullptr)
+        UndoLog::current->updated(this->table_name, handle, before);
+    VersionStore::get().changed(this->table_name, handle, &before);
 }
 
 // DELETE operation analogue.  Take the block and record ID out, go find it and delete.
 void HeapTable::del(const Handle handle) {
+    if (this->is_frozen())
+        throw DbRelationError(this->table_name + " is frozen");
     this->open();
+    LockManager::get().lock_row(this->table_name, handle, LockManager::X);
+    this->file.lock(handle.first);
+    VersionStore::get().check_writable(this->table_name, handle);
+    if (UndoLog::current != nullptr || VersionStore::current != nullptr) {
+        ValueDict *before = project(handle, &this->column_names, true);
+        if (UndoLog::current != nullptr)
+            UndoLog::current->deleted(this->table_name, handle, *before);
+        VersionStore::get().changed(this->table_name, handle, before);
+        delete before;
+    }
+    erase(handle);
+}
+
+// Rows put back keep their handles where there's still room for them in their blocks. Where there isn't
+// (another session has filled the space since), they go wherever append puts them.
+Handle HeapTable::undo(const UndoRecord &record) {
+    if (record.kind == UndoRecord::CREATED)
+        return DbRelation::undo(record);
+    this->open();
+    if (record.kind == UndoRecord::INSERTED) {
+        erase(record.handle);
+        return record.handle;
+    }
+    try {
+        put_row(record.handle, &record.before);
+        return record.handle;
+    } catch (DbBlockNoRoomError &e) {
+        if (record.kind == UndoRecord::UPDATED)
+            erase(record.handle);
+        return append(&record.before);
+    }
+}
+
+// Takes a row out of its block (and its overflowed values out of the overflow file), with nothing recorded. The
+// block is locked before anything changes, so that if another transaction has it, nothing has.
+void HeapTable::erase(Handle handle) {
     BlockID block_id = handle.first;
     RecordID record_id = handle.second;
+    this->file.lock(block_id);
     SlottedPage *block = this->file.get(block_id);
+    Dbt *data = block->get(record_id);
+    if (data == nullptr) {
+        delete block;
+        throw DbRelationError("no such row");
+    }
+    free_overflow(data);
+    delete data;
     block->del(record_id);
     this->file.put(block);
     delete block;
-    close();
+}
+
+// The old record's bytes are copied before the block is changed, since its overflowed values can only be freed
+// once the new record is safely in. A row that's wider than the one it replaces widens the block's zone map
+// entry (which never narrows until the table is vacuumed).
+void HeapTable::put_row(Handle handle, const ValueDict *row) {
+    BlockID block_id = handle.first;
+    this->file.lock(block_id);  // as in erase
+    Dbt *data = marshal(row);
+    SlottedPage *block = this->file.get(block_id);
+    Dbt *old = block->get(handle.second);
+    bool replacing = old != nullptr;  // rather than putting back a deleted row
+    vector<char> old_bytes;
+    if (replacing)
+        old_bytes.assign((char *) old->get_data(), (char *) old->get_data() + old->get_size());
+    delete old;
+    try {
+        block->put(handle.second, *data);
+    } catch (DbBlockNoRoomError &e) {
+        free_overflow(data);
+        delete block;
+        delete[] (char *) data->get_data();
+        delete data;
+        throw;
+    }
+    this->file.put(block);
+    delete block;
+    delete[] (char *) data->get_data();
+    delete data;
+    if (replacing) {
+        Dbt old_data(old_bytes.data(), (u32) old_bytes.size());
+        free_overflow(&old_data);
+        this->bloom_filter.add(block_id, row, false);
+        this->zone_map.add(block_id, row);
+    } else {
+        this->bloom_filter.add(block_id, row, this->zone_map.is_empty(block_id));
+        this->zone_map.add(block_id, row);
+    }
 }
 
 // Temporarily copied David and Haley's code from MS2
@@ -100,28 +405,88 @@ Handles *HeapTable::select() {
 Handles *HeapTable::select(const ValueDict *where) {
     open();
     Handles* handles = new Handles();
-    BlockIDs* block_ids = file.block_ids();
-    for (auto const& block_id: *block_ids) {
-        SlottedPage* block = file.get(block_id);
-        RecordIDs* record_ids = block->ids();
+    ValueDict encoded;
+    if (where != nullptr && !encode_where(where, encoded))
+        return handles;  // wants a value that isn't in a column's dictionary, so no row has it
+    ValueRanges ranges;
+    if (where != nullptr) {
+        for (auto const &column: *where) {
+            ranges[column.first].restrict_min(column.second, true);
+            ranges[column.first].restrict_max(column.second, true);
+        }
+    }
+    // the rows come back in the order their blocks arrive in, which for a pagefile table needn't be block order
+    file.get_blocks(candidate_blocks(ranges), [&](SlottedPage *block) {
+        RecordIDs *record_ids = block->ids();
+        for (auto const &record_id: *record_ids)
+            if (where == nullptr || selected(block, record_id, &encoded))
+                handles->push_back(Handle(block->get_block_id(), record_id));
+        delete record_ids;
+    });
+    VersionStore::get().select(this->table_name, handles, [where](const ValueDict &row) {
+        if (where != nullptr)
+            for (auto const &column: *where)
+                if (row.at(column.first) != column.second)
+                    return false;
+        return true;
+    });
+    return handles;
+}
+
+// Blocks the zone map or Bloom filters rule out aren't read at all. For a table filled in order of a column, a
+// range on that column only reads the blocks holding the range.
+Handles *HeapTable::select(const ValueRanges &ranges) {
+    open();
+    Handles *handles = new Handles();
+    ColumnNames column_names;
+    for (auto const &range: ranges)
+        column_names.push_back(range.first);
+    file.get_blocks(candidate_blocks(ranges), [&](SlottedPage *block) {
+        RecordIDs *record_ids = block->ids();
         for (auto const &record_id: *record_ids) {
-            Handle handle(block_id, record_id);
-            ValueDict copy;
-            if(where != nullptr) {
-                // std::cout << "Debug for select / where" << std::endl;
-                copy.insert(where->begin(), where->end()); 
-                if (selected(handle, &copy))
-                    handles->push_back(Handle(block_id, record_id));
-            } else
-            {
-                //std::cout << "Debug for select / no where block id {" << block_id << "} and recordid {" << record_id<< "}" << std::endl;
-                handles->push_back(Handle(block_id, record_id));
-            }
+            ValueDict *row = this->project(block, record_id, &column_names, true);
+            bool selected = true;
+            for (auto const &range: ranges)
+                selected = selected && range.second.contains((*row)[range.first]);
+            if (selected)
+                handles->push_back(Handle(block->get_block_id(), record_id));
+            delete row;
         }
         delete record_ids;
-        delete block;
-    }
-    delete block_ids;
+    });
+    VersionStore::get().select(this->table_name, handles, [&ranges](const ValueDict &row) {
+        for (auto const &range: ranges)
+            if (!range.second.contains(row.at(range.first)))
+                return false;
+        return true;
+    });
+    return handles;
+}
+
+BlockIDs HeapTable::candidate_blocks(const ValueRanges &ranges) {
+    BlockIDs block_ids;
+    for (BlockID block_id = 1; block_id <= this->file.get_last_block_id(); block_id++)
+        if (zone_map.might_match(block_id, ranges) && bloom_filter.might_match(block_id, ranges))
+            block_ids.push_back(block_id);
+    return block_ids;
+}
+
+// The blocks are picked evenly spaced through the file, so a table filled in order of some column is sampled
+// across the whole range of that column.
+Handles *HeapTable::sample(BlockID max_blocks, BlockID &picked, BlockID &block_count) {
+    open();
+    Handles *handles = new Handles();
+    block_count = this->file.get_last_block_id();
+    picked = min(max_blocks, block_count);
+    BlockIDs block_ids;
+    for (BlockID i = 0; i < picked; i++)
+        block_ids.push_back((BlockID) ((u_int64_t) i * block_count / picked) + 1);
+    file.get_blocks(block_ids, [&](SlottedPage *block) {
+        RecordIDs *record_ids = block->ids();
+        for (auto const &record_id: *record_ids)
+            handles->push_back(Handle(block->get_block_id(), record_id));
+        delete record_ids;
+    });
     return handles;
 }
 
@@ -133,20 +498,40 @@ Handles *select(Handles *current_selection, const ValueDict *where){
 
 // ATTRIBUTION: we copied this method from Professor Lundeen's solution repo
 /**
- * See if the row at the given handle satisfies the given where clause
- * @param handle  row to check
- * @param where   conditions to check
- * @return        true if conditions met, false otherwise
+ * See if a row satisfies the given where clause
+ * @param block      block the row is in
+ * @param record_id  row to check
+ * @param where      conditions to check (from encode_where)
+ * @return           true if conditions met, false otherwise
  */
-bool HeapTable::selected(Handle handle, const ValueDict *where) {
+bool HeapTable::selected(SlottedPage *block, RecordID record_id, const ValueDict *where) {
     if (where == nullptr)
         return true;
-    ValueDict *row = this->project(handle, *where);
+    ColumnNames column_names;
+    for (auto const &column: *where)
+        column_names.push_back(column.first);
+    ValueDict *row = this->project(block, record_id, &column_names, false);
     bool is_selected = *row == *where;
     delete row;
     return is_selected;
 }
 
+// Values wanted for dictionary columns are swapped for their codes, so rows can be checked without decoding.
+bool HeapTable::encode_where(const ValueDict *where, ValueDict &encoded) {
+    encoded = *where;
+    for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+        Dictionary *dictionary = this->dictionaries[col_num];
+        auto column = encoded.find(this->column_names[col_num]);
+        if (dictionary == nullptr || column == encoded.end())
+            continue;
+        u32 code;
+        if (column->second.data_type != ColumnAttribute::TEXT || !dictionary->find(column->second.s, code))
+            return false;
+        column->second = Value((int32_t) code);
+    }
+    return true;
+}
+
 
 // Just pulls out the column names from a ValueDict and passes that to the usual form of project().
 ValueDict *HeapTable::project(Handle handle, ValueDict where) {
@@ -166,14 +551,56 @@ ValueDict *HeapTable::project(Handle handle) {
 
 // This is the part that actually does the projecting.  
 ValueDict *HeapTable::project(Handle handle, const ColumnNames *column_names) {
+    ValueDict *row = VersionStore::get().project(this->table_name, handle, column_names);
+    if (row != nullptr)
+        return row;
+    return project(handle, column_names, true);
+}
 
-    BlockID block_id = handle.first;
-    RecordID record_id = handle.second;
-    SlottedPage *block = file.get(block_id);
+ValueDict *HeapTable::project(Handle handle, const ColumnNames *column_names, bool decode) {
+    SlottedPage *block = file.get(handle.first);
+    ValueDict *row;
+    try {
+        row = project(block, handle.second, column_names, decode);
+    } catch (DbRelationError &e) {
+        delete block;
+        throw;
+    }
+    delete block;
+    return row;
+}
+
+// Reads each block the handles are in just once. The rows come back in the order of the handles, whatever order
+// the blocks arrive in.
+ValueDicts *HeapTable::project(Handles *handles, const ColumnNames *column_names) {
+    open();
+    ValueDicts *rows = new ValueDicts(handles->size(), nullptr);
+    map<BlockID, vector<size_t>> positions;  // where each block's rows go in rows
+    for (size_t i = 0; i < handles->size(); i++) {
+        (*rows)[i] = VersionStore::get().project(this->table_name, (*handles)[i], column_names);
+        if ((*rows)[i] == nullptr)
+            positions[(*handles)[i].first].push_back(i);
+    }
+    BlockIDs block_ids;
+    for (auto const &block: positions)
+        block_ids.push_back(block.first);
+    file.get_blocks(block_ids, [&](SlottedPage *block) {
+        for (auto const &i: positions[block->get_block_id()])
+            (*rows)[i] = project(block, (*handles)[i].second, column_names, true);
+    });
+    return rows;
+}
+
+ValueDicts *HeapTable::project(Handles *handles) {
+    return project(handles, &this->column_names);
+}
+
+ValueDict *HeapTable::project(SlottedPage *block, RecordID record_id, const ColumnNames *column_names, bool decode) {
     Dbt *data = block->get(record_id);
-    ValueDict *row = unmarshal(data);
+    if (data == nullptr)
+        throw DbRelationError("no such row");
+    ValueDict *row = unmarshal(data, column_names->empty() ? nullptr : column_names, decode);
     delete data;
-    delete block;
     if (column_names->empty())
         return row;
     ValueDict *result = new ValueDict();
@@ -189,6 +616,182 @@ ValueDict *HeapTable::project(Handle handle, const ColumnNames *column_names) {
     return result;
 }
 
+BlockID HeapTable::get_block_count() {
+    this->open();
+    return this->file.get_last_block_id();
+}
+
+// Records are copied as-is (they're already marshaled), filling each new block before starting the next.
+// Block counts come from Berkeley DB rather than our cached count since other processes may be writing.
+// The blocks are noted as written from before the first of them is read, so none written afterwards is missed.
+HeapTable &HeapTable::vacuum_copy(bool &fresh) {
+    this->open();
+    fresh = this->vacuum_table == nullptr;
+    if (!fresh)
+        return *this->vacuum_table;
+    remove_vacuum_files(this->table_name);  // left over from an interrupted VACUUM
+    HeapFile::note_writes(this->table_name);
+    this->vacuum_table = new HeapTable(*this, VACUUM_SUFFIX);
+    this->vacuum_table->file.create();
+    this->vacuum_table->zone_map.create();
+    this->vacuum_table->bloom_filter.create();
+    this->vacuum_rows.clear();
+    BlockID block_count = this->file.get_block_count();
+    for (BlockID block_id = 1; block_id <= block_count; block_id++)
+        this->vacuum_rows.push_back(copy_block(block_id));
+    return *this->vacuum_table;
+}
+
+// A changed block's rows are taken out of the copy (without freeing their overflowed values, which the table's
+// own records still use, or which were freed when they were) and copied again, as are blocks added since.
+BlockID HeapTable::vacuum_swap(const std::vector<DbIndex *> &indices) {
+    if (this->vacuum_table == nullptr)
+        throw DbRelationError(this->table_name + " has no copy to swap in (VACUUM it again)");
+    this->open();
+    HeapTable *copy = this->vacuum_table;
+    BlockIDs noted = HeapFile::take_written(this->table_name, true);
+    set<BlockID> written(noted.begin(), noted.end());
+    BlockID block_count = this->file.get_block_count();
+    for (BlockID block_id = (BlockID) this->vacuum_rows.size() + 1; block_id <= block_count; block_id++)
+        written.insert(block_id);
+    this->vacuum_rows.resize(block_count);
+    for (auto const &block_id: written) {
+        for (auto const &handle: this->vacuum_rows[block_id - 1]) {
+            for (auto index: indices)
+                index->del(handle);
+            SlottedPage *block = copy->file.get(handle.first);
+            block->del(handle.second);
+            copy->file.put(block);
+            delete block;
+        }
+        this->vacuum_rows[block_id - 1] = copy_block(block_id);
+        for (auto const &handle: this->vacuum_rows[block_id - 1])
+            for (auto index: indices)
+                index->insert(handle);
+    }
+
+    Identifier copy_name = copy->table_name;
+    copy->close();
+    delete copy;
+    this->vacuum_table = nullptr;
+    this->vacuum_rows.clear();
+    this->close();
+    this->file.swap_in(copy_name);
+    string renames[][2] = {{ZoneMap::file_name(copy_name), ZoneMap::file_name(this->table_name)},
+                           {BloomFilter::file_name(copy_name), BloomFilter::file_name(this->table_name)}};
+    for (auto const &rename: renames) {
+        // one that's missing (a table with no Bloom filters has no file for them) is rebuilt when next opened
+        try {
+            _DB_ENV->dbremove(_DB_TXN, rename[1].c_str(), nullptr, 0);
+        } catch (DbException &e) {
+            // wasn't there
+        }
+        try {
+            _DB_ENV->dbrename(_DB_TXN, rename[0].c_str(), nullptr, rename[1].c_str(), 0);
+        } catch (DbException &e) {
+            // wasn't there either
+        }
+    }
+
+    HeapFile compacted(this->table_name, this->file.get_block_size(), this->file.is_compressed(),
+                       this->file.get_io_depth());
+    compacted.open();
+    BlockID new_block_count = compacted.get_last_block_id();
+    compacted.close();
+    return new_block_count;
+}
+
+void HeapTable::vacuum_abandon() {
+    if (this->vacuum_table == nullptr)
+        return;
+    HeapFile::take_written(this->table_name, true);
+    this->vacuum_table->close();
+    delete this->vacuum_table;
+    this->vacuum_table = nullptr;
+    this->vacuum_rows.clear();
+    remove_vacuum_files(this->table_name);
+}
+
+Handles HeapTable::copy_block(BlockID block_id) {
+    Handles copied;
+    SlottedPage *block = this->file.get(block_id);
+    RecordIDs *record_ids = block->ids();
+    SlottedPage *target = this->vacuum_table->file.get(this->vacuum_table->file.get_last_block_id());
+    for (auto const &record_id: *record_ids) {
+        Dbt *data = block->get(record_id);
+        copied.push_back(this->vacuum_table->add_copied(target, data));
+        delete data;
+    }
+    this->vacuum_table->file.put(target);
+    delete target;
+    delete record_ids;
+    delete block;
+    return copied;
+}
+
+Handle HeapTable::add_copied(SlottedPage *&target, Dbt *data) {
+    RecordID record_id;
+    try {
+        record_id = target->add(data);
+    } catch (DbBlockNoRoomError &e) {
+        this->file.put(target);
+        delete target;
+        target = this->file.get_new();
+        record_id = target->add(data);
+    }
+    BlockID block_id = target->get_block_id();
+    ValueDict *row = unmarshal(data);
+    this->bloom_filter.add(block_id, row, this->zone_map.is_empty(block_id));
+    this->zone_map.add(block_id, row);
+    delete row;
+    return Handle(block_id, record_id);
+}
+
+void HeapTable::remove_vacuum_files(const Identifier &table_name) {
+    HeapFile::remove_if_exists(table_name + VACUUM_SUFFIX);
+    for (auto const &filename: {ZoneMap::file_name(table_name + VACUUM_SUFFIX),
+                                BloomFilter::file_name(table_name + VACUUM_SUFFIX)}) {
+        try {
+            _DB_ENV->dbremove(_DB_TXN, filename.c_str(), nullptr, 0);
+        } catch (DbException &e) {
+            // wasn't there
+        }
+    }
+}
+
+// The zone map, Bloom filters, overflow file and dictionaries can't change once the table is frozen, so they go
+// on being used as they are; only the heap file is copied.
+void HeapTable::freeze() {
+    this->open();
+    this->file.freeze();
+    this->close();
+}
+
+void HeapTable::unfreeze() {
+    this->close();
+    FrozenFile::remove_if_exists(this->table_name);
+}
+
+// Fill in the zone map and Bloom filters afresh from the rows themselves.
+void HeapTable::rebuild_block_summaries() {
+    this->zone_map.create();
+    this->bloom_filter.create();
+    for (BlockID block_id = 1; block_id <= this->file.get_last_block_id(); block_id++) {
+        SlottedPage *block = this->file.get(block_id);
+        RecordIDs *record_ids = block->ids();
+        for (auto const &record_id: *record_ids) {
+            Dbt *data = block->get(record_id);
+            ValueDict *row = unmarshal(data);
+            this->bloom_filter.add(block_id, row, this->zone_map.is_empty(block_id));
+            this->zone_map.add(block_id, row);
+            delete row;
+            delete data;
+        }
+        delete record_ids;
+        delete block;
+    }
+}
+
 //Check if this row is acceptable to insert.
 ValueDict *HeapTable::validate(const ValueDict *row) {
     ValueDict *full_row = new ValueDict();
@@ -205,88 +808,197 @@ ValueDict *HeapTable::validate(const ValueDict *row) {
 }
 
 //Add another record.  Returns the handle of the new row.
+//Goes into whichever block the free-space map says has room (which may be one emptied out by deletes),
+//or else the last block, or else a brand new block at the end of the file.
 Handle HeapTable::append(const ValueDict *row) {
     Dbt *data = marshal(row);
-    SlottedPage *block = this->file.get(this->file.get_last_block_id());
-    RecordID record_id;
-    try {
-        record_id = block->add(data);
-    } catch (DbBlockNoRoomError &e) {
-        delete block;
+    SlottedPage *block = nullptr;
+    RecordID record_id = 0;
+    BlockID block_id = this->file.find_room(data->get_size());
+    if (block_id != 0) {
+        block = this->file.get(block_id);
+        try {
+            record_id = block->add(data);
+        } catch (DbBlockNoRoomError &e) {
+            delete block;
+            block = nullptr;
+        }
+    }
+    if (block == nullptr) {
         block = this->file.get_new();
         record_id = block->add(data);
     }
     this->file.put(block);
+    this->bloom_filter.add(block->get_block_id(), row, this->zone_map.is_empty(block->get_block_id()));
+    this->zone_map.add(block->get_block_id(), row);
+    Handle handle(block->get_block_id(), record_id);
     delete block;
     delete[] (char *) data->get_data();
     delete data;
-    return Handle(this->file.get_last_block_id(), record_id);
+    return handle;
+}
+
+// In a row, a TEXT value is normally a u16 length followed by the bytes. An overflowed one has OVERFLOW_MARKER
+// for its length, then the u32 full length, the u32 first overflow page, and the first OVERFLOW_PREFIX_SZ bytes
+// of the value. The rest of the value is in the overflow file.
+static const u16 OVERFLOW_MARKER = UINT16_MAX;
+static const uint OVERFLOW_INLINE_SZ = sizeof(u16) + 2 * sizeof(u32) + HeapTable::OVERFLOW_PREFIX_SZ;
+
+// A dictionary-encoded value is just its code, 7 bits to a byte with the high bit set on all but the last byte.
+static uint varint_size(u32 n) {
+    uint size = 1;
+    while (n >= 0x80) {
+        n >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static void put_varint(char *bytes, uint &offset, u32 n) {
+    while (n >= 0x80) {
+        bytes[offset++] = (char) ((n & 0x7F) | 0x80);
+        n >>= 7;
+    }
+    bytes[offset++] = (char) n;
+}
+
+static u32 get_varint(const char *bytes, uint &offset) {
+    u32 n = 0;
+    for (uint shift = 0;; shift += 7) {
+        u_int8_t b = (u_int8_t) bytes[offset++];
+        n |= (u32) (b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return n;
+    }
 }
 
 // ATTRIBUTION: we copied marshal() from Prof. Lundeen's solution repo
 // return the bits to go into the file
 // caller responsible for freeing the returned Dbt and its enclosed ret->get_data().
 Dbt *HeapTable::marshal(const ValueDict *row) {
-    char *bytes = new char[DbBlock::BLOCK_SZ]; // more than we need (we insist that one row fits into DbBlock::BLOCK_SZ)
+    const uint block_size = this->file.get_block_size();
+    const uint max_row_size = block_size - 9;  // what an empty SlottedPage has room for
+
+    // TEXT values over a quarter of a block go out of line, then the biggest of the rest until the row fits
+    vector<bool> out_of_line(this->column_names.size(), false);
+    vector<u32> codes(this->column_names.size(), 0);
+    uint row_size = 0;
+    for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+        ColumnAttribute::DataType data_type = this->column_attributes[col_num].get_data_type();
+        if (this->dictionaries[col_num] != nullptr) {
+            codes[col_num] = this->dictionaries[col_num]->encode(row->at(this->column_names[col_num]).s);
+            row_size += varint_size(codes[col_num]);
+        } else if (data_type == ColumnAttribute::DataType::INT) {
+            row_size += sizeof(int32_t);
+        } else if (data_type == ColumnAttribute::DataType::BOOLEAN) {
+            row_size += sizeof(uint8_t);
+        } else if (data_type == ColumnAttribute::DataType::TEXT) {
+            u_long size = row->at(this->column_names[col_num]).s.length();
+            if (size > UINT32_MAX)
+                throw DbRelationError("text field too long to marshal");
+            out_of_line[col_num] = size > block_size / 4;
+            row_size += out_of_line[col_num] ? OVERFLOW_INLINE_SZ : sizeof(u16) + size;
+        }
+    }
+    while (row_size > max_row_size) {
+        int biggest = -1;
+        u_long biggest_size = OVERFLOW_INLINE_SZ;
+        for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+            if (this->column_attributes[col_num].get_data_type() != ColumnAttribute::DataType::TEXT ||
+                out_of_line[col_num] || this->dictionaries[col_num] != nullptr)
+                continue;
+            u_long size = row->at(this->column_names[col_num]).s.length();
+            if (size > biggest_size) {
+                biggest = col_num;
+                biggest_size = size;
+            }
+        }
+        if (biggest < 0)
+            throw DbRelationError("row too big to marshal");
+        out_of_line[biggest] = true;
+        row_size -= sizeof(u16) + biggest_size - OVERFLOW_INLINE_SZ;
+    }
+
+    char *bytes = new char[row_size];
     uint offset = 0;
     uint col_num = 0;
     for (auto const &column_name: this->column_names) {
-        ColumnAttribute ca = this->column_attributes[col_num++];
+        ColumnAttribute ca = this->column_attributes[col_num];
         ValueDict::const_iterator column = row->find(column_name);
         Value value = column->second;
 
-        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
-            if (offset + 4 > DbBlock::BLOCK_SZ - 4)
-                throw DbRelationError("row too big to marshal");
+        if (this->dictionaries[col_num] != nullptr) {
+            put_varint(bytes, offset, codes[col_num]);
+        } else if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
             *(int32_t *) (bytes + offset) = value.n;
             offset += sizeof(int32_t);
+        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT && out_of_line[col_num]) {
+            u32 size = (u32) value.s.length();
+            *(u16 *) (bytes + offset) = OVERFLOW_MARKER;
+            offset += sizeof(u16);
+            *(u32 *) (bytes + offset) = size;
+            offset += sizeof(u32);
+            *(u32 *) (bytes + offset) = this->overflow.write(value.s.data() + OVERFLOW_PREFIX_SZ,
+                                                             size - OVERFLOW_PREFIX_SZ);
+            offset += sizeof(u32);
+            memcpy(bytes + offset, value.s.data(), OVERFLOW_PREFIX_SZ);
+            offset += OVERFLOW_PREFIX_SZ;
         } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
-            u_long size = value.s.length();
-            if (size > UINT16_MAX)
-                throw DbRelationError("text field too long to marshal");
-            if (offset + 2 + size > DbBlock::BLOCK_SZ)
-                throw DbRelationError("row too big to marshal");
+            u16 size = (u16) value.s.length();
             *(u16 *) (bytes + offset) = size;
             offset += sizeof(u16);
             memcpy(bytes + offset, value.s.c_str(), size); // assume ascii for now
             offset += size;
         } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
-            if (offset + 1 > DbBlock::BLOCK_SZ - 1)
-                throw DbRelationError("row too big to marshal");
             *(uint8_t *) (bytes + offset) = (uint8_t) value.n;
             offset += sizeof(uint8_t);
         } else {
+            delete[] bytes;
             throw DbRelationError("Only know how to marshal INT, TEXT, and BOOLEAN");
         }
+        col_num++;
     }
-    char *right_size_bytes = new char[offset];
-    memcpy(right_size_bytes, bytes, offset);
-    delete[] bytes;
-    Dbt *data = new Dbt(right_size_bytes, offset);
+    Dbt *data = new Dbt(bytes, offset);
     return data;
 }
 
 // ATTRIBUTION: we copied unmarshal from Prof. Lundeen's solution repo
-ValueDict *HeapTable::unmarshal(Dbt *data) {
+ValueDict *HeapTable::unmarshal(Dbt *data, const ColumnNames *wanted, bool decode) {
     ValueDict *row = new ValueDict();
     Value value;
     char *bytes = (char *) data->get_data();
     uint offset = 0;
     uint col_num = 0;
     for (auto const &column_name: this->column_names) {
+        Dictionary *dictionary = this->dictionaries[col_num];
         ColumnAttribute ca = this->column_attributes[col_num++];
         value.data_type = ca.get_data_type();
-        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
+        if (dictionary != nullptr) {
+            u32 code = get_varint(bytes, offset);
+            if (decode) {
+                value.s = dictionary->decode(code);
+            } else {
+                value.data_type = ColumnAttribute::DataType::INT;
+                value.n = (int32_t) code;
+            }
+        } else if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
             value.n = *(int32_t *) (bytes + offset);
             offset += sizeof(int32_t);
         } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
             u16 size = *(u16 *) (bytes + offset);
             offset += sizeof(u16);
-            char buffer[DbBlock::BLOCK_SZ];
-            memcpy(buffer, bytes + offset, size);
-            buffer[size] = '\0';
-            value.s = string(buffer);  // assume ascii for now
-            offset += size;
+            if (size == OVERFLOW_MARKER) {
+                u32 full_size = *(u32 *) (bytes + offset);
+                BlockID first = *(u32 *) (bytes + offset + sizeof(u32));
+                offset += 2 * sizeof(u32) + OVERFLOW_PREFIX_SZ;
+                if (wanted != nullptr && find(wanted->begin(), wanted->end(), column_name) == wanted->end())
+                    continue;  // nobody's going to look at it, so don't bother with the overflow pages
+                value.s = string(bytes + offset - OVERFLOW_PREFIX_SZ, OVERFLOW_PREFIX_SZ) +
+                          this->overflow.read(first, full_size - OVERFLOW_PREFIX_SZ);
+            } else {
+                value.s = string(bytes + offset, size);  // assume ascii for now
+                offset += size;
+            }
         } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
             value.n = *(uint8_t *) (bytes + offset);
             offset += sizeof(uint8_t);
@@ -298,6 +1010,31 @@ ValueDict *HeapTable::unmarshal(Dbt *data) {
     return row;
 }
 
+// Give back the overflow pages of a record that's going away.
+void HeapTable::free_overflow(Dbt *data) {
+    char *bytes = (char *) data->get_data();
+    uint offset = 0;
+    uint col_num = 0;
+    for (auto ca: this->column_attributes) {
+        if (this->dictionaries[col_num++] != nullptr) {
+            get_varint(bytes, offset);
+        } else if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
+            offset += sizeof(int32_t);
+        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
+            u16 size = *(u16 *) (bytes + offset);
+            offset += sizeof(u16);
+            if (size == OVERFLOW_MARKER) {
+                this->overflow.free(*(u32 *) (bytes + offset + sizeof(u32)));
+                offset += 2 * sizeof(u32) + OVERFLOW_PREFIX_SZ;
+            } else {
+                offset += size;
+            }
+        } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
+            offset += sizeof(uint8_t);
+        }
+    }
+}
+
 // PREVIOUS CODE: Echidna
 
 // SELECT operation analogue.  Load up your block IDs from the file, then your IDs from the block and where they match, push back a handle object and return it once they're all checked.
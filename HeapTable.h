@@ -2,20 +2,30 @@
 
 #include "storage_engine.h"
 #include "HeapFile.h"
+#include "OverflowFile.h"
+#include "Dictionary.h"
+#include "ZoneMap.h"
+#include "BloomFilter.h"
 #include <cstring>
 #include "db_cxx.h"
 using namespace std;
 using u16 = u_int16_t;
 using u32 = u_int32_t;
+
 /**
  * @class HeapTable - Heap storage engine (implementation of DbRelation)
+ *
+ * A table's files are all named after it: "<name>.db" for the heap file and "<name>.<what>" for each file
+ * beside it (free-space map, zone map, overflow file, etc.) and for VACUUM's copy. Table names can't contain
+ * '.' (see SQLExec::create), so none of those names can be another table's.
  */
 
 class HeapTable : public DbRelation {
 public:
-    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes);
+    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+              const TableOptions &options = TableOptions());
 
-    virtual ~HeapTable() {}
+    virtual ~HeapTable();
 
     HeapTable(const HeapTable &other) = delete;
 
@@ -37,31 +47,229 @@ public:
 
     virtual Handle insert(const ValueDict *row);
 
-    //Note: ignore these for now, they will be updated in future milestones
     virtual void update(const Handle handle, const ValueDict *new_values);
 
     virtual void del(const Handle handle) ;
 
+    virtual Handle undo(const UndoRecord &record);
+
     virtual Handles *select();
 
     virtual Handles *select(const ValueDict *where);
 
+    virtual Handles *select(const ValueRanges &ranges);
+
+    virtual Handles *sample(BlockID max_blocks, BlockID &picked, BlockID &block_count);
+
     virtual ValueDict *project(Handle handle);
 
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
 
+    virtual ValueDicts *project(Handles *handles);
+
+    virtual ValueDicts *project(Handles *handles, const ColumnNames *column_names);
+
+    /**
+     * Number of blocks currently in the table's file.
+     */
+    virtual BlockID get_block_count();
+
+    /**
+     * First half of VACUUM: copy every live row, densely packed, into a table beside this one (named with
+     * VACUUM_SUFFIX, and reading this one's overflow file and dictionaries), for the caller to build the table's
+     * indices on. The table is only read, so other users can go on using it meanwhile; the blocks they write from
+     * now on are noted for vacuum_swap. A copy this object made before (for a VACUUM that then gave way to wait
+     * for its lock) is kept instead, since the writes since are noted too.
+     * @param fresh  set to whether the copy was just made, so its indices are still to be built
+     * @returns      the copy (owned by this object)
+     */
+    virtual HeapTable &vacuum_copy(bool &fresh);
+
+    /**
+     * Second half of VACUUM: bring the copy made by vacuum_copy up to date and swap it in for the table. Call with
+     * the table locked. Only the blocks written since they were copied are copied again: the rows they had are
+     * taken out of the copy and the rows they have now are put in, and the indices built on the copy are told
+     * of both. The copy's zone map and Bloom filters replace the table's along with its file.
+     * Afterwards this object's file is closed for good and rows have new handles, so the caller must stop
+     * using this object and swap the indices built on the copy in for the table's.
+     * @param indices  the indices built on the copy
+     * @returns        number of blocks in the new file
+     */
+    virtual BlockID vacuum_swap(const std::vector<DbIndex *> &indices);
+
+    /**
+     * Give up on a VACUUM between vacuum_copy and vacuum_swap: stop noting writes and remove the copy.
+     */
+    virtual void vacuum_abandon();
+
+    /**
+     * Suffix of the temporary table name that VACUUM builds its copy under.
+     */
+    static const std::string VACUUM_SUFFIX;
+
+    /**
+     * Whether the table is frozen (see freeze). A frozen table can be read but not changed.
+     */
+    virtual bool is_frozen() const { return file.is_frozen(); }
+
+    /**
+     * See whether the table's writes are logged (so are undone by recovery if their transaction never commits),
+     * which they aren't if it's kept in a page file.
+     */
+    virtual bool is_logged() const { return file.get_io_depth() == 0; }
+
+    /**
+     * Write the frozen copy of the table's file that FREEZE TABLE has it read from. Recording that the table is
+     * frozen (its frozen option) is up to the caller, as is building a new HeapTable to make use of the copy.
+     */
+    virtual void freeze();
+
+    /**
+     * Remove the table's frozen copy, for UNFREEZE TABLE. Call on the frozen table, and then stop using it:
+     * like freeze, the caller records the change in the table's options and builds a new HeapTable.
+     */
+    virtual void unfreeze();
+
+    /**
+     * Check the storage options given to CREATE TABLE for a heap table.
+     * Recognized: page_size (4096, 8192, 16384, 32768 or 65536 bytes; "8K", "8KB" etc. also accepted)
+     *             compression (lz4 or none)
+     *             dictionary (TEXT columns to dictionary-encode, separated by commas or spaces)
+     *             bloom (columns to keep per-block Bloom filters on, separated by commas or spaces)
+     *             format (heap; see ColumnarTable for the other one)
+     *             storage (bdb, the default, or pagefile to keep the blocks in a plain file read asynchronously)
+     *             io_depth (reads a pagefile table keeps outstanding during scans, 1 to 1024; default 32)
+     * @param options            the options to check
+     * @param column_names       the table's columns
+     * @param column_attributes  their types
+     * @throws                   DbRelationError if an option is unknown or has a bad value
+     */
+    static void validate_options(const TableOptions &options, const ColumnNames &column_names,
+                                 ColumnAttributes column_attributes);
+
+    /**
+     * Get the block size to use from a table's storage options.
+     * @param options  the table's options
+     * @returns        the page_size option in bytes, or DbBlock::BLOCK_SZ if there isn't one
+     */
+    static u32 page_size(const TableOptions &options);
+
+    /**
+     * See whether a table's storage options ask for its pages to be compressed.
+     * @param options  the table's options
+     * @returns        true if the compression option is lz4
+     */
+    static bool compressed(const TableOptions &options);
+
+    /**
+     * Get how many reads a table's storage options ask to keep outstanding during scans.
+     * @param options  the table's options
+     * @returns        the io_depth option (or its default) if storage is pagefile; 0 if the table is kept in a
+     *                 Berkeley DB file
+     */
+    static u32 io_depth(const TableOptions &options);
+
+    /**
+     * See whether a table's options say it is frozen. The frozen option is set by FREEZE TABLE (CREATE TABLE
+     * doesn't accept it).
+     * @param options  the table's options
+     * @returns        true if the frozen option is true
+     */
+    static bool frozen(const TableOptions &options);
+
+    /**
+     * Get the columns a table's storage options ask to have dictionary-encoded.
+     * @param options  the table's options
+     * @returns        the columns named by the dictionary option (empty if there isn't one)
+     */
+    static ColumnNames dictionary_columns(const TableOptions &options);
+
+    /**
+     * Get the columns a table's storage options ask to have Bloom filters kept on.
+     * @param options  the table's options
+     * @returns        the columns named by the bloom option (empty if there isn't one)
+     */
+    static ColumnNames bloom_columns(const TableOptions &options);
+
+    /**
+     * Bytes of an overflowed TEXT value that are still kept in the row.
+     */
+    static const u32 OVERFLOW_PREFIX_SZ = 64;
+
 protected:
     HeapFile file;
+    OverflowFile overflow;
+    std::vector<Dictionary *> dictionaries;  // one per column; nullptr unless the column is dictionary-encoded
+    ZoneMap zone_map;
+    BloomFilter bloom_filter;
+    HeapTable *vacuum_table;  // VACUUM's copy, between vacuum_copy and vacuum_swap
+    std::vector<Handles> vacuum_rows;  // for each block copied, where its rows are in the copy
+
+    /**
+     * An empty table to hold VACUUM's copy of table, named after it with suffix. It reads the table's own
+     * overflow file and dictionaries, since its records are copied as they are.
+     */
+    HeapTable(const HeapTable &table, const std::string &suffix);
 
     virtual ValueDict *validate(const ValueDict *row);
 
     virtual Handle append(const ValueDict *row);
 
+    /**
+     * Take a row out, without recording the change in the UndoLog.
+     */
+    virtual void erase(Handle handle);
+
+    /**
+     * Put a row at a handle, replacing the row there or putting back a deleted one, without recording the change
+     * in the UndoLog. Keeps the zone map and Bloom filters up to date.
+     * @throws  DbBlockNoRoomError if the row doesn't fit in the block (which is left as it was)
+     */
+    virtual void put_row(Handle handle, const ValueDict *row);
+
     virtual Dbt *marshal(const ValueDict *row);
 
-    virtual ValueDict *unmarshal(Dbt *data);
+    /**
+     * Turn a stored record back into a row.
+     * @param data    the record
+     * @param wanted  columns the caller is going to look at (nullptr for all of them); overflowed TEXT values
+     *                in other columns are left out of the row rather than read from the overflow file
+     * @param decode  false to leave dictionary-encoded columns as their (INT) codes
+     */
+    virtual ValueDict *unmarshal(Dbt *data, const ColumnNames *wanted = nullptr, bool decode = true);
+
+    virtual void free_overflow(Dbt *data);
 
-    bool selected(Handle handle, const ValueDict* where);
+    bool selected(SlottedPage *block, RecordID record_id, const ValueDict *where);
+
+    bool encode_where(const ValueDict *where, ValueDict &encoded);
+
+    ValueDict *project(Handle handle, const ColumnNames *column_names, bool decode);
+
+    ValueDict *project(SlottedPage *block, RecordID record_id, const ColumnNames *column_names, bool decode);
+
+    /**
+     * Blocks that might hold rows in the given ranges, going by the zone map and Bloom filters.
+     */
+    BlockIDs candidate_blocks(const ValueRanges &ranges);
 
     ValueDict *project(Handle handle, ValueDict where);
+
+    /**
+     * Add a record copied as it is from the table this is VACUUM's copy of, to the block being filled (which is
+     * put, and replaced with a new one, once it's full), keeping the zone map and Bloom filters up to date.
+     */
+    Handle add_copied(SlottedPage *&target, Dbt *data);
+
+    /**
+     * Copy the rows of one of the table's blocks to the end of VACUUM's copy.
+     * @returns  where they went
+     */
+    Handles copy_block(BlockID block_id);
+
+    static void remove_vacuum_files(const Identifier &table_name);
+
+    void rebuild_block_summaries();
+
+    static ColumnNames option_columns(const TableOptions &options, const std::string &option_name);
 };
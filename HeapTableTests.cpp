@@ -0,0 +1,161 @@
+#include "HeapTableTests.h"
+#include "HeapTable.h"
+#include "LockManager.h"
+#include <map>
+
+using namespace std;
+
+namespace HeapTableTests{
+    // an index on the id column that keeps its entries in memory, so that its lookups can be checked
+    class MapIndex : public DbIndex {
+    public:
+        MapIndex(DbRelation &relation) : DbIndex(relation, "_test_vacuum_id", ColumnNames{"id"}, true) {}
+
+        void create(){
+            Handles *handles = relation.select();
+            for(auto const &handle : *handles)
+                insert(handle);
+            delete handles;
+        }
+
+        void drop(){ entries.clear(); }
+
+        void open(){}
+
+        void close(){}
+
+        Handles *lookup(ValueDict *key_values) const {
+            Handles *handles = new Handles();
+            auto found = entries.find((*key_values)["id"].n);
+            if(found != entries.end())
+                handles->push_back(found->second);
+            return handles;
+        }
+
+        void insert(Handle handle){
+            ValueDict *row = relation.project(handle);
+            entries[(*row)["id"].n] = handle;
+            delete row;
+        }
+
+        void del(Handle handle){
+            ValueDict *row = relation.project(handle);
+            entries.erase((*row)["id"].n);
+            delete row;
+        }
+
+        map<int32_t, Handle> entries;
+    };
+
+    // VACUUM packs the live rows into fewer blocks; rows changed between the copy and the swap are copied again,
+    // and an index built on the copy finds every row at its new handle once the copy is swapped in
+    void testVacuum(){
+        cout << "Testing VACUUM" << endl;
+        ColumnNames columnNames = {"id", "body"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        HeapTable table("_test_vacuum", columnNames, columnAttributes);
+        table.create();
+        vector<Handle> handles;
+        ValueDict row;
+        for(int i = 0; i < 1000; i++){
+            row["id"] = Value(i);
+            row["body"] = Value(string(100, (char) ('a' + i % 26)));
+            handles.push_back(table.insert(&row));
+        }
+        for(int i = 0; i < 1000; i++)
+            if(i % 4 != 0)
+                table.del(handles[i]); // leaves ids 0, 4, 8, ...
+        BlockID before = table.get_block_count();
+
+        bool fresh;
+        HeapTable &copy = table.vacuum_copy(fresh);
+        MapIndex index(copy);
+        index.create();
+        table.del(handles[4]); // meanwhile, in a block that's been copied
+        ValueDict newValues;
+        newValues["body"] = Value(string("changed"));
+        table.update(handles[8], &newValues);
+        row["id"] = Value(1000);
+        row["body"] = Value(string(100, (char) ('a' + 1000 % 26)));
+        table.insert(&row); // and at the end
+        BlockID after = table.vacuum_swap(vector<DbIndex *>(1, &index));
+
+        HeapTable vacuumed("_test_vacuum", columnNames, columnAttributes);
+        Handles *all = vacuumed.select();
+        size_t rowCount = all->size();
+        delete all;
+        string problem;
+        if(!fresh)
+            problem = "VACUUM didn't make a new copy";
+        else if(after * 3 > before)
+            problem = "VACUUM went from " + to_string(before) + " to only " + to_string(after) + " blocks";
+        else if(rowCount != 250 || index.entries.size() != 250)
+            problem = "VACUUM left " + to_string(rowCount) + " rows and " + to_string(index.entries.size()) +
+                      " index entries instead of 250";
+        for(int id = 0; id <= 1000 && problem.empty(); id += 4){
+            ValueDict key;
+            key["id"] = Value(id);
+            Handles *found = index.lookup(&key);
+            if(id == 4 ? !found->empty() : found->size() != 1){
+                problem = "the index found the wrong rows for id " + to_string(id) + " after VACUUM";
+            }else if(!found->empty()){
+                ValueDict *got = vacuumed.project(found->front());
+                string body = id == 8 ? "changed" : string(100, (char) ('a' + id % 26));
+                if((*got)["id"].n != id || (*got)["body"].s != body)
+                    problem = "the index found some other row for id " + to_string(id) + " after VACUUM";
+                delete got;
+            }
+            delete found;
+        }
+        vacuumed.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // a transaction writes only blocks no other transaction has written: its inserts go elsewhere, and changing
+    // a row in a block another one has written waits for that one to end (refused here, with no time to wait)
+    void testBlockLocks(){
+        cout << "Testing block locks" << endl;
+        ColumnNames columnNames = {"id"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT)};
+        HeapTable table("_test_block_locks", columnNames, columnAttributes);
+        table.create();
+        LockManager &locks = LockManager::get();
+        u32 timeout = locks.get_timeout();
+        LockManager::TxnID saved = LockManager::current;
+        locks.set_timeout(0);
+        ValueDict row;
+        row["id"] = Value(1);
+        LockManager::current = 1001;
+        Handle first = table.insert(&row);
+        row["id"] = Value(2);
+        LockManager::current = 1002;
+        Handle second = table.insert(&row);
+        string problem;
+        if(second.first == first.first)
+            problem = "two transactions inserted into the same block";
+        try{
+            table.del(first);
+            if(problem.empty())
+                problem = "a transaction deleted from a block another one had written";
+        } catch(LockWaitError &e){
+        }
+        locks.unlock_all(1001);
+        table.del(first);
+        locks.unlock_all(1002);
+        LockManager::current = saved;
+        locks.set_timeout(timeout);
+        Handles *handles = table.select();
+        if(problem.empty() && (handles->size() != 1 || handles->front() != second))
+            problem = "the table has " + to_string(handles->size()) + " rows of 1";
+        delete handles;
+        table.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testVacuum();
+        testBlockLocks();
+    }
+}
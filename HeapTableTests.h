@@ -0,0 +1,7 @@
+#pragma once
+
+namespace HeapTableTests{
+    void testVacuum();
+    void testBlockLocks();
+    void testAll();
+}
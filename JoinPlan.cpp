@@ -0,0 +1,292 @@
+#include "JoinPlan.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+// The join columns' values, run together so rows with equal values get equal keys.
+static string join_key(const ValueDict *row, const ColumnNames &columns) {
+    string key;
+    for (auto const &column: columns) {
+        const Value &value = row->at(column);
+        if (value.data_type == ColumnAttribute::TEXT)
+            key += "s" + to_string(value.s.size()) + ":" + value.s;
+        else
+            key += "n" + to_string(value.n) + ":";
+    }
+    return key;
+}
+
+static void delete_rows(ValueDicts *rows) {
+    for (auto row: *rows)
+        delete row;
+    delete rows;
+}
+
+ValueDicts *JoinScanPlan::evaluate() {
+    this->actual.start();
+    Handles *handles = this->input.ranges.empty() ? this->input.table->select()
+                                                   : this->input.table->select(this->input.ranges);
+    ValueDicts *rows = this->input.table->project(handles);
+    for (auto &row: *rows) {
+        ValueDict *qualified = new ValueDict();
+        for (auto const &column: *row)
+            (*qualified)[this->input.alias + "." + column.first] = column.second;
+        delete row;
+        row = qualified;
+    }
+    delete handles;
+    this->actual.stop(rows->size());
+    return rows;
+}
+
+ExplainNode JoinScanPlan::explain() const {
+    string detail = "on " + this->input.table_name;
+    if (this->input.alias != this->input.table_name)
+        detail += " " + this->input.alias;
+    if (!this->input.ranges.empty())
+        detail += " where " + ExplainNode::describe(this->input.ranges);
+    return ExplainNode("Table Scan", detail, this->rows, this->actual);
+}
+
+HashJoinPlan::HashJoinPlan(JoinPlan *build, JoinPlan *probe, ColumnNames build_columns, ColumnNames probe_columns,
+                           double rows, double cost) : JoinPlan(rows, cost), build(build), probe(probe),
+                                                       build_columns(build_columns), probe_columns(probe_columns) {
+}
+
+HashJoinPlan::~HashJoinPlan() {
+    delete this->build;
+    delete this->probe;
+}
+
+ValueDicts *HashJoinPlan::evaluate() {
+    this->actual.start();
+    ValueDicts *build_rows = this->build->evaluate();
+    unordered_multimap<string, const ValueDict *> table;
+    for (auto row: *build_rows)
+        table.insert(make_pair(join_key(row, this->build_columns), row));
+
+    ValueDicts *probe_rows = this->probe->evaluate();
+    ValueDicts *rows = new ValueDicts();
+    for (auto row: *probe_rows) {
+        auto matches = table.equal_range(join_key(row, this->probe_columns));
+        for (auto match = matches.first; match != matches.second; match++) {
+            ValueDict *joined = new ValueDict(*row);
+            joined->insert(match->second->begin(), match->second->end());
+            rows->push_back(joined);
+        }
+    }
+    delete_rows(probe_rows);
+    delete_rows(build_rows);
+    this->actual.stop(rows->size());
+    return rows;
+}
+
+// The build side is listed first.
+ExplainNode HashJoinPlan::explain() const {
+    string detail = "on ";
+    for (size_t i = 0; i < this->build_columns.size(); i++)
+        detail += (i == 0 ? "" : " AND ") + this->build_columns[i] + " = " + this->probe_columns[i];
+    ExplainNode node("Hash Join", detail, this->rows, this->actual);
+    node.children.push_back(this->build->explain());
+    node.children.push_back(this->probe->explain());
+    return node;
+}
+
+NestedLoopJoinPlan::NestedLoopJoinPlan(JoinPlan *outer, JoinPlan *inner, double rows, double cost)
+        : JoinPlan(rows, cost), outer(outer), inner(inner) {
+}
+
+NestedLoopJoinPlan::~NestedLoopJoinPlan() {
+    delete this->outer;
+    delete this->inner;
+}
+
+ValueDicts *NestedLoopJoinPlan::evaluate() {
+    this->actual.start();
+    ValueDicts *outer_rows = this->outer->evaluate();
+    ValueDicts *inner_rows = this->inner->evaluate();
+    ValueDicts *rows = new ValueDicts();
+    for (auto outer_row: *outer_rows) {
+        for (auto inner_row: *inner_rows) {
+            ValueDict *joined = new ValueDict(*outer_row);
+            joined->insert(inner_row->begin(), inner_row->end());
+            rows->push_back(joined);
+        }
+    }
+    delete_rows(inner_rows);
+    delete_rows(outer_rows);
+    this->actual.stop(rows->size());
+    return rows;
+}
+
+ExplainNode NestedLoopJoinPlan::explain() const {
+    ExplainNode node("Nested Loop", "", this->rows, this->actual);
+    node.children.push_back(this->outer->explain());
+    node.children.push_back(this->inner->explain());
+    return node;
+}
+
+JoinPlanner::JoinPlanner(const std::vector<JoinInput> &inputs, const std::vector<JoinPredicate> &predicates)
+        : inputs(inputs), predicates(predicates) {
+    for (auto const &input: inputs) {
+        this->input_blocks.push_back(input.statistics.block_count);
+        this->input_rows.push_back(max(input.statistics.estimated_rows(input.ranges), 1.0));
+    }
+    for (auto const &predicate: predicates) {
+        double distinct_values = max(distinct(predicate.left, predicate.left_column),
+                                     distinct(predicate.right, predicate.right_column));
+        this->selectivities.push_back(1 / max(distinct_values, 1.0));
+    }
+}
+
+// A column with no statistics is taken to be a key. There can't be more distinct values than rows left after
+// the input's own where-clause comparisons.
+double JoinPlanner::distinct(uint input, const Identifier &column_name) const {
+    const ColumnStatistics *column = this->inputs[input].statistics.get_column(column_name);
+    if (column == nullptr)
+        return this->input_rows[input];
+    return min((double) column->distinct_count, this->input_rows[input]);
+}
+
+double JoinPlanner::rows(InputSet set) const {
+    double rows = 1;
+    for (uint i = 0; i < this->inputs.size(); i++)
+        if (set & (1ULL << i))
+            rows *= this->input_rows[i];
+    for (uint i = 0; i < this->predicates.size(); i++)
+        if ((set & (1ULL << this->predicates[i].left)) && (set & (1ULL << this->predicates[i].right)))
+            rows *= this->selectivities[i];
+    return max(rows, 1.0);
+}
+
+bool JoinPlanner::connected(InputSet left, InputSet right) const {
+    for (auto const &predicate: this->predicates) {
+        InputSet a = 1ULL << predicate.left, b = 1ULL << predicate.right;
+        if (((left & a) && (right & b)) || ((left & b) && (right & a)))
+            return true;
+    }
+    return false;
+}
+
+// A hash join handles each input row once; a cross product handles every pair.
+double JoinPlanner::join_cost(InputSet left, InputSet right, double left_cost, double right_cost) const {
+    double work = connected(left, right) ? rows(left) + rows(right) : rows(left) * rows(right);
+    return left_cost + right_cost + work + rows(left | right);
+}
+
+JoinPlan *JoinPlanner::scan(uint input) const {
+    return new JoinScanPlan(this->inputs[input], this->input_rows[input],
+                            this->input_blocks[input] + this->input_rows[input]);
+}
+
+JoinPlan *JoinPlanner::join(InputSet left_set, JoinPlan *left, InputSet right_set, JoinPlan *right) const {
+    double rows = this->rows(left_set | right_set);
+    double cost = join_cost(left_set, right_set, left->get_cost(), right->get_cost());
+    if (!connected(left_set, right_set))
+        return new NestedLoopJoinPlan(left, right, rows, cost);
+
+    if (right->get_rows() < left->get_rows()) {
+        swap(left_set, right_set);
+        swap(left, right);
+    }
+    ColumnNames build_columns, probe_columns;
+    for (auto const &predicate: this->predicates) {
+        Identifier l = this->inputs[predicate.left].alias + "." + predicate.left_column;
+        Identifier r = this->inputs[predicate.right].alias + "." + predicate.right_column;
+        if ((left_set & (1ULL << predicate.left)) && (right_set & (1ULL << predicate.right))) {
+            build_columns.push_back(l);
+            probe_columns.push_back(r);
+        } else if ((left_set & (1ULL << predicate.right)) && (right_set & (1ULL << predicate.left))) {
+            build_columns.push_back(r);
+            probe_columns.push_back(l);
+        }
+    }
+    return new HashJoinPlan(left, right, build_columns, probe_columns, rows, cost);
+}
+
+JoinPlan *JoinPlanner::plan() {
+    if (this->inputs.size() <= DP_TABLE_LIMIT)
+        return plan_dynamic();
+    return plan_greedy();
+}
+
+// Sets are visited in increasing order, so both halves of any split have been costed already. A set that has
+// any connected split ignores its unconnected ones.
+JoinPlan *JoinPlanner::plan_dynamic() {
+    uint n = (uint) this->inputs.size();
+    InputSet all = (1ULL << n) - 1;
+    vector<double> best_cost(all + 1, -1);
+    vector<InputSet> best_left(all + 1, 0);
+    vector<bool> best_connected(all + 1, false);
+    for (uint i = 0; i < n; i++)
+        best_cost[1ULL << i] = this->input_blocks[i] + this->input_rows[i];
+
+    for (InputSet set = 1; set <= all; set++) {
+        if ((set & (set - 1)) == 0)
+            continue;  // a single input
+        InputSet lowest = set & (~set + 1);
+        for (InputSet left = (set - 1) & set; left != 0; left = (left - 1) & set) {
+            if (!(left & lowest))
+                continue;  // each split once, with the lowest input on the left
+            InputSet right = set & ~left;
+            bool is_connected = connected(left, right);
+            if (best_connected[set] && !is_connected)
+                continue;
+            double cost = join_cost(left, right, best_cost[left], best_cost[right]);
+            if (best_cost[set] < 0 || (is_connected && !best_connected[set]) || cost < best_cost[set]) {
+                best_cost[set] = cost;
+                best_left[set] = left;
+                best_connected[set] = is_connected;
+            }
+        }
+    }
+
+    // build the chosen plan top down
+    struct Builder {
+        const JoinPlanner &planner;
+        const vector<InputSet> &best_left;
+
+        JoinPlan *build(InputSet set) const {
+            if ((set & (set - 1)) == 0) {
+                uint input = 0;
+                while (!(set & (1ULL << input)))
+                    input++;
+                return planner.scan(input);
+            }
+            InputSet left = best_left[set], right = set & ~best_left[set];
+            return planner.join(left, build(left), right, build(right));
+        }
+    };
+    return Builder{*this, best_left}.build(all);
+}
+
+// Greedy operator ordering: join the pair of plans with the smallest result, preferring connected pairs.
+JoinPlan *JoinPlanner::plan_greedy() {
+    vector<pair<InputSet, JoinPlan *>> plans;
+    for (uint i = 0; i < this->inputs.size(); i++)
+        plans.push_back(make_pair(1ULL << i, scan(i)));
+    while (plans.size() > 1) {
+        size_t best_i = 0, best_j = 1;
+        double best_rows = -1;
+        bool best_connected = false;
+        for (size_t i = 0; i < plans.size(); i++) {
+            for (size_t j = i + 1; j < plans.size(); j++) {
+                bool is_connected = connected(plans[i].first, plans[j].first);
+                double joined_rows = rows(plans[i].first | plans[j].first);
+                if (best_rows < 0 || (is_connected && !best_connected) ||
+                    (is_connected == best_connected && joined_rows < best_rows)) {
+                    best_i = i;
+                    best_j = j;
+                    best_rows = joined_rows;
+                    best_connected = is_connected;
+                }
+            }
+        }
+        JoinPlan *joined = join(plans[best_i].first, plans[best_i].second, plans[best_j].first, plans[best_j].second);
+        InputSet set = plans[best_i].first | plans[best_j].first;
+        plans.erase(plans.begin() + best_j);
+        plans[best_i] = make_pair(set, joined);
+    }
+    return plans.front().second;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "TableStatistics.h"
+#include "Explain.h"
+using namespace std;
+
+/**
+ * One of the tables in a join, as named in the FROM clause.
+ */
+struct JoinInput {
+    Identifier table_name;
+    Identifier alias;            // what its columns are qualified with (the table name if there's no alias)
+    DbRelation *table;
+    ValueRanges ranges;          // the where-clause comparisons of its columns with values
+    bool analyzed;               // false if statistics is only TableStatistics::guess
+    TableStatistics statistics;
+
+    JoinInput() : table(nullptr), analyzed(false) {}
+};
+
+/**
+ * An equality between columns of two of the inputs, e.g. f.customer_id = c.id (inputs by position).
+ */
+struct JoinPredicate {
+    uint left;
+    Identifier left_column;
+    uint right;
+    Identifier right_column;
+};
+
+/**
+ * @class JoinPlan - a node in a join plan. Rows coming out of a plan have their values keyed by
+ * "alias.column" so that columns of the same name in different inputs stay apart.
+ */
+class JoinPlan {
+public:
+    JoinPlan(double rows, double cost) : rows(rows), cost(cost) {}
+
+    virtual ~JoinPlan() {}
+
+    JoinPlan(const JoinPlan &other) = delete;
+
+    JoinPlan &operator=(const JoinPlan &other) = delete;
+
+    /**
+     * Run the plan.
+     * @returns  the rows (freed by caller, rows and all)
+     */
+    virtual ValueDicts *evaluate() = 0;
+
+    /**
+     * Describe the plan, with what happened when it ran if evaluate has been called.
+     */
+    virtual ExplainNode explain() const = 0;
+
+    double get_rows() const { return rows; }  // estimated rows coming out
+
+    double get_cost() const { return cost; }  // estimated work, in blocks read plus rows handled
+
+protected:
+    double rows;
+    double cost;
+    Measurement actual;
+};
+
+/**
+ * @class JoinScanPlan - reads the rows of one input that satisfy its ranges.
+ */
+class JoinScanPlan : public JoinPlan {
+public:
+    JoinScanPlan(const JoinInput &input, double rows, double cost) : JoinPlan(rows, cost), input(input) {}
+
+    virtual ValueDicts *evaluate();
+
+    virtual ExplainNode explain() const;
+
+protected:
+    const JoinInput &input;
+};
+
+/**
+ * @class HashJoinPlan - equi-join: the build side's rows go into a hash table on their join columns, then each
+ * of the probe side's rows looks for its matches there.
+ */
+class HashJoinPlan : public JoinPlan {
+public:
+    // build_columns[i] is to equal probe_columns[i] (all as "alias.column"); takes ownership of the two plans
+    HashJoinPlan(JoinPlan *build, JoinPlan *probe, ColumnNames build_columns, ColumnNames probe_columns,
+                 double rows, double cost);
+
+    virtual ~HashJoinPlan();
+
+    virtual ValueDicts *evaluate();
+
+    virtual ExplainNode explain() const;
+
+protected:
+    JoinPlan *build;
+    JoinPlan *probe;
+    ColumnNames build_columns;
+    ColumnNames probe_columns;
+};
+
+/**
+ * @class NestedLoopJoinPlan - cross product, for inputs that no predicate connects.
+ */
+class NestedLoopJoinPlan : public JoinPlan {
+public:
+    // takes ownership of the two plans
+    NestedLoopJoinPlan(JoinPlan *outer, JoinPlan *inner, double rows, double cost);
+
+    virtual ~NestedLoopJoinPlan();
+
+    virtual ValueDicts *evaluate();
+
+    virtual ExplainNode explain() const;
+
+protected:
+    JoinPlan *outer;
+    JoinPlan *inner;
+};
+
+/**
+ * @class JoinPlanner - picks the order to join the inputs in, and how to join each pair, from estimates of how
+ * many rows each input and each intermediate result will have.
+ *
+ * An input's rows come from its statistics (see ANALYZE), or their stand-in guessed from its block count. A
+ * predicate keeps one row in max(distinct values on either side) of the cross product, with a column with no
+ * statistics taken to be unique. Up to DP_TABLE_LIMIT inputs, every way of splitting every set of inputs into
+ * two joined sets is tried, cheapest first (dynamic programming, so the plans can be bushy). Beyond that the
+ * two sets whose join comes out smallest are joined until one is left (greedy). Sets that no predicate
+ * connects are only crossed when there is nothing else to do. Connected sets are hash joined, building on the
+ * side estimated to be smaller.
+ */
+class JoinPlanner {
+public:
+    static const uint DP_TABLE_LIMIT = 10;
+
+    JoinPlanner(const std::vector<JoinInput> &inputs, const std::vector<JoinPredicate> &predicates);
+
+    /**
+     * @returns  the cheapest plan found (freed by caller)
+     */
+    JoinPlan *plan();
+
+protected:
+    typedef u_int64_t InputSet;  // bit i set for input i
+
+    const std::vector<JoinInput> &inputs;
+    const std::vector<JoinPredicate> &predicates;
+    std::vector<double> input_rows;
+    std::vector<double> input_blocks;
+    std::vector<double> selectivities;  // one per predicate
+
+    double distinct(uint input, const Identifier &column_name) const;
+
+    double rows(InputSet set) const;
+
+    bool connected(InputSet left, InputSet right) const;
+
+    double join_cost(InputSet left, InputSet right, double left_cost, double right_cost) const;
+
+    JoinPlan *scan(uint input) const;
+
+    JoinPlan *join(InputSet left_set, JoinPlan *left, InputSet right_set, JoinPlan *right) const;
+
+    JoinPlan *plan_dynamic();
+
+    JoinPlan *plan_greedy();
+};
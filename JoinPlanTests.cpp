@@ -0,0 +1,80 @@
+#include "JoinPlanTests.h"
+#include "JoinPlan.h"
+#include "HeapTable.h"
+
+using namespace std;
+
+namespace JoinPlanTests{
+    static JoinInput input(HeapTable &table, Identifier name){
+        JoinInput joinInput;
+        joinInput.table_name = name;
+        joinInput.alias = name;
+        joinInput.table = &table;
+        joinInput.analyzed = true;
+        joinInput.statistics = TableStatistics::collect(table, name);
+        return joinInput;
+    }
+
+    // orders -> customers -> regions: the two small tables are joined first, each hash join builds on its
+    // smaller side, and every order comes out matched with its customer and region
+    void testJoinOrder(){
+        cout << "Testing join order" << endl;
+        ColumnAttributes two = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::INT)};
+        ColumnAttributes one = {ColumnAttribute(ColumnAttribute::INT)};
+        HeapTable orders("orders", {"id", "customer"}, two);
+        HeapTable customers("customers", {"id", "region"}, two);
+        HeapTable regions("regions", {"id"}, one);
+        orders.create();
+        customers.create();
+        regions.create();
+        ValueDict row;
+        for(int i = 0; i < 2000; i++){
+            row = {{"id", Value(i)}, {"customer", Value(i % 50)}};
+            orders.insert(&row);
+        }
+        for(int i = 0; i < 50; i++){
+            row = {{"id", Value(i)}, {"region", Value(i % 5)}};
+            customers.insert(&row);
+        }
+        for(int i = 0; i < 5; i++){
+            row = {{"id", Value(i)}};
+            regions.insert(&row);
+        }
+        vector<JoinInput> inputs = {input(orders, "orders"), input(customers, "customers"), input(regions, "regions")};
+        vector<JoinPredicate> predicates = {{0, "customer", 1, "id"}, {1, "region", 2, "id"}};
+        JoinPlanner planner(inputs, predicates);
+        JoinPlan *plan = planner.plan();
+        ExplainNode node = plan->explain();
+        string problem;
+        if(node.name != "Hash Join" || node.children.size() != 2 || node.children[0].name != "Hash Join" ||
+           node.children[1].detail != "on orders")
+            problem = "the planner didn't join customers and regions before orders";
+        else if(node.children[0].children[0].detail != "on regions" || node.children[0].detail != "on regions.id = customers.region")
+            problem = "the planner didn't build on regions: " + node.children[0].detail;
+        else if(node.estimated_rows < 1000 || node.estimated_rows > 4000)
+            problem = "the planner estimated " + to_string(node.estimated_rows) + " rows of 2000";
+        if(problem.empty()){
+            ValueDicts *rows = plan->evaluate();
+            uint matched = 0;
+            for(auto joined : *rows){
+                if((*joined)["orders.customer"] == (*joined)["customers.id"] &&
+                   (*joined)["customers.region"] == (*joined)["regions.id"])
+                    matched++;
+                delete joined;
+            }
+            if(rows->size() != 2000 || matched != 2000)
+                problem = "the join gave " + to_string(rows->size()) + " rows of 2000, " + to_string(matched) + " matched";
+            delete rows;
+        }
+        delete plan;
+        orders.drop();
+        customers.drop();
+        regions.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testJoinOrder();
+    }
+}
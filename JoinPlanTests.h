@@ -0,0 +1,6 @@
+#pragma once
+
+namespace JoinPlanTests{
+    void testJoinOrder();
+    void testAll();
+}
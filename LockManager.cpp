@@ -0,0 +1,484 @@
+#include "LockManager.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+const u32 LockManager::SHARD_COUNT;
+const u32 LockManager::DEFAULT_TIMEOUT_MS;
+const u32 LockManager::DEADLOCK_CHECK_MS;
+
+thread_local LockManager::TxnID LockManager::current = 0;
+
+// indexed by Mode
+static const bool COMPATIBLE[5][5] = {
+        // IS     IX     S      SIX    X
+        {true,  true,  true,  true,  false},  // IS
+        {true,  true,  false, false, false},  // IX
+        {true,  false, true,  false, false},  // S
+        {true,  false, false, false, false},  // SIX
+        {false, false, false, false, false}   // X
+};
+
+static const LockManager::Mode COMBINED[5][5] = {
+        {LockManager::IS,  LockManager::IX,  LockManager::S,   LockManager::SIX, LockManager::X},
+        {LockManager::IX,  LockManager::IX,  LockManager::SIX, LockManager::SIX, LockManager::X},
+        {LockManager::S,   LockManager::SIX, LockManager::S,   LockManager::SIX, LockManager::X},
+        {LockManager::SIX, LockManager::SIX, LockManager::SIX, LockManager::SIX, LockManager::X},
+        {LockManager::X,   LockManager::X,   LockManager::X,   LockManager::X,   LockManager::X}
+};
+
+string LockManager::LockID::to_string() const {
+    if (this->table_name.empty())
+        return "the database";
+    if (this->handle == Handle(0, 0))
+        return "table " + this->table_name;
+    if (this->handle.second == 0)
+        return "block " + std::to_string(this->handle.first) + " of " + this->table_name;
+    return "row (" + std::to_string(this->handle.first) + ", " + std::to_string(this->handle.second) + ") of " +
+           this->table_name;
+}
+
+size_t LockManager::LockIDHash::operator()(const LockID &lock_id) const {
+    size_t h = hash<string>()(lock_id.table_name);
+    h ^= (((size_t) lock_id.handle.first << 16) | lock_id.handle.second) * 0x9e3779b97f4a7c15ULL;
+    return h;
+}
+
+LockManager &LockManager::get() {
+    static LockManager locks;
+    return locks;
+}
+
+LockManager::LockManager() : held_lock(), held(), victims(), timeout_ms(DEFAULT_TIMEOUT_MS), command_lock(nullptr),
+                             wait_count(0), timeout_count(0), deadlock_count(0), waiting(0), running(false),
+                             stopping(false) {
+}
+
+void LockManager::start() {
+    lock_guard<mutex> guard(this->worker_lock);
+    if (this->running)
+        return;
+    this->stopping = false;
+    this->running = true;
+    this->worker = thread(&LockManager::work, this);
+}
+
+void LockManager::stop() {
+    {
+        lock_guard<mutex> guard(this->worker_lock);
+        if (!this->running)
+            return;
+        this->stopping = true;
+    }
+    this->worker_changed.notify_all();
+    this->worker.join();
+    lock_guard<mutex> guard(this->worker_lock);
+    this->running = false;
+}
+
+void LockManager::lock_table(const Identifier &table_name, Mode mode) {
+    if (current == 0)
+        return;
+    acquire(current, LockID(), mode == IS || mode == S ? IS : IX);
+    acquire(current, LockID(table_name), mode);
+}
+
+void LockManager::lock_row(const Identifier &table_name, Handle handle, Mode mode) {
+    if (current == 0)
+        return;
+    Mode intention = mode == S ? IS : IX;
+    acquire(current, LockID(), intention);
+    acquire(current, LockID(table_name), intention);
+    acquire(current, LockID(table_name, handle), mode);
+}
+
+// Blocks aren't in the hierarchy: whoever writes one holds a lock on the table its rows are in already.
+void LockManager::lock_block(const string &file_name, BlockID block_id) {
+    if (current == 0)
+        return;
+    acquire(current, LockID(file_name, Handle(block_id, 0)), X);
+}
+
+bool LockManager::try_lock_block(const string &file_name, BlockID block_id) {
+    if (current == 0)
+        return true;
+    return acquire(current, LockID(file_name, Handle(block_id, 0)), X, false);
+}
+
+void LockManager::unlock_all(TxnID txn) {
+    vector<LockID> lock_ids;
+    bool was_parked = false;
+    Parked waiting_for;
+    {
+        lock_guard<mutex> guard(this->held_lock);
+        auto parked_request = this->parked.find(txn);
+        if (parked_request != this->parked.end()) {
+            was_parked = true;
+            waiting_for = parked_request->second;
+            this->parked.erase(parked_request);
+            this->victims.erase(txn);
+        }
+        auto found = this->held.find(txn);
+        if (found != this->held.end()) {
+            lock_ids.swap(found->second);
+            this->held.erase(found);
+        }
+    }
+    if (was_parked) {
+        this->waiting--;
+        Shard &lock_shard = shard(waiting_for.lock_id);
+        lock_guard<mutex> guard(lock_shard.lock);
+        auto head = lock_shard.heads.find(waiting_for.lock_id);
+        if (head != lock_shard.heads.end()) {
+            for (auto request = head->second.requests.begin(); request != head->second.requests.end(); request++) {
+                if (!request->granted && request->txn == txn) {
+                    withdraw(lock_shard, waiting_for.lock_id, request);
+                    break;
+                }
+            }
+        }
+    }
+    for (auto const &lock_id: lock_ids) {
+        Shard &lock_shard = shard(lock_id);
+        lock_guard<mutex> guard(lock_shard.lock);
+        auto head = lock_shard.heads.find(lock_id);
+        if (head == lock_shard.heads.end())
+            continue;
+        head->second.requests.remove_if([txn](const Request &request) {
+            return request.granted && request.txn == txn;
+        });
+        if (head->second.requests.empty()) {
+            lock_shard.heads.erase(head);
+        } else {
+            grant(lock_id, head->second);
+            lock_shard.changed.notify_all();
+        }
+    }
+}
+
+bool LockManager::is_held(TxnID txn, const LockID &lock_id, Mode mode) {
+    Shard &lock_shard = shard(lock_id);
+    lock_guard<mutex> guard(lock_shard.lock);
+    auto head = lock_shard.heads.find(lock_id);
+    if (head == lock_shard.heads.end())
+        return false;
+    for (auto const &request: head->second.requests)
+        if (request.granted && request.txn == txn)
+            return combine(request.mode, mode) == request.mode;
+    return false;
+}
+
+size_t LockManager::get_lock_count() {
+    lock_guard<mutex> guard(this->held_lock);
+    size_t count = 0;
+    for (auto const &txn: this->held)
+        count += txn.second.size();
+    return count;
+}
+
+void LockManager::get_counts(u_int64_t &wait_count, u_int64_t &timeout_count, u_int64_t &deadlock_count) const {
+    wait_count = this->wait_count;
+    timeout_count = this->timeout_count;
+    deadlock_count = this->deadlock_count;
+}
+
+// The waits-for graph has an edge from each waiting transaction to every transaction ahead of it for the same
+// lock (holding it or waiting for it) in a mode that conflicts. All the shards are locked while it's drawn up, so
+// that it's a true picture of one moment.
+size_t LockManager::break_deadlocks() {
+    vector<unique_lock<mutex>> guards;
+    for (auto &lock_shard: this->shards)
+        guards.push_back(unique_lock<mutex>(lock_shard.lock));
+    map<TxnID, set<TxnID>> waits_for;
+    for (auto &lock_shard: this->shards) {
+        for (auto const &head: lock_shard.heads) {
+            const list<Request> &requests = head.second.requests;
+            for (auto waiter = requests.begin(); waiter != requests.end(); waiter++) {
+                if (waiter->granted)
+                    continue;
+                for (auto ahead = requests.begin(); ahead != waiter; ahead++)
+                    if (ahead->txn != waiter->txn && !is_compatible(ahead->mode, waiter->mode))
+                        waits_for[waiter->txn].insert(ahead->txn);
+            }
+        }
+    }
+
+    size_t found = 0;
+    lock_guard<mutex> held_guard(this->held_lock);
+    while (true) {
+        // depth first, looking for an edge back to a transaction on the path
+        vector<TxnID> cycle;
+        map<TxnID, int> state;  // 1 on the path, 2 done
+        for (auto const &start: waits_for) {
+            if (state[start.first] != 0)
+                continue;
+            vector<pair<TxnID, set<TxnID>::const_iterator>> path;
+            path.push_back(make_pair(start.first, start.second.begin()));
+            state[start.first] = 1;
+            while (!path.empty() && cycle.empty()) {
+                TxnID txn = path.back().first;
+                auto &next = path.back().second;
+                auto edges = waits_for.find(txn);
+                if (edges == waits_for.end() || next == edges->second.end()) {
+                    state[txn] = 2;
+                    path.pop_back();
+                    continue;
+                }
+                TxnID to = *next++;
+                if (state[to] == 1) {
+                    for (auto step = path.rbegin(); step != path.rend(); step++) {
+                        cycle.push_back(step->first);
+                        if (step->first == to)
+                            break;
+                    }
+                } else if (state[to] == 0) {
+                    state[to] = 1;
+                    auto to_edges = waits_for.find(to);
+                    path.push_back(make_pair(to, to_edges == waits_for.end() ? set<TxnID>::const_iterator()
+                                                                              : to_edges->second.begin()));
+                }
+            }
+            if (!cycle.empty())
+                break;
+        }
+        if (cycle.empty())
+            break;
+
+        // the one with the least to lose, and of those the youngest
+        TxnID victim = 0;
+        size_t victim_locks = 0;
+        for (auto txn: cycle) {
+            auto locks = this->held.find(txn);
+            size_t lock_count = locks == this->held.end() ? 0 : locks->second.size();
+            if (victim == 0 || lock_count < victim_locks || (lock_count == victim_locks && txn > victim)) {
+                victim = txn;
+                victim_locks = lock_count;
+            }
+        }
+        this->victims.insert(victim);
+        waits_for.erase(victim);
+        found++;
+    }
+    if (found > 0)
+        for (auto &lock_shard: this->shards)
+            lock_shard.changed.notify_all();
+    return found;
+}
+
+bool LockManager::is_compatible(Mode a, Mode b) {
+    return COMPATIBLE[a][b];
+}
+
+LockManager::Mode LockManager::combine(Mode a, Mode b) {
+    return COMBINED[a][b];
+}
+
+const char *LockManager::mode_name(Mode mode) {
+    static const char *names[] = {"IS", "IX", "S", "SIX", "X"};
+    return names[mode];
+}
+
+LockManager::Shard &LockManager::shard(const LockID &lock_id) {
+    return this->shards[LockIDHash()(lock_id) % SHARD_COUNT];
+}
+
+// A transaction that already holds the lock in a weaker mode has it upgraded, ahead of any others waiting for it.
+// A new request waits its turn behind those.
+bool LockManager::acquire(TxnID txn, const LockID &lock_id, Mode mode, bool may_wait) {
+    Shard &lock_shard = shard(lock_id);
+    unique_lock<mutex> guard(lock_shard.lock);
+    LockHead &head = lock_shard.heads[lock_id];
+    list<Request> &requests = head.requests;
+    Request *own = nullptr;
+    auto first_waiting = requests.end();
+    bool conflicts = false;
+    for (auto request = requests.begin(); request != requests.end(); request++) {
+        if (!request->granted) {
+            if (first_waiting == requests.end())
+                first_waiting = request;
+        } else if (request->txn == txn) {
+            own = &*request;
+        }
+    }
+    Mode wanted = own == nullptr ? mode : combine(own->mode, mode);
+    if (own != nullptr && wanted == own->mode)
+        return true;
+    const Request *holder = nullptr;
+    for (auto const &request: requests) {
+        if (request.granted && request.txn != txn && !is_compatible(request.mode, wanted)) {
+            conflicts = true;
+            holder = &request;
+        }
+    }
+    if (!conflicts && (own != nullptr || first_waiting == requests.end())) {
+        if (own != nullptr) {
+            own->mode = wanted;
+        } else {
+            requests.insert(first_waiting, Request(txn, wanted, true));
+            lock_guard<mutex> held_guard(this->held_lock);
+            this->held[txn].push_back(lock_id);
+        }
+        return true;
+    }
+    if (!may_wait) {
+        if (requests.empty())
+            lock_shard.heads.erase(lock_id);
+        return false;
+    }
+
+    string what = "could not lock " + lock_id.to_string() + " (" + mode_name(wanted) + "): ";
+    string why = holder != nullptr ? string("another transaction holds it (") + mode_name(holder->mode) + ")"
+                                   : string("other transactions are waiting for it");
+    if (this->timeout_ms == 0) {
+        if (requests.empty())
+            lock_shard.heads.erase(lock_id);
+        throw LockWaitError(what + why);
+    }
+
+    auto request = requests.insert(own != nullptr ? first_waiting : requests.end(), Request(txn, wanted, false));
+    this->wait_count++;
+    this->waiting++;
+    if (this->running)
+        this->worker_changed.notify_all();
+    if (this->command_lock != nullptr) {
+        lock_guard<mutex> held_guard(this->held_lock);
+        this->parked[txn] = Parked{lock_id, what, why};
+        throw LockBusyError(what + why);
+    }
+    wait(lock_shard, lock_id, request, txn, guard, what, why);
+    return true;
+}
+
+// Lets go of the command lock while it waits, having taken the shard's lock off it first (the order they're
+// taken in when a statement locks something).
+void LockManager::wait_for_lock(TxnID txn) {
+    Parked waiting_for;
+    {
+        lock_guard<mutex> held_guard(this->held_lock);
+        auto found = this->parked.find(txn);
+        if (found == this->parked.end())
+            return;
+        waiting_for = found->second;
+        this->parked.erase(found);
+    }
+    Shard &lock_shard = shard(waiting_for.lock_id);
+    unique_lock<mutex> guard(lock_shard.lock);
+    auto head = lock_shard.heads.find(waiting_for.lock_id);
+    auto request = head->second.requests.begin();  // it's in the queue, if only as granted
+    while (request != head->second.requests.end() && (request->granted || request->txn != txn))
+        request++;
+    if (request == head->second.requests.end()) {  // granted already
+        this->waiting--;
+        return;
+    }
+    if (this->command_lock != nullptr)
+        this->command_lock->unlock();
+    try {
+        wait(lock_shard, waiting_for.lock_id, request, txn, guard, waiting_for.what, waiting_for.why);
+    } catch (LockWaitError &e) {
+        if (guard.owns_lock())
+            guard.unlock();
+        if (this->command_lock != nullptr)
+            this->command_lock->lock();
+        throw;
+    }
+    guard.unlock();
+    if (this->command_lock != nullptr)
+        this->command_lock->lock();
+}
+
+void LockManager::wait(Shard &lock_shard, const LockID &lock_id, list<Request>::iterator request, TxnID txn,
+                       unique_lock<mutex> &guard, const string &what, const string &why) {
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() +
+                                                chrono::milliseconds((u32) this->timeout_ms);
+    bool deadlock = false, timed_out = false;
+    while (!request->granted) {
+        {
+            lock_guard<mutex> held_guard(this->held_lock);
+            deadlock = this->victims.erase(txn) > 0;
+        }
+        if (deadlock)
+            break;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (now >= deadline) {
+            timed_out = true;
+            break;
+        }
+        lock_shard.changed.wait_until(guard, min(deadline, now + chrono::milliseconds(DEADLOCK_CHECK_MS)));
+        if (!this->running && !request->granted) {
+            guard.unlock();
+            break_deadlocks();
+            guard.lock();
+        }
+    }
+    if (request->granted) {
+        lock_guard<mutex> held_guard(this->held_lock);
+        this->victims.erase(txn);  // in case the lock came free just as it was picked
+    } else {
+        withdraw(lock_shard, lock_id, request);
+    }
+    this->waiting--;
+
+    if (deadlock) {
+        this->deadlock_count++;
+        throw LockWaitError(what + "deadlock with other transactions, so this one was chosen to give way", true);
+    }
+    if (timed_out) {
+        this->timeout_count++;
+        throw LockWaitError(what + why + ", and the wait timed out after " + to_string((u32) this->timeout_ms) +
+                            " ms");
+    }
+}
+
+// Waiting requests are granted in order, as far as the first that still conflicts with the holders.
+void LockManager::grant(const LockID &lock_id, LockHead &head) {
+    list<Request> &requests = head.requests;
+    for (auto request = requests.begin(); request != requests.end(); request++) {
+        if (request->granted)
+            continue;
+        for (auto const &other: requests)
+            if (other.granted && other.txn != request->txn && !is_compatible(other.mode, request->mode))
+                return;
+        bool upgrade = false;
+        for (auto own = requests.begin(); own != request; own++) {
+            if (own->granted && own->txn == request->txn) {
+                requests.erase(own);  // the upgraded request replaces it
+                upgrade = true;
+                break;
+            }
+        }
+        request->granted = true;
+        if (!upgrade) {
+            lock_guard<mutex> held_guard(this->held_lock);
+            this->held[request->txn].push_back(lock_id);
+        }
+    }
+}
+
+void LockManager::withdraw(Shard &lock_shard, const LockID &lock_id, list<Request>::iterator request) {
+    auto head = lock_shard.heads.find(lock_id);
+    head->second.requests.erase(request);
+    if (head->second.requests.empty()) {
+        lock_shard.heads.erase(head);
+    } else {
+        grant(lock_id, head->second);
+        lock_shard.changed.notify_all();
+    }
+}
+
+void LockManager::work() {
+    unique_lock<mutex> guard(this->worker_lock);
+    while (!this->stopping) {
+        this->worker_changed.wait_for(guard, chrono::milliseconds(DEADLOCK_CHECK_MS));
+        if (this->waiting == 0 || this->stopping)
+            continue;
+        guard.unlock();
+        break_deadlocks();
+        guard.lock();
+    }
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class LockWaitError - a lock that couldn't be had: the wait for it timed out, or would never have ended
+ */
+class LockWaitError : public DbRelationError {
+public:
+    explicit LockWaitError(std::string s, bool deadlock = false) : DbRelationError(s), deadlock(deadlock) {}
+
+    bool deadlock;  // the transaction was chosen to break a deadlock
+};
+
+/**
+ * @class LockBusyError - a lock that is held by another transaction, asked for while running under the command lock
+ * (see LockManager::set_command_lock). The request keeps its place in the lock's queue; the statement is to undo
+ * what it has done, wait (see LockManager::wait_for_lock) and then run again.
+ */
+class LockBusyError : public DbRelationError {
+public:
+    explicit LockBusyError(std::string s) : DbRelationError(s) {}
+};
+
+/**
+ * @class LockManager - locks on the database, its tables and their rows, held by transactions until they end
+ * (strict two-phase locking), for the sessions of this process.
+ *
+ * The locks form a hierarchy. Before a transaction locks a table it takes an intention lock on the database, and
+ * before it locks a row, one on the row's table: IS to read below, IX to write below. So writers of different
+ * rows of a table only get in each other's way on those rows, while a statement that replaces the table wholesale
+ * (X on it) still conflicts with every one of them without going through their rows. SIX is S on the whole plus
+ * IX for writing some of the rows below, which a transaction holding one of those and asking for the other gets.
+ *
+ * Lock heads (who holds each lock, and in what mode, and who is waiting for it) are kept in a hash table split into
+ * shards, each with its own mutex, so that sessions locking different things seldom contend for the same mutex. A
+ * request that conflicts with a lock someone else holds (or with one asked for before it) joins the lock's wait
+ * queue, first come first served except that a transaction upgrading a lock it already has goes first. It waits
+ * until the lock is granted, for no longer than the lock timeout.
+ *
+ * Waiting can go round in a circle. A background thread (see start) looks for cycles in the waits-for graph now and
+ * then, and breaks each by refusing the wait of the transaction in it that has the fewest locks (the least work to
+ * lose), or of the youngest of those. Without the thread, waiters look for themselves.
+ *
+ * Statements run one at a time, under the server's command lock. A statement that would wait doesn't, since the
+ * tables it is part way through changing aren't safe for another session to use until it's done with them: the lock
+ * throws LockBusyError instead, and the statement gives way, undoing itself. It waits between statements (see
+ * wait_for_lock), with the command lock let go so that the transactions it waits for can go on and end, and then
+ * runs again.
+ *
+ * Readers read from snapshots (see VersionStore), so all a SELECT takes is IS on its tables, which only conflicts
+ * with statements like DROP TABLE.
+ *
+ * Apart from the hierarchy, a transaction locks each block of a file that it writes (see lock_block). Berkeley DB
+ * logs a block as a whole, and undoes an uncommitted transaction's changes in recovery by putting back the block
+ * as it found it, so no two transactions can have uncommitted changes in one block.
+ */
+class LockManager {
+public:
+    typedef u_int64_t TxnID;
+
+    enum Mode {
+        IS,   // intention to read below
+        IX,   // intention to write below
+        S,    // read
+        SIX,  // read, with the intention to write below
+        X     // write
+    };
+
+    /**
+     * @class LockID - what a lock is on: the database (no table name), a table (no handle) or a row of one, or a
+     * block of a file (the file's name, which has a '.' as table names don't, and the block with record 0).
+     */
+    struct LockID {
+        Identifier table_name;
+        Handle handle;  // (0, 0) for the table as a whole (there is no block 0)
+
+        LockID() : table_name(), handle(0, 0) {}
+
+        LockID(const Identifier &table_name, Handle handle = Handle(0, 0)) : table_name(table_name),
+                                                                             handle(handle) {}
+
+        bool operator==(const LockID &other) const {
+            return table_name == other.table_name && handle == other.handle;
+        }
+
+        std::string to_string() const;
+    };
+
+    static const u32 SHARD_COUNT = 16;
+    static const u32 DEFAULT_TIMEOUT_MS = 10000;
+    static const u32 DEADLOCK_CHECK_MS = 100;  // how often to look for deadlocks while anyone waits
+
+    /**
+     * The transaction the current thread locks for (0 to lock nothing). Set by the TransactionManager.
+     */
+    static thread_local TxnID current;
+
+    /**
+     * The one lock manager for all the sessions.
+     */
+    static LockManager &get();
+
+    LockManager();
+
+    virtual ~LockManager() { stop(); }
+
+    LockManager(const LockManager &other) = delete;
+
+    LockManager &operator=(const LockManager &other) = delete;
+
+    /**
+     * Start the thread that looks for deadlocks.
+     */
+    virtual void start();
+
+    virtual void stop();
+
+    /**
+     * @param timeout_ms  longest to wait for a lock, in milliseconds (0 never waits)
+     */
+    virtual void set_timeout(u32 timeout_ms) { this->timeout_ms = timeout_ms; }
+
+    virtual u32 get_timeout() const { return timeout_ms; }
+
+    /**
+     * The lock that callers hold while they run statements (nullptr if none). With one set, requests that would
+     * wait throw LockBusyError instead, to be waited for with it let go.
+     */
+    virtual void set_command_lock(std::mutex *command_lock) { this->command_lock = command_lock; }
+
+    /**
+     * Lock a table for the current thread's transaction, along with the intention lock on the database it implies.
+     * @param table_name  the table
+     * @param mode        how to lock it
+     * @throws            LockWaitError if it can't be had, LockBusyError if it has to be waited for
+     */
+    virtual void lock_table(const Identifier &table_name, Mode mode);
+
+    /**
+     * Lock a row for the current thread's transaction, along with the intention locks above it it implies.
+     * @param table_name  the row's table
+     * @param handle      the row
+     * @param mode        S or X
+     * @throws            LockWaitError if it can't be had, LockBusyError if it has to be waited for
+     */
+    virtual void lock_row(const Identifier &table_name, Handle handle, Mode mode);
+
+    /**
+     * Lock a block of a file for writing, for the current thread's transaction. Call before changing anything
+     * that goes in the block, so that the change can give way (see LockBusyError) without being half made.
+     * @param file_name  the file
+     * @param block_id   the block
+     * @throws           LockWaitError if it can't be had, LockBusyError if it has to be waited for
+     */
+    virtual void lock_block(const std::string &file_name, BlockID block_id);
+
+    /**
+     * Lock a block of a file for writing, for the current thread's transaction, if no other transaction has it.
+     * @returns  whether the block is now locked (e.g. false to put a new row in another block instead)
+     */
+    virtual bool try_lock_block(const std::string &file_name, BlockID block_id);
+
+    /**
+     * Wait for the lock a transaction's statement gave way on (see LockBusyError) to be granted, with the command
+     * lock let go meanwhile. Call between statements, when nothing is part way through a change.
+     * @param txn  the transaction
+     * @throws     LockWaitError if it can't be had (the request is withdrawn)
+     */
+    virtual void wait_for_lock(TxnID txn);
+
+    /**
+     * Release every lock a transaction holds (when it ends), and withdraw any it is waiting for.
+     */
+    virtual void unlock_all(TxnID txn);
+
+    /**
+     * Whether a transaction holds a lock at least as strong as mode.
+     */
+    virtual bool is_held(TxnID txn, const LockID &lock_id, Mode mode);
+
+    /**
+     * How many locks are held, by all the transactions together.
+     */
+    virtual size_t get_lock_count();
+
+    /**
+     * How many lock requests have had to wait, and how many of those timed out or were refused to break a deadlock.
+     */
+    virtual void get_counts(u_int64_t &wait_count, u_int64_t &timeout_count, u_int64_t &deadlock_count) const;
+
+    /**
+     * Look for deadlocks now, refusing a wait in each one found.
+     * @returns  how many were found
+     */
+    virtual size_t break_deadlocks();
+
+    /**
+     * Whether two transactions can hold locks in these modes on the same thing at once.
+     */
+    static bool is_compatible(Mode a, Mode b);
+
+    /**
+     * The weakest mode that is at least as strong as both (e.g. SIX for S and IX).
+     */
+    static Mode combine(Mode a, Mode b);
+
+    static const char *mode_name(Mode mode);
+
+protected:
+    struct Request {
+        TxnID txn;
+        Mode mode;
+        bool granted;
+
+        Request(TxnID txn, Mode mode, bool granted) : txn(txn), mode(mode), granted(granted) {}
+    };
+
+    struct Parked {
+        LockID lock_id;
+        std::string what, why;  // what couldn't be locked and why, for the error if the wait fails
+    };
+
+    struct LockHead {
+        std::list<Request> requests;  // the granted ones, then the waiting ones in the order they'll be granted
+    };
+
+    struct LockIDHash {
+        size_t operator()(const LockID &lock_id) const;
+    };
+
+    struct Shard {
+        std::mutex lock;
+        std::condition_variable changed;  // a lock was granted or released, or a waiter refused
+        std::unordered_map<LockID, LockHead, LockIDHash> heads;
+    };
+
+    Shard shards[SHARD_COUNT];
+    std::mutex held_lock;
+    std::unordered_map<TxnID, std::vector<LockID>> held;  // what each transaction has locked, for unlock_all
+    std::set<TxnID> victims;  // waiters refused to break deadlocks, not yet told (guarded by held_lock)
+    std::unordered_map<TxnID, Parked> parked;  // requests given way on, not yet waited for (guarded by held_lock)
+    std::atomic<u32> timeout_ms;
+    std::mutex *command_lock;
+    std::atomic<u_int64_t> wait_count, timeout_count, deadlock_count;
+    std::atomic<size_t> waiting;  // how many requests are waiting
+
+    std::atomic<bool> running;
+    bool stopping;
+    std::thread worker;
+    std::mutex worker_lock;
+    std::condition_variable worker_changed;
+
+    Shard &shard(const LockID &lock_id);
+
+    /**
+     * @param may_wait  false to give up at once (returning false) if the lock can't be had yet
+     */
+    bool acquire(TxnID txn, const LockID &lock_id, Mode mode, bool may_wait = true);
+
+    /**
+     * Wait for a request in a lock's queue to be granted, withdrawing it if it isn't in time. Call with the shard's
+     * lock held (by guard).
+     * @throws  LockWaitError if the wait times out or is refused to break a deadlock
+     */
+    void wait(Shard &lock_shard, const LockID &lock_id, std::list<Request>::iterator request, TxnID txn,
+              std::unique_lock<std::mutex> &guard, const std::string &what, const std::string &why);
+
+    /**
+     * Grant the waiting requests for a lock that now can be, in turn. Call with the shard's lock held.
+     */
+    void grant(const LockID &lock_id, LockHead &head);
+
+    /**
+     * Take a request that is waiting no longer out of its lock's queue, letting those behind it be granted if
+     * they now can. Call with the shard's lock held.
+     */
+    void withdraw(Shard &lock_shard, const LockID &lock_id, std::list<Request>::iterator request);
+
+    void work();
+};
@@ -0,0 +1,109 @@
+#include "LockManagerTests.h"
+#include "LockManager.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+namespace LockManagerTests{
+    // row locks conflict only on the same row, the intention locks they take conflict with table locks, and a
+    // table lock on top of an intention lock becomes the mode that covers both (IX and S make SIX)
+    void testConflicts(){
+        cout << "Testing lock conflicts" << endl;
+        LockManager locks;
+        locks.set_timeout(0); // refuse, rather than wait for, locks other transactions hold
+        LockManager::TxnID saved = LockManager::current;
+        LockManager::current = 1;
+        locks.lock_row("_test_locks", Handle(1, 1), LockManager::X);
+        LockManager::current = 2;
+        locks.lock_row("_test_locks", Handle(1, 2), LockManager::X); // IX on the table for both
+        string problem;
+        try {
+            locks.lock_row("_test_locks", Handle(1, 1), LockManager::S);
+            problem = "granted S on a row another transaction has X on";
+        } catch (LockWaitError &e) {
+        }
+        try {
+            locks.lock_table("_test_locks", LockManager::S); // txn 1's IX on the table is in the way
+            if(problem.empty())
+                problem = "granted S on a table another transaction has IX on";
+        } catch (LockWaitError &e) {
+        }
+        locks.unlock_all(1);
+        locks.lock_table("_test_locks", LockManager::S);
+        if(problem.empty() && (!locks.is_held(2, LockManager::LockID("_test_locks"), LockManager::SIX) ||
+                               !locks.is_held(2, LockManager::LockID(), LockManager::IX)))
+            problem = "didn't upgrade IX and S to SIX";
+        locks.unlock_all(2);
+        if(problem.empty() && locks.get_lock_count() != 0)
+            problem = "still has locks after unlocking everything";
+        LockManager::current = saved;
+        if(!problem.empty())
+            throw DbRelationError("lock manager " + problem);
+    }
+
+    // a block is written by one transaction at a time, whatever the tables above it
+    void testBlocks(){
+        cout << "Testing block locks" << endl;
+        LockManager locks;
+        locks.set_timeout(0);
+        LockManager::TxnID saved = LockManager::current;
+        LockManager::current = 1;
+        locks.lock_block("_test_locks.db", 1);
+        LockManager::current = 2;
+        string problem;
+        if(locks.try_lock_block("_test_locks.db", 1))
+            problem = "let two transactions write the same block";
+        else if(!locks.try_lock_block("_test_locks.db", 2) || !locks.try_lock_block("_test_other.db", 1))
+            problem = "kept a transaction from writing a block no other has written";
+        locks.unlock_all(1);
+        if(problem.empty() && !locks.try_lock_block("_test_locks.db", 1))
+            problem = "kept a block locked after its writer ended";
+        locks.unlock_all(2);
+        LockManager::current = saved;
+        if(!problem.empty())
+            throw DbRelationError("lock manager " + problem);
+    }
+
+    // two transactions each waiting for a row the other has locked: the cycle is found and one of them gives
+    // way long before its wait would have timed out, letting the other one through
+    void testDeadlock(){
+        cout << "Testing deadlock detection" << endl;
+        LockManager locks; // no background thread, so the waiters look for the cycle themselves
+        locks.set_timeout(10000);
+        atomic<int> victims(0), through(0);
+        auto transaction = [&](LockManager::TxnID txn, Handle first, Handle second){
+            LockManager::current = txn;
+            locks.lock_row("_test_deadlock", first, LockManager::X);
+            this_thread::sleep_for(chrono::milliseconds(50)); // until the other has its first row
+            try {
+                locks.lock_row("_test_deadlock", second, LockManager::X);
+                through++;
+            } catch (LockWaitError &e) {
+                if(e.deadlock)
+                    victims++;
+            }
+            locks.unlock_all(txn);
+        };
+        auto started = chrono::steady_clock::now();
+        thread one(transaction, 1, Handle(1, 1), Handle(1, 2));
+        thread two(transaction, 2, Handle(1, 2), Handle(1, 1));
+        one.join();
+        two.join();
+        auto waited = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - started).count();
+        if(victims != 1 || through != 1)
+            throw DbRelationError("deadlock wasn't broken by making just one transaction give way");
+        if(waited >= 10000)
+            throw DbRelationError("deadlock was only broken by the wait timing out");
+        if(locks.get_lock_count() != 0)
+            throw DbRelationError("lock manager still has locks after the deadlock");
+    }
+
+    void testAll(){
+        testConflicts();
+        testBlocks();
+        testDeadlock();
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+namespace LockManagerTests{
+    void testConflicts();
+    void testBlocks();
+    void testDeadlock();
+    void testAll();
+}
@@ -0,0 +1,122 @@
+#include "Lz4.h"
+#include <cstring>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+// Rules of the format: matches are at least MIN_MATCH long, the last LAST_LITERALS bytes are always literals,
+// and no match starts within MATCH_LIMIT bytes of the end.
+static const u32 MIN_MATCH = 4;
+static const u32 LAST_LITERALS = 5;
+static const u32 MATCH_LIMIT = 12;
+static const u32 MAX_OFFSET = 65535;
+static const int HASH_LOG = 12;
+
+static u32 read32(const char *p) {
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static u32 hash_of(u32 v) {
+    return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+// lengths that don't fit in a token nibble continue in 255s and a final byte
+static void put_length(vector<char> &dst, u32 length) {
+    while (length >= 255) {
+        dst.push_back((char) 255);
+        length -= 255;
+    }
+    dst.push_back((char) length);
+}
+
+static void put_sequence(vector<char> &dst, const char *literals, u32 n_literals, u32 offset, u32 match_length) {
+    u32 match_code = match_length == 0 ? 0 : match_length - MIN_MATCH;
+    dst.push_back((char) ((min(n_literals, 15U) << 4) | min(match_code, 15U)));
+    if (n_literals >= 15)
+        put_length(dst, n_literals - 15);
+    dst.insert(dst.end(), literals, literals + n_literals);
+    if (match_length == 0)
+        return;  // the last sequence has no match
+    dst.push_back((char) (offset & 0xFF));
+    dst.push_back((char) (offset >> 8));
+    if (match_code >= 15)
+        put_length(dst, match_code - 15);
+}
+
+void Lz4::compress(const char *src, u32 size, vector<char> &dst) {
+    dst.clear();
+    u32 anchor = 0;
+    if (size > MATCH_LIMIT) {
+        vector<int> table(1 << HASH_LOG, -1);
+        u32 i = 0;
+        while (i <= size - MATCH_LIMIT) {
+            u32 v = read32(src + i);
+            u32 h = hash_of(v);
+            int candidate = table[h];
+            table[h] = (int) i;
+            if (candidate < 0 || i - candidate > MAX_OFFSET || read32(src + candidate) != v) {
+                i++;
+                continue;
+            }
+            u32 length = MIN_MATCH;
+            u32 max_length = size - LAST_LITERALS - i;
+            while (length < max_length && src[candidate + length] == src[i + length])
+                length++;
+            put_sequence(dst, src + anchor, i - anchor, i - candidate, length);
+            i += length;
+            anchor = i;
+        }
+    }
+    put_sequence(dst, src + anchor, size - anchor, 0, 0);
+}
+
+int Lz4::decompress(const char *src, u32 size, char *dst, u32 capacity) {
+    const unsigned char *in = (const unsigned char *) src;
+    u32 ip = 0, op = 0;
+    while (ip < size) {
+        u32 token = in[ip++];
+        u32 n_literals = token >> 4;
+        if (n_literals == 15) {
+            u32 b;
+            do {
+                if (ip >= size)
+                    return -1;
+                b = in[ip++];
+                n_literals += b;
+            } while (b == 255);
+        }
+        if (n_literals > size - ip || n_literals > capacity - op)
+            return -1;
+        memcpy(dst + op, src + ip, n_literals);
+        ip += n_literals;
+        op += n_literals;
+        if (ip == size)
+            break;  // the last sequence
+
+        if (size - ip < 2)
+            return -1;
+        u32 offset = in[ip] | (in[ip + 1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > op)
+            return -1;
+        u32 length = token & 0x0F;
+        if (length == 15) {
+            u32 b;
+            do {
+                if (ip >= size)
+                    return -1;
+                b = in[ip++];
+                length += b;
+            } while (b == 255);
+        }
+        length += MIN_MATCH;
+        if (length > capacity - op)
+            return -1;
+        for (u32 i = 0; i < length; i++, op++)  // byte at a time since the match may overlap its own output
+            dst[op] = dst[op - offset];
+    }
+    return (int) op;
+}
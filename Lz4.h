@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class Lz4 - compressor for the LZ4 block format (no frame header or checksums).
+ *
+ * A small self-contained implementation so compressed tables don't need an outside library. The compressor
+ * is the plain greedy one with a single hash table, which is plenty for 4-64kB pages. The output can be read
+ * by any LZ4 block decoder and vice versa.
+ */
+class Lz4 {
+public:
+    /**
+     * Compress a buffer.
+     * @param src   bytes to compress
+     * @param size  number of bytes to compress
+     * @param dst   replaced with the compressed bytes
+     */
+    static void compress(const char *src, u32 size, std::vector<char> &dst);
+
+    /**
+     * Decompress a buffer made by compress().
+     * @param src       compressed bytes
+     * @param size      number of compressed bytes
+     * @param dst       receives the decompressed bytes
+     * @param capacity  room in dst
+     * @returns         number of bytes decompressed, or -1 if src isn't valid or doesn't fit in dst
+     */
+    static int decompress(const char *src, u32 size, char *dst, u32 capacity);
+};
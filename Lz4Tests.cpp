@@ -0,0 +1,38 @@
+#include "Lz4Tests.h"
+#include "Lz4.h"
+#include "storage_engine.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Lz4Tests{
+    // what Lz4 compresses comes back the same, whether or not it could be made any smaller
+    void testRoundTrip(){
+        cout << "Testing LZ4" << endl;
+        string repetitive, random;
+        u32 seed = 1;
+        for(int i = 0; i < 16384; i++){
+            repetitive += "the same words over and over "[i % 29];
+            seed = seed * 1103515245 + 12345;
+            random += (char) (seed >> 16);
+        }
+        for(const string *input : {&repetitive, &random}){
+            vector<char> compressed;
+            Lz4::compress(input->data(), (u32) input->size(), compressed);
+            vector<char> output(input->size());
+            int size = Lz4::decompress(compressed.data(), (u32) compressed.size(), output.data(), (u32) output.size());
+            if(size != (int) input->size() || string(output.data(), output.size()) != *input)
+                throw DbRelationError("LZ4 didn't give back what it compressed");
+            if(input == &repetitive && compressed.size() >= input->size() / 4)
+                throw DbRelationError("LZ4 didn't make repetitive text much smaller");
+            if(Lz4::decompress(compressed.data(), (u32) compressed.size(), output.data(), (u32) output.size() - 1) != -1)
+                throw DbRelationError("LZ4 decompressed into a buffer too small for it");
+        }
+    }
+
+    void testAll(){
+        testRoundTrip();
+    }
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace Lz4Tests{
+    void testRoundTrip();
+    void testAll();
+}
@@ -0,0 +1,116 @@
+#include "OverflowFile.h"
+#include <cstring>
+#include <vector>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+// block 1 of the file holds the free list head; chains use blocks 2 and up
+static const BlockID FIRST_PAGE = 2;
+
+void OverflowFile::open() {
+    if (this->file.is_open())
+        return;
+    vector<char> buffer(this->file.get_block_size());
+    if (this->file.open(true)) {
+        this->file.read(1, buffer.data());
+        this->free_head = *(u32 *) buffer.data();
+    } else {
+        this->free_head = 0;
+        this->file.write(1, buffer.data());
+    }
+}
+
+void OverflowFile::close() {
+    this->file.close();
+}
+
+void OverflowFile::drop() {
+    try {
+        this->file.drop();
+    } catch (DbException &e) {
+        // never had anything overflow
+    }
+    this->free_head = 0;
+}
+
+// The chain is written back to front so that each page is written as soon as it's allocated (which is what
+// moves the end of the file along) and already knows the id of the page after it.
+BlockID OverflowFile::write(const char *bytes, u32 length) {
+    this->open();
+    u32 block_size = this->file.get_block_size();
+    u32 per_page = block_size - PAGE_HEADER_SZ;
+    u32 n_pages = length == 0 ? 1 : (length + per_page - 1) / per_page;
+    vector<char> buffer(block_size);
+    BlockID next = 0;
+    for (u32 i = n_pages; i-- > 0;) {
+        u32 offset = i * per_page;
+        u32 used = min(per_page, length - offset);
+        BlockID page = allocate();
+        memset(buffer.data(), 0, block_size);
+        *(u32 *) buffer.data() = next;
+        *(u32 *) (buffer.data() + sizeof(u32)) = used;
+        memcpy(buffer.data() + PAGE_HEADER_SZ, bytes + offset, used);
+        this->file.write(page, buffer.data());
+        next = page;
+    }
+    return next;
+}
+
+string OverflowFile::read(BlockID first, u32 length) {
+    this->open();
+    string value;
+    value.reserve(length);
+    vector<char> buffer(this->file.get_block_size());
+    BlockID page = first;
+    while (value.size() < length) {
+        if (page < FIRST_PAGE || !this->file.read(page, buffer.data()))
+            throw DbRelationError("overflow chain is broken");
+        u32 used = min(*(u32 *) (buffer.data() + sizeof(u32)), (u32) (length - value.size()));
+        value.append(buffer.data() + PAGE_HEADER_SZ, used);
+        page = *(u32 *) buffer.data();
+    }
+    return value;
+}
+
+// Only the last page of the chain has to be rewritten: it gets linked to the old free list. The free list is in
+// block 1, which only one transaction at a time can write, so if another has it, the chain is left where it is
+// (until VACUUM copies the table) rather than waiting.
+void OverflowFile::free(BlockID first) {
+    this->open();
+    if (!this->file.try_lock(1))
+        return;
+    vector<char> buffer(this->file.get_block_size());
+    BlockID page = first;
+    while (true) {
+        if (page < FIRST_PAGE || !this->file.read(page, buffer.data()))
+            throw DbRelationError("overflow chain is broken");
+        BlockID next = *(u32 *) buffer.data();
+        if (next == 0)
+            break;
+        page = next;
+    }
+    *(u32 *) buffer.data() = this->free_head;
+    this->file.write(page, buffer.data());
+    this->free_head = first;
+    write_free_head();
+}
+
+// The file is extended instead of taking a page off the free list if another transaction has the list (see free).
+BlockID OverflowFile::allocate() {
+    if (this->free_head == 0 || !this->file.try_lock(1))
+        return max(this->file.get_last_block_id() + 1, FIRST_PAGE);
+    BlockID page = this->free_head;
+    vector<char> buffer(this->file.get_block_size());
+    this->file.read(page, buffer.data());
+    this->free_head = *(u32 *) buffer.data();
+    write_free_head();
+    return page;
+}
+
+void OverflowFile::write_free_head() {
+    vector<char> buffer(this->file.get_block_size());
+    *(u32 *) buffer.data() = this->free_head;
+    this->file.write(1, buffer.data());
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "BlockFile.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class OverflowFile - out-of-line storage for TEXT values too big to keep in their row.
+ *
+ * A value is stored as a chain of pages in a BlockFile beside the heap file. Each page starts with the id of
+ * the next page in the chain (0 at the end) and the number of value bytes on the page. Block 1 holds the head
+ * of the list of freed pages, which are reused before the file is extended (unless another transaction is using
+ * the list: then the file is extended, and freed pages are left out of the list).
+ * The file isn't created until the first value overflows, so tables without big values never have one.
+ */
+class OverflowFile {
+public:
+    static const u32 PAGE_HEADER_SZ = 2 * sizeof(u32);
+
+    /**
+     * @param name        name of the heap file this belongs to
+     * @param block_size  size of the overflow pages
+     */
+    OverflowFile(std::string name, u32 block_size) : file(file_name(name), block_size), free_head(0) {}
+
+    /**
+     * Name of the file holding the overflow pages for the given heap file.
+     */
+    static std::string file_name(std::string name) { return name + ".ovf.db"; }
+
+    virtual ~OverflowFile() {}
+
+    OverflowFile(const OverflowFile &other) = delete;
+
+    OverflowFile &operator=(const OverflowFile &other) = delete;
+
+    virtual void close();
+
+    /**
+     * Remove the file if there is one.
+     */
+    virtual void drop();
+
+    /**
+     * Store a value in a new chain of pages.
+     * @param bytes   the value
+     * @param length  number of bytes in the value
+     * @returns       the first page of the chain
+     */
+    virtual BlockID write(const char *bytes, u32 length);
+
+    /**
+     * Get back a value stored by write().
+     * @param first   the first page of the chain
+     * @param length  number of bytes in the value
+     */
+    virtual std::string read(BlockID first, u32 length);
+
+    /**
+     * Put all the pages of a chain on the free list.
+     * @param first  the first page of the chain
+     */
+    virtual void free(BlockID first);
+
+protected:
+    BlockFile file;
+    BlockID free_head;
+
+    virtual void open();
+
+    virtual BlockID allocate();
+
+    virtual void write_free_head();
+};
@@ -0,0 +1,48 @@
+#include "OverflowFileTests.h"
+#include "HeapTable.h"
+
+using namespace std;
+
+namespace OverflowFileTests{
+    // TEXT values over a quarter of a block go to a chain of overflow pages; the chains are freed when their rows
+    // are updated or deleted, and the freed pages are used again before the file grows
+    void testChains(){
+        cout << "Testing overflow pages" << endl;
+        ColumnNames columnNames = {"id", "body"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        HeapTable table("_test_overflow", columnNames, columnAttributes);
+        table.create();
+        string big;
+        for(int i = 0; i < 10000; i++)
+            big += (char) ('a' + i % 26);
+        ValueDict row;
+        row["id"] = Value(1);
+        row["body"] = Value(big);
+        Handle handle = table.insert(&row);
+        ValueDict *got = table.project(handle);
+        bool same = (*got)["body"].s == big;
+        delete got;
+        if(!same)
+            throw DbRelationError("a TEXT value that overflowed didn't come back the same");
+
+        ValueDict newValues;
+        newValues["body"] = Value(big.substr(1) + "!");
+        table.update(handle, &newValues); // the old chain is freed
+        table.del(handle); // and then the new one
+        row["body"] = Value(big);
+        table.insert(&row); // from freed pages
+        table.insert(&row); // likewise
+        table.close();
+        BlockFile overflowFile(OverflowFile::file_name("_test_overflow"), DbBlock::BLOCK_SZ);
+        overflowFile.open();
+        BlockID pages = overflowFile.get_last_block_id(); // the free list's head, then two chains
+        overflowFile.close();
+        table.drop();
+        if(pages > 1 + 2 * (big.size() / (DbBlock::BLOCK_SZ - OverflowFile::PAGE_HEADER_SZ) + 1))
+            throw DbRelationError("overflow pages weren't freed when their rows were updated or deleted");
+    }
+
+    void testAll(){
+        testChains();
+    }
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace OverflowFileTests{
+    void testChains();
+    void testAll();
+}
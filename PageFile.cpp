@@ -0,0 +1,458 @@
+#include "PageFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "db_cxx.h"
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+// more threads than this doing buffered preads gains nothing, whatever the io_depth
+static const u32 MAX_READ_THREADS = 16;
+
+// set once io_uring_setup has failed (old kernel, or forbidden by seccomp), so we stop trying
+static atomic<bool> uring_unavailable(false);
+
+// cleared by set_io_uring(false), to have threads do the reads whether or not the kernel has io_uring
+static atomic<bool> uring_allowed(true);
+
+// Page files written since the last sync_written, by path: each a descriptor of its own, so that syncing it can't
+// race with the PageFile closing its descriptor (or the number being reused).
+static mutex written_lock;
+static map<string, int> written;
+
+// Read a whole block, retrying after signals and short reads. False at end of file or on error (errno set).
+static bool read_block(int fd, BlockID block_id, char *buffer, u32 block_size) {
+    off_t offset = (off_t) (block_id - 1) * block_size;
+    u32 done = 0;
+    while (done < block_size) {
+        ssize_t n = ::pread(fd, buffer + done, block_size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            if (n == 0)
+                errno = 0;
+            return false;
+        }
+        done += (u32) n;
+    }
+    return true;
+}
+
+static string read_error(BlockID block_id, const string &name) {
+    return "could not read block " + to_string(block_id) + " of " + PageFile::file_name(name) +
+           (errno == 0 ? string(" (past the end)") : ": " + string(strerror(errno)));
+}
+
+#ifdef HAVE_IO_URING
+
+/*
+ * Reads through an io_uring: each read is queued on the submission ring and the kernel posts it to the completion
+ * ring when done. Only this thread touches the rings, so the usual liburing dance is done by hand here with
+ * acquire/release atomics on the head and tail indices the kernel shares with us.
+ */
+class UringReads : public PageReads {
+public:
+    UringReads(int fd, const string &name, u32 block_size, const BlockIDs &block_ids, u32 depth)
+            : fd(fd), name(name), block_size(block_size), block_ids(block_ids), submitted(0), delivered(0),
+              in_flight(0), unsubmitted(0), slots(min((size_t) depth, block_ids.size())), ring(-1),
+              sq_ptr(MAP_FAILED), cq_ptr(MAP_FAILED), sqes(nullptr), sq_size(0), cq_size(0), sqes_size(0) {
+        for (u32 i = 0; i < slots.size(); i++)
+            free_slots.push_back(i);
+    }
+
+    virtual ~UringReads() {
+        // the kernel may still be writing into our buffers, so wait for whatever it has
+        try {
+            while (this->in_flight > 0) {
+                Slot *slot;
+                int result;
+                if (reap(slot, result))
+                    this->in_flight--;
+                else
+                    enter(1);
+            }
+        } catch (DbRelationError &e) {
+            // nothing more we can do; the ring is torn down below either way
+        }
+        if (this->sqes != nullptr)
+            ::munmap(this->sqes, this->sqes_size);
+        if (this->cq_ptr != MAP_FAILED && this->cq_ptr != this->sq_ptr)
+            ::munmap(this->cq_ptr, this->cq_size);
+        if (this->sq_ptr != MAP_FAILED)
+            ::munmap(this->sq_ptr, this->sq_size);
+        if (this->ring >= 0)
+            ::close(this->ring);
+    }
+
+    // Set up the ring. False if this kernel won't give us one.
+    bool start() {
+        if (this->slots.empty())
+            return true;
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        this->ring = (int) ::syscall(__NR_io_uring_setup, (unsigned) this->slots.size(), &params);
+        if (this->ring < 0)
+            return false;
+
+        this->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        this->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+        single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+        if (single_mmap)
+            this->sq_size = this->cq_size = max(this->sq_size, this->cq_size);
+        this->sq_ptr = ::mmap(nullptr, this->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring,
+                              IORING_OFF_SQ_RING);
+        if (this->sq_ptr == MAP_FAILED)
+            return false;
+        this->cq_ptr = single_mmap ? this->sq_ptr : ::mmap(nullptr, this->cq_size, PROT_READ | PROT_WRITE,
+                                                           MAP_SHARED | MAP_POPULATE, this->ring, IORING_OFF_CQ_RING);
+        if (this->cq_ptr == MAP_FAILED)
+            return false;
+        this->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = ::mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring,
+                            IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+        this->sqes = (io_uring_sqe *) sqes;
+
+        char *sq = (char *) this->sq_ptr, *cq = (char *) this->cq_ptr;
+        this->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+        this->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+        this->sq_array = (unsigned *) (sq + params.sq_off.array);
+        this->cq_head = (unsigned *) (cq + params.cq_off.head);
+        this->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+        this->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+        this->cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+        return true;
+    }
+
+    virtual bool next(BlockID &block_id, std::vector<char> &block) {
+        if (this->delivered == this->block_ids.size())
+            return false;
+        while (this->submitted < this->block_ids.size() && !this->free_slots.empty())
+            queue(this->block_ids[this->submitted++]);
+        if (this->unsubmitted > 0)
+            enter(0);
+
+        Slot *slot;
+        int result;
+        while (!reap(slot, result))
+            enter(1);
+        this->in_flight--;
+        this->free_slots.push_back((u32) (slot - this->slots.data()));
+        // a failed or short read (which buffered reads shouldn't give us) is simply done again synchronously
+        if (result != (int) this->block_size &&
+            !read_block(this->fd, slot->block_id, slot->buffer.data(), this->block_size))
+            throw DbRelationError(read_error(slot->block_id, this->name));
+
+        block_id = slot->block_id;
+        block.swap(slot->buffer);
+        this->delivered++;
+        return true;
+    }
+
+protected:
+    struct Slot {
+        BlockID block_id;
+        std::vector<char> buffer;
+        iovec iov;
+    };
+
+    int fd;
+    string name;
+    u32 block_size;
+    BlockIDs block_ids;
+    size_t submitted;    // blocks queued so far (they're read in this order)
+    size_t delivered;    // blocks handed back so far
+    u32 in_flight;       // queued but not yet reaped
+    u32 unsubmitted;     // queued but not yet passed to the kernel
+    std::vector<Slot> slots;
+    std::vector<u32> free_slots;
+
+    int ring;
+    void *sq_ptr, *cq_ptr;
+    io_uring_sqe *sqes;
+    size_t sq_size, cq_size, sqes_size;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+
+    // Put a read on the submission ring (io_uring_enter hands it to the kernel).
+    void queue(BlockID block_id) {
+        u32 slot_index = this->free_slots.back();
+        this->free_slots.pop_back();
+        Slot &slot = this->slots[slot_index];
+        slot.block_id = block_id;
+        slot.buffer.resize(this->block_size);
+        slot.iov.iov_base = slot.buffer.data();
+        slot.iov.iov_len = this->block_size;
+
+        unsigned tail = *this->sq_tail;  // only we write it
+        unsigned index = tail & *this->sq_mask;
+        io_uring_sqe *sqe = &this->sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = this->fd;
+        sqe->addr = (u_int64_t) (uintptr_t) &slot.iov;
+        sqe->len = 1;
+        sqe->off = (u_int64_t) (block_id - 1) * this->block_size;
+        sqe->user_data = slot_index;
+        this->sq_array[index] = index;
+        __atomic_store_n(this->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        this->in_flight++;
+        this->unsubmitted++;
+    }
+
+    // Submit what's been queued, and wait for at least wait_for completions.
+    void enter(u32 wait_for) {
+        while (true) {
+            int n = (int) ::syscall(__NR_io_uring_enter, this->ring, this->unsubmitted, wait_for,
+                                    wait_for > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (n >= 0) {
+                this->unsubmitted -= min((u32) n, this->unsubmitted);
+                return;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                throw DbRelationError("io_uring_enter on " + PageFile::file_name(this->name) + ": " +
+                                      strerror(errno));
+        }
+    }
+
+    // Take a completion off the completion ring, if there is one.
+    bool reap(Slot *&slot, int &result) {
+        unsigned head = *this->cq_head;  // only we write it
+        if (head == __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE))
+            return false;
+        io_uring_cqe *cqe = &this->cqes[head & *this->cq_mask];
+        slot = &this->slots[cqe->user_data];
+        result = cqe->res;
+        __atomic_store_n(this->cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+#endif
+
+/*
+ * Reads by a pool of threads, each doing one pread at a time. Reads stop getting started once io_depth blocks are
+ * either being read or waiting to be handed back, so a slow consumer doesn't have the whole table read into memory.
+ */
+class ThreadPoolReads : public PageReads {
+public:
+    ThreadPoolReads(int fd, const string &name, u32 block_size, const BlockIDs &block_ids, u32 depth)
+            : fd(fd), name(name), block_size(block_size), depth(depth), block_ids(block_ids), started(0),
+              delivered(0), in_flight(0), stopping(false) {
+        size_t thread_count = min(min((size_t) depth, (size_t) MAX_READ_THREADS), block_ids.size());
+        for (size_t i = 0; i < thread_count; i++)
+            this->threads.push_back(thread(&ThreadPoolReads::work, this));
+    }
+
+    virtual ~ThreadPoolReads() {
+        {
+            lock_guard<mutex> guard(this->lock);
+            this->stopping = true;
+        }
+        this->room.notify_all();
+        for (auto &worker: this->threads)
+            worker.join();
+    }
+
+    virtual bool next(BlockID &block_id, std::vector<char> &block) {
+        unique_lock<mutex> guard(this->lock);
+        this->ready.wait(guard, [this] {
+            return !this->completed.empty() || !this->error.empty() || this->delivered == this->block_ids.size();
+        });
+        if (!this->error.empty())
+            throw DbRelationError(this->error);
+        if (this->delivered == this->block_ids.size())
+            return false;
+        block_id = this->completed.front().first;
+        block.swap(this->completed.front().second);
+        this->completed.pop_front();
+        this->delivered++;
+        guard.unlock();
+        this->room.notify_one();
+        return true;
+    }
+
+protected:
+    int fd;
+    string name;
+    u32 block_size;
+    u32 depth;
+    BlockIDs block_ids;
+    size_t started;      // blocks a thread has taken so far (they're taken in this order)
+    size_t delivered;    // blocks handed back so far
+    u32 in_flight;       // being read right now
+    bool stopping;
+    string error;        // from the first read that failed
+    deque<pair<BlockID, std::vector<char>>> completed;
+    vector<thread> threads;
+    mutex lock;
+    condition_variable ready;  // a block has been read (or a read failed)
+    condition_variable room;   // a block has been handed back, so another read may start
+
+    void work() {
+        unique_lock<mutex> guard(this->lock);
+        while (true) {
+            this->room.wait(guard, [this] {
+                return this->stopping || !this->error.empty() || this->started == this->block_ids.size() ||
+                       this->completed.size() + this->in_flight < this->depth;
+            });
+            if (this->stopping || !this->error.empty() || this->started == this->block_ids.size())
+                return;
+            BlockID block_id = this->block_ids[this->started++];
+            this->in_flight++;
+            guard.unlock();
+
+            std::vector<char> buffer(this->block_size);
+            bool ok = read_block(this->fd, block_id, buffer.data(), this->block_size);
+            string message = ok ? "" : read_error(block_id, this->name);
+
+            guard.lock();
+            this->in_flight--;
+            if (ok)
+                this->completed.push_back(make_pair(block_id, std::move(buffer)));
+            else if (this->error.empty())
+                this->error = message;
+            this->ready.notify_one();
+        }
+    }
+};
+
+PageFile::PageFile(std::string name, u32 block_size, u32 io_depth) : name(name), block_size(block_size),
+                                                                     io_depth(io_depth), last(0), fd(-1) {
+}
+
+string PageFile::path(std::string name) {
+    const char *home = nullptr;
+    if (_DB_ENV != nullptr)
+        _DB_ENV->get_home(&home);
+    return (home == nullptr ? "" : string(home) + "/") + file_name(name);
+}
+
+void PageFile::create() {
+    this->file_open(O_RDWR | O_CREAT | O_EXCL);
+}
+
+void PageFile::open() {
+    if (!this->is_open())
+        this->file_open(O_RDWR);
+}
+
+void PageFile::close() {
+    if (this->fd < 0)
+        return;
+    ::close(this->fd);
+    this->fd = -1;
+}
+
+void PageFile::drop() {
+    this->close();
+    if (::unlink(path(this->name).c_str()) != 0)
+        throw DbRelationError("could not remove " + file_name(this->name) + ": " + strerror(errno));
+}
+
+void PageFile::read(BlockID block_id, char *buffer) {
+    if (block_id == 0 || !read_block(this->fd, block_id, buffer, this->block_size))
+        throw DbRelationError(read_error(block_id, this->name));
+}
+
+void PageFile::write(BlockID block_id, const char *buffer) {
+    off_t offset = (off_t) (block_id - 1) * this->block_size;
+    u32 done = 0;
+    while (done < this->block_size) {
+        ssize_t n = ::pwrite(this->fd, buffer + done, this->block_size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw DbRelationError("could not write block " + to_string(block_id) + " of " + file_name(this->name) +
+                                  ": " + strerror(errno));
+        done += (u32) n;
+    }
+    if (block_id > this->last)
+        this->last = block_id;
+
+    string file_path = path(this->name);
+    lock_guard<mutex> guard(written_lock);
+    if (written.find(file_path) == written.end()) {
+        int fd = ::dup(this->fd);
+        if (fd < 0)
+            throw DbRelationError("could not write block " + to_string(block_id) + " of " + file_name(this->name) +
+                                  ": " + strerror(errno));
+        written[file_path] = fd;
+    }
+}
+
+// Writes made while this runs are either in the sync or left for the next one.
+bool PageFile::sync_written() {
+    map<string, int> to_sync;
+    {
+        lock_guard<mutex> guard(written_lock);
+        to_sync.swap(written);
+    }
+    bool ok = true;
+    for (auto const &file: to_sync) {
+        if (::fdatasync(file.second) != 0)
+            ok = false;
+        ::close(file.second);
+    }
+    return ok;
+}
+
+// io_uring is tried first; if the kernel won't set up a ring, threads do the reads instead from then on.
+PageReads *PageFile::read_async(const BlockIDs &block_ids) {
+#ifdef HAVE_IO_URING
+    if (uring_allowed && !uring_unavailable) {
+        UringReads *reads = new UringReads(this->fd, this->name, this->block_size, block_ids, this->io_depth);
+        if (reads->start())
+            return reads;
+        delete reads;
+        uring_unavailable = true;
+    }
+#endif
+    return new ThreadPoolReads(this->fd, this->name, this->block_size, block_ids, this->io_depth);
+}
+
+void PageFile::set_io_uring(bool allowed) {
+    uring_allowed = allowed;
+}
+
+BlockID PageFile::get_block_count() {
+    struct stat status;
+    if (::fstat(this->fd, &status) != 0)
+        throw DbRelationError("could not stat " + file_name(this->name) + ": " + strerror(errno));
+    return (BlockID) (status.st_size / this->block_size);
+}
+
+void PageFile::file_open(int flags) {
+    this->fd = ::open(path(this->name).c_str(), flags | O_CLOEXEC, 0644);
+    if (this->fd < 0)
+        throw DbRelationError("could not open " + file_name(this->name) + ": " + strerror(errno));
+    this->last = (flags & O_CREAT) ? 0 : this->get_block_count();
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class PageReads - blocks of a PageFile being read in the background, handed back in the order the reads
+ * complete rather than the order they were asked for.
+ *
+ * Up to the file's io_depth reads are kept outstanding at once; more are started as earlier ones are handed back.
+ * Reads are done with io_uring where the kernel allows it, and otherwise by a small pool of threads doing pread.
+ * Destroying the object before every block has been handed back waits for the reads in flight and drops the rest.
+ */
+class PageReads {
+public:
+    virtual ~PageReads() {}
+
+    /**
+     * Wait for the next read to complete.
+     * @param block_id  set to the block that was read
+     * @param block     replaced with its block_size bytes
+     * @returns         false once every block has been handed back
+     * @throws          DbRelationError if a read fails
+     */
+    virtual bool next(BlockID &block_id, std::vector<char> &block) = 0;
+};
+
+/**
+ * @class PageFile - a plain file of fixed-size blocks, read and written with pread/pwrite rather than through
+ * Berkeley DB. Block n is at offset (n - 1) * block_size.
+ *
+ * Used as the storage backend for heap files created with storage = pagefile. There is no buffer pool of our own:
+ * the operating system's page cache does that job. What it buys over a RecNo file is that a scan can have many
+ * reads outstanding at once (see PageReads), instead of stalling on each cache miss in turn.
+ *
+ * Page files aren't in Berkeley DB's log. Instead, the files written to are synced whenever the log is flushed
+ * for a commit (see sync_written), so a committed change to one survives a crash like any other.
+ */
+class PageFile {
+public:
+    static const u32 DEFAULT_IO_DEPTH = 32;
+    static const u32 MAX_IO_DEPTH = 1024;
+
+    /**
+     * @param name        name of the heap file this is the backend for
+     * @param block_size  size of the blocks
+     * @param io_depth    most reads to keep outstanding during read_async
+     */
+    PageFile(std::string name, u32 block_size, u32 io_depth = DEFAULT_IO_DEPTH);
+
+    /**
+     * Name of the file holding the blocks of the given heap file.
+     */
+    static std::string file_name(std::string name) { return name + ".pages"; }
+
+    /**
+     * Path of the file holding the blocks of the given heap file (in the Berkeley DB environment's home).
+     */
+    static std::string path(std::string name);
+
+    virtual ~PageFile() { close(); }
+
+    PageFile(const PageFile &other) = delete;
+
+    PageFile &operator=(const PageFile &other) = delete;
+
+    /**
+     * Create the (empty) file. Fails if it already exists.
+     */
+    virtual void create();
+
+    virtual void open();
+
+    virtual void close();
+
+    /**
+     * Remove the file (closing it first if necessary).
+     */
+    virtual void drop();
+
+    /**
+     * Read a block.
+     * @param block_id  which block to read
+     * @param buffer    receives block_size bytes
+     */
+    virtual void read(BlockID block_id, char *buffer);
+
+    /**
+     * Write a block (extending the file if block_id is past the end).
+     * @param block_id  which block to write
+     * @param buffer    block_size bytes to write
+     */
+    virtual void write(BlockID block_id, const char *buffer);
+
+    /**
+     * Start reading the given blocks in the background.
+     * @param block_ids  blocks to read; the file must stay open until the returned reads are deleted
+     * @returns          the reads in progress (caller deletes)
+     */
+    virtual PageReads *read_async(const BlockIDs &block_ids);
+
+    /**
+     * Whether read_async may use io_uring (the default) or is to use its pool of threads regardless.
+     */
+    static void set_io_uring(bool allowed);
+
+    /**
+     * Number of blocks in the file, as it is on disk now (other processes may have extended it).
+     */
+    virtual BlockID get_block_count();
+
+    virtual BlockID get_last_block_id() const { return last; }
+
+    virtual u32 get_io_depth() const { return io_depth; }
+
+    /**
+     * Flush the blocks written to every page file since the last call to disk (fdatasync), so that they are as
+     * durable as the log. Called by whoever flushes the log, before reporting the commits in it durable.
+     * @returns  false if any of them couldn't be flushed
+     */
+    static bool sync_written();
+
+    bool is_open() const { return fd >= 0; }
+
+protected:
+    std::string name;
+    u32 block_size;
+    u32 io_depth;
+    BlockID last;
+    int fd;
+
+    virtual void file_open(int flags);
+};
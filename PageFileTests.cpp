@@ -0,0 +1,94 @@
+#include "PageFileTests.h"
+#include "PageFile.h"
+#include "HeapFile.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace PageFileTests{
+    static const u32 BLOCK_SIZE = 4096;
+    static const BlockID BLOCKS = 200;
+
+    // each block is filled with its own id
+    static bool holds(const vector<char> &block, BlockID block_id){
+        for(u32 offset = 0; offset < BLOCK_SIZE; offset += sizeof(BlockID))
+            if(memcmp(&block[offset], &block_id, sizeof(BlockID)) != 0)
+                return false;
+        return true;
+    }
+
+    // every block asked for comes back once, whole, whether io_uring or the thread pool did the reads
+    void testReadAsync(){
+        cout << "Testing page file reads" << endl;
+        PageFile file("_test_pages", BLOCK_SIZE, 8);
+        file.create();
+        vector<char> buffer(BLOCK_SIZE);
+        for(BlockID block_id = 1; block_id <= BLOCKS; block_id++){
+            for(u32 offset = 0; offset < BLOCK_SIZE; offset += sizeof(BlockID))
+                memcpy(&buffer[offset], &block_id, sizeof(BlockID));
+            file.write(block_id, buffer.data());
+        }
+        BlockIDs blockIds;
+        for(BlockID block_id = BLOCKS; block_id > 0; block_id -= 2)
+            blockIds.push_back(block_id);
+        string problem;
+        for(bool uring : {true, false}){
+            PageFile::set_io_uring(uring);
+            PageReads *reads = file.read_async(blockIds);
+            BlockIDs seen;
+            BlockID block_id;
+            while(problem.empty() && reads->next(block_id, buffer)){
+                seen.push_back(block_id);
+                if(!holds(buffer, block_id))
+                    problem = "block " + to_string(block_id) + " didn't read back as written";
+            }
+            delete reads;
+            sort(seen.begin(), seen.end());
+            BlockIDs expected = blockIds;
+            sort(expected.begin(), expected.end());
+            if(problem.empty() && seen != expected)
+                problem = "read " + to_string(seen.size()) + " blocks of " + to_string(expected.size());
+            if(!problem.empty())
+                problem += uring ? " (io_uring)" : " (thread pool)";
+        }
+        PageFile::set_io_uring(true);
+        file.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // a heap file kept in a page file hands every block to get_blocks, records intact
+    void testGetBlocks(){
+        cout << "Testing page file heap files" << endl;
+        HeapFile file("_test_pages", BLOCK_SIZE, false, 4);
+        file.create();
+        for(BlockID block_id = 1; block_id <= BLOCKS; block_id++){
+            SlottedPage *block = block_id == 1 ? file.get(1) : file.get_new();
+            string record = "block " + to_string(block->get_block_id());
+            Dbt data((void *) record.c_str(), (u_int32_t) record.size() + 1);
+            block->add(&data);
+            file.put(block);
+            delete block;
+        }
+        BlockIDs *blockIds = file.block_ids();
+        u32 delivered = 0, intact = 0;
+        file.get_blocks(*blockIds, [&](SlottedPage *block){
+            Dbt *data = block->get(1);
+            if(data != nullptr && string((const char *) data->get_data()) == "block " + to_string(block->get_block_id()))
+                intact++;
+            delete data;
+            delivered++;
+        });
+        delete blockIds;
+        file.drop();
+        if(delivered != BLOCKS || intact != BLOCKS)
+            throw DbRelationError("get_blocks delivered " + to_string(delivered) + " blocks of " + to_string(BLOCKS) +
+                                  ", " + to_string(intact) + " intact");
+    }
+
+    void testAll(){
+        testReadAsync();
+        testGetBlocks();
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+namespace PageFileTests{
+    void testReadAsync();
+    void testGetBlocks();
+    void testAll();
+}
@@ -0,0 +1,174 @@
+#include "PaxPage.h"
+#include <cstring>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+static u16 get_u16(const char *address) {
+    u16 n;
+    memcpy(&n, address, sizeof(n));
+    return n;
+}
+
+static void put_u16(char *address, u16 n) {
+    memcpy(address, &n, sizeof(n));
+}
+
+PaxPage::PaxPage(const ColumnAttributes &column_attributes, std::vector<char> &&bytes, bool is_new) : bytes(
+        std::move(bytes)) {
+    for (auto ca: column_attributes)
+        this->data_types.push_back(ca.get_data_type());
+    if (is_new) {
+        memset(this->bytes.data(), 0, this->bytes.size());
+        this->num_rows = 0;
+        put_n(0, 0);
+        vector<u32> offsets;
+        layout(0, vector<u32>(this->data_types.size(), 0), offsets);
+        for (uint col = 0; col < this->data_types.size(); col++)
+            put_n(directory(col), (u16) offsets[col]);
+    } else {
+        this->num_rows = get_n(0);
+    }
+}
+
+// The page is laid out afresh with room for the new row in every minipage. Pages are small enough that
+// shuffling the minipages along costs little next to fetching and storing the block.
+bool PaxPage::add(const std::vector<Value> &row, RecordID &id) {
+    if (this->num_rows == UINT16_MAX)
+        return false;
+    u16 n_rows = this->num_rows + 1;
+    vector<u32> lengths;
+    for (uint col = 0; col < this->data_types.size(); col++) {
+        if (this->data_types[col] == ColumnAttribute::INT)
+            lengths.push_back(sizeof(int32_t) * n_rows);
+        else if (this->data_types[col] == ColumnAttribute::BOOLEAN)
+            lengths.push_back(n_rows);
+        else
+            lengths.push_back(get_n(directory(col) + 2) + sizeof(u16) + (u32) row[col].s.size());
+    }
+    vector<u32> offsets;
+    if (layout(n_rows, lengths, offsets) > this->bytes.size())
+        return false;
+
+    vector<char> page(this->bytes.size(), 0);
+    char *to = page.data();
+    const char *from = this->bytes.data();
+    put_u16(to, n_rows);
+    memcpy(to + bitmap(), from + bitmap(), (this->num_rows + 7) / 8);
+    for (uint col = 0; col < this->data_types.size(); col++) {
+        char *dest = to + offsets[col];
+        const char *source = from + get_n(directory(col));
+        const Value &value = row[col];
+        if (this->data_types[col] == ColumnAttribute::INT) {
+            memcpy(dest, source, sizeof(int32_t) * this->num_rows);
+            memcpy(dest + sizeof(int32_t) * this->num_rows, &value.n, sizeof(int32_t));
+        } else if (this->data_types[col] == ColumnAttribute::BOOLEAN) {
+            memcpy(dest, source, this->num_rows);
+            dest[this->num_rows] = (char) (value.n != 0);
+        } else {
+            u32 text_size = get_n(directory(col) + 2) - sizeof(u16) * this->num_rows;
+            memcpy(dest, source, sizeof(u16) * this->num_rows);
+            put_u16(dest + sizeof(u16) * this->num_rows, (u16) (text_size + value.s.size()));
+            memcpy(dest + sizeof(u16) * n_rows, source + sizeof(u16) * this->num_rows, text_size);
+            memcpy(dest + sizeof(u16) * n_rows + text_size, value.s.data(), value.s.size());
+        }
+
+        u16 min_row = 0, max_row = 0;
+        if (this->num_rows > 0) {
+            min_row = value < get_min(col) ? this->num_rows : get_n(directory(col) + 4);
+            max_row = get_max(col) < value ? this->num_rows : get_n(directory(col) + 6);
+        }
+        put_u16(to + directory(col), (u16) offsets[col]);
+        put_u16(to + directory(col) + 2, (u16) lengths[col]);
+        put_u16(to + directory(col) + 4, min_row);
+        put_u16(to + directory(col) + 6, max_row);
+    }
+    this->bytes.swap(page);
+    this->num_rows = n_rows;
+    id = n_rows;
+    return true;
+}
+
+void PaxPage::del(RecordID id) {
+    if (id == 0 || id > this->num_rows)
+        return;
+    this->bytes[bitmap() + (id - 1) / 8] |= (char) (1 << ((id - 1) % 8));
+}
+
+void PaxPage::undel(RecordID id) {
+    if (id == 0 || id > this->num_rows)
+        return;
+    this->bytes[bitmap() + (id - 1) / 8] &= (char) ~(1 << ((id - 1) % 8));
+}
+
+bool PaxPage::is_deleted(RecordID id) const {
+    if (id == 0 || id > this->num_rows)
+        return true;
+    return (this->bytes[bitmap() + (id - 1) / 8] & (1 << ((id - 1) % 8))) != 0;
+}
+
+Value PaxPage::get(RecordID id, uint col) const {
+    u32 index = id - 1;
+    const char *minipage = this->bytes.data() + get_n(directory(col));
+    Value value;
+    value.data_type = this->data_types[col];
+    if (value.data_type == ColumnAttribute::INT) {
+        memcpy(&value.n, minipage + sizeof(int32_t) * index, sizeof(int32_t));
+    } else if (value.data_type == ColumnAttribute::BOOLEAN) {
+        value.n = (u_int8_t) minipage[index];
+    } else {
+        u32 start = index == 0 ? 0 : get_u16(minipage + sizeof(u16) * (index - 1));
+        u32 end = get_u16(minipage + sizeof(u16) * index);
+        value.s = string(minipage + sizeof(u16) * this->num_rows + start, end - start);
+    }
+    return value;
+}
+
+// Written a column at a time over the minipage so the compiler can vectorize the INT and BOOLEAN loops.
+void PaxPage::match(uint col, const Value &value, std::vector<char> &selected) const {
+    const char *minipage = this->bytes.data() + get_n(directory(col));
+    if (value.data_type != this->data_types[col]) {
+        fill(selected.begin(), selected.end(), 0);
+    } else if (value.data_type == ColumnAttribute::INT) {
+        const int32_t *values = (const int32_t *) minipage;  // the layout keeps INT minipages aligned
+        int32_t wanted = value.n;
+        for (u32 i = 0; i < this->num_rows; i++)
+            selected[i] &= (char) (values[i] == wanted);
+    } else if (value.data_type == ColumnAttribute::BOOLEAN) {
+        char wanted = (char) (value.n != 0);
+        for (u32 i = 0; i < this->num_rows; i++)
+            selected[i] &= (char) (minipage[i] == wanted);
+    } else {
+        const char *text = minipage + sizeof(u16) * this->num_rows;
+        u32 start = 0;
+        for (u32 i = 0; i < this->num_rows; i++) {
+            u32 end = get_u16(minipage + sizeof(u16) * i);
+            if (selected[i])
+                selected[i] = (char) (end - start == value.s.size() &&
+                                      memcmp(text + start, value.s.data(), value.s.size()) == 0);
+            start = end;
+        }
+    }
+}
+
+// Work out where each minipage goes for a page of n_rows rows. Returns the number of bytes used.
+u32 PaxPage::layout(u16 n_rows, const std::vector<u32> &lengths, std::vector<u32> &offsets) const {
+    u32 offset = bitmap() + (n_rows + 7) / 8;
+    offsets.clear();
+    for (uint col = 0; col < this->data_types.size(); col++) {
+        if (this->data_types[col] == ColumnAttribute::INT)
+            offset = (offset + 3) & ~3U;
+        offsets.push_back(offset);
+        offset += lengths[col];
+    }
+    return offset;
+}
+
+u16 PaxPage::get_n(u32 offset) const {
+    return get_u16(this->bytes.data() + offset);
+}
+
+void PaxPage::put_n(u32 offset, u16 n) {
+    put_u16(this->bytes.data() + offset, n);
+}
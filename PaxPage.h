@@ -0,0 +1,105 @@
+#pragma once
+
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class PaxPage - a block of a columnar table, with its rows stored column by column (PAX layout).
+ *
+ *      Rows are stored in a minipage per column, so reading one column of every row in the block only touches
+ *      that column's bytes, and INT columns are plain arrays that can be scanned in a tight loop.
+ *          Bytes 0x00 - 0x01: number of rows (deleted ones included)
+ *          Then a directory entry for each column:
+ *              2 bytes: offset to the column's minipage
+ *              2 bytes: length of the minipage
+ *              2 bytes: row number holding the column's smallest value
+ *              2 bytes: row number holding the column's largest value
+ *          Then a bitmap of deleted rows, one bit per row
+ *          Then the minipages, one per column:
+ *              INT      4-byte values (4-byte aligned)
+ *              BOOLEAN  1-byte values
+ *              TEXT     2-byte offsets to the end of each value, then the values' bytes
+ *      Row ids are handed out sequentially starting with 1. Deleted rows keep their values, so the min/max rows
+ *      stay good (if a little loose) without having to be recomputed.
+ */
+class PaxPage {
+public:
+    static const u32 DIRECTORY_ENTRY_SZ = 8;
+
+    /**
+     * @param column_attributes  the table's column types
+     * @param bytes              the block (block size bytes)
+     * @param is_new             true to start an empty page rather than use what's in bytes
+     */
+    PaxPage(const ColumnAttributes &column_attributes, std::vector<char> &&bytes, bool is_new);
+
+    virtual ~PaxPage() {}
+
+    PaxPage(const PaxPage &other) = delete;
+
+    PaxPage &operator=(const PaxPage &other) = delete;
+
+    /**
+     * Add a row.
+     * @param row  one value per column, in column order
+     * @param id   set to the new row's id
+     * @returns    false if there isn't room for the row (the page is unchanged)
+     */
+    virtual bool add(const std::vector<Value> &row, RecordID &id);
+
+    virtual void del(RecordID id);
+
+    /**
+     * Bring back a deleted row (its values are still there).
+     */
+    virtual void undel(RecordID id);
+
+    virtual bool is_deleted(RecordID id) const;
+
+    /**
+     * Number of rows ever added to the page (deleted ones included).
+     */
+    virtual RecordID get_row_count() const { return num_rows; }
+
+    /**
+     * Get one column of a row.
+     */
+    virtual Value get(RecordID id, uint col) const;
+
+    /**
+     * Smallest value in a column of a non-empty page (possibly from a deleted row).
+     */
+    virtual Value get_min(uint col) const { return get(get_n(directory(col) + 4) + 1, col); }
+
+    /**
+     * Largest value in a column of a non-empty page (possibly from a deleted row).
+     */
+    virtual Value get_max(uint col) const { return get(get_n(directory(col) + 6) + 1, col); }
+
+    /**
+     * Clear selected[i] for each row i + 1 whose value in the given column isn't value.
+     * @param col       which column to check
+     * @param value     the value wanted
+     * @param selected  one entry per row in the page
+     */
+    virtual void match(uint col, const Value &value, std::vector<char> &selected) const;
+
+    virtual const char *get_data() const { return bytes.data(); }
+
+protected:
+    std::vector<ColumnAttribute::DataType> data_types;
+    std::vector<char> bytes;
+    u16 num_rows;
+
+    u32 directory(uint col) const { return sizeof(u16) + col * DIRECTORY_ENTRY_SZ; }
+
+    u32 bitmap() const { return directory((uint) data_types.size()); }
+
+    virtual u32 layout(u16 n_rows, const std::vector<u32> &lengths, std::vector<u32> &offsets) const;
+
+    u16 get_n(u32 offset) const;
+
+    void put_n(u32 offset, u16 n);
+};
@@ -0,0 +1,143 @@
+#include "Prefetcher.h"
+#include <algorithm>
+#include <vector>
+#include "db_cxx.h"
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+Prefetcher::Prefetcher(DbHandlePool &handles, u32 block_size, bool compressed)
+        : handles(handles), block_size(block_size), compressed(compressed), running(false), first(0),
+          last(0), consumed_count(0), fetched_count(0), window(MIN_WINDOW), max_window(MIN_WINDOW), interval(0),
+          held(false), fetching(false), stopping(false) {
+}
+
+void Prefetcher::start(const BlockIDs &upcoming) {
+    this->stop();
+    this->plan = upcoming;
+    this->first = 1;
+    this->last = 0;
+    this->launch();
+}
+
+void Prefetcher::start(BlockID first, BlockID last) {
+    this->stop();
+    this->plan.clear();
+    this->first = first;
+    this->last = last;
+    this->launch();
+}
+
+// The window is however many blocks the scan gets through in LEAD_TIME at the rate it has been going.
+void Prefetcher::consumed(BlockID block_id) {
+    if (!this->running)
+        return;
+    lock_guard<mutex> guard(this->lock);
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (this->consumed_count > 0) {
+        double elapsed = chrono::duration<double>(now - this->last_consumed).count();
+        this->interval = this->interval == 0 ? elapsed : 0.875 * this->interval + 0.125 * elapsed;
+        double wanted = this->interval > 0 ? LEAD_TIME / this->interval : this->max_window;
+        this->window = (u32) max((double) MIN_WINDOW, min(wanted, (double) this->max_window));
+    }
+    this->last_consumed = now;
+
+    if (!this->plan.empty()) {
+        if (this->consumed_count < this->plan.size() && this->plan[this->consumed_count] == block_id)
+            this->consumed_count++;
+    } else if (block_id >= this->first && block_id <= this->last) {
+        this->consumed_count = block_id - this->first + 1;
+    }
+    // no point fetching what the scan has already read for itself
+    this->fetched_count = max(this->fetched_count, this->consumed_count);
+    this->held = false;
+    this->changed.notify_all();
+}
+
+void Prefetcher::hold() {
+    if (!this->running)
+        return;
+    unique_lock<mutex> guard(this->lock);
+    this->held = true;
+    this->changed.wait(guard, [this] { return !this->fetching; });
+}
+
+void Prefetcher::stop() {
+    if (!this->running)
+        return;
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->stopping = true;
+    }
+    this->changed.notify_all();
+    this->worker.join();
+    this->running = false;
+}
+
+u32 Prefetcher::get_window() {
+    lock_guard<mutex> guard(this->lock);
+    return this->window;
+}
+
+// A quarter of the cache is as much as we want to fill ahead of the scan.
+void Prefetcher::launch() {
+    u_int32_t gbytes = 0, bytes = 0;
+    int ncache = 0;
+    _DB_ENV->get_cachesize(&gbytes, &bytes, &ncache);
+    u_int64_t cache_blocks = (((u_int64_t) gbytes << 30) + bytes) / this->block_size;
+    this->max_window = (u32) max((u_int64_t) MIN_WINDOW, min(cache_blocks / 4, (u_int64_t) MAX_WINDOW));
+
+    this->consumed_count = this->fetched_count = 0;
+    this->window = MIN_WINDOW;
+    this->interval = 0;
+    this->held = this->fetching = this->stopping = false;
+    this->running = true;
+    this->worker = thread(&Prefetcher::work, this);
+}
+
+size_t Prefetcher::plan_size() const {
+    if (!this->plan.empty())
+        return this->plan.size();
+    return this->last >= this->first ? (size_t) (this->last - this->first + 1) : 0;
+}
+
+BlockID Prefetcher::planned(size_t i) const {
+    return this->plan.empty() ? this->first + (BlockID) i : this->plan[i];
+}
+
+// Reading a record leaves its pages in the shared cache, which is all we're after; the record itself is read
+// into the same buffer every time and thrown away.
+void Prefetcher::work() {
+    try {
+        DbHandlePool::Lease db(this->handles);
+        vector<char> record(this->compressed ? this->block_size + 1 : this->block_size);
+
+        unique_lock<mutex> guard(this->lock);
+        while (true) {
+            this->changed.wait(guard, [this] {
+                return this->stopping || (!this->held && this->fetched_count < this->plan_size() &&
+                                          this->fetched_count < this->consumed_count + this->window);
+            });
+            if (this->stopping)
+                break;
+            BlockID block_id = this->planned(this->fetched_count++);
+            this->fetching = true;
+            guard.unlock();
+            Dbt key(&block_id, sizeof(block_id)), data(record.data(), (u32) record.size());
+            data.set_ulen((u32) record.size());
+            data.set_flags(DB_DBT_USERMEM);
+            db->get(nullptr, &key, &data, 0);
+            guard.lock();
+            this->fetching = false;
+            this->changed.notify_all();
+        }
+    } catch (...) {
+        // prefetching is only a hint: the scan reads every block for itself anyway
+    }
+    {
+        lock_guard<mutex> guard(this->lock);
+        this->fetching = false;
+    }
+    this->changed.notify_all();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "storage_engine.h"
+#include "DbHandlePool.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class Prefetcher - reads the blocks a scan of a heap file is about to want into Berkeley DB's buffer pool on a
+ * background thread, so the scan finds them already cached instead of waiting on each read in turn.
+ *
+ * A prefetch is started either with the list of blocks a scan is going to read (HeapFile::get_blocks knows it),
+ * or with a range once HeapFile notices gets walking through the file in order. The thread keeps a window of
+ * blocks fetched ahead of the last one the scan reported consuming. The window is sized from the rate the scan
+ * consumes blocks (enough for LEAD_TIME of it), between MIN_WINDOW and a quarter of the cache, so that blocks
+ * aren't pushed out of the cache again before the scan gets to them.
+ *
+ * The thread reads through a handle borrowed from the file's DbHandlePool, one no other thread is using. It must
+ * not read while the file is being written, so writers call hold() first.
+ */
+class Prefetcher {
+public:
+    static const u32 MIN_WINDOW = 8;
+    static const u32 MAX_WINDOW = 1024;
+    static constexpr double LEAD_TIME = 0.05;  // seconds of consumption to keep fetched ahead
+
+    /**
+     * @param handles     on the heap file's Berkeley DB file
+     * @param block_size  size of its blocks
+     * @param compressed  whether its records vary in length (see HeapFile)
+     */
+    Prefetcher(DbHandlePool &handles, u32 block_size, bool compressed);
+
+    virtual ~Prefetcher() { stop(); }
+
+    Prefetcher(const Prefetcher &other) = delete;
+
+    Prefetcher &operator=(const Prefetcher &other) = delete;
+
+    /**
+     * Start prefetching the given blocks, in order (stopping any prefetch already going).
+     */
+    virtual void start(const BlockIDs &upcoming);
+
+    /**
+     * Start prefetching the blocks from first to last, in order (stopping any prefetch already going).
+     */
+    virtual void start(BlockID first, BlockID last);
+
+    /**
+     * Tell the prefetcher the scan has read a block (letting it move on, if it was held).
+     */
+    virtual void consumed(BlockID block_id);
+
+    /**
+     * Keep the thread from reading until the next call to consumed. Returns once any read under way is done.
+     */
+    virtual void hold();
+
+    /**
+     * Stop prefetching, waiting for the thread to finish with the file.
+     */
+    virtual void stop();
+
+    bool is_running() const { return running; }
+
+    /**
+     * Blocks the prefetcher is currently trying to stay ahead of the scan by.
+     */
+    virtual u32 get_window();
+
+protected:
+    DbHandlePool &handles;
+    u32 block_size;
+    bool compressed;
+    bool running;
+    BlockIDs plan;          // blocks to fetch, in order; if empty, the range first..last instead
+    BlockID first, last;
+    size_t consumed_count;  // how far through the plan the scan is
+    size_t fetched_count;   // how far through it the thread is
+    u32 window;
+    u32 max_window;
+    double interval;        // average seconds between blocks consumed
+    std::chrono::steady_clock::time_point last_consumed;
+    bool held, fetching, stopping;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable changed;
+
+    void launch();
+    size_t plan_size() const;
+    BlockID planned(size_t i) const;
+    void work();
+};
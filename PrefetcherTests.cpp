@@ -0,0 +1,88 @@
+#include "PrefetcherTests.h"
+#include "Prefetcher.h"
+#include "HeapTable.h"
+#include <thread>
+
+using namespace std;
+
+namespace PrefetcherTests{
+    // the window stays at its smallest for a slow scan, widens for a fast one, and stopping stops the thread
+    void testWindow(){
+        cout << "Testing prefetch window" << endl;
+        HeapFile file("_test_prefetch");
+        file.create();
+        for(BlockID block_id = 2; block_id <= 300; block_id++){
+            SlottedPage *block = file.get_new();
+            file.put(block);
+            delete block;
+        }
+        file.close();
+        DbHandlePool handles("_test_prefetch.db", DbBlock::BLOCK_SZ);
+        handles.open();
+        Prefetcher prefetcher(handles, DbBlock::BLOCK_SZ, false);
+        prefetcher.start(1, 300);
+        string problem;
+        if(!prefetcher.is_running())
+            problem = "the prefetcher didn't start";
+        BlockID block_id = 1;
+        for(; block_id <= 20; block_id++){
+            this_thread::sleep_for(chrono::milliseconds(10));
+            prefetcher.consumed(block_id);
+        }
+        u32 slow = prefetcher.get_window();
+        for(; block_id <= 300; block_id++)
+            prefetcher.consumed(block_id);
+        u32 fast = prefetcher.get_window();
+        if(problem.empty() && slow != Prefetcher::MIN_WINDOW)
+            problem = "a slow scan got a window of " + to_string(slow) + " blocks";
+        else if(problem.empty() && (fast < slow || fast > Prefetcher::MAX_WINDOW))
+            problem = "a fast scan got a window of " + to_string(fast) + " blocks";
+        prefetcher.stop();
+        if(problem.empty() && prefetcher.is_running())
+            problem = "the prefetcher didn't stop";
+        handles.close();
+        file.drop();
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // scans see what's written between them, with the prefetcher held off the file during the writes
+    void testScans(){
+        cout << "Testing prefetched scans" << endl;
+        ColumnNames columnNames = {"a", "b"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        HeapTable table("_test_prefetch", columnNames, columnAttributes);
+        table.create();
+        Handles handles;
+        ValueDict row;
+        for(int i = 0; i < 20000; i++){
+            row["a"] = Value(i);
+            row["b"] = Value(string(100, 'x'));
+            handles.push_back(table.insert(&row));
+        }
+        Handles *all = table.select();
+        size_t before = all->size();
+        delete all;
+        for(int i = 0; i < 20000; i += 2)
+            table.del(handles[i]);
+        all = table.select();
+        ValueDicts *rows = table.project(all);
+        int odd = 0;
+        for(auto const &projected : *rows){
+            if((*projected)["a"].n % 2 == 1)
+                odd++;
+            delete projected;
+        }
+        size_t after = all->size();
+        delete rows;
+        delete all;
+        table.drop();
+        if(before != 20000 || after != 10000 || odd != 10000)
+            throw DbRelationError("scans found " + to_string(before) + " and " + to_string(after) + " rows");
+    }
+
+    void testAll(){
+        testWindow();
+        testScans();
+    }
+}
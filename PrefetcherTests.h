@@ -0,0 +1,7 @@
+#pragma once
+
+namespace PrefetcherTests{
+    void testWindow();
+    void testScans();
+    void testAll();
+}
@@ -0,0 +1,103 @@
+#include "PreparedStatement.h"
+#include <algorithm>
+
+using namespace std;
+using namespace hsql;
+
+PreparedStatement::PreparedStatement(SQLParserResult *parse) : parse(parse) {
+    SQLStatement *statement = parse->getMutableStatement(0);
+    switch (statement->type()) {
+        case kStmtInsert: {
+            InsertStatement *insert = (InsertStatement *) statement;
+            if (insert->values != nullptr)
+                for (auto value: *insert->values)
+                    find_placeholders(value);
+            break;
+        }
+        case kStmtSelect: {
+            SelectStatement *select = (SelectStatement *) statement;
+            for (auto expr: *select->selectList)
+                find_placeholders(expr);
+            find_placeholders(select->fromTable);
+            find_placeholders(select->whereClause);
+            break;
+        }
+        default:
+            break;
+    }
+    // the parser numbers a placeholder by where it is in the text
+    vector<size_t> order(this->placeholders.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+        return this->placeholders[a]->ival < this->placeholders[b]->ival;
+    });
+    vector<Expr *> sorted;
+    for (auto i: order)
+        sorted.push_back(this->placeholders[i]);
+    this->placeholders = sorted;
+    for (auto placeholder: this->placeholders)
+        this->positions.push_back(placeholder->ival);
+    this->strings.resize(this->placeholders.size());
+}
+
+// The tree goes back to how the parser made it, so that freeing it doesn't free our strings.
+PreparedStatement::~PreparedStatement() {
+    unbind();
+    delete this->parse;
+}
+
+const SQLStatement *PreparedStatement::get_statement() const {
+    return this->parse->getStatement(0);
+}
+
+void PreparedStatement::bind(const vector<Value> &parameters) {
+    if (parameters.size() != this->placeholders.size())
+        throw DbRelationError("statement takes " + to_string(this->placeholders.size()) + " parameters, not " +
+                              to_string(parameters.size()));
+    for (size_t i = 0; i < parameters.size(); i++) {
+        Expr *placeholder = this->placeholders[i];
+        if (parameters[i].data_type == ColumnAttribute::TEXT) {
+            this->strings[i] = parameters[i].s;
+            placeholder->type = kExprLiteralString;
+            placeholder->name = (char *) this->strings[i].c_str();
+        } else {
+            placeholder->type = kExprLiteralInt;
+            placeholder->name = nullptr;
+            placeholder->ival = parameters[i].n;
+        }
+    }
+}
+
+void PreparedStatement::unbind() {
+    for (size_t i = 0; i < this->placeholders.size(); i++) {
+        this->placeholders[i]->type = kExprPlaceholder;
+        this->placeholders[i]->name = nullptr;
+        this->placeholders[i]->ival = this->positions[i];
+    }
+}
+
+void PreparedStatement::find_placeholders(Expr *expr) {
+    if (expr == nullptr)
+        return;
+    if (expr->type == kExprPlaceholder)
+        this->placeholders.push_back(expr);
+    find_placeholders(expr->expr);
+    find_placeholders(expr->expr2);
+    if (expr->exprList != nullptr)
+        for (auto item: *expr->exprList)
+            find_placeholders(item);
+}
+
+void PreparedStatement::find_placeholders(TableRef *table) {
+    if (table == nullptr)
+        return;
+    if (table->list != nullptr)
+        for (auto listed: *table->list)
+            find_placeholders(listed);
+    if (table->join != nullptr) {
+        find_placeholders(table->join->left);
+        find_placeholders(table->join->right);
+        find_placeholders(table->join->condition);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "SQLParser.h"
+#include "storage_engine.h"
+
+/**
+ * @class PreparedStatement - a statement parsed once, with '?' placeholders standing for values that are only
+ * supplied when it is run, e.g. INSERT INTO t VALUES (?, ?) or SELECT * FROM t WHERE id = ?
+ *
+ * Binding writes the values into the placeholders' places in the parse tree, which is then run like any other
+ * statement. Placeholders are numbered in the order they appear in the statement.
+ */
+class PreparedStatement {
+public:
+    /**
+     * @param parse  a successful parse of a single statement (taken over, and freed with this)
+     */
+    PreparedStatement(hsql::SQLParserResult *parse);
+
+    virtual ~PreparedStatement();
+
+    PreparedStatement(const PreparedStatement &other) = delete;
+
+    PreparedStatement &operator=(const PreparedStatement &other) = delete;
+
+    const hsql::SQLStatement *get_statement() const;
+
+    size_t get_parameter_count() const { return placeholders.size(); }
+
+    /**
+     * Fill in the placeholders (replacing any earlier values).
+     * @param parameters  a value for each placeholder, in order (INT or TEXT)
+     * @throws            DbRelationError if there are too many or too few
+     */
+    void bind(const std::vector<Value> &parameters);
+
+protected:
+    hsql::SQLParserResult *parse;
+    std::vector<hsql::Expr *> placeholders;
+    std::vector<int64_t> positions;    // each placeholder's original ival, put back before the tree is freed
+    std::vector<std::string> strings;  // the bound TEXT values, which the tree points into
+
+    void find_placeholders(hsql::Expr *expr);
+
+    void find_placeholders(hsql::TableRef *table);
+
+    void unbind();
+};
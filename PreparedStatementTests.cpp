@@ -0,0 +1,69 @@
+#include "PreparedStatementTests.h"
+#include "PreparedStatement.h"
+
+using namespace std;
+using namespace hsql;
+
+namespace PreparedStatementTests{
+    static PreparedStatement *prepare(const string &query){
+        SQLParserResult *parse = SQLParser::parseSQLString(query);
+        if(!parse->isValid() || parse->size() != 1){
+            delete parse;
+            throw DbRelationError("couldn't parse " + query);
+        }
+        return new PreparedStatement(parse);
+    }
+
+    static bool isInt(const Expr *expr, int64_t n){
+        return expr->type == kExprLiteralInt && expr->ival == n;
+    }
+
+    static bool isText(const Expr *expr, const string &s){
+        return expr->type == kExprLiteralString && expr->name != nullptr && s == expr->name;
+    }
+
+    // each bind replaces the last one's values in the parse tree, whichever type they were
+    void testRebinding(){
+        cout << "Testing prepared statement rebinding" << endl;
+        PreparedStatement *statement = prepare("SELECT * FROM t WHERE a = ? AND b = ?");
+        const Expr *where = ((const SelectStatement *) statement->get_statement())->whereClause;
+        string problem;
+        statement->bind({Value(1), Value("first")});
+        if(!isInt(where->expr->expr2, 1) || !isText(where->expr2->expr2, "first"))
+            problem = "the first values weren't bound";
+        statement->bind({Value("second"), Value(2)});
+        if(problem.empty() && (!isText(where->expr->expr2, "second") || !isInt(where->expr2->expr2, 2)))
+            problem = "rebinding didn't replace the first values";
+        delete statement;
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // placeholders are counted in the order they're written, and binding the wrong number of values is refused
+    void testParameterCount(){
+        cout << "Testing prepared statement parameters" << endl;
+        PreparedStatement *statement = prepare("INSERT INTO t VALUES (?, 5, ?)");
+        const InsertStatement *insert = (const InsertStatement *) statement->get_statement();
+        string problem;
+        if(statement->get_parameter_count() != 2)
+            problem = "counted " + to_string(statement->get_parameter_count()) + " parameters of 2";
+        statement->bind({Value(7), Value(9)});
+        if(problem.empty() && (!isInt(insert->values->at(0), 7) || !isInt(insert->values->at(1), 5) ||
+                               !isInt(insert->values->at(2), 9)))
+            problem = "the values went in the wrong places";
+        try{
+            statement->bind({Value(7)});
+            if(problem.empty())
+                problem = "binding too few values wasn't refused";
+        } catch(DbRelationError &e){
+        }
+        delete statement;
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testRebinding();
+        testParameterCount();
+    }
+}
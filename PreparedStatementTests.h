@@ -0,0 +1,7 @@
+#pragma once
+
+namespace PreparedStatementTests{
+    void testRebinding();
+    void testParameterCount();
+    void testAll();
+}
@@ -0,0 +1,90 @@
+#include "Protocol.h"
+#include <cerrno>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// write or read all of it, retrying after signals and short transfers
+static bool write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::recv(fd, data, size, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool Protocol::send_message(int fd, const string &message) {
+    if (message.size() > MAX_MESSAGE)
+        return false;
+    u_int32_t length = htonl((u_int32_t) message.size());
+    return write_all(fd, (const char *) &length, sizeof(length)) && write_all(fd, message.data(), message.size());
+}
+
+bool Protocol::receive_message(int fd, string &message) {
+    u_int32_t length;
+    if (!read_all(fd, (char *) &length, sizeof(length)))
+        return false;
+    length = ntohl(length);
+    if (length > MAX_MESSAGE)
+        return false;
+    message.resize(length);
+    return length == 0 || read_all(fd, &message[0], length);
+}
+
+int Protocol::connect_unix(const string &path) {
+    sockaddr_un address;
+    if (path.size() >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (::connect(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int Protocol::connect_tcp(u_int16_t port) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (::connect(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+
+/**
+ * The client/server wire protocol. Every message is a 4-byte length in network byte order followed by that many
+ * bytes. A client sends a command (one line of what the REPL accepts) and gets back one response, whose first
+ * byte is RESPONSE_OK or RESPONSE_ERROR and the rest the text the REPL would have printed.
+ */
+namespace Protocol {
+    const char RESPONSE_OK = '+';      // the text is the command's output
+    const char RESPONSE_ERROR = '-';   // the text includes error messages
+
+    const u_int32_t MAX_MESSAGE = 64 * 1024 * 1024;
+
+    /**
+     * Write a message to a socket.
+     * @returns  false if the connection is gone
+     */
+    bool send_message(int fd, const std::string &message);
+
+    /**
+     * Read a message from a socket.
+     * @returns  false at end of file, if the connection is gone, or if the length is over MAX_MESSAGE
+     */
+    bool receive_message(int fd, std::string &message);
+
+    /**
+     * Connect to a server listening on a Unix domain socket.
+     * @returns  the socket, or -1 (with errno set)
+     */
+    int connect_unix(const std::string &path);
+
+    /**
+     * Connect to a server listening on a localhost TCP port.
+     * @returns  the socket, or -1 (with errno set)
+     */
+    int connect_tcp(u_int16_t port);
+}
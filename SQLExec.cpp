@@ -10,6 +10,7 @@
 #include "storage_engine.h"
 #include "Transactions.h"
 #include <iostream>
+#include <set>
 
 using namespace std;
 using namespace hsql;
@@ -17,20 +18,23 @@ using namespace hsql;
 // define static data
 Tables *SQLExec::tables = nullptr;
 Indices *SQLExec::indices = nullptr;
-TransactionManager SQLExec::tm = TransactionManager();
+Statistics *SQLExec::statistics = nullptr;
+thread_local TransactionManager SQLExec::tm = TransactionManager();
+thread_local map<Identifier, PreparedStatement *> SQLExec::prepared;
+CatalogCache<Identifier, shared_ptr<const TableMetadata>> SQLExec::metadata;
 
 // make query result be printable
 ostream &operator<<(ostream &out, const QueryResult &qres) {
     if (qres.column_names != nullptr) {
         for (auto const &column_name: *qres.column_names)
             out << column_name << " ";
-        out << endl << "+";
+        out << '\n' << "+";
         for (unsigned int i = 0; i < qres.column_names->size(); i++)
             out << "----------+";
-        out << endl;
+        out << '\n';
         for (auto const &row: *qres.rows) {
             for (auto const &column_name: *qres.column_names) {
-                Value value = row->at(column_name);
+                const Value &value = row->at(column_name);
                 switch (value.data_type) {
                     case ColumnAttribute::INT:
                         out << value.n;
@@ -43,7 +47,7 @@ ostream &operator<<(ostream &out, const QueryResult &qres) {
                 }
                 out << " ";
             }
-            out << endl;
+            out << '\n';
         }
     }
     out << qres.message;
@@ -72,21 +76,25 @@ QueryResult::~QueryResult() {
  * @param statement the statement to be executed
  * @return QueryResult* the result of the statement
  */
-QueryResult *SQLExec::execute(const SQLStatement *statement) {
+QueryResult *SQLExec::execute(const SQLStatement *statement, const TableOptions *options) {
     // Initializes _tables table if not null
     if (SQLExec::tables == nullptr) {
         SQLExec::tables = new Tables();
         SQLExec::indices = new Indices();
+        SQLExec::statistics = new Statistics();
     }
 
     // initialize transaction manager
     // if(SQLExec::tm == nullptr)
     //     SQLExec::tm = TransactionManager();
-    
-    try {
+
+    // a statement that writes is logged as a transaction of its own, unless it's part of one already; every
+    // statement reads from a snapshot
+    bool writes = statement->type() != kStmtSelect && statement->type() != kStmtShow;
+    return runStatement(writes, [statement, options]() -> QueryResult * {
         switch (statement->type()) {
             case kStmtCreate:
-                return create((const CreateStatement *) statement);
+                return create((const CreateStatement *) statement, options);
             case kStmtDrop:
                 return drop((const DropStatement *) statement);
             case kStmtShow:
@@ -98,28 +106,187 @@ QueryResult *SQLExec::execute(const SQLStatement *statement) {
             default:
                 return new QueryResult("not implemented");
         }
+    });
+}
+
+QueryResult *SQLExec::explain(const SelectStatement *statement, ExplainMode mode) {
+    if (SQLExec::tables == nullptr) {
+        SQLExec::tables = new Tables();
+        SQLExec::indices = new Indices();
+        SQLExec::statistics = new Statistics();
+    }
+
+    return runStatement(false, [statement, mode]() { return select(statement, mode); });
+}
+
+QueryResult *SQLExec::prepare(const Identifier &name, const string &query) {
+    if (SQLExec::tables == nullptr) {
+        SQLExec::tables = new Tables();
+        SQLExec::indices = new Indices();
+        SQLExec::statistics = new Statistics();
+    }
+
+    SQLParserResult *parse = SQLParser::parseSQLString(query);
+    if (!parse->isValid() || parse->size() != 1) {
+        delete parse;
+        throw SQLExecError("Error: can only prepare a single valid statement: " + query);
+    }
+    const SQLStatement *statement = parse->getStatement(0);
+    if (statement->type() != kStmtInsert && statement->type() != kStmtSelect) {
+        delete parse;
+        throw SQLExecError("Error: only INSERT and SELECT statements can be prepared");
+    }
+    PreparedStatement *preparedStatement = new PreparedStatement(parse);
+
+    // look the tables up now, so that running it doesn't have to
+    try {
+        if (statement->type() == kStmtInsert) {
+            Identifier tableName = ((const InsertStatement *) statement)->tableName;
+            if (table_metadata(tableName)->column_names.empty())
+                throw SQLExecError("Error: table " + tableName + " does not exist");
+        } else {
+            vector<JoinInput> inputs;
+            vector<const Expr *> conditions;
+            join_inputs(((const SelectStatement *) statement)->fromTable, inputs, conditions);
+            for (auto const &input : inputs)
+                if (table_metadata(input.table_name)->column_names.empty())
+                    throw SQLExecError("Error: table " + input.table_name + " does not exist");
+        }
+    } catch (...) {
+        delete preparedStatement;
+        throw;
+    }
+
+    deallocate(name);
+    SQLExec::prepared[name] = preparedStatement;
+    return new QueryResult("prepared " + name + " (" + to_string(preparedStatement->get_parameter_count()) +
+                           " parameters)");
+}
+
+QueryResult *SQLExec::execute_prepared(const Identifier &name, const vector<Value> &parameters) {
+    auto found = SQLExec::prepared.find(name);
+    if (found == SQLExec::prepared.end())
+        throw SQLExecError("Error: no prepared statement " + name);
+    try {
+        found->second->bind(parameters);
+    } catch (DbRelationError &e) {
+        throw SQLExecError("Error: " + name + " " + e.what());
+    }
+    return execute(found->second->get_statement());
+}
+
+QueryResult *SQLExec::deallocate(const Identifier &name) {
+    auto found = SQLExec::prepared.find(name);
+    if (found == SQLExec::prepared.end())
+        return new QueryResult("no prepared statement " + name);
+    delete found->second;
+    SQLExec::prepared.erase(found);
+    return new QueryResult("deallocated " + name);
+}
+
+void SQLExec::wait_durable() {
+    try {
+        tm.wait_durable();
     } catch (DbRelationError &e) {
         throw SQLExecError(string("DbRelationError: ") + e.what());
     }
 }
 
+void SQLExec::end_session() {
+    while (!SQLExec::prepared.empty())
+        delete deallocate(SQLExec::prepared.begin()->first);
+    while (tm.getCurrentTransactionID() != -1)
+        tm.rollback_transaction();
+}
+
+shared_ptr<const TableMetadata> SQLExec::table_metadata(const Identifier &table_name) {
+    shared_ptr<const TableMetadata> cached;
+    if (SQLExec::metadata.get(table_name, cached))
+        return cached;
+
+    TableMetadata *tableMetadata = new TableMetadata();
+    shared_ptr<const TableMetadata> built(tableMetadata);
+    SQLExec::tables->get_columns(table_name, tableMetadata->column_names, tableMetadata->column_attributes);
+    if (tableMetadata->column_names.empty())
+        return built;  // not kept, so the table is noticed as soon as it's created
+    for (auto const &indexName : SQLExec::indices->get_index_names(table_name)) {
+        TableMetadata::Index index;
+        bool isHash;
+        index.name = indexName;
+        SQLExec::indices->get_columns(table_name, indexName, index.column_names, isHash, index.is_unique);
+        tableMetadata->indices.push_back(index);
+    }
+    tableMetadata->analyzed = SQLExec::statistics->get_statistics(table_name, tableMetadata->statistics);
+    auto *holder = new shared_ptr<const TableMetadata>(built);
+    if (SQLExec::metadata.insert(table_name, holder) != holder)
+        delete holder;  // another session cached it first; this copy is just as good for this statement
+    return built;
+}
+
+// Sessions still using what was cached keep their own references to it, so only the cache's go.
+void SQLExec::forget_metadata() {
+    SQLExec::metadata.retire(SQLExec::metadata.erase_if([](const Identifier &) { return true; }));
+}
+
+// EXPLAIN's result: a row per step of the plan, in a single column of text.
+static QueryResult *plan_result(const ExplainNode &plan) {
+    vector<string> lines;
+    plan.describe(lines);
+    ValueDicts *rows = new ValueDicts();
+    for (auto const &line: lines) {
+        ValueDict *row = new ValueDict();
+        (*row)["query_plan"] = Value(line);
+        rows->push_back(row);
+    }
+    return new QueryResult(new ColumnNames(1, "query_plan"),
+                           new ColumnAttributes(1, ColumnAttribute(ColumnAttribute::TEXT)), rows, SUCCESS_MESSAGE);
+}
+
 QueryResult *SQLExec::execute_transaction_command(const TransactionStatement *statement){
     switch(statement->type){
         case TransactionStatement::BEGIN:
-            tm.begin_transaction();
-            return new QueryResult("Successfully executed begin transaction");
+            return new QueryResult(tm.begin_transaction());
         case TransactionStatement::COMMIT:
-            tm.commit_transaction();
-            return new QueryResult("Successfully executed commit transaction");
+            return new QueryResult(tm.commit_transaction());
         case TransactionStatement::ROLLBACK:
-            tm.rollback_transaction();
-            return new QueryResult("Successfully executed rollback transaction");
+            try {
+                return new QueryResult(tm.rollback_transaction());
+            } catch (TransactionManagerError &e) {
+                throw SQLExecError(e.what());
+            }
         default:
             return new QueryResult("invalid transaction type");
     }
     return new QueryResult("invalid transaction type");
 }
 
+QueryResult *SQLExec::execute_utility_command(const UtilityStatement *statement){
+    if (SQLExec::tables == nullptr) {
+        SQLExec::tables = new Tables();
+        SQLExec::indices = new Indices();
+        SQLExec::statistics = new Statistics();
+    }
+
+    // these replace or remove a table's files, which ROLLBACK couldn't undo
+    if (statement->type != UtilityStatement::ANALYZE && tm.getCurrentTransactionID() != -1)
+        throw SQLExecError("Error: VACUUM, FREEZE and UNFREEZE cannot be used inside a transaction");
+
+    return runStatement(true, [statement]() -> QueryResult * {
+        switch(statement->type){
+            case UtilityStatement::VACUUM:
+                return vacuum(statement);
+            case UtilityStatement::ANALYZE:
+                return analyze(statement);
+            case UtilityStatement::FREEZE:
+                return freeze(statement);
+            case UtilityStatement::UNFREEZE:
+                return unfreeze(statement);
+            default:
+                return new QueryResult("invalid utility command");
+        }
+    });
+}
+
 /**
  * @brief Sets up the column definitions
  * 
@@ -145,12 +312,16 @@ void SQLExec::column_definition(const ColumnDefinition *col, Identifier &column_
  * @brief Executes a create statement
  * 
  * @param statement the create statement to be executed
+ * @param options storage options for CREATE TABLE (nullptr if none), recorded in _options
  * @return QueryResult* the result of the create statement
  */
-QueryResult *SQLExec::create(const CreateStatement *statement) {
-    // don't need transaction handling for create since it creates a new file, it doesn't 
-    // modify an existing one. 
-    // In case 2 transactions create the same table, HeapFile::create handles the case that
+QueryResult *SQLExec::create(const CreateStatement *statement, const TableOptions *options) {
+    if (options != nullptr && !options->empty() && statement->type != CreateStatement::kTable)
+        throw SQLExecError("storage options are only allowed on CREATE TABLE");
+    forget_metadata();
+
+    // the table created (or indexed) is locked exclusively, so nobody else can use it until the transaction
+    // ends. In case 2 transactions create the same table, HeapFile::create handles the case that
     // the table already exists 
 
     //check create type (future proofed for other types)
@@ -159,6 +330,9 @@ QueryResult *SQLExec::create(const CreateStatement *statement) {
         case CreateStatement::kTable: 
             { 
                 Identifier table_name = statement->tableName;
+                // the table's files are named "<table>.<what>" (see HeapTable)
+                if (table_name.find('.') != string::npos)
+                    throw SQLExecError("Error: table names can't contain '.'");
                 ColumnNames column_names;
                 ColumnAttributes column_attributes;
                 Identifier column_name;
@@ -168,6 +342,15 @@ QueryResult *SQLExec::create(const CreateStatement *statement) {
                     column_names.push_back(column_name);
                     column_attributes.push_back(column_attribute);
                 }
+                TableOptions table_options;
+                if (options != nullptr)
+                    table_options = *options;
+                if (ColumnarTable::is_columnar(table_options))
+                    ColumnarTable::validate_options(table_options);
+                else
+                    HeapTable::validate_options(table_options, column_names, column_attributes);
+
+                requestLock((SQLStatement*)statement, table_name);
 
                 // Add to schema: _tables and _columns
                 ValueDict row;
@@ -175,13 +358,22 @@ QueryResult *SQLExec::create(const CreateStatement *statement) {
                 Handle t_handle = SQLExec::tables->insert(&row);  // Insert into _tables
                 try {
                     Handles c_handles;
+                    Handles o_handles;
                     DbRelation &columns = SQLExec::tables->get_table(Columns::TABLE_NAME);
+                    DbRelation &options_table = SQLExec::tables->get_table(Options::TABLE_NAME);
                     try {
                         for (uint i = 0; i < column_names.size(); i++) {
                             row["column_name"] = column_names[i];
                             row["data_type"] = Value(column_attributes[i].get_data_type() == ColumnAttribute::INT ? "INT" : "TEXT");
                             c_handles.push_back(columns.insert(&row));  // Insert into _columns
                         }
+                        ValueDict option_row;
+                        option_row["table_name"] = table_name;
+                        for (auto const &option: table_options) {
+                            option_row["option_name"] = Value(option.first);
+                            option_row["option_value"] = Value(option.second);
+                            o_handles.push_back(options_table.insert(&option_row));  // Insert into _options
+                        }
 
                         // Finally, actually create the relation
                         DbRelation &table = SQLExec::tables->get_table(table_name);
@@ -191,10 +383,12 @@ QueryResult *SQLExec::create(const CreateStatement *statement) {
                             table.create();
 
                     } catch (...) {
-                        // attempt to remove from _columns
+                        // attempt to remove from _columns and _options
                         try {
                             for (auto const &handle: c_handles)
                                 columns.del(handle);
+                            for (auto const &handle: o_handles)
+                                options_table.del(handle);
                         } catch (...) {}
                         throw;
                     }
@@ -216,6 +410,7 @@ QueryResult *SQLExec::create(const CreateStatement *statement) {
                 Identifier table_name = statement->tableName;
 
                 // get underlying relation
+                requestLock((SQLStatement*)statement, table_name); // the index is part of its table
                 DbRelation &table = SQLExec::tables->get_table(table_name);
 
                 // check that given columns exist in table
@@ -258,34 +453,83 @@ QueryResult *SQLExec::create(const CreateStatement *statement) {
     return nullptr;
 }
 
-// If there's a transaction currently running, requests a lock on the table file.
-// Returns a pair of (file descriptor for the DB file for the table, ID of the current transaction)
-// so that releaseLock can use those. Returns a pair of (-1, -1) if there are no transactions running
-// @param stmt: a SQL statement that's inside the transaction
-// @param tableToAccess: table being read or written to by the statement
-pair<int, int> SQLExec::requestLock(SQLStatement* stmt, Identifier tableToAccess){
-    // check if there are transactions in the active transaction list
-    if(tm.getActiveTransactions().size() > 0){
-        int fd = tm.getFD(tableToAccess); // get FD for table
-        int currentTransID = tm.getCurrentTransactionID(); // transaction ID of this transaction
+// Runs a statement in a Berkeley DB transaction and a snapshot of its own, unless it's part of a transaction
+// already (see TransactionManager::begin_statement).
+// A statement that has to wait for a lock gives way instead (see LockManager), since the tables it's part way
+// through using aren't safe for other sessions to use meanwhile: what it has done so far is undone, it waits, and
+// then it runs again from the start, looking up afresh whatever it had looked up.
+QueryResult *SQLExec::runStatement(bool writes, const function<QueryResult *()> &run){
+    tm.begin_statement(writes);
+    try {
+        while(true){
+            try {
+                QueryResult *result = run();
+                tm.end_statement();
+                return result;
+            } catch (LockBusyError &e) {
+                tm.undo_statement();
+                LockManager::get().wait_for_lock(LockManager::current);
+            }
+        }
+    } catch (LockWaitError &e) {
+        tm.end_statement();
+        throw abandonTransaction(e);
+    } catch (DbRelationError &e) {
+        tm.end_statement();
+        throw SQLExecError(string("DbRelationError: ") + e.what());
+    } catch (...) {
+        tm.end_statement();
+        throw;
+    }
+}
 
-        if(currentTransID == -1) // check if stack is empty again, just in case
-            return std::pair<int, int>(-1, -1);
-        
-        tm.tryToGetLock(currentTransID, *stmt, fd);
-        return std::pair<int, int>(fd, currentTransID);
+// A statement that couldn't get a lock leaves its transaction unable to go on, and (in a deadlock) holding up
+// others until it ends, so the whole transaction is rolled back.
+SQLExecError SQLExec::abandonTransaction(const LockWaitError &e){
+    string message = string("LockWaitError: ") + e.what();
+    size_t levels = tm.getActiveTransactions().size();
+    if(levels == 0)
+        return SQLExecError(message);
+    string failure;
+    for(; levels > 0; levels--){
+        try {
+            tm.rollback_transaction();
+        } catch (exception &rollbackError) {
+            failure = rollbackError.what();
+        }
     }
+    if(!failure.empty())
+        return SQLExecError(message + " (" + failure + ")");
+    return SQLExecError(message + " (transaction rolled back)");
+}
 
-    return std::pair<int, int>(-1, -1); // if there are no active transactions
+// Locks a table in the mode a statement needs, until the transaction it's part of (or the statement itself, if
+// it isn't part of one) ends. Reads only need to keep the table from being replaced under them, since they're
+// from a snapshot; writers lock the rows they change as well (see LockManager).
+// Other sessions may run while this waits for the lock, and change the catalog, so call it before looking the
+// table up.
+// @param stmt: the statement that's accessing the table
+// @param tableToAccess: table being read or written to by the statement
+void SQLExec::requestLock(SQLStatement* stmt, Identifier tableToAccess){
+    LockManager::Mode mode;
+    switch(stmt->type()){
+        case kStmtSelect:
+        case kStmtShow:
+            mode = LockManager::IS;
+            break;
+        case kStmtInsert:
+        case kStmtDelete:
+            mode = LockManager::IX;
+            break;
+        default: // CREATE, DROP and FREEZE/UNFREEZE (VACUUM and ANALYZE say what they need themselves)
+            mode = LockManager::X;
+    }
+    requestLock(tableToAccess, mode);
 }
 
-// If a transaction is executing and has a lock, this releases the lock. If no transactions, does nothing.
-// @param fdAndID: a pair with the first element being the file descriptor of the DB file being accessed by the statement,
-//                 and the second element being the ID of the transaction that's executing a statement
-void SQLExec::releaseLock(pair<int, int> fdAndID){
-    if(fdAndID != pair<int, int>(-1, -1))
-        tm.releaseLock(fdAndID.first, fdAndID.second);
-    tm.updateTablesAndNames();
+// Locks a table in a given mode, for statements that need different locks at different stages.
+void SQLExec::requestLock(Identifier tableToAccess, LockManager::Mode mode){
+    LockManager::get().lock_table(tableToAccess, mode);
 }
 
 /**
@@ -295,6 +539,7 @@ void SQLExec::releaseLock(pair<int, int> fdAndID){
  * @return QueryResult* the result of the drop statement
  */
 QueryResult *SQLExec::drop(const DropStatement *statement) {
+    forget_metadata();
 
     switch(statement->type) {
         case DropStatement::kTable:
@@ -302,10 +547,18 @@ QueryResult *SQLExec::drop(const DropStatement *statement) {
             {
                 //check table is not a schema table
                 Identifier tableName = statement->name;
-                if(tableName == Tables::TABLE_NAME || tableName == Columns::TABLE_NAME)
+                if(tableName == Tables::TABLE_NAME || tableName == Columns::TABLE_NAME || tableName == Options::TABLE_NAME ||
+                   tableName == Statistics::TABLE_NAME)
                     throw SQLExecError("Error: schema tables cannot be dropped");
-
-                pair<int, int> fdAndID = requestLock((SQLStatement*)statement, tableName); // request lock on table to drop
+                // the table's files are gone for good, which ROLLBACK couldn't undo
+                if(tm.getCurrentTransactionID() != -1)
+                    throw SQLExecError("Error: DROP TABLE cannot be used inside a transaction");
+                // nor could the snapshots of transactions still running that see rows it no longer has
+                if(VersionStore::get().has_versions(tableName))
+                    throw SQLExecError("Error: " + tableName + " has changes that transactions still running can't see yet "
+                                       "(DROP it once they've finished)");
+
+                requestLock((SQLStatement*)statement, tableName); // request lock on table to drop
                 
                 DbRelation &table = SQLExec::tables->get_table(tableName);
                 ValueDict where;
@@ -329,6 +582,15 @@ QueryResult *SQLExec::drop(const DropStatement *statement) {
                     columns.del(handle);
                 delete columnHandles;
 
+                //remove options
+                DbRelation &options = SQLExec::tables->get_table(Options::TABLE_NAME);
+                Handles *optionHandles = options.select(&where);
+                for(const auto &handle : *optionHandles)
+                    options.del(handle);
+                delete optionHandles;
+
+                //remove statistics
+                SQLExec::statistics->forget(tableName);
 
                 //drop table and remove from schema
                 table.drop();
@@ -337,7 +599,6 @@ QueryResult *SQLExec::drop(const DropStatement *statement) {
                 delete tableHandles;
 
                 
-                releaseLock(fdAndID); // if this statement is part of a transaction, release the lock
             }
             return new QueryResult("Table successfully dropped!");
         case DropStatement::kIndex:
@@ -345,7 +606,7 @@ QueryResult *SQLExec::drop(const DropStatement *statement) {
                 Identifier tableName = statement->name;
                 Identifier indexName = statement->indexName;
 
-                pair<int, int> fdAndID = requestLock((SQLStatement*)statement, indexName); // request lock on index to drop
+                requestLock((SQLStatement*)statement, tableName); // the index is part of its table
 
                 DbIndex &index = SQLExec::indices->get_index(tableName, indexName);
                 index.drop();
@@ -360,7 +621,6 @@ QueryResult *SQLExec::drop(const DropStatement *statement) {
                 }
                 delete handleList;
 
-                releaseLock(fdAndID); // if this statement is part of a transaction, release the lock
 
                 return new QueryResult("Index successfully dropped");
             }
@@ -403,14 +663,15 @@ QueryResult *SQLExec::show_tables() {
     SQLStatement stmt = ShowStatement(ShowStatement::EntityType::kTables);
 
     // lock _tables schema table
-    pair<int, int> fdAndID = requestLock(&stmt, Tables::TABLE_NAME);
+    requestLock(&stmt, Tables::TABLE_NAME);
 
     Handles *handles = SQLExec::tables->select();
     ValueDicts *rows = new ValueDicts;
     for (auto &handle: *handles) {
         ValueDict *row = SQLExec::tables->project(handle, colNames);
         Identifier name = row->at("table_name").s;
-        if (name != Columns::TABLE_NAME && name != Indices::TABLE_NAME)
+        if (name != Columns::TABLE_NAME && name != Indices::TABLE_NAME && name != Options::TABLE_NAME &&
+            name != Statistics::TABLE_NAME)
             rows->push_back(row);
         else
             delete row;
@@ -418,7 +679,6 @@ QueryResult *SQLExec::show_tables() {
 
 
     delete handles;
-    releaseLock(fdAndID);
     return new QueryResult(colNames, colAttributes, rows, "showing tables");
 }
 
@@ -430,7 +690,7 @@ QueryResult *SQLExec::show_tables() {
  */
 QueryResult *SQLExec::show_columns(const ShowStatement *statement) {
     // lock _columns schema table
-    pair<int, int> fdAndID = requestLock((SQLStatement*)statement, Columns::TABLE_NAME);
+    requestLock((SQLStatement*)statement, Columns::TABLE_NAME);
 
     DbRelation &columns = SQLExec::tables->get_table(Columns::TABLE_NAME);
 
@@ -454,7 +714,6 @@ QueryResult *SQLExec::show_columns(const ShowStatement *statement) {
     }
 
     delete handles;
-    releaseLock(fdAndID);
     return new QueryResult(column_names, column_attributes, rows, "showing columns");
 }
 
@@ -484,7 +743,7 @@ QueryResult *SQLExec::show_index(const ShowStatement *statement) {
     location["table_name"] = Value(statement->tableName);
 
     // lock _tables schema table
-    pair<int, int> fdAndID = requestLock((SQLStatement*)statement, Indices::TABLE_NAME);
+    requestLock((SQLStatement*)statement, Indices::TABLE_NAME);
     Handles *handleList = SQLExec::indices->select(&location);
 
     ValueDicts *rows = new ValueDicts;
@@ -493,7 +752,6 @@ QueryResult *SQLExec::show_index(const ShowStatement *statement) {
         rows->push_back(row);
     }
     delete handleList;
-    releaseLock(fdAndID);
     return new QueryResult(colNames, colAttr, rows, "showing indices");
 }
 
@@ -502,32 +760,21 @@ QueryResult *SQLExec::show_index(const ShowStatement *statement) {
 //                2) only supports int and text;
 //                   the values being inserted can only be literal strings or integers (hsql doesn't support booleans)
 QueryResult *SQLExec::insert(const InsertStatement *statement) {
-    // check if the table exists
-    ValueDict where;
-    where["table_name"] = Value(statement->tableName);
-    Handles* handles = tables->select(&where);
+    requestLock((SQLStatement*)statement, statement->tableName); 
 
-    if(handles->empty()){
-        delete handles;
-        handles = nullptr;
+    // check if the table exists
+    std::shared_ptr<const TableMetadata> tableMetadata = table_metadata(statement->tableName);
+    if(tableMetadata->column_names.empty())
         return new QueryResult("Error: table does not exist");
-    }
-
-    delete handles; 
-
-    pair<int, int> fdAndID = requestLock((SQLStatement*)statement, statement->tableName); 
+    Handles* handles;
 
     // construct the ValueDict, making sure it's in the same order as the order of columns in the table
     ValueDict rowToInsert;
-    ColumnNames colNames; // column names for the table that the row will be inserted into
-    ColumnAttributes colAttributes; // column attributes of that table
+    const ColumnNames &colNames = tableMetadata->column_names; // column names for the table that the row will be inserted into
     Expr* expr; // expressions for the values in the statement
     Value valueToInsert;
     string message = "Successfully inserted 1 row into table "; // message returned in QueryResult
 
-    // get the order of the columns in the table 
-    tables->get_columns(statement->tableName, colNames, colAttributes);
-
     // if there's no list of columns specified, the order is the same as the order of columns in the table
     if(statement->columns == nullptr){
         for(unsigned int i=0; i < statement->values->size(); i++){
@@ -570,6 +817,12 @@ QueryResult *SQLExec::insert(const InsertStatement *statement) {
     // insert the row into the table
     DbRelation& table = tables->get_table(statement->tableName); // the relation for the table
 
+    // a page file's writes aren't logged, so they can't be made part of a transaction that may never commit
+    HeapTable *heapTable = dynamic_cast<HeapTable *>(&table);
+    if(heapTable != nullptr && !heapTable->is_logged() && tm.getCurrentTransactionID() != -1)
+        throw SQLExecError("Error: " + string(statement->tableName) + " is kept in a page file, which isn't logged, so it "
+                           "can't be changed inside a transaction");
+
     // check if the row already exists in the table    
     handles = table.select(&rowToInsert);
     if(!handles->empty()){
@@ -580,18 +833,12 @@ QueryResult *SQLExec::insert(const InsertStatement *statement) {
     delete handles;
     table.insert(&rowToInsert);
 
-    releaseLock(fdAndID);
-
     // insert into any indices
-    IndexNames indexNames = indices->get_index_names(statement->tableName);
-    int numIndices = indexNames.size();
+    int numIndices = tableMetadata->indices.size();
 
     if(numIndices > 0){
-        ValueDict indexRowToInsert; // the row to insert into _indices
-
-        for(string indexName : indexNames){
-            // need to request a lock on each index too
-            fdAndID = requestLock((SQLStatement*)statement, indexName);
+        for(auto const &tableIndex : tableMetadata->indices){
+            const Identifier &indexName = tableIndex.name;
 
             // don't need to check if the index exists since it's in indexNames
             DbIndex& index = indices->get_index(statement->tableName, indexName);
@@ -604,8 +851,6 @@ QueryResult *SQLExec::insert(const InsertStatement *statement) {
             // handles should contain only one row
             index.insert((*handles)[0]);
             delete handles;
-
-            releaseLock(fdAndID);
         }
     }
 
@@ -623,23 +868,38 @@ QueryResult *SQLExec::insert(const InsertStatement *statement) {
 }
 
 // Precondition: no nested queries/select statements; you can only select from a table.
-QueryResult *SQLExec::select(const SelectStatement *statement) {
+// With an explain mode, the result is the plan (see SQLExec::explain) rather than the rows.
+QueryResult *SQLExec::select(const SelectStatement *statement, ExplainMode mode) {
+    if(statement->fromTable->type == TableRefType::kTableJoin ||
+       statement->fromTable->type == TableRefType::kTableCrossProduct)
+        return select_join(statement, mode);
+
     // throw an error if statement->fromTable is not a table name
     if(statement->fromTable->type != TableRefType::kTableName)
         return new QueryResult("Error: only selecting from a single table is supported");
 
     Identifier tableName = statement->fromTable->getName(); // name of table to select from
 
-    pair<int, int> fdAndID = requestLock((SQLStatement*)statement, tableName);
+    requestLock((SQLStatement*)statement, tableName);
+
+    ValueRanges ranges; // what the where clause allows for each column it mentions
+    if(statement->whereClause != nullptr)
+        where_ranges(statement->whereClause, ranges);
 
     DbRelation& table = tables->get_table(tableName); // get the DbRelation for the table
     TableScanPlan tableScan = TableScanPlan(&table); // start with table scan
-    SelectPlan selectPlan = SelectPlan(&tableScan);    // wrap that in a SelectPlan
+    SelectPlan selectPlan = SelectPlan(&tableScan, ranges);    // wrap that in a SelectPlan, which does the where clause
+
+    // look the rows up in an index instead, if there's one that the statistics say is cheaper than scanning
+    Identifier indexName;
+    ValueDict key;
+    if(choose_index(tableName, ranges, indexName, key))
+        selectPlan.use_index(&SQLExec::indices->get_index(tableName, indexName), key);
 
     // get all column names and attributes in the table
-    ColumnNames allColNames; // all column names in the table
-    ColumnAttributes allColAttrs; // all column attributes in the table
-    tables->get_columns(tableName, allColNames, allColAttrs);
+    std::shared_ptr<const TableMetadata> tableMetadata = table_metadata(tableName);
+    const ColumnNames &allColNames = tableMetadata->column_names; // all column names in the table
+    const ColumnAttributes &allColAttrs = tableMetadata->column_attributes; // all column attributes in the table
 
     // determine whether all columns are being selected or only some
     ColumnNames colsToSelect;
@@ -654,6 +914,18 @@ QueryResult *SQLExec::select(const SelectStatement *statement) {
 
     // We can pass colsToSelect in both cases since the column names will be ignored if projecting all columns.
     EvalPlan projection = EvalPlan(selectAllColumns ? true : false, colsToSelect, &selectPlan);
+
+    if(mode != ExplainMode::NONE){
+        TableStatistics tableStatistics = tableMetadata->analyzed ? tableMetadata->statistics
+                                                                 : TableStatistics::guess(table, tableName);
+        if(mode == ExplainMode::ANALYZE){
+            ValueDicts rows = projection.evaluate();
+            for(auto row : rows)
+                delete row;
+        }
+        return plan_result(projection.explain(tableStatistics.estimated_rows(ranges)));
+    }
+
     ValueDicts result = projection.evaluate();
     ColumnAttributes selectedColAttrs; // if it's not a select * statement, these are the attributes of only the columns being selected   
 
@@ -661,7 +933,7 @@ QueryResult *SQLExec::select(const SelectStatement *statement) {
         // Need to get the column attributes only corresponding to the columns we're selecting
         for(Identifier selectedColName : colsToSelect){
             // get an iterator to the location of selectedColName in allColNames
-            ColumnNames::iterator it = find(allColNames.begin(), allColNames.end(), selectedColName);
+            ColumnNames::const_iterator it = find(allColNames.begin(), allColNames.end(), selectedColName);
 
             // get the index of selectedColName in allColNames, which is also the index of that column's
             // attribute in allColAttrs
@@ -671,26 +943,560 @@ QueryResult *SQLExec::select(const SelectStatement *statement) {
             selectedColAttrs.push_back(allColAttrs[index]);
         }   
 
-        releaseLock(fdAndID);
-        return new QueryResult(&colsToSelect, &selectedColAttrs, &result, SUCCESS_MESSAGE);
+        return new QueryResult(new ColumnNames(colsToSelect), new ColumnAttributes(selectedColAttrs),
+                               new ValueDicts(result), SUCCESS_MESSAGE);
     }
 
-    releaseLock(fdAndID);
-    return new QueryResult(&allColNames, &allColAttrs, &result, SUCCESS_MESSAGE);
+    return new QueryResult(new ColumnNames(allColNames), new ColumnAttributes(allColAttrs), new ValueDicts(result),
+                           SUCCESS_MESSAGE);
 }
 
-pair<vector<DbRelation*>, vector<Identifier>*> SQLExec::saveTablesAndNames(){
-    vector<DbRelation*> tableList; // list of all DbRelations for tables
-    vector<Identifier>* tableNameList = new vector<Identifier>(); // list of all names of tables
-    Handles* handles = tables->select(); // get handles to all table names
+/**
+ * @brief Executes a select from several tables joined together, e.g. FROM a, b WHERE a.id = b.a_id or
+ * FROM a JOIN b ON a.id = b.a_id
+ * The ON conditions and where clause are ANDs of comparisons between a column and a value, or of equalities
+ * between columns of two different tables. The JoinPlanner picks the order to join the tables in from their
+ * statistics, not the order they're written in.
+ * @param statement the select statement to be executed
+ * @param mode whether to give the plan instead of the rows (and whether to run it first)
+ * @return QueryResult* the joined rows, with columns named "table.column" (or "alias.column")
+ */
+QueryResult *SQLExec::select_join(const SelectStatement *statement, ExplainMode mode) {
+    vector<JoinInput> inputs;
+    vector<const Expr *> conditions;
+    join_inputs(statement->fromTable, inputs, conditions);
+    if(inputs.size() > 64)
+        throw SQLExecError("Error: at most 64 tables can be joined");
+    for(size_t i = 0; i < inputs.size(); i++)
+        for(size_t j = 0; j < i; j++)
+            if(inputs[i].alias == inputs[j].alias)
+                throw SQLExecError("Error: table name '" + inputs[i].alias + "' specified more than once");
+    for(auto &input : inputs){
+        requestLock((SQLStatement*)statement, input.table_name);
+        input.table = &SQLExec::tables->get_table(input.table_name);
+    }
+
+    vector<JoinPredicate> predicates;
+    if(statement->whereClause != nullptr)
+        conditions.push_back(statement->whereClause);
+    for(auto const &condition : conditions)
+        join_conditions(condition, inputs, predicates);
 
-    // get DbRelations for all the tables
-    for(Handle h : *handles){
-        ValueDict* tableName = tables->project(h);
-        tableNameList->push_back((*tableName)["table_name"].s);
-        DbRelation* table = &tables->get_table((*tableName)["table_name"].s);
-        tableList.push_back(table);
+    // work out the result's columns before doing any work
+    ColumnNames *columnNames = new ColumnNames();
+    ColumnAttributes *columnAttributes = new ColumnAttributes();
+    try {
+        for(Expr* expr : *statement->selectList){
+            vector<uint> which;
+            Identifier columnName;
+            if(expr->type == kExprStar){
+                for(uint i = 0; i < inputs.size(); i++)
+                    which.push_back(i);
+            } else if(expr->type == kExprColumnRef){
+                which.push_back(resolve_column(expr, inputs));
+                columnName = expr->name;
+            } else {
+                throw SQLExecError("Error: only columns can be selected from a join");
+            }
+            for(auto i : which){
+                const ColumnNames &tableColumns = inputs[i].table->get_column_names();
+                ColumnNames wanted = columnName.empty() ? tableColumns : ColumnNames(1, columnName);
+                ColumnAttributes *attributes = inputs[i].table->get_column_attributes(wanted);
+                for(size_t c = 0; c < wanted.size(); c++){
+                    columnNames->push_back(inputs[i].alias + "." + wanted[c]);
+                    columnAttributes->push_back((*attributes)[c]);
+                }
+                delete attributes;
+            }
+        }
+    } catch (...) {
+        delete columnNames;
+        delete columnAttributes;
+        throw;
+    }
+
+    for(auto &input : inputs){
+        std::shared_ptr<const TableMetadata> tableMetadata = table_metadata(input.table_name);
+        input.analyzed = tableMetadata->analyzed;
+        input.statistics = input.analyzed ? tableMetadata->statistics
+                                          : TableStatistics::guess(*input.table, input.table_name);
     }
 
-    return pair<vector<DbRelation*>, vector<Identifier>*>(tableList, tableNameList);
-}
\ No newline at end of file
+    ValueDicts *rows = nullptr;
+    QueryResult *planResult = nullptr;
+    try {
+        JoinPlanner planner(inputs, predicates);
+        JoinPlan *plan = planner.plan();
+        try {
+            if(mode != ExplainMode::PLAN)
+                rows = plan->evaluate();
+            if(mode != ExplainMode::NONE){
+                if(rows != nullptr){
+                    for(auto row : *rows)
+                        delete row;
+                    delete rows;
+                }
+                planResult = plan_result(plan->explain());
+            }
+        } catch (...) {
+            delete plan;
+            throw;
+        }
+        delete plan;
+    } catch (...) {
+        delete columnNames;
+        delete columnAttributes;
+        throw;
+    }
+    if(planResult != nullptr){
+        delete columnNames;
+        delete columnAttributes;
+        return planResult;
+    }
+    return new QueryResult(columnNames, columnAttributes, rows, SUCCESS_MESSAGE);
+}
+
+/**
+ * @brief Lists the tables in a FROM clause, along with any ON conditions joining them
+ * @param table the FROM clause (or part of it)
+ * @param inputs gets the tables, in the order written
+ * @param conditions gets the ON conditions
+ */
+void SQLExec::join_inputs(const TableRef *table, vector<JoinInput> &inputs, vector<const Expr *> &conditions) {
+    switch(table->type){
+        case kTableName: {
+            JoinInput input;
+            input.table_name = table->name;
+            input.alias = table->alias != nullptr ? table->alias : table->name;
+            inputs.push_back(input);
+            break;
+        }
+        case kTableCrossProduct:
+            for(auto const &listed : *table->list)
+                join_inputs(listed, inputs, conditions);
+            break;
+        case kTableJoin:
+            if(table->join->type != kJoinInner && table->join->type != kJoinCross)
+                throw SQLExecError("Error: only inner joins are supported");
+            join_inputs(table->join->left, inputs, conditions);
+            join_inputs(table->join->right, inputs, conditions);
+            if(table->join->condition != nullptr)
+                conditions.push_back(table->join->condition);
+            break;
+        default:
+            throw SQLExecError("Error: only tables can be joined");
+    }
+}
+
+/**
+ * @brief Sorts the comparisons in a join's conditions into those on a single table (kept as ranges on that
+ * table) and equalities between two tables' columns (the predicates the tables are joined on)
+ * @param expr an ON condition or where clause (or part of it)
+ * @param inputs the tables being joined; comparisons with values are added to their ranges
+ * @param predicates gets the equalities between tables
+ */
+void SQLExec::join_conditions(const Expr *expr, vector<JoinInput> &inputs, vector<JoinPredicate> &predicates) {
+    if(expr->type == kExprOperator && expr->opType == Expr::AND){
+        join_conditions(expr->expr, inputs, predicates);
+        join_conditions(expr->expr2, inputs, predicates);
+        return;
+    }
+    if(expr->type != kExprOperator || expr->expr == nullptr || expr->expr2 == nullptr)
+        throw SQLExecError("Error: only comparisons of a column with a value are supported in a where clause");
+
+    if(expr->expr->type == kExprColumnRef && expr->expr2->type == kExprColumnRef){
+        if(expr->opType != Expr::SIMPLE_OP || expr->opChar != '=')
+            throw SQLExecError("Error: columns can only be compared with each other by =");
+        JoinPredicate predicate;
+        predicate.left = resolve_column(expr->expr, inputs);
+        predicate.left_column = expr->expr->name;
+        predicate.right = resolve_column(expr->expr2, inputs);
+        predicate.right_column = expr->expr2->name;
+        if(predicate.left == predicate.right)
+            throw SQLExecError("Error: comparing two columns of the same table is not supported");
+        predicates.push_back(predicate);
+        return;
+    }
+
+    const Expr *column = expr->expr->type == kExprColumnRef ? expr->expr : expr->expr2;
+    if(column->type != kExprColumnRef)
+        throw SQLExecError("Error: only comparisons of a column with a value are supported in a where clause");
+    where_ranges(expr, inputs[resolve_column(column, inputs)].ranges);
+}
+
+/**
+ * @brief Works out which of the tables being joined a column belongs to
+ * @param column the column, either qualified (table.column or alias.column) or not
+ * @param inputs the tables being joined
+ * @return uint the position of the column's table in inputs
+ */
+uint SQLExec::resolve_column(const Expr *column, const vector<JoinInput> &inputs) {
+    Identifier name = column->name;
+    uint found = (uint) inputs.size();
+    for(uint i = 0; i < inputs.size(); i++){
+        if(column->table != nullptr && inputs[i].alias != column->table)
+            continue;
+        const ColumnNames &columnNames = inputs[i].table->get_column_names();
+        if(find(columnNames.begin(), columnNames.end(), name) == columnNames.end())
+            continue;
+        if(found != inputs.size())
+            throw SQLExecError("Error: column '" + name + "' is ambiguous");
+        found = i;
+    }
+    if(found == inputs.size())
+        throw SQLExecError("Error: unknown column '" + (column->table != nullptr ? string(column->table) + "." : "") +
+                           name + "'");
+    return found;
+}
+
+/**
+ * @brief Turns a where clause into a range of values for each column it restricts
+ * Only ANDs of comparisons (=, <, >, <=, >=) between a column and a literal are supported.
+ * @param expr the where clause (or part of it)
+ * @param ranges gets narrowed by each comparison
+ */
+void SQLExec::where_ranges(const Expr *expr, ValueRanges &ranges) {
+    if(expr->type != kExprOperator)
+        throw SQLExecError("Error: only comparisons of a column with a value are supported in a where clause");
+    if(expr->opType == Expr::AND){
+        where_ranges(expr->expr, ranges);
+        where_ranges(expr->expr2, ranges);
+        return;
+    }
+
+    // put the column on the left, turning the comparison around if it was on the right
+    const Expr *column = expr->expr;
+    const Expr *literal = expr->expr2;
+    bool flipped = false;
+    if(column != nullptr && column->type != kExprColumnRef){
+        swap(column, literal);
+        flipped = true;
+    }
+    if(column == nullptr || literal == nullptr || column->type != kExprColumnRef ||
+       (literal->type != kExprLiteralInt && literal->type != kExprLiteralString))
+        throw SQLExecError("Error: only comparisons of a column with a value are supported in a where clause");
+    Value value = literal->type == kExprLiteralInt ? Value((int32_t) literal->ival) : Value(string(literal->name));
+
+    bool less = false, greater = false, equal = false;
+    if(expr->opType == Expr::SIMPLE_OP && expr->opChar == '=')
+        equal = true;
+    else if(expr->opType == Expr::SIMPLE_OP && expr->opChar == '<')
+        less = true;
+    else if(expr->opType == Expr::SIMPLE_OP && expr->opChar == '>')
+        greater = true;
+    else if(expr->opType == Expr::LESS_EQ)
+        less = equal = true;
+    else if(expr->opType == Expr::GREATER_EQ)
+        greater = equal = true;
+    else
+        throw SQLExecError("Error: only =, <, >, <= and >= are supported in a where clause");
+    if(flipped)
+        swap(less, greater);
+
+    ValueRange &range = ranges[column->name];
+    if(!less)
+        range.restrict_min(value, equal);  // column = v, column > v, or column >= v
+    if(!greater)
+        range.restrict_max(value, equal);  // column = v, column < v, or column <= v
+}
+
+// Moving the rows would lose track of the versions of them that other transactions' snapshots still see.
+void SQLExec::checkNoVersions(Identifier tableName) {
+    if (VersionStore::get().has_versions(tableName))
+        throw SQLExecError("Error: " + tableName + " has changes that transactions still running can't see yet "
+                           "(VACUUM it once they've finished)");
+}
+
+/**
+ * @brief Executes VACUUM: rewrites a table into densely packed blocks
+ * 
+ * The rewrite happens under an IS lock on the table, so the table stays usable while it runs, and so does
+ * building the table's indices on the copy, since every row gets a new handle. X is only taken to copy again
+ * the blocks written meanwhile and swap the new files in.
+ * @param statement the vacuum statement to be executed
+ * @return QueryResult* the block counts before and after
+ */
+QueryResult *SQLExec::vacuum(const UtilityStatement *statement) {
+    Identifier tableName = statement->tableName;
+    if (tableName == Tables::TABLE_NAME || tableName == Columns::TABLE_NAME || tableName == Indices::TABLE_NAME ||
+        tableName == Options::TABLE_NAME || tableName == Statistics::TABLE_NAME)
+        throw SQLExecError("Error: schema tables cannot be vacuumed");
+
+    // IS keeps the table from being dropped or replaced while it's copied, without keeping anyone from using it
+    requestLock(tableName, LockManager::IS);
+    HeapTable *table = dynamic_cast<HeapTable *>(&SQLExec::tables->get_table(tableName));
+    if (table == nullptr)
+        throw SQLExecError("Error: only heap tables can be vacuumed");
+    if (table->is_frozen())
+        throw SQLExecError("Error: " + tableName + " is frozen (UNFREEZE TABLE it first)");
+    checkNoVersions(tableName);
+
+    BlockID before = table->get_block_count();
+    bool fresh;
+    HeapTable &copy = table->vacuum_copy(fresh);
+    IndexNames indexNames = SQLExec::indices->get_index_names(tableName);
+    vector<DbIndex *> built; // the table's indices, built on the copy
+    BlockID after;
+    try {
+        for (auto const &indexName : indexNames) {
+            built.push_back(SQLExec::indices->make_index(copy, tableName, indexName));
+            if (fresh)
+                built.back()->create();
+            else
+                built.back()->open();
+        }
+        // others may write to the table while we wait for X; vacuum_swap copies again just the blocks they wrote
+        requestLock(tableName, LockManager::X);
+        checkNoVersions(tableName);
+        after = table->vacuum_swap(built);
+        for (size_t i = 0; i < built.size(); i++) {
+            built[i]->close();
+            SQLExec::indices->get_index(tableName, indexNames[i]).swap_in(*built[i]);
+        }
+    } catch (LockBusyError &e) {
+        // the copy and the indices built on it are kept for this VACUUM to use when it's run again
+        for (auto index : built) {
+            index->close();
+            delete index;
+        }
+        throw;
+    } catch (...) {
+        for (auto index : built)
+            delete index;
+        table->vacuum_abandon();
+        throw;
+    }
+    for (auto index : built)
+        delete index;
+    SQLExec::indices->uncache(tableName);  // they refer to the old table object
+    Tables::uncache(tableName);
+
+    return new QueryResult("vacuumed " + tableName + " from " + to_string(before) + " to " + to_string(after) +
+                           " blocks");
+}
+
+/**
+ * @brief Executes an analyze statement: works out the table's statistics from a sample of its blocks and
+ * records them in _statistics (replacing any from before), for the planner to go by
+ * @param statement the analyze statement to be executed
+ * @return QueryResult* the row and block counts found
+ */
+QueryResult *SQLExec::analyze(const UtilityStatement *statement) {
+    Identifier tableName = statement->tableName;
+    if (tableName == Statistics::TABLE_NAME)
+        throw SQLExecError("Error: _statistics cannot be analyzed");
+
+    // statistics are only estimates, so the sample needn't keep writers out, just DROP TABLE and the like
+    requestLock(tableName, LockManager::IS);
+    DbRelation &table = SQLExec::tables->get_table(tableName);
+    TableStatistics tableStatistics = TableStatistics::collect(table, tableName);
+    SQLExec::statistics->put_statistics(tableStatistics);
+    forget_metadata();
+
+    return new QueryResult("analyzed " + tableName + ": " + to_string(tableStatistics.row_count) + " rows in " +
+                           to_string(tableStatistics.block_count) + " blocks");
+}
+
+/**
+ * @brief Executes FREEZE TABLE: writes a flat copy of a heap table's file to be read through a memory mapping,
+ * and marks the table frozen in _options so it is read from the copy (and can't be changed) from then on
+ * @param statement the freeze statement to be executed
+ * @return QueryResult* the number of blocks frozen
+ */
+QueryResult *SQLExec::freeze(const UtilityStatement *statement) {
+    Identifier tableName = statement->tableName;
+    if (tableName == Tables::TABLE_NAME || tableName == Columns::TABLE_NAME || tableName == Indices::TABLE_NAME ||
+        tableName == Options::TABLE_NAME || tableName == Statistics::TABLE_NAME)
+        throw SQLExecError("Error: schema tables cannot be frozen");
+
+    requestLock((SQLStatement*)statement, tableName);
+    HeapTable *table = dynamic_cast<HeapTable *>(&SQLExec::tables->get_table(tableName));
+    if (table == nullptr)
+        throw SQLExecError("Error: only heap tables can be frozen");
+    if (table->is_frozen())
+        throw SQLExecError("Error: " + tableName + " is already frozen");
+
+    BlockID blockCount = table->get_block_count();
+    table->freeze();
+    try {
+        ValueDict row;
+        row["table_name"] = Value(tableName);
+        row["option_name"] = Value("frozen");
+        row["option_value"] = Value("true");
+        SQLExec::tables->get_table(Options::TABLE_NAME).insert(&row);
+    } catch (DbRelationError &e) {
+        table->unfreeze();  // nothing will read the copy
+        throw;
+    }
+    SQLExec::indices->uncache(tableName);  // they refer to the old table object
+    Tables::uncache(tableName);
+
+    return new QueryResult("froze " + tableName + " (" + to_string(blockCount) + " blocks)");
+}
+
+/**
+ * @brief Executes UNFREEZE TABLE: removes a table's frozen copy so it is read from (and written to) its own
+ * file again
+ * @param statement the unfreeze statement to be executed
+ * @return QueryResult* confirmation that the table is unfrozen
+ */
+QueryResult *SQLExec::unfreeze(const UtilityStatement *statement) {
+    Identifier tableName = statement->tableName;
+    requestLock((SQLStatement*)statement, tableName);
+    HeapTable *table = dynamic_cast<HeapTable *>(&SQLExec::tables->get_table(tableName));
+    if (table == nullptr || !table->is_frozen())
+        throw SQLExecError("Error: " + tableName + " is not frozen");
+
+    DbRelation &options = SQLExec::tables->get_table(Options::TABLE_NAME);
+    ValueDict where;
+    where["table_name"] = Value(tableName);
+    where["option_name"] = Value("frozen");
+    Handles *optionHandles = options.select(&where);
+    for (auto const &handle : *optionHandles)
+        options.del(handle);
+    delete optionHandles;
+    table->unfreeze();
+    SQLExec::indices->uncache(tableName);  // they refer to the old table object
+    Tables::uncache(tableName);
+
+    return new QueryResult("unfroze " + tableName);
+}
+
+/**
+ * @brief Picks an index to look rows up in for a select, if there is one worth using
+ * An index can be used if the where clause has an equality on each of its columns. It's worth using if the
+ * blocks its matches are estimated to be in (from the table's statistics) are fewer than the table's blocks.
+ * A table that has never been analyzed uses any index it can.
+ * @param table_name the table being selected from
+ * @param ranges the where clause, as ranges
+ * @param index_name returned by reference: the index to use
+ * @param key returned by reference: the key to look up in it
+ * @return true if an index should be used
+ */
+bool SQLExec::choose_index(Identifier table_name, const ValueRanges &ranges, Identifier &index_name,
+                           ValueDict &key) {
+    if (ranges.empty())
+        return false;
+    std::shared_ptr<const TableMetadata> tableMetadata = table_metadata(table_name);
+    const TableStatistics &tableStatistics = tableMetadata->statistics;
+    bool analyzed = tableMetadata->analyzed;
+    double bestCost = analyzed ? max((double) tableStatistics.block_count, 1.0) : -1;
+    bool chosen = false;
+    for (auto const &index : tableMetadata->indices) {
+        const Identifier &name = index.name;
+        const ColumnNames &columnNames = index.column_names;
+        bool isUnique = index.is_unique;
+        ValueDict indexKey;
+        ValueRanges keyRanges;
+        for (auto const &columnName : columnNames) {
+            auto range = ranges.find(columnName);
+            if (range == ranges.end() || !range->second.is_equality())
+                break;
+            indexKey[columnName] = range->second.min;
+            keyRanges[columnName] = range->second;
+        }
+        if (indexKey.size() != columnNames.size())
+            continue;
+
+        // each match is taken to be in a different block, plus a block's worth for reading the index
+        double cost = 0;
+        if (analyzed) {
+            double matches = isUnique ? 1 : tableStatistics.estimated_rows(keyRanges);
+            cost = min(matches, (double) tableStatistics.block_count) + 1;
+        }
+        if (bestCost < 0 || cost < bestCost) {
+            bestCost = cost;
+            index_name = name;
+            key = indexKey;
+            chosen = true;
+        }
+    }
+    return chosen;
+}
+
+// The schema tables are undone like any others, so whatever was cached from their rows has to be forgotten
+// afterwards, for the tables named in the rows as well as the tables changed. A row that had to move when it
+// was put back takes the older changes to it along to where it went.
+// If a change can't be reversed, the snapshots are told that the older ones are gone as well, since the caller
+// then has Berkeley DB put the files back as they were instead (see reloadTables).
+void SQLExec::undoChanges(const UndoLog &undoLog){
+    const vector<UndoRecord> &records = undoLog.get_records();
+    map<pair<Identifier, Handle>, Handle> moved;
+    set<Identifier> changed; // tables whose definitions (rows in the schema tables) changed, or that were created
+    for(auto record = records.rbegin(); record != records.rend(); record++){
+        Identifier tableName = record->table_name;
+        if(record->kind != UndoRecord::CREATED)
+            VersionStore::get().undone(tableName, record->handle);
+        try {
+            DbRelation &table = tableName == Tables::TABLE_NAME ? *SQLExec::tables :
+                                tableName == Indices::TABLE_NAME ? *SQLExec::indices :
+                                tableName == Statistics::TABLE_NAME ? *SQLExec::statistics :
+                                SQLExec::tables->get_table(tableName);
+            if(record->kind == UndoRecord::CREATED)
+                changed.insert(tableName);
+
+            pair<Identifier, Handle> key(tableName, record->handle);
+            auto found = moved.find(key);
+            Handle handle = found == moved.end() ? record->handle : found->second;
+            if(record->kind != UndoRecord::CREATED && !tableName.empty() && tableName[0] == '_'){
+                ValueDict *row = record->kind == UndoRecord::INSERTED ? table.project(handle) : nullptr;
+                const ValueDict &schemaRow = row != nullptr ? *row : record->before;
+                auto named = schemaRow.find("table_name");
+                if(named != schemaRow.end())
+                    changed.insert(named->second.s);
+                delete row;
+            }
+
+            Handle now;
+            if(handle == record->handle){
+                now = table.undo(*record);
+            }else{
+                UndoRecord elsewhere = *record;
+                elsewhere.handle = handle;
+                now = table.undo(elsewhere);
+            }
+            if(now != handle)
+                moved[key] = now;
+        } catch (...) {
+            for(auto older = record + 1; older != records.rend(); older++)
+                if(older->kind != UndoRecord::CREATED)
+                    VersionStore::get().undone(older->table_name, older->handle);
+            throw;
+        }
+    }
+    // Only tables whose definitions changed are forgotten. The rows of the others changing back doesn't affect
+    // the objects cached for them, which other sessions holding locks on those tables may be using right now.
+    for(auto const &tableName: changed){
+        if(tableName == Tables::TABLE_NAME || tableName == Indices::TABLE_NAME || tableName == Statistics::TABLE_NAME)
+            continue; // not cached
+        SQLExec::indices->uncache(tableName);
+        Tables::uncache(tableName);
+    }
+    if(!changed.empty())
+        forget_metadata();
+}
+
+// Aborting takes the files back past whatever the objects cached for them know (e.g. how many blocks there are),
+// so they're all forgotten, or closed to be opened again, for the schema tables, which are never forgotten. No
+// other session's statement is part way through using them (see runStatement).
+void SQLExec::reloadTables(const UndoLog &undoLog){
+    set<Identifier> tableNames;
+    for(auto const &record: undoLog.get_records())
+        tableNames.insert(record.table_name);
+    bool schemaChanged = false;
+    for(auto const &tableName: tableNames){
+        if(tableName == Tables::TABLE_NAME || tableName == Indices::TABLE_NAME || tableName == Statistics::TABLE_NAME ||
+           tableName == Columns::TABLE_NAME || tableName == Options::TABLE_NAME){
+            DbRelation &table = tableName == Indices::TABLE_NAME ? *SQLExec::indices :
+                                tableName == Statistics::TABLE_NAME ? *SQLExec::statistics :
+                                SQLExec::tables->get_table(tableName);
+            table.close();
+            schemaChanged = true;
+        }else{
+            SQLExec::indices->uncache(tableName);
+            Tables::uncache(tableName);
+        }
+    }
+    if(schemaChanged)
+        forget_metadata();
+}
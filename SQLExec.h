@@ -8,12 +8,21 @@ class TransactionManager; // forward declaring to avoid compilation error
 
 
 #include <exception>
+#include <functional>
+#include <memory>
 #include <string>
 #include <stack>
 #include "SQLParser.h"
 #include "SchemaTables.h"
 #include "TransactionStatement.h"
+#include "UtilityStatement.h"
 #include "Transactions.h"
+#include "JoinPlan.h"
+#include "Explain.h"
+#include "PreparedStatement.h"
+#include "UndoLog.h"
+#include "LockManager.h"
+#include "CatalogCache.h"
 using namespace hsql;
 using namespace std;
 
@@ -61,6 +70,28 @@ protected:
 };
 
 
+/**
+ * What the schema tables say about a table, as statements on it need it. Kept from one statement to the next
+ * (see SQLExec::table_metadata) so that running the same statements over and over doesn't read the schema
+ * tables every time.
+ */
+struct TableMetadata {
+    struct Index {
+        Identifier name;
+        ColumnNames column_names;
+        bool is_unique;
+    };
+
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    std::vector<Index> indices;
+    bool analyzed;
+    TableStatistics statistics;  // only if analyzed (a guess would go stale as the table grows)
+
+    TableMetadata() : analyzed(false) {}
+};
+
+
 /**
  * @class SQLExec - execution engine
  */
@@ -70,9 +101,10 @@ public:
      * Execute the given SQL statement.
      * Precondition: Do NOT call this with a transaction statement
      * @param statement   the Hyrise AST of the SQL statement to execute
+     * @param options     storage options from a CREATE TABLE's WITH clause, if any
      * @returns           the query result (freed by caller)
      */
-    static QueryResult *execute(const hsql::SQLStatement *statement);
+    static QueryResult *execute(const hsql::SQLStatement *statement, const TableOptions *options = nullptr);
 
     /**
      * Execute the given transaction statement.
@@ -81,18 +113,85 @@ public:
      */
     static QueryResult *execute_transaction_command(const TransactionStatement *statement);
 
-    // To help the TransactionManager: return a pair of DbRelations of all tables in the DBMS,
-    // and their names.
-    static pair<vector<DbRelation*>, vector<Identifier>*> saveTablesAndNames(); 
+    /**
+     * Execute the given utility statement (e.g., VACUUM).
+     * @param statement   the utility statement to execute
+     * @returns           the query result (freed by caller)
+     */
+    static QueryResult *execute_utility_command(const UtilityStatement *statement);
+
+    /**
+     * Show how the given SELECT would be run (EXPLAIN), or run it and show what each step did (EXPLAIN ANALYZE).
+     * @param statement   the SELECT
+     * @param mode        ExplainMode::PLAN or ExplainMode::ANALYZE
+     * @returns           the plan, a row per step (freed by caller)
+     */
+    static QueryResult *explain(const hsql::SelectStatement *statement, ExplainMode mode);
+
+    /**
+     * Parse an INSERT or SELECT once, to be run any number of times with different values for its '?'
+     * placeholders (PREPARE name AS ...). A statement already prepared under the name is replaced.
+     * @param name        what to call it
+     * @param query       the statement
+     * @returns           the query result (freed by caller)
+     */
+    static QueryResult *prepare(const Identifier &name, const std::string &query);
+
+    /**
+     * Run a prepared statement (EXECUTE name (values)).
+     * @param name        the name it was prepared under
+     * @param parameters  a value for each of its placeholders, in order
+     * @returns           the query result (freed by caller)
+     */
+    static QueryResult *execute_prepared(const Identifier &name, const std::vector<Value> &parameters);
+
+    /**
+     * Forget a prepared statement (DEALLOCATE name).
+     * @param name        the name it was prepared under
+     * @returns           the query result (freed by caller)
+     */
+    static QueryResult *deallocate(const Identifier &name);
+
+    /**
+     * Wait until this thread's last commit (of a transaction, or of a statement run outside one) is in the
+     * write-ahead log on disk. Call once the statement's results are ready but before reporting them, without
+     * holding anything other sessions need, so their commits can share the log flush.
+     */
+    static void wait_durable();
+
+    /**
+     * Clean up after a server session (on its thread): roll back its open transactions and forget its
+     * prepared statements.
+     */
+    static void end_session();
+
+    // To help the TransactionManager: reverse the changes in a transaction's undo log, newest first.
+    static void undoChanges(const UndoLog &undoLog);
+
+    // To help the TransactionManager: forget what's cached of the tables a transaction changed, once its Berkeley
+    // DB transaction has been aborted instead (putting their files back as they were).
+    static void reloadTables(const UndoLog &undoLog);
 
 protected:
     // the one place in the system that holds the _tables and _indices tables
     static Tables *tables;
     static Indices *indices;
-    static TransactionManager tm; 
+    static Statistics *statistics;
+    // per thread, so that each server session has its own transactions and prepared statements
+    static thread_local TransactionManager tm; 
+    static thread_local std::map<Identifier, PreparedStatement *> prepared;
+    static CatalogCache<Identifier, std::shared_ptr<const TableMetadata>> metadata;
+
+    // What the schema tables say about a table, read from them only the first time it's asked for after any
+    // change to them. A table that doesn't exist has no columns. Shared, so that it outlives forget_metadata
+    // for statements (in this session or another) still using it.
+    static std::shared_ptr<const TableMetadata> table_metadata(const Identifier &table_name);
+
+    // Called whenever the schema tables change.
+    static void forget_metadata();
 
     // recursive decent into the AST
-    static QueryResult *create(const hsql::CreateStatement *statement);
+    static QueryResult *create(const hsql::CreateStatement *statement, const TableOptions *options);
 
     static QueryResult *drop(const hsql::DropStatement *statement);
 
@@ -110,18 +209,42 @@ protected:
 
     static QueryResult *del(const hsql::DeleteStatement *statement);
 
-    static QueryResult *select(const hsql::SelectStatement *statement);
+    static QueryResult *select(const hsql::SelectStatement *statement, ExplainMode mode = ExplainMode::NONE);
+
+    static QueryResult *select_join(const hsql::SelectStatement *statement, ExplainMode mode = ExplainMode::NONE);
+
+    static void join_inputs(const hsql::TableRef *table, vector<JoinInput> &inputs, vector<const hsql::Expr *> &conditions);
 
-    static pair<int, int> requestLock(SQLStatement* stmt, Identifier tableToAccess);
+    static void join_conditions(const hsql::Expr *expr, vector<JoinInput> &inputs, vector<JoinPredicate> &predicates);
 
-    // If a transaction is executing and has a lock, this releases the lock. If no transactions, does nothing.
-    // @param fdAndID: a pair with the first element being the file descriptor of the DB file being accessed by the statement,
-    //                 and the second element being the ID of the transaction that's executing a statement
-    static void releaseLock(pair<int, int> fdAndID);
+    static uint resolve_column(const hsql::Expr *column, const vector<JoinInput> &inputs);
+
+    static QueryResult *vacuum(const UtilityStatement *statement);
+
+    static QueryResult *analyze(const UtilityStatement *statement);
+
+    static void checkNoVersions(Identifier tableName);
+
+    static QueryResult *freeze(const UtilityStatement *statement);
+
+    static QueryResult *unfreeze(const UtilityStatement *statement);
+
+    static bool choose_index(Identifier table_name, const ValueRanges &ranges, Identifier &index_name,
+                             ValueDict &key);
+
+    static void requestLock(SQLStatement* stmt, Identifier tableToAccess);
+
+    static void requestLock(Identifier tableToAccess, LockManager::Mode mode);
+
+    static QueryResult *runStatement(bool writes, const std::function<QueryResult *()> &run);
+
+    static SQLExecError abandonTransaction(const LockWaitError &e);
 
     static void
     column_definition(const hsql::ColumnDefinition *col, Identifier &column_name, ColumnAttribute &column_attribute);
 
+    static void where_ranges(const hsql::Expr *expr, ValueRanges &ranges);
+
 
 };
 
@@ -5,6 +5,7 @@
  */
 #include "SchemaTables.h"
 #include "ParseTreeToString.h"
+#include <algorithm>
 
 
 void initialize_schema_tables() {
@@ -17,6 +18,12 @@ void initialize_schema_tables() {
     Indices indices;
     indices.create_if_not_exists();
     indices.close();
+    Options options;
+    options.create_if_not_exists();
+    options.close();
+    Statistics statistics;
+    statistics.create_if_not_exists();
+    statistics.close();
 }
 
 // Not terribly useful since the parser weeds most of these out
@@ -47,7 +54,8 @@ bool is_acceptable_data_type(std::string dt) {
  */
 const Identifier Tables::TABLE_NAME = "_tables";
 Columns *Tables::columns_table = nullptr;
-std::map<Identifier, DbRelation *> Tables::table_cache;
+Options *Tables::options_table = nullptr;
+CatalogCache<Identifier, DbRelation> Tables::table_cache;
 
 // get the column name for _tables column
 ColumnNames &Tables::COLUMN_NAMES() {
@@ -69,10 +77,13 @@ ColumnAttributes &Tables::COLUMN_ATTRIBUTES() {
 
 // ctor - we have a fixed table structure of just one column: table_name
 Tables::Tables() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
-    Tables::table_cache[TABLE_NAME] = this;
+    Tables::table_cache.assign(TABLE_NAME, this);
     if (Tables::columns_table == nullptr)
         columns_table = new Columns();
-    Tables::table_cache[columns_table->TABLE_NAME] = columns_table;
+    Tables::table_cache.assign(columns_table->TABLE_NAME, columns_table);
+    if (Tables::options_table == nullptr)
+        options_table = new Options();
+    Tables::table_cache.assign(options_table->TABLE_NAME, options_table);
 }
 
 // Create the file and also, manually add schema tables.
@@ -85,6 +96,10 @@ void Tables::create() {
     insert(&row);
     row["table_name"] = Value("_indices");
     insert(&row);
+    row["table_name"] = Value("_options");
+    insert(&row);
+    row["table_name"] = Value("_statistics");
+    insert(&row);
 }
 
 // Manually check that table_name is unique.
@@ -105,11 +120,7 @@ void Tables::del(Handle handle) {
     ValueDict *row = project(handle);
     Identifier table_name = row->at("table_name").s;
     delete row;
-    if (Tables::table_cache.find(table_name) != Tables::table_cache.end()) {
-        DbRelation *table = Tables::table_cache.at(table_name);
-        Tables::table_cache.erase(table_name);
-        delete table;
-    }
+    uncache(table_name);
 
     HeapTable::del(handle);
 }
@@ -147,19 +158,31 @@ void Tables::get_columns(Identifier table_name, ColumnNames &column_names, Colum
     delete handles;
 }
 
+void Tables::uncache(Identifier table_name) {
+    delete Tables::table_cache.erase(table_name);
+}
+
 // Return a table for given table_name.
 DbRelation &Tables::get_table(Identifier table_name) {
     // if they are asking about a table we've once constructed, then just return that one
-    if (Tables::table_cache.find(table_name) != Tables::table_cache.end())
-        return *Tables::table_cache[table_name];
+    DbRelation *cached = Tables::table_cache.find(table_name);
+    if (cached != nullptr)
+        return *cached;
 
-    // otherwise assume it is a HeapTable (for now)
+    // otherwise build it in whichever format it was created with
     ColumnNames column_names;
     ColumnAttributes column_attributes;
     get_columns(table_name, column_names, column_attributes);
-    DbRelation *table = new HeapTable(table_name, column_names, column_attributes);
-    Tables::table_cache[table_name] = table;
-    return *table;
+    TableOptions options = Tables::options_table->get_options(table_name);
+    DbRelation *table;
+    if (ColumnarTable::is_columnar(options))
+        table = new ColumnarTable(table_name, column_names, column_attributes, options);
+    else
+        table = new HeapTable(table_name, column_names, column_attributes, options);
+    cached = Tables::table_cache.insert(table_name, table);
+    if (cached != table)
+        delete table;  // another session built it first
+    return *cached;
 }
 
 
@@ -228,6 +251,32 @@ void Columns::create() {
     row["column_name"] = Value("is_unique");
     row["data_type"] = Value("BOOLEAN");
     insert(&row);
+
+    row["data_type"] = Value("TEXT");
+    row["table_name"] = Value("_options");
+    row["column_name"] = Value("table_name");
+    insert(&row);
+    row["column_name"] = Value("option_name");
+    insert(&row);
+    row["column_name"] = Value("option_value");
+    insert(&row);
+
+    row["table_name"] = Value("_statistics");
+    row["column_name"] = Value("table_name");
+    insert(&row);
+    row["column_name"] = Value("column_name");
+    insert(&row);
+    row["column_name"] = Value("histogram");
+    insert(&row);
+    row["data_type"] = Value("INT");
+    row["column_name"] = Value("row_count");
+    insert(&row);
+    row["column_name"] = Value("block_count");
+    insert(&row);
+    row["column_name"] = Value("distinct_count");
+    insert(&row);
+    row["column_name"] = Value("avg_width");
+    insert(&row);
 }
 
 // Manually check that (table_name, column_name) is unique.
@@ -255,13 +304,176 @@ Handle Columns::insert(const ValueDict *row) {
 }
 
 
+/*
+ * ****************************
+ * Options class implementation
+ * ****************************
+ */
+const Identifier Options::TABLE_NAME = "_options";
+
+// get the column name for _options column
+ColumnNames &Options::COLUMN_NAMES() {
+    static ColumnNames cn;
+    if (cn.empty()) {
+        cn.push_back("table_name");
+        cn.push_back("option_name");
+        cn.push_back("option_value");
+    }
+    return cn;
+}
+
+// get the column attribute for _options column
+ColumnAttributes &Options::COLUMN_ATTRIBUTES() {
+    static ColumnAttributes cas;
+    if (cas.empty()) {
+        ColumnAttribute ca(ColumnAttribute::TEXT);
+        cas.push_back(ca);
+        cas.push_back(ca);
+        cas.push_back(ca);
+    }
+    return cas;
+}
+
+// ctor - we have a fixed table structure
+Options::Options() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+}
+
+// Manually check that (table_name, option_name) is unique.
+Handle Options::insert(const ValueDict *row) {
+    ValueDict where;
+    where["table_name"] = row->at("table_name");
+    where["option_name"] = row->at("option_name");
+    Handles *handles = select(&where);
+    bool unique = handles->empty();
+    delete handles;
+    if (!unique)
+        throw DbRelationError("duplicate option " + row->at("table_name").s + "." + row->at("option_name").s);
+    return HeapTable::insert(row);
+}
+
+// Return the options recorded for given table.
+TableOptions Options::get_options(Identifier table_name) {
+    // SELECT * FROM _options WHERE table_name = <table_name>
+    TableOptions options;
+    ValueDict where;
+    where["table_name"] = table_name;
+    Handles *handles = select(&where);
+    for (auto const &handle: *handles) {
+        ValueDict *row = project(handle);
+        options[(*row)["option_name"].s] = (*row)["option_value"].s;
+        delete row;
+    }
+    delete handles;
+    return options;
+}
+
+
+/*
+ * *******************************
+ * Statistics class implementation
+ * *******************************
+ */
+const Identifier Statistics::TABLE_NAME = "_statistics";
+
+// get the column name for _statistics column
+ColumnNames &Statistics::COLUMN_NAMES() {
+    static ColumnNames cn;
+    if (cn.empty()) {
+        cn.push_back("table_name");
+        cn.push_back("column_name");
+        cn.push_back("row_count");
+        cn.push_back("block_count");
+        cn.push_back("distinct_count");
+        cn.push_back("avg_width");
+        cn.push_back("histogram");
+    }
+    return cn;
+}
+
+// get the column attribute for _statistics column
+ColumnAttributes &Statistics::COLUMN_ATTRIBUTES() {
+    static ColumnAttributes cas;
+    if (cas.empty()) {
+        ColumnAttribute text(ColumnAttribute::TEXT), integer(ColumnAttribute::INT);
+        cas.push_back(text);
+        cas.push_back(text);
+        cas.push_back(integer);
+        cas.push_back(integer);
+        cas.push_back(integer);
+        cas.push_back(integer);
+        cas.push_back(text);
+    }
+    return cas;
+}
+
+// ctor - we have a fixed table structure
+Statistics::Statistics() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+}
+
+// Columns dropped or added since the last ANALYZE are left out or have no statistics, respectively.
+bool Statistics::get_statistics(Identifier table_name, TableStatistics &statistics) {
+    // SELECT * FROM _statistics WHERE table_name = <table_name>
+    ColumnNames column_names;
+    ColumnAttributes column_attributes;
+    Tables::get_columns(table_name, column_names, column_attributes);
+    ValueDict where;
+    where["table_name"] = table_name;
+    Handles *handles = select(&where);
+    bool found = !handles->empty();
+    statistics = TableStatistics();
+    statistics.table_name = table_name;
+    for (auto const &handle: *handles) {
+        ValueDict *row = project(handle);
+        statistics.row_count = (u32) (*row)["row_count"].n;
+        statistics.block_count = (u32) (*row)["block_count"].n;
+        auto column = find(column_names.begin(), column_names.end(), (*row)["column_name"].s);
+        if (column != column_names.end()) {
+            ColumnStatistics column_statistics;
+            column_statistics.column_name = *column;
+            column_statistics.data_type = column_attributes[column - column_names.begin()].get_data_type();
+            column_statistics.distinct_count = (u32) (*row)["distinct_count"].n;
+            column_statistics.avg_width = (u32) (*row)["avg_width"].n;
+            column_statistics.histogram = Histogram::from_string((*row)["histogram"].s, column_statistics.data_type);
+            statistics.columns.push_back(column_statistics);
+        }
+        delete row;
+    }
+    delete handles;
+    return found;
+}
+
+void Statistics::put_statistics(const TableStatistics &statistics) {
+    forget(statistics.table_name);
+    for (auto const &column: statistics.columns) {
+        ValueDict row;
+        row["table_name"] = Value(statistics.table_name);
+        row["column_name"] = Value(column.column_name);
+        row["row_count"] = Value((int32_t) statistics.row_count);
+        row["block_count"] = Value((int32_t) statistics.block_count);
+        row["distinct_count"] = Value((int32_t) column.distinct_count);
+        row["avg_width"] = Value((int32_t) column.avg_width);
+        row["histogram"] = Value(column.histogram.to_string());
+        insert(&row);
+    }
+}
+
+void Statistics::forget(Identifier table_name) {
+    ValueDict where;
+    where["table_name"] = table_name;
+    Handles *handles = select(&where);
+    for (auto const &handle: *handles)
+        del(handle);
+    delete handles;
+}
+
+
 /*
  * ****************************
  * Indices class implementation
  * ****************************
  */
 const Identifier Indices::TABLE_NAME = "_indices";
-std::map<std::pair<Identifier, Identifier>, DbIndex *> Indices::index_cache;
+CatalogCache<std::pair<Identifier, Identifier>, DbIndex> Indices::index_cache;
 
 // get the column name for _indices column
 ColumnNames &Indices::COLUMN_NAMES() {
@@ -329,12 +541,7 @@ void Indices::del(Handle handle) {
     Identifier table_name = row->at("table_name").s;
     Identifier index_name = row->at("index_name").s;
     delete row;
-    std::pair<Identifier, Identifier> cache_key(table_name, index_name);
-    if (Indices::index_cache.find(cache_key) != Indices::index_cache.end()) {
-        DbIndex *index = Indices::index_cache.at(cache_key);
-        Indices::index_cache.erase(cache_key);
-        delete index;
-    }
+    delete Indices::index_cache.erase(std::pair<Identifier, Identifier>(table_name, index_name));
     HeapTable::del(handle);
 }
 
@@ -390,22 +597,35 @@ public:
 DbIndex &Indices::get_index(Identifier table_name, Identifier index_name) {
     // if they are asking about an index we've once constructed, then just return that one
     std::pair<Identifier, Identifier> cache_key(table_name, index_name);
-    if (Indices::index_cache.find(cache_key) != Indices::index_cache.end())
-        return *Indices::index_cache[cache_key];
+    DbIndex *cached = Indices::index_cache.find(cache_key);
+    if (cached != nullptr)
+        return *cached;
+
+    DbIndex *index = make_index(Tables::get_table(table_name), table_name, index_name);
+    cached = Indices::index_cache.insert(cache_key, index);
+    if (cached != index)
+        delete index;  // another session built it first
+    return *cached;
+}
 
-    // otherwise assume it is a DummyIndex (for now)
+DbIndex *Indices::make_index(DbRelation &relation, Identifier table_name, Identifier index_name) {
+    // assume it is a DummyIndex (for now)
     ColumnNames column_names;
     bool is_hash, is_unique;
     get_columns(table_name, index_name, column_names, is_hash, is_unique);
-    DbRelation &table = Tables::get_table(table_name);
-    DbIndex *index;
     if (is_hash) {
-        index = new DummyIndex(table, index_name, column_names, is_unique);  // FIXME - change to HashIndex
+        return new DummyIndex(relation, index_name, column_names, is_unique);  // FIXME - change to HashIndex
     } else {
-        index = new DummyIndex(table, index_name, column_names, is_unique);  // FIXME - change to BTreeIndex
+        return new DummyIndex(relation, index_name, column_names, is_unique);  // FIXME - change to BTreeIndex
     }
-    Indices::index_cache[cache_key] = index;
-    return *index;
+}
+
+void Indices::uncache(Identifier table_name) {
+    auto on_table = [&table_name](const std::pair<Identifier, Identifier> &cache_key) {
+        return cache_key.first == table_name;
+    };
+    for (DbIndex *index: Indices::index_cache.erase_if(on_table))
+        delete index;
 }
 
 IndexNames Indices::get_index_names(Identifier table_name) {
@@ -10,6 +10,9 @@
 #include "ParseTreeToString.h"
 #include "storage_engine.h"
 #include "heap_storage.h"
+#include "ColumnarTable.h"
+#include "TableStatistics.h"
+#include "CatalogCache.h"
 
 class HeapTable;
 
@@ -48,6 +51,83 @@ protected:
     static ColumnAttributes &COLUMN_ATTRIBUTES();
 };
 
+/**
+ * @class Options - The singleton table that stores the storage options (e.g. page_size) each table was created with.
+ * One row per option: (table_name, option_name, option_value).
+ */
+class Options : public HeapTable {
+public:
+    /**
+     * Name of the options table ("_options")
+     */
+    static const Identifier TABLE_NAME;
+
+    // ctor/dtor
+    Options();
+
+    virtual ~Options() {}
+
+    /**
+     * Get the storage options recorded for a table.
+     * @param table_name  table to get options for
+     * @returns           its options (empty if it was created without any)
+     */
+    virtual TableOptions get_options(Identifier table_name);
+
+    // HeapTable overrides
+    virtual Handle insert(const ValueDict *row);
+
+protected:
+    // hard-coded columns for the _options table
+    static ColumnNames &COLUMN_NAMES();
+
+    static ColumnAttributes &COLUMN_ATTRIBUTES();
+};
+
+/**
+ * @class Statistics - The singleton table that stores what ANALYZE found out about each table.
+ * One row per column: (table_name, column_name, row_count, block_count, distinct_count, avg_width, histogram),
+ * with the table-wide row_count and block_count repeated on each of the table's rows.
+ */
+class Statistics : public HeapTable {
+public:
+    /**
+     * Name of the statistics table ("_statistics")
+     */
+    static const Identifier TABLE_NAME;
+
+    // ctor/dtor
+    Statistics();
+
+    virtual ~Statistics() {}
+
+    /**
+     * Get the statistics recorded for a table.
+     * @param table_name  table to get statistics for
+     * @param statistics  returned by reference: the table's statistics
+     * @returns           false if the table has never been analyzed
+     */
+    virtual bool get_statistics(Identifier table_name, TableStatistics &statistics);
+
+    /**
+     * Record a table's statistics, replacing any recorded before.
+     * @param statistics  the table's statistics
+     */
+    virtual void put_statistics(const TableStatistics &statistics);
+
+    /**
+     * Remove the statistics recorded for a table, e.g. because it is being dropped.
+     * @param table_name  table to forget
+     */
+    virtual void forget(Identifier table_name);
+
+protected:
+    // hard-coded columns for the _statistics table
+    static ColumnNames &COLUMN_NAMES();
+
+    static ColumnAttributes &COLUMN_ATTRIBUTES();
+};
+
 typedef ColumnNames IndexNames;
 
 
@@ -84,6 +164,16 @@ public:
     */
    virtual DbIndex &get_index(Identifier table_name, Identifier index_name);
 
+   /**
+    * Construct a DbIndex for the given index on some other relation than the table itself (nothing is cached,
+    * created or opened). VACUUM builds a table's indices on its copy of the table this way.
+    * @param relation    what the index is to be built on
+    * @param table_name  what table the index is on
+    * @param index_name  name of index (unique by table)
+    * @returns           the new DbIndex (freed by caller)
+    */
+   virtual DbIndex *make_index(DbRelation &relation, Identifier table_name, Identifier index_name);
+
    /**
     * Get the list of indices on a given table.
     * @param table_name  which table to lookup the indices on
@@ -91,6 +181,12 @@ public:
     */
    virtual IndexNames get_index_names(Identifier table_name);
 
+   /**
+    * Forget (and delete) the cached DbIndex's on a table, e.g. because the table itself was re-instantiated.
+    * @param table_name  table whose indices to forget
+    */
+   virtual void uncache(Identifier table_name);
+
    // overrides
    virtual Handle insert(const ValueDict *row);
 
@@ -102,7 +198,8 @@ protected:
    static ColumnAttributes &COLUMN_ATTRIBUTES();
 
 private:
-   static std::map<std::pair<Identifier, Identifier>, DbIndex *> index_cache;
+   // the indices instantiated so far, by table and index name (looked up without locks, see CatalogCache)
+   static CatalogCache<std::pair<Identifier, Identifier>, DbIndex> index_cache;
 };
 
 
@@ -148,6 +245,13 @@ public:
      */
     static DbRelation &get_table(Identifier table_name);
 
+    /**
+     * Forget (and delete) the DbRelation cached for a table, so the next get_table builds a fresh one.
+     * Needed after the table's file has been replaced underneath it (e.g., by VACUUM).
+     * @param table_name  table to forget
+     */
+    static void uncache(Identifier table_name);
+
 protected:
     // hard-coded columns for _tables table
     static ColumnNames &COLUMN_NAMES();
@@ -157,9 +261,12 @@ protected:
     // keep a reference to the columns table (for get_columns method)
     static Columns *columns_table;
 
+    // and the options table (for get_table method)
+    static Options *options_table;
+
 private:
-    // keep a cache of all the tables we've instantiated so far
-    static std::map<Identifier, DbRelation *> table_cache;
+    // keep a cache of all the tables we've instantiated so far (looked up without locks, see CatalogCache)
+    static CatalogCache<Identifier, DbRelation> table_cache;
 };
 
 
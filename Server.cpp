@@ -0,0 +1,118 @@
+#include "Server.h"
+#include "Protocol.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const int BACKLOG = 64;
+
+Server::Server(CommandRunner runner, SessionCleanup cleanup, CommandFinisher finisher) : runner(runner),
+                                                                                         cleanup(cleanup),
+                                                                                         finisher(finisher),
+                                                                                         listener(-1) {
+}
+
+Server::~Server() {
+    if (this->listener >= 0)
+        ::close(this->listener);
+    if (!this->socket_path.empty())
+        ::unlink(this->socket_path.c_str());
+}
+
+void Server::listen_unix(const string &path) {
+    sockaddr_un address;
+    if (path.size() >= sizeof(address.sun_path))
+        throw runtime_error("socket path too long: " + path);
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    this->listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->listener < 0)
+        throw runtime_error(string("socket: ") + strerror(errno));
+    ::unlink(path.c_str());
+    if (::bind(this->listener, (sockaddr *) &address, sizeof(address)) < 0 || ::listen(this->listener, BACKLOG) < 0)
+        throw runtime_error("can't listen on " + path + ": " + strerror(errno));
+    this->socket_path = path;
+}
+
+void Server::listen_tcp(u_int16_t port) {
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    this->listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (this->listener < 0)
+        throw runtime_error(string("socket: ") + strerror(errno));
+    int reuse = 1;
+    ::setsockopt(this->listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(this->listener, (sockaddr *) &address, sizeof(address)) < 0 || ::listen(this->listener, BACKLOG) < 0)
+        throw runtime_error("can't listen on port " + to_string(port) + ": " + strerror(errno));
+}
+
+void Server::serve() {
+    while (true) {
+        int fd = ::accept(this->listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            cerr << "accept: " << strerror(errno) << endl;
+            return;
+        }
+        thread(&Server::session, this, fd).detach();
+    }
+}
+
+// A command's output is collected and sent back whole. QUIT (or hanging up) ends the session.
+void Server::session(int fd) {
+    string command;
+    while (Protocol::receive_message(fd, command)) {
+        string trimmed = command;
+        trimmed.erase(0, trimmed.find_first_not_of(" \t\r\n"));
+        trimmed.erase(trimmed.find_last_not_of(" \t\r\n;") + 1);
+        if (trimmed == "quit" || trimmed == "QUIT")
+            break;
+
+        ostringstream out, err;
+        {
+            lock_guard<mutex> guard(this->running);
+            try {
+                this->runner(command, out, err);
+            } catch (exception &e) {
+                err << e.what() << endl;
+            }
+        }
+        if (this->finisher) {
+            try {
+                this->finisher(err);
+            } catch (exception &e) {
+                err << e.what() << endl;
+            }
+        }
+        string response = err.str().empty() ? string(1, Protocol::RESPONSE_OK) : string(1, Protocol::RESPONSE_ERROR);
+        response += out.str() + err.str();
+        if (!Protocol::send_message(fd, response))
+            break;
+    }
+    {
+        lock_guard<mutex> guard(this->running);
+        try {
+            this->cleanup();
+        } catch (exception &e) {
+            cerr << "ending session: " << e.what() << endl;
+        }
+    }
+    ::close(fd);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @class Server - serves client sessions over a Unix domain socket or localhost TCP (see Protocol.h), each on its
+ * own thread, all in this process and so sharing its Berkeley DB environment, buffer pool and catalog caches.
+ *
+ * Each session runs its commands through the runner it was given and sends back what they print. A session's
+ * transaction state and prepared statements are its own (they are kept per thread), and are thrown away when
+ * it disconnects. The storage engine isn't safe to enter from two threads at once, so only one session's
+ * command runs at a time; sessions take turns between commands.
+ */
+class Server {
+public:
+    // runs one line of input, writing what it would print to out and any error messages to err
+    typedef std::function<void(const std::string &command, std::ostream &out, std::ostream &err)> CommandRunner;
+
+    // called on a session's thread when the session ends
+    typedef std::function<void()> SessionCleanup;
+
+    // called on a session's thread after each command, once other sessions can run theirs again but before the
+    // command's output is sent (e.g. to wait for its commit to reach the disk); writes any error messages to err
+    typedef std::function<void(std::ostream &err)> CommandFinisher;
+
+    Server(CommandRunner runner, SessionCleanup cleanup, CommandFinisher finisher = nullptr);
+
+    virtual ~Server();
+
+    Server(const Server &other) = delete;
+
+    Server &operator=(const Server &other) = delete;
+
+    /**
+     * Listen on a Unix domain socket (replacing any stale socket file at the path).
+     * @throws  std::runtime_error if the socket can't be set up
+     */
+    void listen_unix(const std::string &path);
+
+    /**
+     * Listen on a TCP port, on the loopback interface only.
+     * @throws  std::runtime_error if the socket can't be set up
+     */
+    void listen_tcp(u_int16_t port);
+
+    /**
+     * Accept connections, starting a session thread for each, until the listening socket fails.
+     */
+    void serve();
+
+    /**
+     * The lock held while a command runs. Whatever a command waits for that another session's command has to
+     * bring about (e.g. a lock its transaction holds) must be waited for with this let go.
+     */
+    std::mutex &get_command_lock() { return running; }
+
+protected:
+    CommandRunner runner;
+    SessionCleanup cleanup;
+    CommandFinisher finisher;
+    int listener;
+    std::string socket_path;  // to remove when done, if listening on a Unix domain socket
+    std::mutex running;       // held while a command runs
+
+    void session(int fd);
+};
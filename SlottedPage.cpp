@@ -11,13 +11,14 @@ using u32 = u_int32_t;
 //memcpy - source pointer, destination pointer, number of bytes to copy
 //location - newsize - size is the formula to find 
 SlottedPage::SlottedPage(Dbt& block, BlockID block_id, bool is_new) : DbBlock(block, block_id, is_new){
-    if(is_new) {
-        this->num_records = 0;
-        this->end_free = DbBlock::BLOCK_SZ - 1;
-        put_header();
-    } else{
-        get_header(this->num_records, this->end_free);
-    }
+    init(is_new);
+}
+
+SlottedPage::SlottedPage(std::vector<char> &&bytes, BlockID block_id, bool is_new) : DbBlock(block_id),
+                                                                                       buffer(std::move(bytes)) {
+    this->block.set_data(this->buffer.data());
+    this->block.set_size((u32) this->buffer.size());
+    init(is_new);
 }
 
 // Add a new record to the block. Return its id.
@@ -27,7 +28,7 @@ RecordID SlottedPage::add(const Dbt* data) {
     u16 id = ++this->num_records;
     u16 size = (u16) data->get_size();
     this->end_free -= size;
-    u16 loc = this->end_free + 1;
+    u32 loc = this->end_free + 1U;
     put_header();
     put_header(id, size, loc);
     memcpy(this->address(loc), data->get_data(), size);
@@ -44,23 +45,33 @@ Dbt *SlottedPage::get(RecordID record_id) const{
 }
 
 //This method replaces at location recordID with the given data encapsulated isn the Dbt.
+//A deleted record can be put back this way too (rolling back a delete does); it goes where add would put it.
 void SlottedPage::put(RecordID recordID, const Dbt &data) {
     u16 size = get_n(4*recordID); //This is the size of the entry
     u16 location = get_n(4*recordID+2); //This is the offset, gotten using the id
-    u16 newSize = (u16)data.get_size(); //This is the new size of the data in the entry
+    u32 newSize = data.get_size(); //This is the new size of the data in the entry
+    if(location == 0) { //deleted, so there's no old data to make room around
+        if(!this->has_room(newSize))
+            throw DbBlockNoRoomError("not enough room for restored record");
+        this->end_free -= (u16) newSize;
+        u32 loc = this->end_free + 1U;
+        put_header();
+        put_header(recordID, (u16) newSize, (u16) loc);
+        memcpy(this->address(loc), data.get_data(), newSize);
+        return;
+    }
     if(newSize>size) { //If the new entry is larger
-        if(!this->has_room(newSize-size)) {
-            cout << "No space for new page." << endl;
-        } else{
-            memcpy(this->address(location-newSize-size), data.get_data(), newSize); //Copy from start of old data to end of new data
-            this->slide(location, location-newSize-size); //
-        }
+        u32 extra = newSize - size;
+        if(!this->has_room(extra))
+            throw DbBlockNoRoomError("not enough room for enlarged record");
+        this->slide(location, location - extra); //open up a gap of extra bytes in front of the old data
+        memcpy(this->address(location - extra), data.get_data(), newSize); //Copy from new start of record
     } else{ //if newsize is smaller than oldsize
         memcpy(this->address(location), data.get_data(), newSize); //copy data from data of newsize over this->address
         this->slide(location+newSize, location+size);
     }
     get_header(size, location, recordID);
-    put_header(recordID, newSize, location);
+    put_header(recordID, (u16) newSize, location);
 }
 
 //delete a record given the record ID.  
@@ -68,7 +79,7 @@ void SlottedPage::del(RecordID record_id){
     u16 size, location;
     this->get_header(size, location, record_id);
     this->put_header(record_id);
-    this->slide(location, location + size);
+    this->slide(location, (u32) location + size);
 }
 //This method returns all of the ids containted within the object.
 RecordIDs *SlottedPage::ids() const{
@@ -82,13 +93,28 @@ RecordIDs *SlottedPage::ids() const{
 	}
 	return idsets;
 }
+// How big a record add() would accept right now (same arithmetic as has_room).
+u_int32_t SlottedPage::get_free_space() {
+    int available = (int) this->end_free - (int) (this->num_records + 2) * 4;
+    return available > 0 ? (u_int32_t) available : 0;
+}
 // SLOTTEDPAGE PROTECTED METHODS START HERE
 
+void SlottedPage::init(bool is_new) {
+    if(is_new) {
+        this->num_records = 0;
+        this->end_free = (u16) (this->block.get_size() - 1);
+        put_header();
+    } else{
+        get_header(this->num_records, this->end_free);
+    }
+}
+
 
 //Pass by reference, so size and location are changed to the values held at record_id.  The +2 is the offset.
 void SlottedPage::get_header(u16 &size, u16 &loc, RecordID id) const{
-    size = get_n((u16)4*id);
-    loc = get_n((u16)(4*id+2));
+    size = get_n(4U*id);
+    loc = get_n(4U*id+2);
 }
 
 //Put_header is the opposite, setting the values at given record ID
@@ -97,37 +123,37 @@ void SlottedPage::put_header(RecordID id, u16 size, u16 loc){
         size = this->num_records;
         loc = this->end_free;
     }
-    put_n((u16)4*id, size);
-    put_n((u16)(4*id+2), loc);
+    put_n(4U*id, size);
+    put_n(4U*id+2, loc);
 }
 
 // Get 2-byte integer at given offset in block.
-u16 SlottedPage::get_n(u16 offset) const{
+u16 SlottedPage::get_n(u32 offset) const{
     return *(u16*)this->address(offset);
 }
 
 // Put a 2-byte integer at given offset in block.
-void SlottedPage::put_n(u16 offset, u16 n) {
+void SlottedPage::put_n(u32 offset, u16 n) {
     *(u16*)this->address(offset) = n;
 }
 
 // Make a void* pointer for a given offset into the data block.
-void* SlottedPage::address(u_int16_t offset) const{
+void* SlottedPage::address(u32 offset) const{
     return (void*)((char*)this->block.get_data() + offset);
 }
 
 //Check available room in the page
-bool SlottedPage::has_room(u_int16_t size) {
-	u16 available=this->end_free - (this->num_records + 2) * 4;
-	return (size <= available);
+bool SlottedPage::has_room(u32 size) {
+	return size <= this->get_free_space();
 }
-//move data down to make room
-void SlottedPage::slide(u_int16_t start, u_int16_t end){
-	u16 shift = end - start;
+//move the data between the free space and start so it ends at end instead (towards the end of the block when
+//end > start, i.e. closing a gap; towards the free space when end < start, i.e. opening one)
+void SlottedPage::slide(u32 start, u32 end){
+	int shift = (int) end - (int) start;
 	if(shift==0) return;
     // slide data
-    void *to = this->address((u16) (this->end_free + 1 + shift));
-    void *from = this->address((u16) (this->end_free + 1));
+    void *to = this->address((u32) ((int) this->end_free + 1 + shift));
+    void *from = this->address(this->end_free + 1U);
     int bytes = start - (this->end_free + 1U);
     memmove(to, from, bytes);
     
@@ -137,12 +163,12 @@ void SlottedPage::slide(u_int16_t start, u_int16_t end){
 	for(RecordID id:*idset){
 		get_header(size, location,id);
 		if (location <= start) {
-			location += shift;
+			location = (u16) ((int) location + shift);
 			put_header(id, size, location);
 		}
 	}
     delete idset; 
-	this->end_free += shift;
+	this->end_free = (u16) ((int) this->end_free + shift);
 	this->put_header();
 }
 
@@ -17,6 +17,7 @@ using u32 = u_int32_t;
             Bytes 0x04 - 0x05: size of record 1
             Bytes 0x06 - 0x07: offset to record 1
             etc.
+        Blocks can be up to 64kB, so the header fields still fit in 2 bytes, but offset arithmetic is done in 4.
  *
  */
 
@@ -28,6 +29,9 @@ public:
     //              and is_new MUST be correct (this is a contractual requirement)
     SlottedPage(Dbt &block, BlockID block_id, bool is_new);
 
+    // Same, but the page keeps its own copy of the block's bytes (e.g. one decompressed from the file)
+    SlottedPage(std::vector<char> &&bytes, BlockID block_id, bool is_new);
+
     // Big 5 - we only need the destructor, copy-ctor, move-ctor, and op= are unnecessary
     // but we delete them explicitly just to make sure we don't use them accidentally
     virtual ~SlottedPage() {}
@@ -51,22 +55,27 @@ public:
 
     virtual RecordIDs *ids(void) const;
 
+    virtual u_int32_t get_free_space() override;
+
 protected:
     u_int16_t num_records;
     u_int16_t end_free;
+    std::vector<char> buffer;  // only used by pages that own their bytes
+
+    virtual void init(bool is_new);
 
     virtual void get_header(u_int16_t &size, u_int16_t &loc, RecordID id = 0) const;
 
     virtual void put_header(RecordID id = 0, u_int16_t size = 0, u_int16_t loc = 0);
 
-    virtual bool has_room(u_int16_t size);
+    virtual bool has_room(u_int32_t size);
 
-    virtual void slide(u_int16_t start, u_int16_t end);
+    virtual void slide(u_int32_t start, u_int32_t end);
 
-    virtual u_int16_t get_n(u_int16_t offset) const;
+    virtual u_int16_t get_n(u_int32_t offset) const;
 
-    virtual void put_n(u_int16_t offset, u_int16_t n);
+    virtual void put_n(u_int32_t offset, u_int16_t n);
 
-    virtual void *address(u_int16_t offset) const;
+    virtual void *address(u_int32_t offset) const;
 };
 
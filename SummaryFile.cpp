@@ -0,0 +1,36 @@
+#include "SummaryFile.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+SummaryFile::SummaryFile(std::string dbfilename, u32 entry_size) : BlockFile(dbfilename, block_size_for(entry_size), false),
+                                                                   entry_size(entry_size) {
+    this->entries_per_block = entry_size == 0 ? 0 : this->block_size / entry_size;
+}
+
+u32 SummaryFile::block_size_for(u32 entry_size) {
+    if (entry_size == 0)
+        return DbBlock::BLOCK_SZ;
+    return (entry_size + DbBlock::BLOCK_SZ - 1) / DbBlock::BLOCK_SZ * DbBlock::BLOCK_SZ;
+}
+
+void SummaryFile::load(std::vector<char> &entries) {
+    entries.clear();
+    vector<char> buffer(this->block_size);
+    for (BlockID map_block_id = 1; map_block_id <= this->last; map_block_id++) {
+        this->read(map_block_id, buffer.data());
+        entries.insert(entries.end(), buffer.begin(), buffer.begin() + this->entries_per_block * this->entry_size);
+    }
+}
+
+void SummaryFile::write_entry(const std::vector<char> &entries, BlockID block_id) {
+    BlockID map_block_id = (block_id - 1) / this->entries_per_block + 1;
+    size_t first = (size_t) (map_block_id - 1) * this->entries_per_block * this->entry_size;
+    size_t size = min((size_t) this->entries_per_block * this->entry_size, entries.size() - first);
+    vector<char> buffer(this->block_size, 0);
+    memcpy(buffer.data(), entries.data() + first, size);
+    this->write(map_block_id, buffer.data());
+}
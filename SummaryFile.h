@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include "BlockFile.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class SummaryFile - a BlockFile of fixed-size entries, one per block of a heap file, packed as many to a block
+ * as fit.
+ *
+ * Used by the per-block summaries beside a heap file (ZoneMap, BloomFilter), which keep all the entries in memory
+ * and write back the block holding an entry whenever they change it. The entry for heap block i is at
+ * (i - 1) * entry_size in the in-memory copy. The summaries only ever widen, so the writes are committed at once
+ * rather than with the transaction that made them (see BlockFile): blocks of entries are shared by many heap blocks,
+ * which different transactions write.
+ */
+class SummaryFile : public BlockFile {
+public:
+    /**
+     * @param dbfilename  the file
+     * @param entry_size  bytes per entry (0 if there is nothing to keep, so no file is ever used)
+     */
+    SummaryFile(std::string dbfilename, u32 entry_size);
+
+    virtual ~SummaryFile() {}
+
+    virtual u32 get_entry_size() const { return entry_size; }
+
+    /**
+     * Read every entry in the file.
+     * @param entries  replaced by the entries, as many as the file's blocks hold
+     */
+    virtual void load(std::vector<char> &entries);
+
+    /**
+     * Write out the block holding a heap block's entry.
+     * @param entries   all the entries
+     * @param block_id  the heap block whose entry changed
+     */
+    virtual void write_entry(const std::vector<char> &entries, BlockID block_id);
+
+protected:
+    u32 entry_size;
+    u32 entries_per_block;
+
+    // normally one block holds hundreds of entries, but a very wide entry needs bigger blocks
+    static u32 block_size_for(u32 entry_size);
+};
@@ -0,0 +1,224 @@
+#include "TableStatistics.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+// fractions of the rows predicates are guessed to keep when there is nothing better to go on
+static const double DEFAULT_EQUALITY_SELECTIVITY = 0.005;
+static const double DEFAULT_RANGE_SELECTIVITY = 1.0 / 3;
+
+// FNV-1a over the value's bytes, then mixed (splitmix64's finalizer) so that small INTs spread over all the bits.
+static u_int64_t hash_of(const Value &value) {
+    const char *bytes;
+    size_t size;
+    if (value.data_type == ColumnAttribute::TEXT) {
+        bytes = value.s.data();
+        size = value.s.size();
+    } else {
+        bytes = (const char *) &value.n;
+        size = sizeof(value.n);
+    }
+    u_int64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (u_int8_t) bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+void HyperLogLog::add(const Value &value) {
+    u_int64_t hash = hash_of(value);
+    u32 which = (u32) (hash >> (64 - PRECISION));
+    u_int64_t rest = hash << PRECISION;
+    u_int8_t rank = 1;
+    while (rank <= 64 - PRECISION && (rest & (1ULL << 63)) == 0) {
+        rank++;
+        rest <<= 1;
+    }
+    this->registers[which] = max(this->registers[which], rank);
+}
+
+// The raw estimate is corrected by linear counting while many registers are still empty.
+double HyperLogLog::estimate() const {
+    double m = (double) this->registers.size();
+    double sum = 0;
+    u32 zeros = 0;
+    for (auto rank: this->registers) {
+        sum += ldexp(1.0, -rank);
+        if (rank == 0)
+            zeros++;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros != 0)
+        estimate = m * log(m / zeros);
+    return estimate;
+}
+
+void Histogram::build(std::vector<Value> values) {
+    this->bounds.clear();
+    if (values.empty())
+        return;
+    sort(values.begin(), values.end());
+    size_t buckets = min((size_t) BUCKETS, values.size() - 1);
+    if (buckets == 0) {
+        this->bounds.push_back(values.front());
+        return;
+    }
+    for (size_t i = 0; i <= buckets; i++)
+        this->bounds.push_back(values[i * (values.size() - 1) / buckets]);
+}
+
+double Histogram::fraction(const ValueRange &range) const {
+    if (this->bounds.empty())
+        return DEFAULT_RANGE_SELECTIVITY;
+    if (this->bounds.size() == 1)
+        return range.contains(this->bounds[0]) ? 1.0 : 0.0;
+
+    double covered = 0;
+    for (size_t i = 0; i + 1 < this->bounds.size(); i++) {
+        const Value &low = this->bounds[i], &high = this->bounds[i + 1];
+        if (!range.overlaps(low, high))
+            continue;
+        if (range.contains(low) && range.contains(high)) {
+            covered += 1;
+        } else if (low.data_type == ColumnAttribute::TEXT || high.n == low.n) {
+            covered += 0.5;
+        } else {
+            double from = range.has_min ? max((double) range.min.n, (double) low.n) : low.n;
+            double to = range.has_max ? min((double) range.max.n, (double) high.n) : high.n;
+            covered += max(0.0, to - from) / ((double) high.n - low.n);
+        }
+    }
+    return covered / (double) (this->bounds.size() - 1);
+}
+
+std::string Histogram::to_string() const {
+    string text;
+    for (auto const &bound: this->bounds) {
+        string value = bound.data_type == ColumnAttribute::TEXT ? bound.s : std::to_string(bound.n);
+        text += std::to_string(value.size()) + ":" + value;
+    }
+    return text;
+}
+
+Histogram Histogram::from_string(const std::string &text, ColumnAttribute::DataType data_type) {
+    Histogram histogram;
+    size_t at = 0;
+    while (at < text.size()) {
+        size_t colon = text.find(':', at);
+        if (colon == string::npos)
+            throw DbRelationError("bad histogram '" + text + "'");
+        size_t size = stoul(text.substr(at, colon - at));
+        string value = text.substr(colon + 1, size);
+        at = colon + 1 + size;
+        if (data_type == ColumnAttribute::TEXT) {
+            histogram.bounds.push_back(Value(value));
+        } else {
+            Value bound((int32_t) stol(value));
+            bound.data_type = data_type;
+            histogram.bounds.push_back(bound);
+        }
+    }
+    return histogram;
+}
+
+double ColumnStatistics::selectivity(const ValueRange &range) const {
+    if (range.is_equality()) {
+        if (!this->histogram.bounds.empty() && !range.overlaps(this->histogram.bounds.front(),
+                                                                this->histogram.bounds.back()))
+            return 0;
+        return this->distinct_count == 0 ? 0 : 1.0 / this->distinct_count;
+    }
+    return this->histogram.fraction(range);
+}
+
+TableStatistics TableStatistics::collect(DbRelation &table, const Identifier &table_name) {
+    TableStatistics statistics;
+    statistics.table_name = table_name;
+    const ColumnNames &column_names = table.get_column_names();
+    ColumnAttributes *column_attributes = table.get_column_attributes(column_names);
+
+    BlockID picked, block_count;
+    Handles *handles = table.sample(SAMPLE_BLOCKS, picked, block_count);
+    vector<HyperLogLog> distinct(column_names.size());
+    vector<vector<Value>> values(column_names.size());
+    vector<u_int64_t> widths(column_names.size(), 0);
+    for (auto const &handle: *handles) {
+        ValueDict *row = table.project(handle);
+        for (uint col = 0; col < column_names.size(); col++) {
+            Value &value = (*row)[column_names[col]];
+            distinct[col].add(value);
+            if (value.data_type == ColumnAttribute::TEXT)
+                widths[col] += sizeof(u16) + value.s.size();
+            else if (value.data_type == ColumnAttribute::BOOLEAN)
+                widths[col] += 1;
+            else
+                widths[col] += sizeof(int32_t);
+            values[col].push_back(value);
+        }
+        delete row;
+    }
+
+    size_t sampled_rows = handles->size();
+    delete handles;
+    statistics.block_count = block_count;
+    statistics.row_count = picked == 0 ? 0 : (u32) llround((double) sampled_rows * block_count / picked);
+    for (uint col = 0; col < column_names.size(); col++) {
+        ColumnStatistics column;
+        column.column_name = column_names[col];
+        column.data_type = (*column_attributes)[col].get_data_type();
+        double estimate = min(distinct[col].estimate(), (double) sampled_rows);
+        if (sampled_rows != 0 && picked < block_count && estimate > 0.1 * sampled_rows)
+            estimate = estimate * statistics.row_count / sampled_rows;  // nearly unique, so more in the rest
+        column.distinct_count = (u32) llround(estimate);
+        if (sampled_rows != 0 && column.distinct_count == 0)
+            column.distinct_count = 1;
+        column.avg_width = sampled_rows == 0 ? 0 : (u32) (widths[col] / sampled_rows);
+        column.histogram.build(values[col]);
+        statistics.columns.push_back(column);
+    }
+    delete column_attributes;
+    return statistics;
+}
+
+TableStatistics TableStatistics::guess(DbRelation &table, const Identifier &table_name) {
+    TableStatistics statistics;
+    statistics.table_name = table_name;
+    statistics.block_count = table.get_block_count();
+    statistics.row_count = statistics.block_count * DEFAULT_ROWS_PER_BLOCK;
+    return statistics;
+}
+
+u32 TableStatistics::avg_row_width() const {
+    u32 width = 0;
+    for (auto const &column: this->columns)
+        width += column.avg_width;
+    return width;
+}
+
+const ColumnStatistics *TableStatistics::get_column(const Identifier &column_name) const {
+    for (auto const &column: this->columns)
+        if (column.column_name == column_name)
+            return &column;
+    return nullptr;
+}
+
+double TableStatistics::selectivity(const ValueRanges &ranges) const {
+    double selectivity = 1;
+    for (auto const &range: ranges) {
+        const ColumnStatistics *column = get_column(range.first);
+        if (column != nullptr)
+            selectivity *= column->selectivity(range.second);
+        else
+            selectivity *= range.second.is_equality() ? DEFAULT_EQUALITY_SELECTIVITY : DEFAULT_RANGE_SELECTIVITY;
+    }
+    return selectivity;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class HyperLogLog - estimates how many distinct values have been added, in a fixed 2^PRECISION bytes.
+ * Each value's 64-bit hash picks a register by its top PRECISION bits; the register keeps the longest run of
+ * leading zeros seen in the rest. The standard error is about 1.04 / sqrt(2^PRECISION).
+ */
+class HyperLogLog {
+public:
+    static const u32 PRECISION = 11;  // 2048 registers, about 2.3% error
+
+    HyperLogLog() : registers(1U << PRECISION, 0) {}
+
+    void add(const Value &value);
+
+    double estimate() const;
+
+protected:
+    std::vector<u_int8_t> registers;
+};
+
+/**
+ * @class Histogram - equi-depth histogram of a column's values.
+ * bounds[0] is the smallest value seen and bounds.back() the largest; each of the bounds.size() - 1 buckets
+ * between neighbouring bounds holds about the same number of rows. Empty if there were no values.
+ */
+class Histogram {
+public:
+    static const u32 BUCKETS = 10;
+
+    std::vector<Value> bounds;
+
+    /**
+     * Build the histogram for a column from (a sample of) its values.
+     */
+    void build(std::vector<Value> values);
+
+    /**
+     * Estimate the fraction of the rows whose value is in the range. Within a bucket INT values are taken to
+     * be spread evenly; a TEXT bucket the range only partly covers counts half.
+     */
+    double fraction(const ValueRange &range) const;
+
+    /**
+     * Write the bounds out as text, each one as its length, a colon, then the value (INTs in decimal).
+     */
+    std::string to_string() const;
+
+    /**
+     * Read back what to_string wrote.
+     */
+    static Histogram from_string(const std::string &text, ColumnAttribute::DataType data_type);
+};
+
+/**
+ * @class ColumnStatistics - what ANALYZE found out about one column.
+ */
+class ColumnStatistics {
+public:
+    Identifier column_name;
+    ColumnAttribute::DataType data_type;
+    u32 distinct_count;
+    u32 avg_width;  // bytes the value takes in a stored row
+    Histogram histogram;
+
+    ColumnStatistics() : data_type(ColumnAttribute::INT), distinct_count(0), avg_width(0) {}
+
+    /**
+     * Estimate the fraction of the rows whose value for this column is in the range: one over the number of
+     * distinct values for an equality, otherwise from the histogram.
+     */
+    double selectivity(const ValueRange &range) const;
+};
+
+/**
+ * @class TableStatistics - what ANALYZE found out about a table, kept in the _statistics schema table.
+ */
+class TableStatistics {
+public:
+    /**
+     * ANALYZE reads at most this many blocks of a table.
+     */
+    static const BlockID SAMPLE_BLOCKS = 300;
+
+    /**
+     * Guess at how many rows fit in a block, for tables that haven't been analyzed.
+     */
+    static const uint DEFAULT_ROWS_PER_BLOCK = 50;
+
+    Identifier table_name;
+    u32 row_count;
+    u32 block_count;
+    std::vector<ColumnStatistics> columns;
+
+    TableStatistics() : row_count(0), block_count(0) {}
+
+    /**
+     * Work out a table's statistics from a sample of its blocks. The row count is scaled up from the sample.
+     * The distinct counts are too, for columns that look nearly unique in the sample. The rest are taken to
+     * have no values the sample missed.
+     * @param table       the table
+     * @param table_name  its name
+     */
+    static TableStatistics collect(DbRelation &table, const Identifier &table_name);
+
+    /**
+     * Stand-in statistics for a table that has never been analyzed: its current block count, with
+     * DEFAULT_ROWS_PER_BLOCK rows in each, and nothing about its columns (so selectivities are defaults).
+     * @param table       the table
+     * @param table_name  its name
+     */
+    static TableStatistics guess(DbRelation &table, const Identifier &table_name);
+
+    /**
+     * Bytes an average row takes.
+     */
+    u32 avg_row_width() const;
+
+    /**
+     * @returns  the statistics for the named column, or nullptr if there are none
+     */
+    const ColumnStatistics *get_column(const Identifier &column_name) const;
+
+    /**
+     * Estimate the fraction of the rows that satisfy all of the ranges (taking the columns to be independent).
+     */
+    double selectivity(const ValueRanges &ranges) const;
+
+    /**
+     * Estimate how many rows satisfy all of the ranges.
+     */
+    double estimated_rows(const ValueRanges &ranges) const { return this->row_count * selectivity(ranges); }
+};
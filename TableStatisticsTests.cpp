@@ -0,0 +1,89 @@
+#include "TableStatisticsTests.h"
+#include "TableStatistics.h"
+#include "HeapTable.h"
+#include <cmath>
+
+using namespace std;
+
+namespace TableStatisticsTests{
+    static bool near(double estimate, double actual, double tolerance){
+        return fabs(estimate - actual) <= actual * tolerance;
+    }
+
+    // distinct counts come out within a few percent, however many times each value is added
+    void testHyperLogLog(){
+        cout << "Testing HyperLogLog" << endl;
+        HyperLogLog sketch;
+        for(int repeat = 0; repeat < 3; repeat++)
+            for(int i = 0; i < 100000; i++)
+                sketch.add(Value(i));
+        if(!near(sketch.estimate(), 100000, 0.08))
+            throw DbRelationError("HyperLogLog estimated " + to_string(sketch.estimate()) + " distinct values of 100000");
+    }
+
+    // a histogram's buckets hold about the same number of values, estimate ranges by them, and are read back as
+    // they were written
+    void testHistogram(){
+        cout << "Testing histograms" << endl;
+        vector<Value> values;
+        for(int i = 0; i < 10000; i++)
+            values.push_back(Value(i * i % 10007));
+        Histogram histogram;
+        histogram.build(values);
+        ValueRange below;
+        below.restrict_max(Value(2500), false);
+        ValueRange above;
+        above.restrict_min(Value(20000), true);
+        Histogram readBack = Histogram::from_string(histogram.to_string(), ColumnAttribute::INT);
+        string problem;
+        if(histogram.bounds.size() != Histogram::BUCKETS + 1)
+            problem = "histogram has " + to_string(histogram.bounds.size()) + " bounds";
+        else if(!near(histogram.fraction(below), 0.25, 0.2) || histogram.fraction(above) != 0)
+            problem = "histogram estimated " + to_string(histogram.fraction(below)) + " of the values below a quarter";
+        else if(readBack.bounds != histogram.bounds)
+            problem = "histogram didn't read back as it was written";
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    // ANALYZE finds a table's row count, how many distinct values each column has, and how selective
+    // comparisons with them are
+    void testCollect(){
+        cout << "Testing table statistics" << endl;
+        ColumnNames columnNames = {"id", "grp"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::INT)};
+        HeapTable table("_test_stats", columnNames, columnAttributes);
+        table.create();
+        ValueDict row;
+        for(int i = 0; i < 5000; i++){
+            row["id"] = Value(i);
+            row["grp"] = Value(i % 10);
+            table.insert(&row);
+        }
+        TableStatistics statistics = TableStatistics::collect(table, "_test_stats");
+        table.drop();
+        const ColumnStatistics *id = statistics.get_column("id");
+        const ColumnStatistics *grp = statistics.get_column("grp");
+        ValueRanges ranges;
+        ranges["grp"].restrict_min(Value(3), true);
+        ranges["grp"].restrict_max(Value(3), true);
+        double oneGroup = statistics.estimated_rows(ranges);
+        ranges["id"].restrict_max(Value(1000), false);
+        double both = statistics.estimated_rows(ranges);
+        string problem;
+        if(statistics.row_count != 5000 || statistics.block_count == 0)
+            problem = "statistics counted " + to_string(statistics.row_count) + " rows of 5000";
+        else if(id == nullptr || grp == nullptr || !near(id->distinct_count, 5000, 0.1) || grp->distinct_count != 10)
+            problem = "statistics got the distinct counts wrong";
+        else if(!near(oneGroup, 500, 0.1) || !near(both, 100, 0.3))
+            problem = "statistics estimated " + to_string(oneGroup) + " and " + to_string(both) + " rows instead of 500 and 100";
+        if(!problem.empty())
+            throw DbRelationError(problem);
+    }
+
+    void testAll(){
+        testHyperLogLog();
+        testHistogram();
+        testCollect();
+    }
+}
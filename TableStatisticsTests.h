@@ -0,0 +1,8 @@
+#pragma once
+
+namespace TableStatisticsTests{
+    void testHyperLogLog();
+    void testHistogram();
+    void testCollect();
+    void testAll();
+}
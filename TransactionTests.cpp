@@ -1,17 +1,111 @@
 #include "TransactionTests.h"
+#include "HeapTable.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace std;
 
 namespace TransactionTests{
-    void testAll(){
+    static const u_int32_t ENV_FLAGS = DB_CREATE | DB_INIT_MPOOL | DB_INIT_LOG | DB_INIT_TXN | DB_THREAD;
+
+    static void removeDirectory(const string &path){
+        DIR *dir = opendir(path.c_str());
+        if(dir == nullptr)
+            return;
+        while(dirent *entry = readdir(dir))
+            if(string(entry->d_name) != "." && string(entry->d_name) != "..")
+                unlink((path + "/" + entry->d_name).c_str());
+        closedir(dir);
+        rmdir(path.c_str());
+    }
+
+    // A child process commits one transaction, gets another's change written out to the table's file, and dies
+    // without ending it. Opening its environment with recovery has to leave the first change and take out the
+    // second.
+    void testRecovery(){
+        cout << "Testing crash recovery" << endl;
+        const char *home;
+        _DB_ENV->get_home(&home);
+        string path = string(home) + "/_test_recovery";
+        removeDirectory(path);
+        mkdir(path.c_str(), 0755);
+        ColumnNames columnNames = {"id"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT)};
+        ValueDict row;
+        pid_t child = fork();
+        if(child == 0){
+            int status = 1;
+            try{
+                DbEnv env(0U);
+                env.set_flags(DB_AUTO_COMMIT | DB_TXN_NOSYNC, 1);
+                env.open(path.c_str(), ENV_FLAGS, 0);
+                _DB_ENV = &env;
+                TransactionManager::groupCommit = nullptr; // its thread stayed in the parent
+                HeapTable table("_test_recovery", columnNames, columnAttributes);
+                table.create();
+                TransactionManager tm;
+                tm.begin_transaction();
+                row["id"] = Value(1);
+                table.insert(&row);
+                tm.commit_transaction();
+                tm.begin_transaction();
+                row["id"] = Value(2);
+                table.insert(&row);
+                env.memp_sync(nullptr);
+                status = 0;
+            } catch(exception &e){
+                cerr << "crashing process: " << e.what() << endl;
+            }
+            _exit(status); // nothing closed, and the second transaction neither committed nor aborted
+        }
+        int status = 0;
+        string problem;
+        if(child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            problem = "the crashing process failed before it could crash";
+        if(problem.empty()){
+            DbEnv env(0U);
+            env.open(path.c_str(), ENV_FLAGS | DB_RECOVER, 0);
+            DbEnv *saved = _DB_ENV;
+            _DB_ENV = &env;
+            try{
+                HeapTable table("_test_recovery", columnNames, columnAttributes);
+                table.open();
+                Handles *handles = table.select();
+                ValueDicts *rows = table.project(handles);
+                if(rows->size() != 1 || (*rows->front())["id"] != Value(1))
+                    problem = "recovery left " + to_string(rows->size()) + " rows instead of just the committed one";
+                for(auto recovered : *rows)
+                    delete recovered;
+                delete rows;
+                delete handles;
+                table.close();
+            } catch(exception &e){
+                problem = string("couldn't read the recovered table: ") + e.what();
+            }
+            _DB_ENV = saved;
+            env.close(0);
+        }
+        removeDirectory(path);
+        if(!problem.empty())
+            throw TransactionManagerError(problem);
+    }
+
+    // each level's begin, commit and rollback report where the stack is left
+    void testStack(){
         cout << "Testing transaction stack" << endl;
         TransactionManager tm = TransactionManager();
-        tm.begin_transaction();
-        tm.begin_transaction();
-        tm.commit_transaction();
-        tm.begin_transaction();
-        tm.rollback_transaction();
-        tm.rollback_transaction();
-        cout << "Tests passed!" << endl;
+        cout << tm.begin_transaction() << endl;
+        cout << tm.begin_transaction() << endl;
+        cout << tm.commit_transaction() << endl;
+        cout << tm.begin_transaction() << endl;
+        cout << tm.rollback_transaction() << endl;
+        cout << tm.rollback_transaction() << endl;
+    }
+
+    void testAll(){
+        testStack();
+        testRecovery();
     }
-}
\ No newline at end of file
+}
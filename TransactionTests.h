@@ -1,5 +1,7 @@
 #include "Transactions.h"
 
 namespace TransactionTests{
+    void testStack();
+    void testRecovery();
     void testAll();
 }
\ No newline at end of file
@@ -1,33 +1,35 @@
 #include "Transactions.h"
+#include "PageFile.h"
 using namespace std;
 using namespace hsql;
 
-void TransactionManager::begin_transaction(){
+GroupCommit* TransactionManager::groupCommit = nullptr;
+
+string TransactionManager::begin_transaction(){
+    // a nested transaction is a child of the one it's nested in, so it only becomes durable along with that
+    DbTxn* parent = txnStack.empty() ? nullptr : txnStack.top();
+    DbTxn* txn;
+    _DB_ENV->txn_begin(parent, &txn, 0);
+    if(parent == nullptr){
+        if(groupCommit != nullptr)
+            groupCommit->begin();
+        beginSnapshot();
+    }
+    txnStack.push(txn);
+    _DB_TXN = txn;
+    undoStack.push(new UndoLog());
+    UndoLog::current = undoStack.top();
+
     highestTransactionID++;
     activeTransactions.push_back(highestTransactionID); // add new ID to active transactions
-    TransactionStatement* stmt = new TransactionStatement(TransactionStatement::BEGIN);
-    TransactionLogRecord record = {highestTransactionID, nullptr, stmt, nullptr, nullptr};
-    transactionLog.push_back(record); // add begin to log
 
     // add a new transaction to the stack
     transactionStack.push(highestTransactionID);
-    cout << "Opened transaction level " << transactionStack.size() << endl;
-}
-
-void TransactionManager::updateTablesAndNames(){
-    // delete memory occupied by old table list
-    for(uint i = 0; i < currentTables.size(); i++){
-        delete currentTables[i];
-        currentTables[i] = nullptr;
-    }
-
-    pair<vector<DbRelation *>, vector<Identifier>*> tablesAndNames = SQLExec::saveTablesAndNames();
-    currentTables = tablesAndNames.first;
-    tableNames = tablesAndNames.second;
+    return "Opened transaction level " + to_string(transactionStack.size());
 }
 
 // commits the current transaction (the one at the top of the stack)
-void TransactionManager::commit_transaction(){
+string TransactionManager::commit_transaction(){
     if(transactionStack.empty())
         throw TransactionManagerError("Attempted to commit a transaction when there are no transactions pending");
 
@@ -39,27 +41,23 @@ void TransactionManager::commit_transaction(){
 
     activeTransactions.erase(it);
 
-    // add commit to log
-    TransactionStatement* stmt = new TransactionStatement(TransactionStatement::COMMIT);
-    TransactionLogRecord record = {id, nullptr, stmt, nullptr, nullptr};
-    transactionLog.push_back(record); 
-
     // update stack
     int oldNumTransactions = transactionStack.size(); // number of transactions before popping stack
     transactionStack.pop();
-
-    // add checkpoint to log
-    TransactionStatement* stmt2 = new TransactionStatement(TransactionStatement::CHECKPOINT);
-    TransactionLogRecord checkpoint = {id, nullptr, stmt2, &currentTables, tableNames};
-    transactionLog.push_back(checkpoint); 
-
-    cout << "Transaction level " << oldNumTransactions << " committed, " <<
-                            (transactionStack.empty() ? "no" : to_string(transactionStack.size()))
-                            << " transactions pending" << endl;
+    UndoLog* undoLog = popUndoLog();
+    if(!undoStack.empty())
+        undoStack.top()->append(*undoLog); // rolling back the outer transaction undoes this one's changes too
+    delete undoLog;
+    DbTxn* txn = txnStack.top();
+    txnStack.pop();
+    commitTxn(txn);
+
+    return "Transaction level " + to_string(oldNumTransactions) + " committed, " +
+           (transactionStack.empty() ? "no" : to_string(transactionStack.size())) + " transactions pending";
 }
 
 // rolls back the current transaction (the one at the top of the stack)
-void TransactionManager::rollback_transaction(){
+string TransactionManager::rollback_transaction(){
     if(transactionStack.empty())
         throw TransactionManagerError("Attempted to roll back a transaction when there are no transactions pending");
     
@@ -70,106 +68,186 @@ void TransactionManager::rollback_transaction(){
         throw TransactionManagerError("Transaction not found in transaction log");
     }
 
-    // add rollback to log
-    TransactionStatement* stmt = new TransactionStatement(TransactionStatement::ROLLBACK);
-    TransactionLogRecord record = {id, nullptr, stmt, nullptr, nullptr};
-    transactionLog.push_back(record); 
-    
-    // reverse data changes
-    // find the location in the transaction log of the last checkpoint 
-    bool found = false;
-    int i = transactionLog.size() -1;
-    vector<Identifier> toDrop; // names of tables to drop during the rollback
-    vector<Identifier> toCreate; // names of tables to create during the rollback
-    
-    while(!found && i >= 0){
-        if(transactionLog[i].transactionStatement->type == (TransactionStatement::CHECKPOINT))
-            found = true;
-        i--;
+    // reverse the changes, newest first, as part of the transaction (which is then committed like any other,
+    // so that the reversal is logged); the reversing changes aren't recorded in the undo log themselves
+    UndoLog* undoLog = undoStack.top();
+    UndoLog::current = nullptr;
+    string error;
+    try {
+        SQLExec::undoChanges(*undoLog);
+    } catch (exception &e) {
+        error = e.what();
     }
 
-    if(i < 0) throw TransactionManagerError("No checkpoint was added before rolling back");
-
-    // @ Prof Guardia, we wrote how we would implement rollback, hoping you could give us partial credit 
-    // see if any tables were created or dropped between the last checkpoint and now
-
-    // drop any tables that were created after the checkpoint, & create any tables that were dropped
-    // after the checkpoint
-
-    // get the records in the tables after the checkpoint (the old tables) as ValueDicts
-    // drop all the tables that were created after the checkpoints
-
-    // for each table that existed both at the checkpoint (old table) and right before the rollback (new table)
-    // drop the table. create it again. populate it with the ValueDicts of the old table.
-
-
-    
     activeTransactions.erase(it); // remove from activeTransactions
 
     // update stack
     int oldNumTransactions = transactionStack.size(); // number of transactions before popping stack
     transactionStack.pop();
-    
+    popUndoLog();
+    DbTxn* txn = txnStack.top();
+    txnStack.pop();
+    if(!error.empty()){
+        // what's been reversed so far and what hasn't are both thrown away by Berkeley DB instead
+        try {
+            abortTxn(txn);
+        } catch (DbException &e) {
+            SQLExec::reloadTables(*undoLog);
+            delete undoLog;
+            throw TransactionManagerError("Transaction level " + to_string(oldNumTransactions) +
+                                          " could not be rolled back: " + error + "; " + e.what());
+        }
+        SQLExec::reloadTables(*undoLog);
+        delete undoLog;
+        throw TransactionManagerError("Transaction level " + to_string(oldNumTransactions) +
+                                      " was aborted instead of rolled back: " + error);
+    }
+    delete undoLog;
+    commitTxn(txn);
 
-    cout << "Transaction level " << oldNumTransactions << " rolled back, " <<
-                            (transactionStack.empty() ? "no" : to_string(transactionStack.size()))
-                            << " transactions pending" << endl;
+    return "Transaction level " + to_string(oldNumTransactions) + " rolled back, " +
+           (transactionStack.empty() ? "no" : to_string(transactionStack.size())) + " transactions pending";
 }
 
-// returns the file descriptor for a database table file
-// @param tableName: the table for which to get the file descriptor
-int TransactionManager::getFD(Identifier tableName){
-    // TODO: get the name of the data directory from the driver
-    string filename = "data/";
-    filename += tableName;
-    filename += ".db";
-    int fd = open(filename.c_str(), O_RDONLY); // get the file descriptor
+// Takes the current level's undo log off undoStack (for the caller to delete), so that changes are recorded in
+// the enclosing level's, if there is one.
+UndoLog* TransactionManager::popUndoLog(){
+    UndoLog* undoLog = undoStack.top();
+    undoStack.pop();
+    UndoLog::current = undoStack.empty() ? nullptr : undoStack.top();
+    return undoLog;
+}
 
-    if(fd == -1)
-        throw TransactionManagerError("Error: failed to get a file descriptor for table "+tableName);
+// Commits a Berkeley DB transaction that has just been taken off txnStack. A nested one just hands its changes
+// to its parent; the outermost one's commit is left in the log buffer for the group commit to flush, and its
+// changes become visible to other sessions' snapshots.
+void TransactionManager::commitTxn(DbTxn* txn){
+    _DB_TXN = txnStack.empty() ? nullptr : txnStack.top();
+    bool outermost = txnStack.empty();
+    try {
+        txn->commit(0); // doesn't sync the log: the environment has DB_TXN_NOSYNC set
+    } catch (DbException &e) {
+        if(outermost){
+            if(groupCommit != nullptr)
+                groupCommit->end();
+            endSnapshot(); // the changes are in the tables anyway
+        }
+        throw;
+    }
+    if(!outermost)
+        return;
+    endSnapshot();
+    if(groupCommit != nullptr)
+        commitTicket = groupCommit->commit();
+    else{
+        _DB_ENV->log_flush(nullptr);
+        if(!PageFile::sync_written())
+            throw TransactionManagerError("Could not flush a page file; the commit may not survive a crash");
+    }
+}
 
-    return fd;
+// Like commitTxn, for a transaction whose changes Berkeley DB is to put back itself.
+void TransactionManager::abortTxn(DbTxn* txn){
+    _DB_TXN = txnStack.empty() ? nullptr : txnStack.top();
+    bool outermost = txnStack.empty();
+    try {
+        txn->abort();
+    } catch (DbException &e) {
+        if(outermost){
+            if(groupCommit != nullptr)
+                groupCommit->end();
+            endSnapshot();
+        }
+        throw;
+    }
+    if(!outermost)
+        return;
+    if(groupCommit != nullptr)
+        groupCommit->end();
+    endSnapshot();
 }
 
-// tries to get a lock
-// @param transactionID: ID of the transaction that's requesting the lock
-// @param fd: table to lock
+// Statements run inside a transaction are part of its Berkeley DB transaction, and read from its snapshot. Every
+// statement records its changes in a log of its own, which the transaction's (if any) takes over when it ends.
+void TransactionManager::begin_statement(bool writes){
+    if(statementLog == nullptr){
+        statementLog = new UndoLog();
+        UndoLog::current = statementLog;
+    }
+    if(!txnStack.empty() || hasSnapshot)
+        return;
+    beginSnapshot();
+    if(!writes)
+        return;
+    _DB_ENV->txn_begin(nullptr, &statementTxn, 0);
+    if(groupCommit != nullptr)
+        groupCommit->begin();
+    _DB_TXN = statementTxn;
+}
 
-void TransactionManager::tryToGetLock(int transactionID, SQLStatement statement, int fd){
-    // determine whether to get a shared or exclusive lock based on the type of statement
-    bool shared = (statement.type() == kStmtSelect || statement.type() == kStmtShow ? true : false);
+// A statement that failed part way through is committed too: its changes so far stay, as they always have,
+// and the caches (e.g. of block counts) that reflect them stay right.
+void TransactionManager::end_statement(){
+    if(statementLog != nullptr){
+        if(!undoStack.empty())
+            undoStack.top()->append(*statementLog);
+        delete statementLog;
+        statementLog = nullptr;
+        UndoLog::current = undoStack.empty() ? nullptr : undoStack.top();
+    }
+    if(!txnStack.empty())
+        return;
+    if(statementTxn == nullptr){
+        endSnapshot();
+        return;
+    }
+    DbTxn* txn = statementTxn;
+    statementTxn = nullptr;
+    commitTxn(txn);
+}
 
-    // try to lock the database file
-    int errorCode = flock(fd, (shared ? LOCK_SH : LOCK_EX) | LOCK_NB);
-    
-    if(errorCode == -1){ // if not successful
-        // EWOULDBLOCK means that the file is locked, so this transaction needs to wait
-        if(errno == EWOULDBLOCK){
-            cout << "Transaction with id " << transactionID << "waiting to get a lock..." << endl;
-        }else{
-            throw TransactionManagerError("Error: " + errno);
-        }
-    }else{
-        cout << "Successfully got the lock on the file with FD " << fd << endl;
+// The reversing changes aren't recorded, as in a rollback. If reversing fails part way, what's left of the
+// statement's changes stays, as a failed statement's changes do.
+void TransactionManager::undo_statement(){
+    UndoLog* undoLog = statementLog;
+    statementLog = new UndoLog();
+    UndoLog::current = nullptr;
+    try {
+        SQLExec::undoChanges(*undoLog);
+    } catch (...) {
+        delete undoLog;
+        UndoLog::current = statementLog;
+        throw;
     }
+    delete undoLog;
+    UndoLog::current = statementLog;
+}
+
+// The snapshot's transaction ID is what the transaction's locks are held under, too.
+void TransactionManager::beginSnapshot(){
+    snapshot = VersionStore::get().begin();
+    hasSnapshot = true;
+    VersionStore::current = &snapshot;
+    LockManager::current = snapshot.txn;
+}
+
+// The locks are only released once the changes they protected are visible to everyone.
+void TransactionManager::endSnapshot(){
+    if(!hasSnapshot)
+        return;
+    VersionStore::current = nullptr;
+    LockManager::current = 0;
+    hasSnapshot = false;
+    VersionStore::get().commit(snapshot);
+    LockManager::get().unlock_all(snapshot.txn);
 }
 
-// @param transactionID: 
-// @param fileDescriptor: the file descriptor of the file that's locked by this transaction
-void TransactionManager::releaseLock(int transactionID, int fileDescriptor){
-    if(fileDescriptor < 0)
-        throw TransactionManagerError("Error: passed a file descriptor that's less than 0");
-
-    // call flock() with LOCK_UN to remove the lock on the file
-    int errorCode = flock(fileDescriptor, LOCK_UN | LOCK_NB);
-    if(errorCode == -1) 
-        throw TransactionManagerError("Error with releasing lock: " + errno);
-    else cout << "Successfully released the lock" << endl;
-
-    errorCode = close(fileDescriptor);
-    if(errorCode == -1)
-        throw TransactionManagerError("Error with closing the FD: " + errno);
-    else cout << "Successfully closed the file descriptor " << fileDescriptor << endl;
+void TransactionManager::wait_durable(){
+    if(commitTicket == 0 || groupCommit == nullptr)
+        return;
+    u_int64_t ticket = commitTicket;
+    commitTicket = 0;
+    groupCommit->wait(ticket);
 }
 
 // returns ID of the transaction that's currently executing, which is the one
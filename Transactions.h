@@ -5,51 +5,75 @@
 #include "../sql-parser/src/SQLParser.h"
 #include "TransactionStatement.h"
 #include "SQLExec.h"
+#include "GroupCommit.h"
+#include "UndoLog.h"
+#include "VersionStore.h"
+#include "LockManager.h"
 #include <algorithm>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <sys/file.h>
-#include <fcntl.h>
 
 // struct TransactionStatement;
 
 using namespace std;
+    // Each transaction is a Berkeley DB transaction (nested ones are its child transactions), and so is each
+    // statement run outside one, so the environment's write-ahead log holds everything needed to redo or undo
+    // them; recovery replays it when the environment is next opened. Tables kept in page files are the exception:
+    // their writes aren't logged, so they can only be changed by statements run outside a transaction, and a crash
+    // can leave such a statement half done. Commits don't sync the log themselves:
+    // the group commit (if the driver set one up) flushes it for many commits at once, and wait_durable waits
+    // for that.
+    // Each level of transaction also keeps an UndoLog of the changes made in it. ROLLBACK reverses those (and
+    // nothing else, so a nested transaction rolls back on its own) and then commits, so the reversal is logged
+    // like any other change.
+    // Reads see a snapshot (see VersionStore): the whole of an outermost transaction reads as of when it began,
+    // and a statement run outside one as of when it started.
+    // Locks (see LockManager) are held by the same transaction as the snapshot, and released when it ends.
     class TransactionManager{
-
-        // A record in the transaction log
-        struct TransactionLogRecord{
-            int transactionID;      // id of the transaction that executed the statement
-            hsql::SQLStatement* statement; // the SQL statement that was executed, if any
-            hsql::TransactionStatement* transactionStatement; // the transaction statement that was executed, if any
-            vector<DbRelation*>* checkpointTables; // list of DbRelations at a checkpoint, if any
-            vector<Identifier>* tblNames; // list of the names of all the tables at a checkpoint
-        };
-
         private:
-            std::vector<TransactionLogRecord> transactionLog; // the vector at index i is the transaction log for the transaction with id i
             std::vector<int> activeTransactions; // process IDs, starting from 0, of the transactions that are currently running
             int highestTransactionID ; // largest transaction ID that has been created out of all the transactions
             stack<int> transactionStack;
-            vector<DbRelation*> currentTables; // list of DbRelations representing all the tables currently in the database
-            vector<Identifier>* tableNames;
+            stack<DbTxn*> txnStack; // the Berkeley DB transaction for each level of transactionStack
+            stack<UndoLog*> undoStack; // the changes made at each level of transactionStack
+            DbTxn* statementTxn; // the statement's own Berkeley DB transaction, if it's not part of one of those
+            UndoLog* statementLog; // the changes the statement has made so far, for it to give way (see undo_statement)
+            u_int64_t commitTicket; // group commit ticket for the last commit, if it may not be durable yet
+            VersionStore::Snapshot snapshot; // what the transaction or statement reads as of
+            bool hasSnapshot;
+
+            void commitTxn(DbTxn* txn);
+            void abortTxn(DbTxn* txn);
+            void beginSnapshot();
+            void endSnapshot();
+            UndoLog* popUndoLog();
         public: 
-            TransactionManager(){ highestTransactionID = -1; }
-            void begin_transaction();
-            void commit_transaction();
-            void rollback_transaction();
-            int getFD(Identifier tableName);
-            void tryToGetLock(int transactionID, hsql::SQLStatement statement, int fd);
-            void releaseLock(int transactionID, int fileDescriptor);
+            TransactionManager(){ highestTransactionID = -1; statementTxn = nullptr; statementLog = nullptr; commitTicket = 0; hasSnapshot = false; }
+            // each returns what it did, for the statement's result
+            string begin_transaction();
+            string commit_transaction();
+            string rollback_transaction();
+
+            // Run the statement about to be executed in a Berkeley DB transaction of its own (if it writes) and
+            // with a snapshot of its own, unless it's part of a transaction already. Call end_statement when it's
+            // done (whether or not it succeeded).
+            void begin_statement(bool writes = true);
+            void end_statement();
+
+            // Reverse what the statement has done so far, so that it can wait for a lock it gave way on and then
+            // run again; it's still running afterwards, in the same transaction and snapshot.
+            void undo_statement();
+
+            // Wait until the last commit is in the log on disk. Call without holding anything other sessions
+            // need, so that their commits can be flushed with it.
+            void wait_durable();
+
+            // makes commits durable for every session (set up by the driver); commits flush the log themselves
+            // if there isn't one
+            static GroupCommit* groupCommit;
             int getCurrentTransactionID();
 
             // returns a list of the transactions that are currently active in the database system
             vector<int> getActiveTransactions(){ return activeTransactions; } 
 
-            // For every SQLExec method that's called within a transaction, that method MUST call this to 
-            // update the list of tables and table names stored in TransactionManager, but only AFTER all locks are released.
-            // (This is done in SQLExec::releaseLock())
-            void updateTablesAndNames(); 
-
     };
 
     // This is from the instructor code in SQLExec.h
@@ -0,0 +1,28 @@
+#include "UndoLog.h"
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+thread_local UndoLog *UndoLog::current = nullptr;
+
+void UndoLog::inserted(const Identifier &table_name, Handle handle) {
+    this->records.push_back(UndoRecord(UndoRecord::INSERTED, table_name, handle));
+}
+
+void UndoLog::deleted(const Identifier &table_name, Handle handle, const ValueDict &before) {
+    this->records.push_back(UndoRecord(UndoRecord::DELETED, table_name, handle, before));
+}
+
+void UndoLog::updated(const Identifier &table_name, Handle handle, const ValueDict &before) {
+    this->records.push_back(UndoRecord(UndoRecord::UPDATED, table_name, handle, before));
+}
+
+void UndoLog::created(const Identifier &table_name) {
+    this->records.push_back(UndoRecord(UndoRecord::CREATED, table_name));
+}
+
+void UndoLog::append(UndoLog &child) {
+    this->records.insert(this->records.end(), child.records.begin(), child.records.end());
+    child.records.clear();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class UndoRecord - one change a transaction made, with what it takes to reverse it.
+ */
+struct UndoRecord {
+    enum Kind {
+        INSERTED,  // handle was added (reversed by deleting it)
+        DELETED,   // handle was deleted; before is the row it held (reversed by putting it back)
+        UPDATED,   // handle was changed; before is the row it held (reversed by putting it back)
+        CREATED    // the table was created (reversed by dropping it)
+    };
+
+    Kind kind;
+    Identifier table_name;
+    Handle handle;
+    ValueDict before;
+
+    UndoRecord(Kind kind, Identifier table_name, Handle handle = Handle(0, 0), ValueDict before = ValueDict())
+            : kind(kind), table_name(table_name), handle(handle), before(before) {}
+};
+
+/**
+ * @class UndoLog - the changes a transaction has made so far, oldest first, for ROLLBACK to reverse.
+ *
+ * The storage engines record each change in the current thread's log (if it has one) as they make it: inserts by
+ * handle alone, deletes and updates with the row as it was. Rolling back reverses the records newest first, so it
+ * costs time in proportion to the changes made, whatever the size of the tables. A nested transaction has a log of
+ * its own; committing it hands its records on to the transaction it's nested in.
+ *
+ * The log isn't kept on disk. Crash recovery is Berkeley DB's business (see GroupCommit), and the records
+ * only have to last as long as the transaction.
+ */
+class UndoLog {
+public:
+    /**
+     * The log the storage engines record this thread's changes in (nullptr when nothing would roll them back,
+     * e.g. outside BEGIN TRANSACTION). Set by the TransactionManager.
+     */
+    static thread_local UndoLog *current;
+
+    UndoLog() : records() {}
+
+    virtual ~UndoLog() {}
+
+    UndoLog(const UndoLog &other) = delete;
+
+    UndoLog &operator=(const UndoLog &other) = delete;
+
+    virtual void inserted(const Identifier &table_name, Handle handle);
+
+    virtual void deleted(const Identifier &table_name, Handle handle, const ValueDict &before);
+
+    virtual void updated(const Identifier &table_name, Handle handle, const ValueDict &before);
+
+    virtual void created(const Identifier &table_name);
+
+    /**
+     * Take over the records of a nested transaction that committed, after this log's own.
+     * @param child  the nested transaction's log (left empty)
+     */
+    virtual void append(UndoLog &child);
+
+    /**
+     * The records, oldest first.
+     */
+    virtual const std::vector<UndoRecord> &get_records() const { return records; }
+
+    virtual bool is_empty() const { return records.empty(); }
+
+protected:
+    std::vector<UndoRecord> records;
+};
@@ -0,0 +1,116 @@
+#include "UndoLogTests.h"
+#include "HeapTable.h"
+#include "UndoLog.h"
+#include <map>
+#include <set>
+
+using namespace std;
+
+namespace UndoLogTests{
+    // reverses a log's records newest first, as SQLExec::undoChanges does, following rows put back elsewhere
+    static void rollBack(DbRelation &table, const UndoLog &undoLog, size_t &movedCount){
+        map<Handle, Handle> moved;
+        const vector<UndoRecord> &records = undoLog.get_records();
+        for(auto record = records.rbegin(); record != records.rend(); record++){
+            UndoRecord undo = *record;
+            auto found = moved.find(record->handle);
+            if(found != moved.end())
+                undo.handle = found->second;
+            Handle now = table.undo(undo);
+            if(now != undo.handle){
+                moved[record->handle] = now;
+                movedCount++;
+            }
+        }
+    }
+
+    static multiset<string> contents(DbRelation &table){
+        multiset<string> rows;
+        Handles *handles = table.select();
+        for(auto const &handle : *handles){
+            ValueDict *row = table.project(handle);
+            rows.insert(to_string((*row)["id"].n) + ":" + (*row)["body"].s);
+            delete row;
+        }
+        delete handles;
+        return rows;
+    }
+
+    // changes are undone newest first, a nested level's on their own or along with those of the level it
+    // committed into, and a row that no longer fits where it was goes back elsewhere (as it moves when it's
+    // updated to something bigger than its block has room for)
+    void testRollBack(){
+        cout << "Testing undo logs" << endl;
+        ColumnNames columnNames = {"id", "body"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::INT), ColumnAttribute(ColumnAttribute::TEXT)};
+        HeapTable table("_test_undo", columnNames, columnAttributes);
+        table.create();
+        UndoLog *saved = UndoLog::current;
+        UndoLog::current = nullptr;
+        vector<Handle> handles;
+        ValueDict row;
+        for(int i = 0; i < 8; i++){ // just fills the first block
+            row["id"] = Value(i);
+            row["body"] = Value(string(500, (char) ('a' + i)));
+            handles.push_back(table.insert(&row));
+        }
+        multiset<string> before = contents(table);
+
+        UndoLog outer;
+        UndoLog::current = &outer;
+        ValueDict shorter;
+        shorter["body"] = Value(string("x"));
+        table.update(handles[1], &shorter);
+        UndoLog::current = nullptr; // another session takes the room that made
+        ValueDict longer;
+        longer["body"] = Value(string(990, 'a'));
+        table.update(handles[0], &longer);
+        multiset<string> afterOuter = contents(table);
+
+        UndoLog inner;
+        UndoLog::current = &inner;
+        row["id"] = Value(100);
+        Handle added = table.insert(&row);
+        table.update(added, &shorter);
+        table.del(added);
+        table.del(handles[2]);
+        size_t movedCount = 0;
+        UndoLog::current = nullptr;
+        rollBack(table, inner, movedCount);
+        bool innerUndone = contents(table) == afterOuter;
+
+        UndoLog committed;
+        UndoLog::current = &committed;
+        table.del(handles[3]);
+        outer.append(committed);
+        UndoLog::current = nullptr;
+        rollBack(table, outer, movedCount); // handles[3] goes back first, so handles[1] doesn't fit any more
+        before.erase(before.find("0:" + string(500, 'a')));
+        before.insert("0:" + string(990, 'a'));
+        bool outerUndone = contents(table) == before;
+
+        UndoLog grown;
+        UndoLog::current = &grown;
+        longer["body"] = Value(string(1000, 'e'));
+        table.update(handles[4], &longer); // no room for it in the first block any more
+        UndoLog::current = nullptr;
+        bool relocated = grown.get_records().size() == 2 && grown.get_records()[1].handle != handles[4];
+        size_t grownMoved = 0;
+        rollBack(table, grown, grownMoved);
+        bool grownUndone = contents(table) == before;
+        table.drop();
+        UndoLog::current = saved;
+        if(!innerUndone)
+            throw DbRelationError("rolling back a nested level didn't put back what it changed");
+        if(!outerUndone)
+            throw DbRelationError("rolling back didn't put back what the level and the one nested in it changed");
+        if(movedCount != 1)
+            throw DbRelationError("a row put back where there was no room for it wasn't moved");
+        if(!relocated || !grownUndone)
+            throw DbRelationError("a row that grew too big for its block wasn't moved, or wasn't put back");
+    }
+
+    void testAll(){
+        testRollBack();
+    }
+}
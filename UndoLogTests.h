@@ -0,0 +1,6 @@
+#pragma once
+
+namespace UndoLogTests{
+    void testRollBack();
+    void testAll();
+}
@@ -0,0 +1,29 @@
+#ifndef UTILITY_STATEMENT_H
+#define UTILITY_STATEMENT_H
+
+#include <string>
+#include "../sql-parser/src/sql/SQLStatement.h"
+
+  // Represents maintenance commands that the Hyrise parser doesn't know about.
+  // Example "VACUUM foo;", "ANALYZE foo;" or "FREEZE TABLE foo;"
+namespace hsql{
+  struct UtilityStatement : hsql::SQLStatement {
+    enum ActionType {
+      VACUUM,
+      ANALYZE,
+      FREEZE,
+      UNFREEZE
+    };
+
+    // The statement type is only a placeholder (like TransactionStatement's), but it is what SQLExec::requestLock
+    // looks at to pick a lock mode, so it has to be one that takes an exclusive lock.
+    UtilityStatement(ActionType utilityStatementType, std::string tableName) :
+        SQLStatement(hsql::StatementType::kStmtUpdate), type(utilityStatementType), tableName(tableName){}
+    virtual ~UtilityStatement(){}
+
+    ActionType type;
+    std::string tableName;
+  };
+
+}// namespace hsql
+#endif
@@ -0,0 +1,255 @@
+#include "VersionStore.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+const u32 VersionStore::PURGE_INTERVAL_MS;
+
+thread_local const VersionStore::Snapshot *VersionStore::current = nullptr;
+
+VersionStore &VersionStore::get() {
+    static VersionStore versions;
+    return versions;
+}
+
+VersionStore::VersionStore() : chains(), written(), snapshots(), last_txn(0), clock(0), change_count(0),
+                               committed_count(0), running(false), stopping(false) {
+}
+
+void VersionStore::start() {
+    lock_guard<mutex> guard(this->lock);
+    if (this->running)
+        return;
+    this->stopping = false;
+    this->running = true;
+    this->worker = thread(&VersionStore::work, this);
+}
+
+void VersionStore::stop() {
+    {
+        lock_guard<mutex> guard(this->lock);
+        if (!this->running)
+            return;
+        this->stopping = true;
+    }
+    this->committed.notify_all();
+    this->worker.join();
+    lock_guard<mutex> guard(this->lock);
+    this->running = false;
+}
+
+VersionStore::Snapshot VersionStore::begin() {
+    lock_guard<mutex> guard(this->lock);
+    Snapshot snapshot;
+    snapshot.txn = ++this->last_txn;
+    snapshot.as_of = this->clock;
+    this->snapshots.insert(snapshot.as_of);
+    return snapshot;
+}
+
+void VersionStore::commit(const Snapshot &snapshot) {
+    lock_guard<mutex> guard(this->lock);
+    auto rows = this->written.find(snapshot.txn);
+    if (rows != this->written.end()) {
+        Timestamp stamp = ++this->clock;
+        for (auto const &row: rows->second) {
+            auto table = this->chains.find(row.first);
+            if (table == this->chains.end())
+                continue;
+            auto chain = table->second.find(row.second);
+            if (chain == table->second.end())
+                continue;
+            for (auto &change: chain->second) {
+                if (change.writer == snapshot.txn && change.stamp == 0) {
+                    change.stamp = stamp;
+                    this->committed_count++;
+                }
+            }
+        }
+        this->written.erase(rows);
+    }
+    release(snapshot);  // which may have been the oldest
+    if (this->running)
+        this->committed.notify_all();
+    else
+        purge_locked();
+}
+
+void VersionStore::changed(const Identifier &table_name, Handle handle, const ValueDict *before) {
+    if (current == nullptr)
+        return;
+    lock_guard<mutex> guard(this->lock);
+    this->chains[table_name][handle].push_back(
+            Change(current->txn, before != nullptr, before != nullptr ? *before : ValueDict()));
+    this->written[current->txn].push_back(make_pair(table_name, handle));
+    this->change_count++;
+}
+
+void VersionStore::undone(const Identifier &table_name, Handle handle) {
+    if (current == nullptr)
+        return;
+    lock_guard<mutex> guard(this->lock);
+    auto table = this->chains.find(table_name);
+    if (table == this->chains.end())
+        return;
+    auto chain = table->second.find(handle);
+    if (chain == table->second.end() || chain->second.back().writer != current->txn)
+        return;
+    chain->second.pop_back();
+    this->change_count--;
+    if (chain->second.empty()) {
+        table->second.erase(chain);
+        if (table->second.empty())
+            this->chains.erase(table);
+    }
+}
+
+void VersionStore::check_writable(const Identifier &table_name, Handle handle) {
+    if (current == nullptr || this->change_count == 0)
+        return;
+    lock_guard<mutex> guard(this->lock);
+    auto table = this->chains.find(table_name);
+    if (table == this->chains.end())
+        return;
+    auto chain = table->second.find(handle);
+    if (chain == table->second.end() || is_visible(chain->second.back(), *current))
+        return;
+    throw DbRelationError("could not serialize access: a row of " + table_name +
+                          " has been changed by a concurrent transaction");
+}
+
+// A row the snapshot should see that the selection missed (deleted since, or changed so as not to match) has a
+// chain, so only the chains need going through for rows to add.
+void VersionStore::select(const Identifier &table_name, Handles *handles,
+                          const std::function<bool(const ValueDict &row)> &matches) {
+    if (current == nullptr || this->change_count == 0)
+        return;
+    lock_guard<mutex> guard(this->lock);
+    auto table = this->chains.find(table_name);
+    if (table == this->chains.end())
+        return;
+    const TableChains &table_chains = table->second;
+    Handles seen;
+    size_t kept = 0;
+    for (auto const &handle: *handles) {
+        auto chain = table_chains.find(handle);
+        if (chain != table_chains.end()) {
+            seen.push_back(handle);
+            const Change *change = visible_before(chain->second, *current);
+            if (change != nullptr && !(change->existed && matches(change->before)))
+                continue;
+        }
+        (*handles)[kept++] = handle;
+    }
+    handles->resize(kept);
+    sort(seen.begin(), seen.end());
+    for (auto const &chain: table_chains) {
+        if (binary_search(seen.begin(), seen.end(), chain.first))
+            continue;
+        const Change *change = visible_before(chain.second, *current);
+        if (change != nullptr && change->existed && matches(change->before))
+            handles->push_back(chain.first);
+    }
+}
+
+ValueDict *VersionStore::project(const Identifier &table_name, Handle handle, const ColumnNames *column_names) {
+    if (current == nullptr || this->change_count == 0)
+        return nullptr;
+    lock_guard<mutex> guard(this->lock);
+    auto table = this->chains.find(table_name);
+    if (table == this->chains.end())
+        return nullptr;
+    auto chain = table->second.find(handle);
+    if (chain == table->second.end())
+        return nullptr;
+    const Change *change = visible_before(chain->second, *current);
+    if (change == nullptr)
+        return nullptr;
+    if (!change->existed)
+        throw DbRelationError("no such row in " + table_name);
+    if (column_names->empty())
+        return new ValueDict(change->before);
+    ValueDict *row = new ValueDict();
+    for (auto const &column_name: *column_names) {
+        auto column = change->before.find(column_name);
+        if (column == change->before.end()) {
+            delete row;
+            throw DbRelationError("Column does not exist: '" + column_name + "'");
+        }
+        (*row)[column_name] = column->second;
+    }
+    return row;
+}
+
+size_t VersionStore::purge() {
+    lock_guard<mutex> guard(this->lock);
+    return purge_locked();
+}
+
+bool VersionStore::has_versions(const Identifier &table_name) {
+    lock_guard<mutex> guard(this->lock);
+    purge_locked();
+    return this->chains.find(table_name) != this->chains.end();
+}
+
+void VersionStore::release(const Snapshot &snapshot) {
+    auto found = this->snapshots.find(snapshot.as_of);
+    if (found != this->snapshots.end())
+        this->snapshots.erase(found);
+}
+
+bool VersionStore::is_visible(const Change &change, const Snapshot &snapshot) {
+    return change.writer == snapshot.txn || (change.stamp != 0 && change.stamp <= snapshot.as_of);
+}
+
+// Going back from the newest change, every one the snapshot can't see is undone in turn, so the version to see
+// is the one before the oldest of those.
+const VersionStore::Change *VersionStore::visible_before(const Chain &chain, const Snapshot &snapshot) {
+    const Change *result = nullptr;
+    for (auto change = chain.rbegin(); change != chain.rend(); change++) {
+        if (is_visible(*change, snapshot))
+            break;
+        result = &*change;
+    }
+    return result;
+}
+
+// A chain's changes are stamped in order (nobody can change a row while a change to it is uncommitted), so the
+// ones every snapshot can see are at its front.
+size_t VersionStore::purge_locked() {
+    if (this->committed_count == 0)
+        return 0;
+    Timestamp horizon = this->snapshots.empty() ? this->clock : *this->snapshots.begin();
+    size_t forgotten = 0;
+    for (auto table = this->chains.begin(); table != this->chains.end();) {
+        for (auto chain = table->second.begin(); chain != table->second.end();) {
+            while (!chain->second.empty() && chain->second.front().stamp != 0 &&
+                   chain->second.front().stamp <= horizon) {
+                chain->second.pop_front();
+                forgotten++;
+            }
+            if (chain->second.empty())
+                chain = table->second.erase(chain);
+            else
+                chain++;
+        }
+        if (table->second.empty())
+            table = this->chains.erase(table);
+        else
+            table++;
+    }
+    this->change_count -= forgotten;
+    this->committed_count -= forgotten;
+    return forgotten;
+}
+
+void VersionStore::work() {
+    unique_lock<mutex> guard(this->lock);
+    while (!this->stopping) {
+        this->committed.wait_for(guard, chrono::milliseconds(PURGE_INTERVAL_MS));
+        purge_locked();
+    }
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include "storage_engine.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class VersionStore - the older versions of rows that transactions still running may need to see, for snapshot
+ * isolation (multi-version concurrency control).
+ *
+ * The tables themselves always hold the newest version of every row, committed or not. Each change a transaction
+ * makes is also recorded here against the row's handle, with the version it replaced (the before-image, or that
+ * there wasn't one). A row's changes form a chain, oldest first; a change's stamp is the commit timestamp of the
+ * transaction that made it, or 0 while that is still running. The version a change replaced ends at its stamp and
+ * the one it made begins there.
+ *
+ * Every statement or transaction reads as of a snapshot: the commit timestamp when it began. A change is visible
+ * to a snapshot if its own transaction made it or it was committed by then. The storage engines scan and project
+ * the rows as they are on disk and then ask the store to correct the result for the rows that have chains, going
+ * back along each chain past the changes the snapshot can't see. So readers never wait for writers, and never
+ * see uncommitted or later changes. Two transactions changing the same row is refused for the second one (first
+ * updater wins), since whichever commits second would otherwise overwrite a change it never saw.
+ *
+ * A change is forgotten once every snapshot can see it, i.e. it was committed no later than the oldest snapshot
+ * still in use. A background thread does that (see start); without one, commits do it.
+ */
+class VersionStore {
+public:
+    typedef u_int64_t TxnID;
+    typedef u_int64_t Timestamp;
+
+    /**
+     * @class Snapshot - what a statement or transaction reads as of.
+     */
+    struct Snapshot {
+        TxnID txn;          // the transaction reading (its own changes are always visible)
+        Timestamp as_of;    // changes committed at or before this are visible
+
+        Snapshot() : txn(0), as_of(0) {}
+    };
+
+    // how often the background thread looks for changes to forget, if no commit prompts it sooner
+    static const u32 PURGE_INTERVAL_MS = 100;
+
+    /**
+     * The snapshot the current thread is reading as of, and whose transaction its changes are recorded for
+     * (nullptr to read the tables as they are and record nothing). Set by the TransactionManager.
+     */
+    static thread_local const Snapshot *current;
+
+    /**
+     * The one store for all the tables.
+     */
+    static VersionStore &get();
+
+    VersionStore();
+
+    virtual ~VersionStore() { stop(); }
+
+    VersionStore(const VersionStore &other) = delete;
+
+    VersionStore &operator=(const VersionStore &other) = delete;
+
+    /**
+     * Start the thread that forgets changes once no snapshot needs them.
+     */
+    virtual void start();
+
+    virtual void stop();
+
+    /**
+     * Begin a transaction (or a statement run outside one), with a snapshot of what has been committed so far.
+     */
+    virtual Snapshot begin();
+
+    /**
+     * The transaction is over: stamp the changes it made (making them visible to snapshots taken from now on;
+     * a transaction that rolled back has none left, see undone) and release its snapshot.
+     */
+    virtual void commit(const Snapshot &snapshot);
+
+    /**
+     * Record a change the current thread's transaction has made (does nothing if it has no snapshot).
+     * @param table_name  the table changed
+     * @param handle      the row changed
+     * @param before      the row as it was (nullptr if the change inserted it)
+     */
+    virtual void changed(const Identifier &table_name, Handle handle, const ValueDict *before);
+
+    /**
+     * Forget the latest change to a row, which the current thread's transaction has just undone.
+     */
+    virtual void undone(const Identifier &table_name, Handle handle);
+
+    /**
+     * Check that the current thread's transaction may change a row: that nobody has changed it since the
+     * transaction's snapshot, or is changing it now.
+     * @throws  DbRelationError if someone has
+     */
+    virtual void check_writable(const Identifier &table_name, Handle handle);
+
+    /**
+     * Correct a selection made from the table as it is to what the current thread's snapshot should see: drop
+     * rows it can't see and add rows it can see that have since been deleted or changed so as not to match.
+     * @param table_name  the table
+     * @param handles     the handles selected (changed in place)
+     * @param matches     whether a version of a row (all its columns) would have been selected
+     */
+    virtual void select(const Identifier &table_name, Handles *handles,
+                        const std::function<bool(const ValueDict &row)> &matches);
+
+    /**
+     * Get the version of a row the current thread's snapshot should see, if it isn't the one in the table.
+     * @param table_name    the table
+     * @param handle        the row
+     * @param column_names  the columns wanted (all of them if empty)
+     * @returns             those columns of the version to see (freed by caller), or nullptr if the version in
+     *                      the table is the one to see
+     * @throws              DbRelationError if the snapshot shouldn't see the row at all
+     */
+    virtual ValueDict *project(const Identifier &table_name, Handle handle, const ColumnNames *column_names);
+
+    /**
+     * Forget every change that every snapshot can see.
+     * @returns  how many changes were forgotten
+     */
+    virtual size_t purge();
+
+    /**
+     * Whether any snapshot may still need older versions of a table's rows (after forgetting those none does).
+     */
+    virtual bool has_versions(const Identifier &table_name);
+
+    /**
+     * How many changes the store is holding.
+     */
+    size_t get_change_count() const { return change_count; }
+
+protected:
+    struct Change {
+        TxnID writer;
+        Timestamp stamp;    // commit timestamp of the writer (0 until it commits)
+        bool existed;       // whether there was a row before the change
+        ValueDict before;
+
+        Change(TxnID writer, bool existed, ValueDict before) : writer(writer), stamp(0), existed(existed),
+                                                               before(before) {}
+    };
+
+    typedef std::deque<Change> Chain;  // oldest change first
+    typedef std::map<Handle, Chain> TableChains;
+
+    std::map<Identifier, TableChains> chains;
+    std::map<TxnID, std::vector<std::pair<Identifier, Handle>>> written;  // rows each running transaction changed
+    std::multiset<Timestamp> snapshots;  // as_of of every snapshot in use
+    TxnID last_txn;
+    Timestamp clock;  // latest commit timestamp
+    std::atomic<size_t> change_count;
+    size_t committed_count;  // changes stamped and not yet forgotten
+
+    bool running, stopping;
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable committed;
+
+    void release(const Snapshot &snapshot);
+
+    static bool is_visible(const Change &change, const Snapshot &snapshot);
+
+    /**
+     * The change whose before-image is the version of the row the snapshot should see, or nullptr if the row in
+     * the table is. Call with the lock held.
+     */
+    static const Change *visible_before(const Chain &chain, const Snapshot &snapshot);
+
+    size_t purge_locked();
+
+    void work();
+};
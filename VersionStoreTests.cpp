@@ -0,0 +1,59 @@
+#include "VersionStoreTests.h"
+#include "VersionStore.h"
+#include <iostream>
+
+using namespace std;
+
+namespace VersionStoreTests{
+    // a snapshot sees a row as it was when it began until it ends, whatever has been committed since; the old
+    // version is forgotten once no snapshot needs it
+    void testSnapshots(){
+        cout << "Testing the version store" << endl;
+        VersionStore versions; // no background thread, so commits purge
+        const VersionStore::Snapshot *saved = VersionStore::current;
+        Handle handle(1, 1);
+        ColumnNames allColumns;
+        ValueDict old;
+        old["id"] = Value(1);
+        VersionStore::Snapshot reader = versions.begin();
+        VersionStore::Snapshot writer = versions.begin();
+        VersionStore::current = &writer;
+        versions.changed("_test_versions", handle, &old);
+        ValueDict *ownView = versions.project("_test_versions", handle, &allColumns);
+        VersionStore::current = &reader;
+        ValueDict *readerView = versions.project("_test_versions", handle, &allColumns);
+        bool refused = false;
+        try {
+            versions.check_writable("_test_versions", handle);
+        } catch (DbRelationError &e) {
+            refused = true;
+        }
+        versions.commit(writer);
+        ValueDict *laterView = versions.project("_test_versions", handle, &allColumns);
+        bool kept = versions.has_versions("_test_versions");
+        VersionStore::Snapshot newer = versions.begin();
+        VersionStore::current = &newer;
+        ValueDict *newerView = versions.project("_test_versions", handle, &allColumns);
+        versions.commit(newer);
+        versions.commit(reader);
+        VersionStore::current = saved;
+        versions.purge();
+
+        bool ok = ownView == nullptr && readerView != nullptr && (*readerView)["id"] == Value(1) &&
+                  laterView != nullptr && newerView == nullptr;
+        delete ownView;
+        delete readerView;
+        delete laterView;
+        delete newerView;
+        if(!ok)
+            throw DbRelationError("version store showed a snapshot a version it shouldn't have seen");
+        if(!refused)
+            throw DbRelationError("version store let a row be changed by two transactions at once");
+        if(!kept || versions.has_versions("_test_versions") || versions.get_change_count() != 0)
+            throw DbRelationError("version store didn't keep an old version just as long as it was needed");
+    }
+
+    void testAll(){
+        testSnapshots();
+    }
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+namespace VersionStoreTests{
+    void testSnapshots();
+    void testAll();
+}
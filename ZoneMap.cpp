@@ -0,0 +1,173 @@
+#include "ZoneMap.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+// Each entry is the u16 count of rows added followed by every column's bounds: an i32 min and max for INT and
+// BOOLEAN, or for TEXT a u8 length of the min prefix, a u8 length of the max prefix (high bit set if the max
+// was cut short), then the two prefixes in TEXT_PREFIX_SZ bytes each.
+static const u32 COUNT_SZ = sizeof(u16);
+static const u32 INT_BOUNDS_SZ = 2 * sizeof(int32_t);
+static const u32 TEXT_BOUNDS_SZ = 2 + 2 * ZoneMap::TEXT_PREFIX_SZ;
+static const u_int8_t TRUNCATED = 0x80;
+
+static u32 entry_size_for(const ColumnAttributes &column_attributes) {
+    u32 size = COUNT_SZ;
+    for (auto ca: column_attributes)
+        size += ca.get_data_type() == ColumnAttribute::TEXT ? TEXT_BOUNDS_SZ : INT_BOUNDS_SZ;
+    return size;
+}
+
+static int32_t get_i32(const char *address) {
+    int32_t n;
+    memcpy(&n, address, sizeof(n));
+    return n;
+}
+
+static void put_i32(char *address, int32_t n) {
+    memcpy(address, &n, sizeof(n));
+}
+
+static u16 get_count(const char *entry) {
+    u16 n;
+    memcpy(&n, entry, sizeof(n));
+    return n;
+}
+
+static void put_count(char *entry, u16 n) {
+    memcpy(entry, &n, sizeof(n));
+}
+
+ZoneMap::ZoneMap(std::string name, const ColumnNames &column_names, const ColumnAttributes &column_attributes)
+        : file(file_name(name), entry_size_for(column_attributes)), column_names(column_names),
+          entry_size(entry_size_for(column_attributes)) {
+    u32 offset = COUNT_SZ;
+    for (auto ca: column_attributes) {
+        this->data_types.push_back(ca.get_data_type());
+        this->column_offsets.push_back(offset);
+        offset += ca.get_data_type() == ColumnAttribute::TEXT ? TEXT_BOUNDS_SZ : INT_BOUNDS_SZ;
+    }
+}
+
+void ZoneMap::create() {
+    this->drop();
+    this->file.create();
+    this->entries.clear();
+}
+
+bool ZoneMap::open() {
+    if (this->file.is_open())
+        return true;
+    bool existed = this->file.open(true);
+    this->file.load(this->entries);
+    return existed;
+}
+
+void ZoneMap::close() {
+    this->file.close();
+}
+
+void ZoneMap::drop() {
+    try {
+        this->file.drop();
+    } catch (DbException &e) {
+        // wasn't there
+    }
+    this->entries.clear();
+}
+
+void ZoneMap::add(BlockID block_id, const ValueDict *row) {
+    if (block_id == 0)
+        return;
+    if (block_id * this->entry_size > this->entries.size())
+        this->entries.resize(block_id * this->entry_size, 0);
+    char *e = entry(block_id);
+    u16 count = get_count(e);
+    for (uint col = 0; col < this->column_names.size(); col++) {
+        const Value &value = row->at(this->column_names[col]);
+        char *bounds = e + this->column_offsets[col];
+        if (this->data_types[col] != ColumnAttribute::TEXT) {
+            if (count == 0 || value.n < get_i32(bounds))
+                put_i32(bounds, value.n);
+            if (count == 0 || value.n > get_i32(bounds + sizeof(int32_t)))
+                put_i32(bounds + sizeof(int32_t), value.n);
+            continue;
+        }
+        string prefix = value.s.substr(0, TEXT_PREFIX_SZ);
+        bool truncated = value.s.size() > TEXT_PREFIX_SZ;
+        u_int8_t &min_size = (u_int8_t &) bounds[0];
+        u_int8_t &max_size = (u_int8_t &) bounds[1];
+        char *min_bytes = bounds + 2;
+        char *max_bytes = bounds + 2 + TEXT_PREFIX_SZ;
+        if (count == 0 || prefix < string(min_bytes, min_size)) {
+            min_size = (u_int8_t) prefix.size();
+            memcpy(min_bytes, prefix.data(), prefix.size());
+        }
+        string max(max_bytes, max_size & ~TRUNCATED);
+        if (count == 0 || max < prefix) {
+            max_size = (u_int8_t) (prefix.size() | (truncated ? TRUNCATED : 0));
+            memcpy(max_bytes, prefix.data(), prefix.size());
+        } else if (max == prefix && truncated) {
+            max_size |= TRUNCATED;
+        }
+    }
+    if (count < UINT16_MAX)
+        put_count(e, count + 1);
+    this->file.write_entry(this->entries, block_id);
+}
+
+bool ZoneMap::is_empty(BlockID block_id) const {
+    if (block_id == 0 || block_id * this->entry_size > this->entries.size())
+        return true;
+    return get_count(entry(block_id)) == 0;
+}
+
+bool ZoneMap::might_match(BlockID block_id, const ValueRanges &ranges) const {
+    if (block_id == 0 || block_id * this->entry_size > this->entries.size())
+        return true;  // nothing known about the block
+    const char *e = entry(block_id);
+    if (get_count(e) == 0)
+        return false;
+    for (auto const &range: ranges) {
+        auto column = find(this->column_names.begin(), this->column_names.end(), range.first);
+        if (column == this->column_names.end())
+            continue;  // the scan will complain about it
+        uint col = (uint) (column - this->column_names.begin());
+        const char *bounds = e + this->column_offsets[col];
+        const ValueRange &wanted = range.second;
+        if (this->data_types[col] != ColumnAttribute::TEXT) {
+            Value low(get_i32(bounds)), high(get_i32(bounds + sizeof(int32_t)));
+            low.data_type = high.data_type = this->data_types[col];
+            if (!wanted.overlaps(low, high))
+                return false;
+            continue;
+        }
+        u_int8_t max_size = (u_int8_t) bounds[1];
+        string low(bounds + 2, (u_int8_t) bounds[0]);
+        string high(bounds + 2 + TEXT_PREFIX_SZ, max_size & ~TRUNCATED);
+        if (wanted.has_max && wanted.max.data_type == ColumnAttribute::TEXT &&
+            (wanted.max_inclusive ? wanted.max.s < low : wanted.max.s <= low))
+            return false;  // low is at most the real min, so everything in the block is above the range
+        if (wanted.has_min && wanted.min.data_type == ColumnAttribute::TEXT) {
+            if (max_size & TRUNCATED) {
+                // the real max is high followed by something, so only a min past all of those rules the block out
+                if (wanted.min.s.substr(0, TEXT_PREFIX_SZ) > high)
+                    return false;
+            } else if (wanted.min_inclusive ? high < wanted.min.s : high <= wanted.min.s) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+char *ZoneMap::entry(BlockID block_id) {
+    return this->entries.data() + (block_id - 1) * this->entry_size;
+}
+
+const char *ZoneMap::entry(BlockID block_id) const {
+    return this->entries.data() + (block_id - 1) * this->entry_size;
+}
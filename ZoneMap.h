@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include "SummaryFile.h"
+using namespace std;
+using u16 = u_int16_t;
+using u32 = u_int32_t;
+
+/**
+ * @class ZoneMap - persistent per-block summaries of a heap table's values, for skipping blocks in scans.
+ *
+ * For each heap block there is an entry with the number of rows added to the block and, for each column, the
+ * smallest and largest value ever added to it. INT and BOOLEAN bounds are exact. TEXT bounds keep only the
+ * first TEXT_PREFIX_SZ bytes (a prefix of the smallest value is still a lower bound, and the largest is
+ * flagged when it's been cut short). Deletes leave the entry alone, so bounds can be loose but are never
+ * wrong, even once a crash has put back rows whose delete the map was told of (its writes aren't part of the
+ * transaction, see SummaryFile); VACUUM tightens them. There are no NULLs in this database, so no null counts.
+ * The entries are kept in a SummaryFile beside the heap file.
+ */
+class ZoneMap {
+public:
+    static const u32 TEXT_PREFIX_SZ = 16;
+
+    /**
+     * @param name               name of the heap file this map belongs to
+     * @param column_names       the table's columns
+     * @param column_attributes  their types
+     */
+    ZoneMap(std::string name, const ColumnNames &column_names, const ColumnAttributes &column_attributes);
+
+    /**
+     * Name of the file holding the zone map for the given heap file.
+     */
+    static std::string file_name(std::string name) { return name + ".zone.db"; }
+
+    virtual ~ZoneMap() {}
+
+    ZoneMap(const ZoneMap &other) = delete;
+
+    ZoneMap &operator=(const ZoneMap &other) = delete;
+
+    virtual void create();
+
+    /**
+     * Open the map.
+     * @returns  false if there was no map yet (one was created empty and needs to be rebuilt by the caller)
+     */
+    virtual bool open();
+
+    virtual void close();
+
+    /**
+     * Remove the map's file if there is one.
+     */
+    virtual void drop();
+
+    /**
+     * Widen a block's bounds to take in a row just added to it.
+     */
+    virtual void add(BlockID block_id, const ValueDict *row);
+
+    /**
+     * Has the block never had a row added to it (or does the map know nothing about it)?
+     */
+    virtual bool is_empty(BlockID block_id) const;
+
+    /**
+     * Could any row in the block satisfy all of the ranges?
+     * @returns  false only if the block can be skipped
+     */
+    virtual bool might_match(BlockID block_id, const ValueRanges &ranges) const;
+
+protected:
+    SummaryFile file;
+    ColumnNames column_names;
+    std::vector<ColumnAttribute::DataType> data_types;
+    std::vector<u32> column_offsets;  // where each column's bounds are within an entry
+    u32 entry_size;
+    std::vector<char> entries;  // in-memory copy; the entry for heap block i is at (i - 1) * entry_size
+
+    virtual char *entry(BlockID block_id);
+
+    virtual const char *entry(BlockID block_id) const;
+};
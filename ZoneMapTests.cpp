@@ -0,0 +1,61 @@
+#include "ZoneMapTests.h"
+#include "ZoneMap.h"
+#include <iostream>
+
+using namespace std;
+
+namespace ZoneMapTests{
+    // a zone map's TEXT bounds are prefixes; a block whose largest value was cut short can still hold values
+    // past the prefix
+    void testTextPrefixes(){
+        cout << "Testing zone maps" << endl;
+        ColumnNames columnNames = {"name"};
+        ColumnAttributes columnAttributes = {ColumnAttribute(ColumnAttribute::TEXT)};
+        ZoneMap zoneMap("_test_zone", columnNames, columnAttributes);
+        zoneMap.create();
+        string prefix(ZoneMap::TEXT_PREFIX_SZ, 'm');
+        ValueDict row;
+        row["name"] = Value(string("b"));
+        zoneMap.add(1, &row);
+        row["name"] = Value(prefix + "zzz"); // block 1's largest, cut short
+        zoneMap.add(1, &row);
+        row["name"] = Value(prefix); // block 2's largest, whole
+        zoneMap.add(2, &row);
+
+        struct Case {
+            BlockID block;
+            bool isMin;
+            string bound;
+            bool inclusive;
+            bool mightMatch;
+        };
+        Case cases[] = {
+            {1, true, prefix, false, true},             // name > prefix: the real largest is prefix + "zzz"
+            {1, true, prefix + "zzzz", true, true},     // past the real largest, but the map can't tell
+            {1, true, "n", true, false},                // past any value with that prefix
+            {1, false, "b", false, false},              // name < "b", the smallest
+            {1, false, "b", true, true},
+            {2, true, prefix, false, false},            // block 2's largest is exactly prefix
+            {2, true, prefix, true, true},
+        };
+        for(auto const &c : cases){
+            ValueRange range;
+            if(c.isMin)
+                range.restrict_min(Value(c.bound), c.inclusive);
+            else
+                range.restrict_max(Value(c.bound), c.inclusive);
+            ValueRanges ranges;
+            ranges["name"] = range;
+            if(zoneMap.might_match(c.block, ranges) != c.mightMatch){
+                zoneMap.drop();
+                throw DbRelationError("zone map was wrong about block " + to_string(c.block) + " for name " +
+                                              (c.isMin ? ">" : "<") + (c.inclusive ? "= " : " ") + c.bound);
+            }
+        }
+        zoneMap.drop();
+    }
+
+    void testAll(){
+        testTextPrefixes();
+    }
+}
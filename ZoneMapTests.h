@@ -0,0 +1,6 @@
+#pragma once
+
+namespace ZoneMapTests{
+    void testTextPrefixes();
+    void testAll();
+}
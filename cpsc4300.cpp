@@ -3,16 +3,44 @@
 //CPSC 4300 - Milestone 1
 
 #include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
 #include <cstdio>               
 #include <cstdlib>
 #include <string>       
+#include <sstream>
+#include <system_error>
+#include <regex>
+#include <unistd.h>
 #include "db_cxx.h"
 #include "SQLParser.h"
 #include "ParseTreeToString.h"
-#include "LockTableTests.cpp"
 #include "SQLExec.h"  
+#include "Transactions.h"
 #include "TransactionStatement.h"
+#include "UtilityStatement.h"
 #include "TransactionTests.h"
+#include "OverflowFileTests.h"
+#include "Lz4Tests.h"
+#include "ZoneMapTests.h"
+#include "UndoLogTests.h"
+#include "VersionStoreTests.h"
+#include "LockManagerTests.h"
+#include "CatalogCacheTests.h"
+#include "HeapTableTests.h"
+#include "DictionaryTests.h"
+#include "ColumnarTableTests.h"
+#include "BloomFilterTests.h"
+#include "TableStatisticsTests.h"
+#include "JoinPlanTests.h"
+#include "ExplainTests.h"
+#include "PreparedStatementTests.h"
+#include "PageFileTests.h"
+#include "PrefetcherTests.h"
+#include "FrozenFileTests.h"
+#include "DbHandlePoolTests.h"
+#include "Server.h"
 using namespace std;
 using namespace hsql;
 
@@ -24,6 +52,12 @@ const string BEGIN_TRANSACTION = "BEGIN TRANSACTION";
 const string COMMIT_TRANSACTION = "COMMIT TRANSACTION"; 
 const string ROLLBACK_TRANSACTION = "ROLLBACK TRANSACTION"; 
 
+// syntax for the utility commands (followed by a table name)
+const string VACUUM = "VACUUM";
+const string ANALYZE = "ANALYZE";
+const string FREEZE = "FREEZE";
+const string UNFREEZE = "UNFREEZE";
+
 
 string parse(const SQLStatement* result);
 string expressionToString(const Expr *expr);
@@ -39,88 +73,352 @@ string stringToUppercase(string s);
 // Precondition: the command must be a begin, commit, or rollback statement.
 TransactionStatement parseTransactionCommand(string command);
 
+// Converts a utility command (e.g. "VACUUM foo", "ANALYZE foo" or "FREEZE TABLE foo") to a UtilityStatement (freed by caller).
+// Returns nullptr if the command isn't a utility command.
+UtilityStatement *parseUtilityCommand(string command);
+
+// Removes a "WITH (name = value, ...)" storage-options clause from a CREATE TABLE command (the parser doesn't
+// know about it) and returns the options. Returns no options, and leaves the command alone, if there isn't one.
+TableOptions parseTableOptions(string &command);
+
+// Removes an "EXPLAIN" or "EXPLAIN ANALYZE" prefix from a command (the parser doesn't know about those either)
+// and returns which it was. Returns ExplainMode::NONE, and leaves the command alone, if there isn't one.
+ExplainMode parseExplain(string &command);
+
+// Runs a PREPARE, EXECUTE or DEALLOCATE command (the parser doesn't know about those) and prints the result.
+// Returns false, and does nothing, if the command isn't one of those.
+//   PREPARE name AS statement      (the statement may have ? placeholders for values)
+//   EXECUTE name (value, ...)      (integers or quoted strings, one per placeholder)
+//   DEALLOCATE name
+bool runPreparedCommand(const string &command, ostream &out, ostream &err);
+
+// Prints a statement's result: all of it, or in quiet mode just its row count and how long it took.
+void printResult(ostream &out, const QueryResult &q_result);
+
+// Runs each module's tests (the TEST command), stopping at the first one that fails.
+void runTests();
+
+// Runs a line of input (anything but QUIT and TEST), writing its results to out and any errors to err.
+void runCommand(const string &sqlCmd, ostream &out, ostream &err);
+
+// Waits for a command run by a server session to be durable, writing any error to err (see Server).
+void finishCommand(ostream &err);
+
+// Stops the group commit, checkpoints (so the next start has no log to replay) and closes the environment.
+void closeEnvironment(DbEnv &environment, GroupCommit &groupCommit);
+
+// Batch mode (a script given with -f, or stdin that isn't a terminal): no prompt, no parse tree echo, and
+// output is only flushed when the buffer fills. Quiet mode (--quiet) prints only row counts and timings.
+bool batchMode = false;
+bool quietMode = false;
+bool serverMode = false; // serving clients (--socket or --port) instead of reading commands here
+chrono::steady_clock::time_point statementStarted; // when the statement being run was read
+u_int64_t statementCount = 0;
+
 
 //db environment variables
-u_int32_t env_flags = DB_CREATE | DB_INIT_MPOOL; //If the environment does not exist, create it.  Initialize memory.
+//If the environment does not exist, create it.  Initialize memory, and the write-ahead log and transactions
+//(replaying the log to recover from a crash first). The handle is free-threaded, for the server's sessions and
+//our background threads. Berkeley DB's own locking isn't used: the sessions' transactions lock what they use in
+//our LockManager, which includes every block a transaction writes, since recovery puts back whole blocks.
+u_int32_t env_flags = DB_CREATE | DB_INIT_MPOOL | DB_INIT_LOG | DB_INIT_TXN | DB_RECOVER | DB_THREAD;
+const long DEFAULT_CACHE_MB = 64; // Berkeley DB's buffer pool (--cache-size); its own default is only 256 KB
 u_int32_t db_flags = DB_CREATE; //If the database does not exist, create it.
 DbEnv *_DB_ENV;
+thread_local DbTxn *_DB_TXN = nullptr;
 
 int main(int argc, char **argv) {
-   if(argc != 2){
-        cerr << "Missing path." << endl;
+    string dbPath, scriptPath, socketPath;
+    int port = -1;
+    long commitDelay = GroupCommit::DEFAULT_MAX_DELAY_US;
+    long lockTimeout = LockManager::DEFAULT_TIMEOUT_MS;
+    long cacheMB = DEFAULT_CACHE_MB;
+    bool badArgument = false;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if(arg == "-f" && i + 1 < argc)
+            scriptPath = argv[++i];
+        else if(arg == "--socket" && i + 1 < argc)
+            socketPath = argv[++i];
+        else if(arg == "--port" && i + 1 < argc)
+            port = atoi(argv[++i]);
+        else if(arg == "--quiet" || arg == "-q")
+            quietMode = true;
+        else if(arg == "--commit-delay" && i + 1 < argc)
+            commitDelay = atol(argv[++i]);
+        else if(arg == "--lock-timeout" && i + 1 < argc)
+            lockTimeout = atol(argv[++i]);
+        else if(arg == "--cache-size" && i + 1 < argc)
+            cacheMB = atol(argv[++i]);
+        else if(dbPath.empty() && arg[0] != '-')
+            dbPath = arg;
+        else
+            badArgument = true;
+    }
+    serverMode = !socketPath.empty() || port >= 0;
+    if(port > 65535 || (!socketPath.empty() && port >= 0) || (serverMode && !scriptPath.empty()) ||
+       commitDelay < 0 || commitDelay > 1000000 || lockTimeout < 0 || lockTimeout > 3600000 ||
+       cacheMB < 1 || cacheMB > 1048576)
+        badArgument = true;
+    if(dbPath.empty() || badArgument){
+        if(dbPath.empty())
+            cerr << "Missing path." << endl;
+        cerr << "usage: " << argv[0] << " [-f script.sql] [--quiet] [--commit-delay us] [--lock-timeout ms] [--cache-size mb] dbenvpath" << endl;
+        cerr << "       " << argv[0] << " (--socket socket_path | --port port) [--commit-delay us] [--lock-timeout ms] [--cache-size mb] dbenvpath" << endl;
         return -1;
     }
-    string dbPath = argv[1];
+
+    ifstream script;
+    if(!scriptPath.empty()){
+        script.open(scriptPath);
+        if(!script){
+            cerr << "Cannot open " << scriptPath << endl;
+            return -1;
+        }
+    }
+    istream &input = scriptPath.empty() ? cin : script;
+    batchMode = serverMode || !scriptPath.empty() || !isatty(STDIN_FILENO);
+    if(batchMode){
+        // let cout buffer: don't keep it in step with C stdio or flush it before every read
+        ios::sync_with_stdio(false);
+        cin.tie(nullptr);
+    }
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
 
     //init db environment locally and globally
     DbEnv environment(0U);
     try {
         environment.set_message_stream(&cout);
 	    environment.set_error_stream(&cerr);
+        // writes outside an explicit Berkeley DB transaction are transactions of their own, and commits don't
+        // sync the log (the group commit does that for them)
+        environment.set_flags(DB_AUTO_COMMIT | DB_TXN_NOSYNC, 1);
+        environment.log_set_config(DB_LOG_AUTO_REMOVE, 1);
+        // the cache is sized when the environment's regions are made, which recovery does at every start
+        environment.set_cachesize((u_int32_t) (cacheMB / 1024), (u_int32_t) (cacheMB % 1024) << 20, 1);
 	    environment.open(dbPath.c_str(), env_flags, 0);
     } catch(DbException &E) {
         cout << "Error creating DB environment" << endl;
         exit(EXIT_FAILURE);
     }
     _DB_ENV = &environment;
+    GroupCommit groupCommit((u_int32_t) commitDelay);
+    try {
+        groupCommit.start();
+        TransactionManager::groupCommit = &groupCommit;
+    } catch(system_error &E) {
+        cerr << "Could not start group commit; each commit will flush the log itself" << endl;
+    }
+    VersionStore::get().start();  // forgets old row versions once no snapshot needs them
+    LockManager::get().set_timeout((u_int32_t) lockTimeout);
+    LockManager::get().start();  // breaks deadlocks between sessions waiting for each other's locks
     initialize_schema_tables();     
 
+    // serve clients (see cpsc4300client) instead of reading commands here
+    if(serverMode){
+        Server server(runCommand, SQLExec::end_session, finishCommand);
+        LockManager::get().set_command_lock(&server.get_command_lock());
+        try {
+            if(socketPath.empty())
+                server.listen_tcp((u_int16_t) port);
+            else
+                server.listen_unix(socketPath);
+        } catch (runtime_error &e) {
+            cerr << e.what() << endl;
+            closeEnvironment(environment, groupCommit);
+            return -1;
+        }
+        cout << "listening on " << (socketPath.empty() ? "127.0.0.1:" + to_string(port) : socketPath) << endl;
+        server.serve();
+        closeEnvironment(environment, groupCommit);
+        return 0;
+    }
+
 
     //main parse loop
     while(true){
         string sqlCmd;
-        cout << "SQL> ";
-        getline(cin, sqlCmd);
+        if(!batchMode)
+            cout << "SQL> ";
+        if(!getline(input, sqlCmd))
+            break;
+        if(batchMode && sqlCmd.find_first_not_of(" \t\r") == string::npos)
+            continue;
 
         // uppercase version of the command to support case-insensitivity and transaction parsing
         string uppercaseCommand = stringToUppercase(sqlCmd);
 
         if(uppercaseCommand == QUIT){
             break;
-        }if(uppercaseCommand == "TEST"){
-            TransactionTests::testAll();
-        }
-        // Handle transaction commands separately
-        // See if the string contains "TRANSACTION"
-        if(uppercaseCommand.find("TRANSACTION") != string::npos){
-            TransactionStatement transactionStmt = parseTransactionCommand(uppercaseCommand);
-            try {
-                // cout << ParseTreeToString::statement(statement) << endl;
-                QueryResult *q_result = SQLExec::execute_transaction_command(&transactionStmt);
-                cout << *q_result << endl;
-                delete q_result;
-            }
-            catch (SQLExecError &e) {
-                        cerr << e.what() << endl;
-            }
-        }
-        else{
-            SQLParserResult* result = SQLParser::parseSQLString(sqlCmd);
-            if(!result->isValid()){
-                cout << "Invalid command: " << sqlCmd << endl;
-            } else {
-                for(uint i = 0; i < result->size(); ++i){
-                    const SQLStatement* statement = result->getStatement(i);
-                    try {
-                        cout << ParseTreeToString::statement(statement) << endl;
-                        QueryResult *q_result = SQLExec::execute(statement);
-                        cout << *q_result << endl;
-                        delete q_result;
-                    }
-                    catch (SQLExecError &e) {
-                        cerr << e.what() << endl;
-                    }
-                }
-            }
-            delete result;
+        }if(uppercaseCommand == TEST){
+            runTests();
+            continue;
         }
+        runCommand(sqlCmd, cout, cerr);
     }
 
+    if(quietMode){
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - started;
+        cout << statementCount << " statements in " << fixed << setprecision(3) << elapsed.count() << " s\n";
+    }
+    cout.flush();
+
     //close db environment
-    environment.close(0);
+    closeEnvironment(environment, groupCommit);
     return 0;
 } 
 
+void closeEnvironment(DbEnv &environment, GroupCommit &groupCommit){
+    VersionStore::get().stop();
+    LockManager::get().stop();
+    u_int64_t lockWaits, lockTimeouts, deadlocks;
+    LockManager::get().get_counts(lockWaits, lockTimeouts, deadlocks);
+    if(lockWaits > 0)
+        cout << lockWaits << " lock waits (" << lockTimeouts << " timed out, " << deadlocks << " deadlocks)" << endl;
+    groupCommit.stop();
+    TransactionManager::groupCommit = nullptr;
+    try {
+        environment.txn_checkpoint(0, 0, 0);
+    } catch(DbException &E) {
+        cerr << "Could not checkpoint; the log will be replayed at the next start" << endl;
+    }
+    environment.close(0);
+}
+
+void runTests(){
+    try {
+        TransactionTests::testAll();
+        OverflowFileTests::testAll();
+        Lz4Tests::testAll();
+        ZoneMapTests::testAll();
+        UndoLogTests::testAll();
+        VersionStoreTests::testAll();
+        LockManagerTests::testAll();
+        CatalogCacheTests::testAll();
+        HeapTableTests::testAll();
+        DictionaryTests::testAll();
+        ColumnarTableTests::testAll();
+        BloomFilterTests::testAll();
+        TableStatisticsTests::testAll();
+        JoinPlanTests::testAll();
+        ExplainTests::testAll();
+        PreparedStatementTests::testAll();
+        PageFileTests::testAll();
+        PrefetcherTests::testAll();
+        FrozenFileTests::testAll();
+        DbHandlePoolTests::testAll();
+        cout << "Tests passed!" << endl;
+    } catch (exception &e) {
+        cerr << "Test failed: " << e.what() << endl;
+    }
+}
+
+void finishCommand(ostream &err){
+    try {
+        SQLExec::wait_durable();
+    }
+    catch (SQLExecError &e) {
+        err << e.what() << endl;
+    }
+}
+
+void printResult(ostream &out, const QueryResult &q_result){
+    // not until the statement is durable (a server waits once other sessions can go on: see finishCommand)
+    if(!serverMode)
+        SQLExec::wait_durable();
+    statementCount++;
+    if(quietMode){
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - statementStarted;
+        size_t rows = q_result.get_rows() == nullptr ? 0 : q_result.get_rows()->size();
+        out << rows << (rows == 1 ? " row" : " rows") << " in " << fixed << setprecision(3) << elapsed.count()
+             << " ms\n";
+    } else {
+        out << q_result << '\n';
+    }
+    if(!batchMode)
+        out.flush();
+    statementStarted = chrono::steady_clock::now();
+}
+
+void runCommand(const string &sqlCmd, ostream &out, ostream &err){
+    statementStarted = chrono::steady_clock::now();
+    string command = sqlCmd; // the EXPLAIN prefix and WITH clause get taken off this
+    string uppercaseCommand = stringToUppercase(sqlCmd);
+
+    if(runPreparedCommand(sqlCmd, out, err))
+        return;
+    // Utility commands aren't something the parser knows about either
+    UtilityStatement *utilityStmt = nullptr;
+    try {
+        utilityStmt = parseUtilityCommand(sqlCmd);
+    }
+    catch (SQLExecError &e) {
+        err << e.what() << endl;
+        return;
+    }
+    if(utilityStmt != nullptr){
+        try {
+            QueryResult *q_result = SQLExec::execute_utility_command(utilityStmt);
+            printResult(out, *q_result);
+            delete q_result;
+        }
+        catch (SQLExecError &e) {
+            err << e.what() << endl;
+        }
+        delete utilityStmt;
+    }
+    // Handle transaction commands separately
+    // See if the string contains "TRANSACTION"
+    else if(uppercaseCommand.find("TRANSACTION") != string::npos){
+        TransactionStatement transactionStmt = parseTransactionCommand(uppercaseCommand);
+        try {
+            // out << ParseTreeToString::statement(statement) << endl;
+            QueryResult *q_result = SQLExec::execute_transaction_command(&transactionStmt);
+            printResult(out, *q_result);
+            delete q_result;
+        }
+        catch (SQLExecError &e) {
+            err << e.what() << endl;
+        }
+    }
+    else{
+        TableOptions options;
+        ExplainMode explainMode = parseExplain(command);
+        try {
+            options = parseTableOptions(command);
+        }
+        catch (SQLExecError &e) {
+            err << e.what() << endl;
+            return;
+        }
+        SQLParserResult* result = SQLParser::parseSQLString(command);
+        if(!result->isValid()){
+            out << "Invalid command: " << sqlCmd << endl;
+        } else {
+            for(uint i = 0; i < result->size(); ++i){
+                const SQLStatement* statement = result->getStatement(i);
+                try {
+                    if(!batchMode)
+                        out << ParseTreeToString::statement(statement) << endl;
+                    QueryResult *q_result;
+                    if(explainMode == ExplainMode::NONE)
+                        q_result = SQLExec::execute(statement, statement->type() == kStmtCreate ? &options : nullptr);
+                    else if(statement->type() == kStmtSelect)
+                        q_result = SQLExec::explain((const SelectStatement *) statement, explainMode);
+                    else
+                        throw SQLExecError("Error: only SELECT statements can be explained");
+                    printResult(out, *q_result);
+                    delete q_result;
+                }
+                catch (SQLExecError &e) {
+                    err << e.what() << endl;
+                }
+            }
+        }
+        delete result;
+    }
+}
+
 // convert string to uppercase
 string stringToUppercase(string s){
     string result = "";
@@ -145,6 +443,141 @@ TransactionStatement parseTransactionCommand(string command){
     return TransactionStatement(TransactionStatement::COMMIT);
 }
 
+UtilityStatement *parseUtilityCommand(string command){
+    istringstream words(command);
+    string keyword, tableName, extra;
+    words >> keyword >> tableName;
+    keyword = stringToUppercase(keyword);
+    if(keyword != VACUUM && keyword != ANALYZE && keyword != FREEZE && keyword != UNFREEZE)
+        return nullptr;
+    if((keyword == FREEZE || keyword == UNFREEZE) && stringToUppercase(tableName) == "TABLE"){
+        tableName.clear(); // FREEZE TABLE foo, the same as FREEZE foo
+        words >> tableName;
+    }
+
+    // allow a trailing semicolon, either attached to the table name or on its own
+    if(!tableName.empty() && tableName.back() == ';')
+        tableName.pop_back();
+    if(words >> extra && extra != ";")
+        tableName = ""; // something unexpected after the table name
+    if(tableName.empty())
+        throw SQLExecError("Invalid command: " + command);
+    UtilityStatement::ActionType type = UtilityStatement::VACUUM;
+    if(keyword == ANALYZE)
+        type = UtilityStatement::ANALYZE;
+    else if(keyword == FREEZE)
+        type = UtilityStatement::FREEZE;
+    else if(keyword == UNFREEZE)
+        type = UtilityStatement::UNFREEZE;
+    return new UtilityStatement(type, tableName);
+}
+
+bool runPreparedCommand(const string &command, ostream &out, ostream &err){
+    static const regex prepare("^\\s*PREPARE\\s+(\\w+)\\s+(AS|FROM)\\s+(.*)$", regex::icase);
+    static const regex execute("^\\s*EXECUTE\\s+(\\w+)\\s*(\\((.*)\\))?\\s*;?\\s*$", regex::icase);
+    static const regex deallocate("^\\s*DEALLOCATE\\s+(PREPARE\\s+)?(\\w+)\\s*;?\\s*$", regex::icase);
+    static const regex keyword("^\\s*(PREPARE|EXECUTE|DEALLOCATE)\\b", regex::icase);
+    if(!regex_search(command, keyword))
+        return false;
+
+    smatch match;
+    try {
+        QueryResult *q_result;
+        if(regex_match(command, match, prepare)){
+            q_result = SQLExec::prepare(match[1].str(), match[3].str());
+        } else if(regex_match(command, match, deallocate)){
+            q_result = SQLExec::deallocate(match[2].str());
+        } else if(regex_match(command, match, execute)){
+            // values are separated by commas, except inside quotes
+            vector<Value> parameters;
+            string list = match[3].str();
+            size_t i = 0;
+            while(list.find_first_not_of(" \t", i) != string::npos){
+                i = list.find_first_not_of(" \t", i);
+                if(list[i] == '\'' || list[i] == '"'){
+                    size_t end = list.find(list[i], i + 1);
+                    if(end == string::npos)
+                        throw SQLExecError("Invalid command: " + command);
+                    parameters.push_back(Value(list.substr(i + 1, end - i - 1)));
+                    i = end + 1;
+                } else {
+                    size_t end = list.find(',', i);
+                    string number = list.substr(i, end == string::npos ? string::npos : end - i);
+                    number.erase(number.find_last_not_of(" \t") + 1);
+                    if(!regex_match(number, regex("-?[0-9]{1,10}")) || stoll(number) != (int32_t) stoll(number))
+                        throw SQLExecError("Invalid parameter: " + number);
+                    parameters.push_back(Value((int32_t) stoll(number)));
+                    i = end == string::npos ? list.size() : end;
+                }
+                i = list.find_first_not_of(" \t", i);
+                if(i != string::npos && list[i++] != ',')
+                    throw SQLExecError("Invalid command: " + command);
+            }
+            q_result = SQLExec::execute_prepared(match[1].str(), parameters);
+        } else {
+            throw SQLExecError("Invalid command: " + command);
+        }
+        printResult(out, *q_result);
+        delete q_result;
+    }
+    catch (SQLExecError &e) {
+        err << e.what() << endl;
+    }
+    return true;
+}
+
+ExplainMode parseExplain(string &command){
+    static const regex explain("^\\s*EXPLAIN\\s+(ANALYZE\\s+)?", regex::icase);
+    smatch match;
+    if(!regex_search(command, match, explain))
+        return ExplainMode::NONE;
+    ExplainMode mode = match[1].matched ? ExplainMode::ANALYZE : ExplainMode::PLAN;
+    command = match.suffix().str();
+    return mode;
+}
+
+TableOptions parseTableOptions(string &command){
+    TableOptions options;
+    static const regex create("^\\s*CREATE\\s+TABLE\\b", regex::icase);
+    static const regex withClause("\\bWITH\\s*\\(([^()]*)\\)", regex::icase);
+    smatch match;
+    if(!regex_search(command, create) || !regex_search(command, match, withClause))
+        return options;
+
+    // options are separated by commas, except inside quotes (e.g. dictionary = 'status, category')
+    vector<string> optionList(1);
+    char quote = 0;
+    for(char ch : match[1].str()){
+        if(quote == 0 && ch == ',')
+            optionList.push_back("");
+        else
+            optionList.back() += ch;
+        if(quote == 0 && (ch == '\'' || ch == '"'))
+            quote = ch;
+        else if(ch == quote)
+            quote = 0;
+    }
+    for(string option : optionList){
+        size_t equals = option.find('=');
+        if(equals == string::npos)
+            throw SQLExecError("Invalid table option: " + option);
+        string name = option.substr(0, equals);
+        string value = option.substr(equals + 1);
+        // trim whitespace and any quotes around the value
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        value.erase(0, value.find_first_not_of(" \t\"'"));
+        value.erase(value.find_last_not_of(" \t\"'") + 1);
+        if(name.empty() || value.empty())
+            throw SQLExecError("Invalid table option: " + option);
+        for(char &ch : name)
+            ch = tolower(ch);
+        options[name] = value;
+    }
+    command.erase(match.position(0), match.length(0));
+    return options;
+}
+
 string expressionToString(const Expr *expr) {
     string ret;
     switch (expr->type){
@@ -0,0 +1,70 @@
+// Client for cpsc4300's server mode: sends each line of input to the server and prints what comes back.
+//   cpsc4300client (-s socket_path | -p port) [-f script.sql]
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include "Protocol.h"
+
+using namespace std;
+
+int main(int argc, char **argv) {
+    string socketPath, scriptPath;
+    int port = -1;
+    bool badArgument = false;
+    for(int i = 1; i < argc; i++){
+        string arg = argv[i];
+        if(arg == "-s" && i + 1 < argc)
+            socketPath = argv[++i];
+        else if(arg == "-p" && i + 1 < argc)
+            port = atoi(argv[++i]);
+        else if(arg == "-f" && i + 1 < argc)
+            scriptPath = argv[++i];
+        else
+            badArgument = true;
+    }
+    if(badArgument || socketPath.empty() == (port < 0) || port > 65535){
+        cerr << "usage: " << argv[0] << " (-s socket_path | -p port) [-f script.sql]" << endl;
+        return -1;
+    }
+
+    int fd = socketPath.empty() ? Protocol::connect_tcp((u_int16_t) port) : Protocol::connect_unix(socketPath);
+    if(fd < 0){
+        cerr << "Cannot connect: " << strerror(errno) << endl;
+        return -1;
+    }
+
+    ifstream script;
+    if(!scriptPath.empty()){
+        script.open(scriptPath);
+        if(!script){
+            cerr << "Cannot open " << scriptPath << endl;
+            return -1;
+        }
+    }
+    istream &input = scriptPath.empty() ? cin : script;
+    bool interactive = scriptPath.empty() && isatty(STDIN_FILENO);
+
+    string command, response;
+    while(true){
+        if(interactive)
+            cout << "SQL> " << flush;
+        if(!getline(input, command))
+            break;
+        if(command.find_first_not_of(" \t\r") == string::npos)
+            continue;
+        if(!Protocol::send_message(fd, command))
+            break;
+        if(!Protocol::receive_message(fd, response))
+            break;  // the server hung up, e.g. after QUIT
+        if(!response.empty())
+            (response[0] == Protocol::RESPONSE_OK ? cout : cerr) << response.substr(1);
+        if(interactive)
+            cout << flush;
+    }
+    close(fd);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include "storage_engine.h"
+#include "UndoLog.h"
 
 bool Value::operator==(const Value &other) const {
     if (this->data_type != other.data_type)
@@ -28,6 +29,51 @@ bool Value::operator<(const Value &other) const {
     return this->n < other.n;
 }
 
+void ValueRange::restrict_min(const Value &bound, bool inclusive) {
+    if (!this->has_min || this->min < bound || (this->min == bound && !inclusive)) {
+        this->has_min = true;
+        this->min = bound;
+        this->min_inclusive = inclusive;
+    }
+}
+
+void ValueRange::restrict_max(const Value &bound, bool inclusive) {
+    if (!this->has_max || bound < this->max || (this->max == bound && !inclusive)) {
+        this->has_max = true;
+        this->max = bound;
+        this->max_inclusive = inclusive;
+    }
+}
+
+bool ValueRange::is_equality() const {
+    return this->has_min && this->has_max && this->min_inclusive && this->max_inclusive &&
+           !(this->min < this->max) && !(this->max < this->min);
+}
+
+bool ValueRange::contains(const Value &value) const {
+    if (this->has_min) {
+        if (value.data_type != this->min.data_type)
+            return false;
+        if (this->min_inclusive ? value < this->min : !(this->min < value))
+            return false;
+    }
+    if (this->has_max) {
+        if (value.data_type != this->max.data_type)
+            return false;
+        if (this->max_inclusive ? this->max < value : !(value < this->max))
+            return false;
+    }
+    return true;
+}
+
+bool ValueRange::overlaps(const Value &low, const Value &high) const {
+    if (this->has_min && (this->min_inclusive ? high < this->min : !(this->min < high)))
+        return false;
+    if (this->has_max && (this->max_inclusive ? this->max < low : !(low < this->max)))
+        return false;
+    return true;
+}
+
 
 
 
@@ -50,6 +96,41 @@ ColumnAttributes *DbRelation::get_column_attributes(const ColumnNames &select_co
     return ret;
 }
 
+Handles *DbRelation::select(const ValueRanges &ranges) {
+    ColumnNames column_names;
+    for (auto const &range: ranges)
+        column_names.push_back(range.first);
+    Handles *handles = new Handles();
+    Handles *all = select();
+    for (auto const &handle: *all) {
+        ValueDict *row = project(handle, &column_names);
+        bool selected = true;
+        for (auto const &range: ranges)
+            selected = selected && range.second.contains((*row)[range.first]);
+        if (selected)
+            handles->push_back(handle);
+        delete row;
+    }
+    delete all;
+    return handles;
+}
+
+Handles *DbRelation::sample(BlockID max_blocks, BlockID &picked, BlockID &block_count) {
+    Handles *handles = select();
+    block_count = 0;
+    for (auto const &handle: *handles)
+        block_count = std::max(block_count, handle.first);
+    picked = block_count;
+    return handles;
+}
+
+Handle DbRelation::undo(const UndoRecord &record) {
+    if (record.kind != UndoRecord::CREATED)
+        throw DbRelationError("can't roll back changes to " + this->table_name);
+    drop();
+    return record.handle;
+}
+
 // Do a projection for each of a list of handles
 ValueDicts *DbRelation::project(Handles *handles) {
     ValueDicts *ret = new ValueDicts();
@@ -20,6 +20,12 @@
  */
 extern DbEnv *_DB_ENV;
 
+/**
+ * The Berkeley DB transaction that this thread's writes are part of (nullptr to have each write commit on its
+ * own). Set by the TransactionManager for the statement or transaction being run.
+ */
+extern thread_local DbTxn *_DB_TXN;
+
 /*
  * Convenient aliases for types
  */
@@ -28,6 +34,8 @@ typedef u_int32_t BlockID;
 typedef std::vector<RecordID> RecordIDs;
 typedef std::length_error DbBlockNoRoomError;
 
+struct UndoRecord;
+
 /**
  * @class DbBlock - abstract base class for blocks in our database files 
  * (DbBlock's belong to DbFile's.)
@@ -46,15 +54,22 @@ typedef std::length_error DbBlockNoRoomError;
 class DbBlock {
 public:
     /**
-     * our blocks are 4kB
+     * our blocks are 4kB unless a table asks for bigger ones (up to MAX_BLOCK_SZ) when it is created
      */
     static const uint BLOCK_SZ = 4096;
 
+    static const uint MAX_BLOCK_SZ = 65536;
+
     /**
      * ctor/dtor (subclasses should handle the big-5)
      */
     DbBlock(Dbt &block, BlockID block_id, bool is_new = false) : block(block), block_id(block_id) {}
 
+    /**
+     * ctor for subclasses that point block at memory of their own
+     */
+    explicit DbBlock(BlockID block_id) : block(), block_id(block_id) {}
+
     virtual ~DbBlock() {}
 
     /**
@@ -93,6 +108,12 @@ public:
      */
     virtual RecordIDs *ids()  {return nullptr;};
 
+    /**
+     * Get how much room is left in this block for a new record.
+     * @returns  the largest record size that add() would currently accept
+     */
+    virtual u_int32_t get_free_space() { return 0; }
+
     /**
      * Access the whole block's memory as a BerkeleyDB Dbt pointer.
      * @returns  Dbt used by this block
@@ -231,6 +252,47 @@ public:
     bool operator<(const Value &other) const;
 };
 
+/**
+ * @class ValueRange - the values a column may take to satisfy a where clause, e.g. ts > 100 AND ts <= 200
+ * Either bound may be missing, and each is inclusive or exclusive. An equality is a range with min == max.
+ */
+class ValueRange {
+public:
+    bool has_min;
+    bool min_inclusive;
+    Value min;
+    bool has_max;
+    bool max_inclusive;
+    Value max;
+
+    ValueRange() : has_min(false), min_inclusive(true), has_max(false), max_inclusive(true) {}
+
+    /**
+     * Tighten the lower bound (a looser one than the current bound changes nothing).
+     */
+    void restrict_min(const Value &bound, bool inclusive);
+
+    /**
+     * Tighten the upper bound (a looser one than the current bound changes nothing).
+     */
+    void restrict_max(const Value &bound, bool inclusive);
+
+    /**
+     * Is this range a single value, i.e. an equality?
+     */
+    bool is_equality() const;
+
+    /**
+     * Is the value in the range? (Never, if it is of a different type from the bounds.)
+     */
+    bool contains(const Value &value) const;
+
+    /**
+     * Could any value between low and high (inclusive) be in the range?
+     */
+    bool overlaps(const Value &low, const Value &high) const;
+};
+
 // More type aliases
 typedef std::string Identifier;
 typedef std::vector<Identifier> ColumnNames;
@@ -239,6 +301,8 @@ typedef std::pair<BlockID, RecordID> Handle;
 typedef std::vector<Handle> Handles;  // FIXME: will need to turn this into an iterator at some point
 typedef std::map<Identifier, Value> ValueDict;
 typedef std::vector<ValueDict *> ValueDicts;
+typedef std::map<Identifier, std::string> TableOptions;  // physical storage options, e.g. {"page_size": "8192"}
+typedef std::map<Identifier, ValueRange> ValueRanges;  // ANDed together
 
 
 /**
@@ -343,6 +407,29 @@ public:
      */
     virtual Handles *select(const ValueDict *where) = 0;
 
+    /**
+     * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <ranges>
+     * The default checks every row; storage engines that keep summaries of their blocks can do better.
+     * @param ranges  a range for each column with a where-clause predicate on it
+     * @returns       a pointer to a list of handles for qualifying rows (freed by caller)
+     */
+    virtual Handles *select(const ValueRanges &ranges);
+
+    /**
+     * Pick rows for working out statistics about the table (see ANALYZE). The rows come a block at a time,
+     * so every row of each block picked is included. The default picks every block.
+     * @param max_blocks    at most this many blocks are picked
+     * @param picked        returned by reference: the number of blocks picked
+     * @param block_count   returned by reference: the number of blocks in the table
+     * @returns             a pointer to a list of handles for the picked rows (freed by caller)
+     */
+    virtual Handles *sample(BlockID max_blocks, BlockID &picked, BlockID &block_count);
+
+    /**
+     * Number of blocks the table's rows take up (0 if the storage engine can't tell).
+     */
+    virtual BlockID get_block_count() { return 0; }
+
     /**
      * Return a sequence of all values for handle (SELECT *).
      * @param handle  row to get values from
@@ -358,15 +445,28 @@ public:
      * @returns             dictionary of values from row (keyed by column_names)
      */
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names) = 0;
+
+    /**
+     * Reverse a change recorded in an UndoLog (for ROLLBACK). The change must be the latest one to the row
+     * involved that hasn't been reversed yet. The default can only reverse creating the table.
+     * @param record  the change
+     * @returns       where the row is now (which is record.handle unless putting it back had to move it)
+     * @throws        DbRelationError if the storage engine can't reverse that kind of change
+     */
+    virtual Handle undo(const UndoRecord &record);
     
     virtual const ColumnNames &get_column_names() const {
         return column_names;
     }
 
+    virtual const Identifier &get_table_name() const {
+        return table_name;
+    }
+
     ColumnAttributes* get_column_attributes(const ColumnNames &select_column_names) const;
     ValueDict* project(Handle handle, const ValueDict *where);
-    ValueDicts* project(Handles *handles);
-    ValueDicts* project(Handles *handles, const ColumnNames *column_names);
+    virtual ValueDicts* project(Handles *handles);
+    virtual ValueDicts* project(Handles *handles, const ColumnNames *column_names);
     // ValueDicts* project(Handles *handles, const ValueDict * &where);
 
 protected:
@@ -441,6 +541,18 @@ public:
      */
     virtual void del(Handle record) = 0;
 
+    /**
+     * Take over the files of an index built (by VACUUM) on a copy of the relation that has just replaced it, so
+     * that the rows' new handles are what this index finds. An index without files of its own has nothing to
+     * take over.
+     * @param built  the index built on the copy, which must be closed (and isn't used again)
+     */
+    virtual void swap_in(DbIndex &built) {}
+
+    virtual const Identifier &get_name() const {
+        return name;
+    }
+
 protected:
     DbRelation &relation;
     Identifier name;